@@ -4,6 +4,8 @@
 // Set 8-byte alignment for all types in this header
 #pragma pack(push, 8)
 
+#include "OutputBuffer.h"
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
@@ -13,6 +15,7 @@ namespace bbfm {
 class ASTNode;
 class AST;
 class Declaration;
+class ImportDeclaration;
 class EnumDeclaration;
 class ClassDeclaration;
 class Field;
@@ -27,6 +30,8 @@ class MemberAccessExpression;
 class LiteralExpression;
 class FunctionCall;
 class ParenthesizedExpression;
+class QuantifiedExpression;
+class JsonWriter;
 
 // ============================================================================
 // Base AST Node
@@ -38,14 +43,37 @@ class ASTNode
 public:
     virtual ~ASTNode() = default;
 
-    /// \brief Dump the AST node to stdout for debugging
+    /// \brief Dump the AST node as text for debugging
+    /// \param out Output buffer
     /// \param indent Indentation level for pretty printing
-    virtual void Dump(int indent = 0) const = 0;
+    virtual void Dump(OutputBuffer& out, int indent = 0) const = 0;
+
+    /// \brief Write the AST node as one JSON value
+    /// \param json JSON writer
+    virtual void DumpJson(JsonWriter& json) const = 0;
+
+    /// \brief Set the source location of the node's name
+    /// \param line Line (1-based)
+    /// \param column Column (1-based)
+    void SetLocation(const int line, const int column);
+
+    /// \brief Get the source line of the node's name
+    /// \return Line (1-based), 0 if unknown
+    int GetLine() const;
+
+    /// \brief Get the source column of the node's name
+    /// \return Column (1-based), 0 if unknown
+    int GetColumn() const;
 
 protected:
     /// \brief Print indentation for pretty printing
+    /// \param out Output buffer
     /// \param indent Number of indentation levels
-    void PrintIndent(int indent) const;
+    void PrintIndent(OutputBuffer& out, int indent) const;
+
+private:
+    int line_   = 0; // Set by the parser for declarations, fields and invariants
+    int column_ = 0;
 };
 
 // ============================================================================
@@ -96,7 +124,9 @@ public:
 
     bool IsUserDefined() const override;
 
-    void Dump(int indent = 0) const override;
+    void Dump(OutputBuffer& out, int indent = 0) const override;
+
+    void DumpJson(JsonWriter& json) const override;
 
     /// \brief Convert primitive type to string representation
     /// \param type The primitive type to convert
@@ -123,7 +153,9 @@ public:
 
     bool IsUserDefined() const override;
 
-    void Dump(int indent = 0) const override;
+    void Dump(OutputBuffer& out, int indent = 0) const override;
+
+    void DumpJson(JsonWriter& json) const override;
 
 private:
     std::string typeName_;
@@ -137,7 +169,9 @@ private:
 enum class ModifierType
 {
     CARDINALITY, // [1], [0..1], [1..*], [0..*]
-    UNIQUE       // [unique]
+    UNIQUE,      // [unique]
+    INTERNED,    // [interned]
+    ENCODING     // [encoding(rle)]
 };
 
 /// \brief Base class for field modifiers
@@ -191,7 +225,9 @@ public:
     /// \return True if maximum cardinality is unbounded or greater than 1
     bool IsArray() const;
 
-    void Dump(int indent = 0) const override;
+    void Dump(OutputBuffer& out, int indent = 0) const override;
+
+    void DumpJson(JsonWriter& json) const override;
 
 private:
     int minCardinality_;
@@ -205,7 +241,47 @@ public:
     /// \brief Construct a unique modifier
     UniqueModifier() : Modifier(ModifierType::UNIQUE) {}
 
-    void Dump(int indent = 0) const override;
+    void Dump(OutputBuffer& out, int indent = 0) const override;
+
+    void DumpJson(JsonWriter& json) const override;
+};
+
+/// \brief Interned storage modifier for low-cardinality String fields
+///
+/// Values of an interned field are deduplicated in a shared string table and the
+/// field stores a 32-bit symbol id, so equal values are stored once and compare
+/// by id instead of by content.
+class InternedModifier : public Modifier
+{
+public:
+    /// \brief Construct an interned modifier
+    InternedModifier() : Modifier(ModifierType::INTERNED) {}
+
+    void Dump(OutputBuffer& out, int indent = 0) const override;
+
+    void DumpJson(JsonWriter& json) const override;
+};
+
+/// \brief Columnar encoding modifier (e.g., [encoding(rle)])
+///
+/// Overrides the default encoding of the field's column in columnar storage.
+class EncodingModifier : public Modifier
+{
+public:
+    /// \brief Construct an encoding modifier
+    /// \param encoding The encoding name (plain, bitpacked, dictionary, rle, delta)
+    explicit EncodingModifier(const std::string& encoding) : Modifier(ModifierType::ENCODING), encoding_(encoding) {}
+
+    /// \brief Get the encoding name
+    /// \return The encoding name as written in source
+    const std::string& GetEncoding() const;
+
+    void Dump(OutputBuffer& out, int indent = 0) const override;
+
+    void DumpJson(JsonWriter& json) const override;
+
+private:
+    std::string encoding_;
 };
 
 // ============================================================================
@@ -237,9 +313,21 @@ public:
     /// \return The expression result type
     virtual Type GetResultType() const = 0;
 
+    /// \brief Convert an expression type to its BBFM type name
+    /// \param type The type to convert
+    /// \return Type name (e.g., "Timestamp")
+    static const char* TypeToString(const Type type);
+
     /// \brief Convert expression to string representation
     /// \return String representation of the expression
-    virtual std::string ToString() const = 0;
+    std::string ToString() const;
+
+    /// \brief Append the string representation of the expression
+    ///
+    /// Subexpressions append to the same buffer, so printing is linear in
+    /// the size of the expression however deeply it nests.
+    /// \param out Output buffer
+    virtual void Print(OutputBuffer& out) const = 0;
 };
 
 /// \brief Binary expression (arithmetic, comparison, logical operations)
@@ -273,9 +361,10 @@ public:
     /// \param right Right operand
     BinaryExpression(std::unique_ptr<Expression> left, const Op op, std::unique_ptr<Expression> right);
 
-    Type        GetResultType() const override;
-    std::string ToString() const override;
-    void        Dump(int indent = 0) const override;
+    Type GetResultType() const override;
+    void Print(OutputBuffer& out) const override;
+    void Dump(OutputBuffer& out, int indent = 0) const override;
+    void DumpJson(JsonWriter& json) const override;
 
     /// \brief Get the left operand
     /// \return Pointer to left expression
@@ -294,6 +383,20 @@ public:
     /// \return String representation of operator
     static const char* OpToString(const Op op);
 
+    /// \brief Infer the result type of an arithmetic operator
+    ///
+    /// Timestamp and Timespan are 64-bit integer microsecond counts, so temporal
+    /// arithmetic stays integral: Timestamp - Timestamp is a Timespan, Timestamp
+    /// +/- Timespan is a Timestamp, and Timespan can be added, subtracted, scaled
+    /// by Int and divided. An Int added to or subtracted from a temporal value
+    /// is a microsecond count, like a Timespan. Mixing temporal values with Real
+    /// is not allowed.
+    /// \param op The arithmetic operator (ADD, SUB, MUL, DIV or MOD)
+    /// \param leftType Type of the left operand
+    /// \param rightType Type of the right operand
+    /// \return The result type, or UNKNOWN if the operands are not valid for the operator
+    static Type InferArithmeticType(const Op op, const Type leftType, const Type rightType);
+
 private:
     std::unique_ptr<Expression> left_;
     std::unique_ptr<Expression> right_;
@@ -316,9 +419,10 @@ public:
     /// \param operand The operand
     UnaryExpression(const Op op, std::unique_ptr<Expression> operand);
 
-    Type        GetResultType() const override;
-    std::string ToString() const override;
-    void        Dump(int indent = 0) const override;
+    Type GetResultType() const override;
+    void Print(OutputBuffer& out) const override;
+    void Dump(OutputBuffer& out, int indent = 0) const override;
+    void DumpJson(JsonWriter& json) const override;
 
     /// \brief Get the operand
     /// \return Pointer to operand expression
@@ -346,9 +450,10 @@ public:
     /// \param fieldName The name of the field
     explicit FieldReference(const std::string& fieldName);
 
-    Type        GetResultType() const override;
-    std::string ToString() const override;
-    void        Dump(int indent = 0) const override;
+    Type GetResultType() const override;
+    void Print(OutputBuffer& out) const override;
+    void Dump(OutputBuffer& out, int indent = 0) const override;
+    void DumpJson(JsonWriter& json) const override;
 
     /// \brief Get the field name
     /// \return The field name
@@ -367,9 +472,10 @@ public:
     /// \param memberName The name of the member being accessed
     MemberAccessExpression(std::unique_ptr<Expression> object, const std::string& memberName);
 
-    Type        GetResultType() const override;
-    std::string ToString() const override;
-    void        Dump(int indent = 0) const override;
+    Type GetResultType() const override;
+    void Print(OutputBuffer& out) const override;
+    void Dump(OutputBuffer& out, int indent = 0) const override;
+    void DumpJson(JsonWriter& json) const override;
 
     /// \brief Get the object expression
     /// \return The object expression
@@ -404,9 +510,10 @@ public:
     /// \param value The boolean value
     explicit LiteralExpression(const bool value);
 
-    Type        GetResultType() const override;
-    std::string ToString() const override;
-    void        Dump(int indent = 0) const override;
+    Type GetResultType() const override;
+    void Print(OutputBuffer& out) const override;
+    void Dump(OutputBuffer& out, int indent = 0) const override;
+    void DumpJson(JsonWriter& json) const override;
 
     /// \brief Get the integer value (if type is INT)
     /// \return The integer value
@@ -441,9 +548,10 @@ public:
     /// \param arguments The function arguments
     FunctionCall(const std::string& functionName, std::vector<std::unique_ptr<Expression>> arguments);
 
-    Type        GetResultType() const override;
-    std::string ToString() const override;
-    void        Dump(int indent = 0) const override;
+    Type GetResultType() const override;
+    void Print(OutputBuffer& out) const override;
+    void Dump(OutputBuffer& out, int indent = 0) const override;
+    void DumpJson(JsonWriter& json) const override;
 
     /// \brief Get the function name
     /// \return The function name
@@ -466,9 +574,10 @@ public:
     /// \param expr The inner expression
     explicit ParenthesizedExpression(std::unique_ptr<Expression> expr);
 
-    Type        GetResultType() const override;
-    std::string ToString() const override;
-    void        Dump(int indent = 0) const override;
+    Type GetResultType() const override;
+    void Print(OutputBuffer& out) const override;
+    void Dump(OutputBuffer& out, int indent = 0) const override;
+    void DumpJson(JsonWriter& json) const override;
 
     /// \brief Get the inner expression
     /// \return Pointer to the inner expression
@@ -478,6 +587,57 @@ private:
     std::unique_ptr<Expression> expr_;
 };
 
+/// \brief Quantified expression over a collection (forall/exists)
+class QuantifiedExpression : public Expression
+{
+public:
+    /// \brief Quantifiers
+    enum class Quantifier
+    {
+        FORALL, // forall x in c: body
+        EXISTS  // exists x in c: body
+    };
+
+    /// \brief Construct a quantified expression
+    /// \param quantifier The quantifier
+    /// \param variableName Name of the bound variable
+    /// \param collection The collection the variable ranges over
+    /// \param body The boolean predicate evaluated for each element
+    QuantifiedExpression(const Quantifier quantifier, const std::string& variableName, std::unique_ptr<Expression> collection, std::unique_ptr<Expression> body);
+
+    Type GetResultType() const override;
+    void Print(OutputBuffer& out) const override;
+    void Dump(OutputBuffer& out, int indent = 0) const override;
+    void DumpJson(JsonWriter& json) const override;
+
+    /// \brief Get the quantifier
+    /// \return The quantifier
+    Quantifier GetQuantifier() const;
+
+    /// \brief Get the bound variable name
+    /// \return The variable name
+    const std::string& GetVariableName() const;
+
+    /// \brief Get the collection expression
+    /// \return Pointer to the collection expression
+    const Expression* GetCollection() const;
+
+    /// \brief Get the predicate body
+    /// \return Pointer to the body expression
+    const Expression* GetBody() const;
+
+    /// \brief Convert quantifier to string
+    /// \param quantifier The quantifier to convert
+    /// \return String representation of the quantifier
+    static const char* QuantifierToString(const Quantifier quantifier);
+
+private:
+    Quantifier                  quantifier_;
+    std::string                 variableName_;
+    std::unique_ptr<Expression> collection_;
+    std::unique_ptr<Expression> body_;
+};
+
 // ============================================================================
 // Invariant Declaration
 // ============================================================================
@@ -499,7 +659,9 @@ public:
     /// \return The boolean expression
     const Expression* GetExpression() const;
 
-    void Dump(int indent = 0) const override;
+    void Dump(OutputBuffer& out, int indent = 0) const override;
+
+    void DumpJson(JsonWriter& json) const override;
 
 private:
     std::string                 name_;
@@ -559,7 +721,17 @@ public:
     /// \return True if field has unique modifier
     bool HasUniqueConstraint() const;
 
-    void Dump(int indent = 0) const override;
+    /// \brief Check if field uses interned string storage
+    /// \return True if the field has the [interned] modifier
+    bool IsInterned() const;
+
+    /// \brief Get the encoding modifier if present
+    /// \return Pointer to encoding modifier or nullptr
+    const EncodingModifier* GetEncodingModifier() const;
+
+    void Dump(OutputBuffer& out, int indent = 0) const override;
+
+    void DumpJson(JsonWriter& json) const override;
 
 private:
     std::unique_ptr<TypeSpec>              type_;
@@ -569,6 +741,30 @@ private:
     std::unique_ptr<Expression>            initializer_;
 };
 
+// ============================================================================
+// Import Declaration
+// ============================================================================
+
+/// \brief Represents an import of another model file (import "assets.fm";)
+class ImportDeclaration : public ASTNode
+{
+public:
+    /// \brief Construct an import declaration
+    /// \param path The imported path as written, without quotes
+    explicit ImportDeclaration(const std::string& path) : path_(path) {}
+
+    /// \brief Get the imported path
+    /// \return The path as written (relative paths are relative to the importing file)
+    const std::string& GetPath() const;
+
+    void Dump(OutputBuffer& out, int indent = 0) const override;
+
+    void DumpJson(JsonWriter& json) const override;
+
+private:
+    std::string path_;
+};
+
 // ============================================================================
 // Enum Declaration
 // ============================================================================
@@ -590,7 +786,9 @@ public:
     /// \return Vector of enum value names
     const std::vector<std::string>& GetValues() const;
 
-    void Dump(int indent = 0) const override;
+    void Dump(OutputBuffer& out, int indent = 0) const override;
+
+    void DumpJson(JsonWriter& json) const override;
 
 private:
     std::string              name_;
@@ -637,7 +835,9 @@ public:
     /// \return Vector of invariant declarations
     const std::vector<std::unique_ptr<Invariant>>& GetInvariants() const;
 
-    void Dump(int indent = 0) const override;
+    void Dump(OutputBuffer& out, int indent = 0) const override;
+
+    void DumpJson(JsonWriter& json) const override;
 
 private:
     std::string                             name_;
@@ -681,11 +881,66 @@ public:
     /// \return Pointer to class declaration or nullptr
     const ClassDeclaration* AsClass() const;
 
-    void Dump(int indent = 0) const override;
+    /// \brief Move the recorded source locations by a number of lines
+    ///
+    /// Used when an unchanged declaration is reused from an earlier parse
+    /// after lines were inserted or removed above it.
+    /// \param delta Number of lines to add (negative to move up)
+    void ShiftLines(const int delta);
+
+    /// \brief Set the hash of the declaration's source text
+    ///
+    /// Set by the incremental parser; the semantic analyzer uses it to reuse
+    /// the results of unchanged declarations.
+    /// \param hash The hash (0 if unknown)
+    void SetSourceHash(const uint64_t hash);
+
+    /// \brief Get the hash of the declaration's source text
+    /// \return The hash, 0 if unknown
+    uint64_t GetSourceHash() const;
+
+    /// \brief Set the file the declaration was parsed from
+    /// \param sourceFile Source file path as given to the parser
+    void SetSourceFile(const std::string& sourceFile);
+
+    /// \brief Get the file the declaration was parsed from
+    /// \return Source file path, empty if unknown
+    const std::string& GetSourceFile() const;
+
+    /// \brief Mark the declaration as incomplete after syntax error recovery
+    ///
+    /// Set by the parser when a member was dropped, or when only the name of a
+    /// dropped declaration is left. Semantic analysis does not validate such a
+    /// declaration, so its missing parts cause no follow-up errors.
+    /// \param hadSyntaxError True if error recovery dropped part of the declaration
+    void SetHadSyntaxError(const bool hadSyntaxError);
+
+    /// \brief Check whether error recovery dropped part of the declaration
+    /// \return True if the declaration is incomplete
+    bool HadSyntaxError() const;
+
+    /// \brief Get the identity of the declaration
+    ///
+    /// Unique among all declarations created by the process, unlike the address,
+    /// which a later declaration may reuse. The semantic analyzer uses it to
+    /// tell a declaration reused from an earlier parse from a new one.
+    /// \return The identity, never 0
+    uint64_t GetId() const;
+
+    void Dump(OutputBuffer& out, int indent = 0) const override;
+
+    void DumpJson(JsonWriter& json) const override;
 
 private:
     Kind                     kind_;
     std::unique_ptr<ASTNode> declaration_;
+    uint64_t                 sourceHash_ = 0;
+    std::string              sourceFile_;            // Attached to the semantic errors of the declaration
+    bool                     hadSyntaxError_ = false; // Part of the declaration was dropped by error recovery
+    uint64_t                 id_             = NextId();
+
+    /// \brief Get a new declaration identity (thread-safe, declarations are created by parallel parses)
+    static uint64_t NextId();
 };
 
 // ============================================================================
@@ -704,11 +959,45 @@ public:
     /// \return Vector of declarations
     const std::vector<std::unique_ptr<Declaration>>& GetDeclarations() const;
 
-    void Dump(int indent = 0) const override;
+    /// \brief Move all declarations out of the AST, leaving it empty
+    /// \return Vector of declarations
+    std::vector<std::unique_ptr<Declaration>> TakeDeclarations();
+
+    /// \brief Set the imports of the file
+    /// \param imports Import declarations in source order
+    void SetImports(std::vector<std::unique_ptr<ImportDeclaration>> imports);
+
+    /// \brief Get the imports of the file
+    /// \return Import declarations in source order
+    const std::vector<std::unique_ptr<ImportDeclaration>>& GetImports() const;
+
+    /// \brief Move all imports out of the AST
+    /// \return Vector of import declarations
+    std::vector<std::unique_ptr<ImportDeclaration>> TakeImports();
+
+    void Dump(OutputBuffer& out, int indent = 0) const override;
+
+    void DumpJson(JsonWriter& json) const override;
+
+    /// \brief Dump several module ASTs as Dump() dumps their merged AST
+    /// \param modules Module ASTs in module order
+    /// \param out Output buffer
+    static void DumpModules(const std::vector<std::shared_ptr<const AST>>& modules, OutputBuffer& out);
+
+    /// \brief Dump several module ASTs as DumpJson() dumps their merged AST
+    /// \param modules Module ASTs in module order
+    /// \param json JSON writer
+    static void DumpModulesJson(const std::vector<std::shared_ptr<const AST>>& modules, JsonWriter& json);
 
 private:
-    std::vector<std::unique_ptr<Declaration>> declarations_;
+    std::vector<std::unique_ptr<ImportDeclaration>> imports_;
+    std::vector<std::unique_ptr<Declaration>>       declarations_;
 };
+
+/// \brief ASTs of imported modules, each after the modules it imports
+///
+/// Shared, since a module parsed once can be imported by several compiles.
+using ModuleAsts = std::vector<std::shared_ptr<const AST>>;
 } // namespace bbfm
 
 // Restore previous alignment
@@ -0,0 +1,138 @@
+#ifndef __BBFM_ALLOC_TRACKER_H_INCL__
+#define __BBFM_ALLOC_TRACKER_H_INCL__
+
+// Set 8-byte alignment for all types in this header
+#pragma pack(push, 8)
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+namespace bbfm {
+/// \brief Process-wide heap traffic counters for --alloc-report
+///
+/// Only a build with -DBBFM_ALLOC_TRACKING=ON interposes malloc, calloc,
+/// realloc, free and the global operator new/delete; other builds never call
+/// the Record functions. Every allocation is attributed to the active phase
+/// (set by ProfileScope for "phase" and "output" spans) and to the innermost
+/// allocation site of the allocating thread (set by BBFM_ALLOC_SITE). The
+/// counters live in fixed tables, so recording never allocates itself.
+class AllocTracker
+{
+public:
+    /// \brief Check if this build interposes the allocator
+    /// \return True if built with BBFM_ALLOC_TRACKING
+    static bool IsAvailable();
+
+    /// \brief Reset all counters and start recording
+    static void Start();
+
+    /// \brief Stop recording (the counters are kept)
+    static void Stop();
+
+    /// \brief Check if allocations are being recorded
+    /// \return True while recording
+    static bool IsEnabled();
+
+    /// \brief Make a phase the target of all following allocations
+    /// \param name Phase name (phases with the same name share their counters)
+    /// \return The previous phase, to pass to LeavePhase()
+    static int EnterPhase(const std::string& name);
+
+    /// \brief Return to the phase that was active before EnterPhase()
+    /// \param previous Value returned by EnterPhase()
+    static void LeavePhase(const int previous);
+
+    /// \brief Get the number of an allocation site
+    /// \param name Site name, e.g., the method (must outlive the process, e.g., a literal)
+    /// \return Site number (sites with the same name share their counters)
+    static int RegisterSite(const char* name);
+
+    /// \brief Make a site the target of the calling thread's allocations
+    /// \param site Site number from RegisterSite()
+    /// \return The previous site of the calling thread
+    static int SetCurrentSite(const int site);
+
+    /// \brief Count an allocation
+    /// \param bytes Requested size
+    static void RecordAllocation(const size_t bytes);
+
+    /// \brief Count a release
+    static void RecordFree();
+
+    /// \brief Print allocations per phase and the hottest sites
+    /// \param out Output stream
+    /// \param maxSites Number of sites to list
+    static void WriteReport(std::ostream& out, const size_t maxSites = 15);
+
+    /// \brief Write the phase and site counters as JSON
+    /// \param path Output file path
+    /// \return False if the file could not be written
+    static bool WriteJson(const std::string& path);
+
+private:
+    // Static-only class - prevent instantiation
+    AllocTracker()                               = delete;
+    ~AllocTracker()                              = delete;
+    AllocTracker(const AllocTracker&)            = delete;
+    AllocTracker& operator=(const AllocTracker&) = delete;
+};
+
+/// \brief Attributes the calling thread's allocations to a site for the lifetime of a scope
+class AllocSite
+{
+public:
+    /// \brief Enter a site
+    /// \param site Site number from AllocTracker::RegisterSite()
+    explicit AllocSite(const int site) : previous_(AllocTracker::SetCurrentSite(site)) {}
+
+    /// \brief Return to the enclosing site
+    ~AllocSite()
+    {
+        AllocTracker::SetCurrentSite(previous_);
+    }
+
+    AllocSite(const AllocSite&)            = delete;
+    AllocSite& operator=(const AllocSite&) = delete;
+
+private:
+    int previous_;
+};
+
+/// \brief Starts allocation tracking for one compile and writes its reports when the compile ends
+class AllocSession
+{
+public:
+    /// \brief Start a session (does nothing if neither output is requested)
+    /// \param printReport Print the allocation report to stdout at the end
+    /// \param jsonPath JSON output file (empty for none)
+    AllocSession(const bool printReport, const std::string& jsonPath);
+
+    /// \brief Stop tracking and write the requested outputs
+    ~AllocSession();
+
+    AllocSession(const AllocSession&)            = delete;
+    AllocSession& operator=(const AllocSession&) = delete;
+
+private:
+    bool        printReport_;
+    std::string jsonPath_;
+};
+} // namespace bbfm
+
+/// \brief Attribute the allocations of the enclosing scope to a named site
+///
+/// Expands to nothing unless built with BBFM_ALLOC_TRACKING. Use at most once
+/// per scope; the site is registered once, on first execution.
+#ifdef BBFM_ALLOC_TRACKING
+#define BBFM_ALLOC_SITE(name)                                                 \
+    static const int  allocSiteId_ = ::bbfm::AllocTracker::RegisterSite(name); \
+    ::bbfm::AllocSite allocSite_(allocSiteId_)
+#else
+#define BBFM_ALLOC_SITE(name)
+#endif
+
+// Restore previous alignment
+#pragma pack(pop)
+
+#endif // __BBFM_ALLOC_TRACKER_H_INCL__
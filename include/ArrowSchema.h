@@ -0,0 +1,73 @@
+#ifndef __BBFM_ARROW_SCHEMA_H_INCL__
+#define __BBFM_ARROW_SCHEMA_H_INCL__
+
+// Set 8-byte alignment for all types in this header
+#pragma pack(push, 8)
+
+#include "Json.h"
+#include "Layout.h"
+#include "SemanticAnalyzer.h"
+#include <ostream>
+#include <string>
+
+namespace bbfm {
+/// \brief Maps class layouts to Arrow columnar schemas
+///
+/// Writes one Arrow schema per class in the JSON schema format used by the
+/// Arrow integration tests. Each stored field becomes a top-level column:
+/// - Optional fields are nullable (validity bitmap)
+/// - Array fields are list columns (offsets + child "item" column)
+/// - Guid and object references are 16-byte fixed-size binary (arrow.uuid)
+/// - Timestamp/Timespan are microsecond timestamp/duration, Date is date32
+/// - Enums and dictionary-encoded strings are dictionary columns
+///
+/// Record batches written against these schemas can be memory-mapped and
+/// read without copying by any Arrow implementation.
+class ArrowSchemaWriter
+{
+public:
+    /// \brief Construct a schema writer
+    /// \param analyzer The semantic analyzer that validated the model
+    /// \param layouts The computed class layouts
+    ArrowSchemaWriter(const SemanticAnalyzer* analyzer, const LayoutBuilder* layouts);
+
+    /// \brief Destructor
+    virtual ~ArrowSchemaWriter() = default;
+
+    /// \brief Write the schemas of all classes as JSON
+    /// \param out Output stream
+    void Write(std::ostream& out) const;
+
+private:
+    const SemanticAnalyzer* analyzer_;
+    const LayoutBuilder*    layouts_;
+
+    /// \brief Write the Arrow schema of one class
+    /// \param json JSON writer
+    /// \param layout The class layout
+    /// \param dictionaryId Next free dictionary id (updated)
+    void WriteClassSchema(JsonWriter& json, const ClassLayout& layout, int& dictionaryId) const;
+
+    /// \brief Write one column as an Arrow field
+    /// \param json JSON writer
+    /// \param column The column
+    /// \param dictionaryId Next free dictionary id (updated)
+    void WriteField(JsonWriter& json, const ColumnLayout& column, int& dictionaryId) const;
+
+    /// \brief Write the Arrow value type of a column (without list or dictionary wrapping)
+    /// \param json JSON writer
+    /// \param column The column
+    static void WriteValueType(JsonWriter& json, const ColumnLayout& column);
+
+    /// \brief Write one custom metadata entry
+    /// \param json JSON writer
+    /// \param key Metadata key
+    /// \param value Metadata value
+    static void WriteMetadata(JsonWriter& json, const std::string& key, const std::string& value);
+};
+} // namespace bbfm
+
+// Restore previous alignment
+#pragma pack(pop)
+
+#endif // __BBFM_ARROW_SCHEMA_H_INCL__
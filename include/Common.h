@@ -11,6 +11,11 @@
 /// Works across MSVC, GCC, and Clang.
 #define UNREFERENCED_PARAMETER(param) (void)(param)
 
+/// \brief Compiler version reported by --version and the language server
+///
+/// Part of the compile cache key, so entries never cross versions.
+#define BBFM_COMPILER_VERSION "0.1.0"
+
 // Restore previous alignment
 #pragma pack(pop)
 
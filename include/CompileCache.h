@@ -0,0 +1,86 @@
+#ifndef __BBFM_COMPILE_CACHE_H_INCL__
+#define __BBFM_COMPILE_CACHE_H_INCL__
+
+// Set 8-byte alignment for all types in this header
+#pragma pack(push, 8)
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bbfm {
+/// \brief Everything a compile produced, as stored in the compile cache
+struct CachedCompile
+{
+    int                                              exitCode;
+    std::string                                      out;   // Captured stdout
+    std::string                                      err;   // Captured stderr
+    std::vector<std::pair<std::string, std::string>> files; // Output files written (path, content)
+};
+
+/// \brief Content-addressed on-disk cache of complete compiles
+///
+/// An entry is keyed by the compiler binary, the command line and the content
+/// of every input file, so a hit reproduces the compile exactly: its output
+/// is printed and its files are written without running any phase. Entries
+/// are single files named by the hash of their key; the full key is stored in
+/// the entry and compared on lookup.
+///
+/// The directory may be shared by parallel compiles: entries are written to a
+/// temporary file and renamed into place, and readers keep a removed entry
+/// readable through their open handle. A hit refreshes the entry's
+/// modification time; after a store, the least recently used entries are
+/// removed until the directory fits its size limit.
+class CompileCache
+{
+public:
+    /// \brief Construct a cache on a directory (created if missing)
+    /// \param directory Cache directory
+    /// \param maxBytes Size limit of all entries together
+    CompileCache(const std::string& directory, const uint64_t maxBytes);
+
+    /// \brief Destructor
+    virtual ~CompileCache() = default;
+
+    /// \brief Build the key of a compile
+    /// \param args Command line without the program name and the cache options
+    /// \param inputFiles Files the compile reads
+    /// \param key Output key
+    /// \return False if an input file cannot be read (the compile reports it) or the compiler binary cannot be found; nothing is cached then
+    static bool MakeKey(const std::vector<std::string>& args, const std::vector<std::string>& inputFiles, std::string& key);
+
+    /// \brief Look up a compile
+    /// \param key The key
+    /// \param entry Output entry
+    /// \return True on a hit
+    bool Lookup(const std::string& key, CachedCompile& entry) const;
+
+    /// \brief Store a compile and evict the least recently used entries over the limit
+    /// \param key The key
+    /// \param entry The entry
+    /// \return False if the entry could not be written (the cache is then only slower)
+    bool Store(const std::string& key, const CachedCompile& entry) const;
+
+private:
+    std::string directory_;
+    uint64_t    maxBytes_;
+
+    /// \brief Get the entry file path of a key
+    /// \param key The key
+    /// \return Path within the cache directory
+    std::string EntryPath(const std::string& key) const;
+
+    /// \brief Remove the least recently used entries until the cache fits its limit
+    void Evict() const;
+
+    /// \brief Get the identity of the running compiler (version and the binary's device, inode, size and modification time)
+    /// \return Identity string (empty if the binary cannot be found)
+    static const std::string& CompilerIdentity();
+};
+} // namespace bbfm
+
+// Restore previous alignment
+#pragma pack(pop)
+
+#endif // __BBFM_COMPILE_CACHE_H_INCL__
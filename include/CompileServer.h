@@ -0,0 +1,93 @@
+#ifndef __BBFM_COMPILE_SERVER_H_INCL__
+#define __BBFM_COMPILE_SERVER_H_INCL__
+
+// Set 8-byte alignment for all types in this header
+#pragma pack(push, 8)
+
+#include "Driver.h"
+#include "ModelCache.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace bbfm {
+/// \brief Persistent compile server on a local Unix socket
+///
+/// A request is a complete compiler command line plus the client's working
+/// directory. The server runs it in-process against a ModelCache, so repeated
+/// compiles of unchanged files skip Phase 0 and Phase 1, and an ImportCache, so
+/// a compile after an edit parses only the files that changed. It replies with the
+/// exit code and the captured stdout and stderr. Requests are served one at a
+/// time, because each one runs in the client's working directory with the
+/// process's stdout and stderr captured. A client therefore has
+/// CLIENT_TIMEOUT_MS to send its request and to read the reply before its
+/// connection is dropped, and Forward() waits SERVER_TIMEOUT_MS for the reply
+/// before its caller compiles locally.
+///
+/// Wire format (all requests and replies on one connection each):
+/// - Request: NUL-terminated fields: working directory, argument count, arguments
+/// - Reply: "<exit code> <stdout bytes> <stderr bytes>\n", then stdout and stderr
+class CompileServer
+{
+public:
+    /// \brief Time a client has to send its whole request, and for each write of the reply
+    static constexpr int CLIENT_TIMEOUT_MS = 10000;
+
+    /// \brief Time Forward() waits for the reply, including requests queued before it
+    static constexpr int SERVER_TIMEOUT_MS = 30000;
+
+    /// \brief Handler that runs one compiler command line
+    ///
+    /// Receives the arguments (including the program name) and the server's caches,
+    /// writes to std::cout/std::cerr and returns the exit code.
+    using RequestHandler = std::function<int(const std::vector<std::string>& args, ModelCache& cache, ImportCache& imports)>;
+
+    /// \brief Construct a compile server
+    /// \param socketPath Path of the Unix socket to listen on
+    /// \param handler Handler that runs a command line
+    CompileServer(const std::string& socketPath, RequestHandler handler);
+
+    /// \brief Destructor
+    virtual ~CompileServer() = default;
+
+    /// \brief Serve requests until SIGINT or SIGTERM
+    /// \return Exit code (0 on clean shutdown)
+    int Run();
+
+    /// \brief Forward a command line to a running server and replay its reply
+    /// \param socketPath Path of the server's Unix socket
+    /// \param args Arguments (including the program name)
+    /// \param exitCode Output exit code of the remote compile
+    /// \return False if the server is unreachable or gave no valid reply within SERVER_TIMEOUT_MS;
+    ///         nothing was printed to stdout then, so the caller can compile locally
+    static bool Forward(const std::string& socketPath, const std::vector<std::string>& args, int& exitCode);
+
+private:
+    std::string    socketPath_;
+    RequestHandler handler_;
+    ModelCache     cache_;
+    ImportCache    imports_; // Parsed files of earlier requests, by canonical path and content
+
+    /// \brief Serve one connection
+    /// \param fd The connected socket
+    void HandleConnection(const int fd);
+
+    /// \brief Read until the peer closes its write side
+    /// \param fd The socket
+    /// \param data Output data
+    /// \param timeoutMs Time allowed for the whole read, -1 to wait forever
+    /// \return True on success (errno is ETIMEDOUT if the time ran out)
+    static bool ReadAll(const int fd, std::string& data, const int timeoutMs = -1);
+
+    /// \brief Write a whole buffer
+    /// \param fd The socket
+    /// \param data The data
+    /// \return True on success
+    static bool WriteAll(const int fd, const std::string& data);
+};
+} // namespace bbfm
+
+// Restore previous alignment
+#pragma pack(pop)
+
+#endif // __BBFM_COMPILE_SERVER_H_INCL__
@@ -8,14 +8,17 @@
 
 namespace bbfm {
 /// \brief Console output utility for reporting errors and status messages
+///
+/// Errors go through the diagnostics engine, so they are buffered while a
+/// DiagnosticSession is active.
 class Console
 {
 public:
-    /// \brief Report an error message to stderr
+    /// \brief Report an error message without a location
     /// \param message The error message to display
     static void ReportError(const std::string& message);
 
-    /// \brief Report a status message to stdout
+    /// \brief Report a status message to stdout (not flushed per line)
     /// \param message The status message to display
     static void ReportStatus(const std::string& message);
 
@@ -0,0 +1,130 @@
+#ifndef __BBFM_DIAGNOSTICS_H_INCL__
+#define __BBFM_DIAGNOSTICS_H_INCL__
+
+// Set 8-byte alignment for all types in this header
+#pragma pack(push, 8)
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace bbfm {
+/// \brief A message about the model, with its location if known
+struct Diagnostic
+{
+    enum class Severity
+    {
+        NOTE,
+        WARNING,
+        ERROR
+    };
+
+    Severity    severity = Severity::ERROR; // Severity
+    std::string file;                       // Source file (empty if the message has no location)
+    int         line     = 0;               // 1-based line (0 if unknown)
+    int         column   = 0;               // 1-based column (0 if unknown)
+    std::string message;                    // Text without the location
+    std::string sourceLine;                 // Source line shown below the message with a caret at the column (empty for none)
+    uint64_t    sequence = 0;               // Order of reporting, set by Diagnostics::Report()
+};
+
+/// \brief Output formats of the diagnostics
+enum class DiagnosticFormat
+{
+    TEXT,  // file:line:column: error: message, then the source line and a caret
+    JSON,  // {"diagnostics": [...], "suppressed": n}
+    SARIF  // SARIF 2.1.0 log for code scanning tools
+};
+
+/// \brief Process-wide diagnostics engine
+///
+/// While a DiagnosticSession is active, reported diagnostics go to a buffer
+/// of the reporting thread, so parallel phases never contend on a stream or
+/// interleave their messages. When the session ends, the buffers are merged,
+/// sorted by file, line and column (messages without a location keep their
+/// order), duplicates are removed, diagnostics beyond the error limit are
+/// counted instead of shown, and the result goes to std::cerr in one write.
+/// Without a session, diagnostics are written at once, as plain text.
+class Diagnostics
+{
+public:
+    /// \brief Report a diagnostic
+    /// \param diagnostic The diagnostic (its sequence is assigned here)
+    static void Report(Diagnostic diagnostic);
+
+    /// \brief Report a message without a location
+    /// \param severity Severity
+    /// \param message Message text
+    static void Report(const Diagnostic::Severity severity, const std::string& message);
+
+    /// \brief Write a status message to std::cout (in order, without flushing the stream)
+    /// \param message The message
+    static void ReportStatus(const std::string& message);
+
+    /// \brief Render diagnostics
+    /// \param diagnostics Diagnostics in output order
+    /// \param format Output format
+    /// \param suppressed Number of diagnostics left out by the error limit
+    /// \return The rendered text
+    static std::string Render(const std::vector<Diagnostic>& diagnostics, const DiagnosticFormat format, const size_t suppressed);
+
+    /// \brief Parse the name of an output format
+    /// \param name "text", "json" or "sarif"
+    /// \param format Receives the format
+    /// \return False for an unknown name
+    static bool ParseFormat(const std::string& name, DiagnosticFormat& format);
+
+    /// \brief Take the buffered diagnostics of all threads, sorted and without duplicates
+    ///
+    /// A caller that takes them inside a session consumes the records itself
+    /// (e.g., the language server), and the session has nothing left to write.
+    /// \return The diagnostics in output order
+    static std::vector<Diagnostic> TakeBuffered();
+
+private:
+    // Static-only class - prevent instantiation
+    Diagnostics()                              = delete;
+    ~Diagnostics()                             = delete;
+    Diagnostics(const Diagnostics&)            = delete;
+    Diagnostics& operator=(const Diagnostics&) = delete;
+};
+
+/// \brief Buffers the diagnostics of one compile and writes them when it ends
+///
+/// Sessions nest; each one writes everything buffered when it ends or
+/// flushes. No thread may report while a session flushes.
+class DiagnosticSession
+{
+public:
+    /// \brief Default number of diagnostics shown
+    static const size_t DEFAULT_ERROR_LIMIT = 100;
+
+    /// \brief Start buffering
+    /// \param format Output format
+    /// \param errorLimit Number of diagnostics shown (0 for all)
+    explicit DiagnosticSession(const DiagnosticFormat format = DiagnosticFormat::TEXT, const size_t errorLimit = DEFAULT_ERROR_LIMIT);
+
+    /// \brief Write the buffered diagnostics and stop buffering
+    ~DiagnosticSession();
+
+    DiagnosticSession(const DiagnosticSession&)            = delete;
+    DiagnosticSession& operator=(const DiagnosticSession&) = delete;
+
+    /// \brief Write the buffered diagnostics now (text format only; JSON and SARIF are written once, at the end)
+    void Flush();
+
+private:
+    DiagnosticFormat format_;
+    size_t           errorLimit_;
+
+    /// \brief Write the buffered diagnostics to std::cerr
+    /// \param always Write a JSON or SARIF document even without diagnostics
+    void Write(const bool always);
+};
+} // namespace bbfm
+
+// Restore previous alignment
+#pragma pack(pop)
+
+#endif // __BBFM_DIAGNOSTICS_H_INCL__
@@ -6,11 +6,59 @@
 
 #include "AST.h"
 #include "SemanticAnalyzer.h"
+#include <cstdint>
+#include <map>
+#include <set>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace bbfm {
+/// \brief A model file parsed by the driver
+struct ModuleFile
+{
+    std::string path;        // Canonical path
+    uint64_t    contentHash; // Hash of the content that was parsed
+};
+
+/// \brief Parsed modules kept across compiles
+///
+/// The language server and watch mode compile the same files after every
+/// edit. Given an import cache, LoadImports() parses an imported file only if
+/// its content hash differs from the cached parse, and shares the cached AST
+/// otherwise. Only modules without syntax errors are kept, so the errors of a
+/// broken file are reported by every compile. A replaced AST stays alive for
+/// the compiles that still use it.
+class ImportCache
+{
+public:
+    /// \brief Construct an empty cache
+    ImportCache() = default;
+
+    /// \brief Destructor
+    virtual ~ImportCache() = default;
+
+    /// \brief Find the parse of a module
+    /// \param canonical Canonical path of the module
+    /// \param contentHash Hash of the current content of the module
+    /// \return The AST (its declarations must not be taken) or nullptr if the module is not cached or changed
+    std::shared_ptr<AST> Find(const std::string& canonical, const uint64_t contentHash) const;
+
+    /// \brief Add the parse of a module, replacing the parse of an older content
+    /// \param canonical Canonical path of the module
+    /// \param contentHash Hash of the parsed content
+    /// \param ast The AST
+    void Insert(const std::string& canonical, const uint64_t contentHash, std::shared_ptr<AST> ast);
+
+    /// \brief Get the number of cached modules
+    /// \return Number of cached modules
+    size_t GetSize() const;
+
+private:
+    std::map<std::string, std::pair<uint64_t, std::shared_ptr<AST>>> modules_; // (content hash, AST) by canonical path
+};
+
 /// \brief Main driver for the BBFM compiler
 ///
 /// The Driver class orchestrates the compilation phases:
@@ -30,17 +78,98 @@ public:
 
     /// \brief Phase 0: Lexical analysis and parsing
     ///
-    /// Parses all source files and constructs the Abstract Syntax Tree.
-    /// \return Unique pointer to the constructed AST (nullptr on failure)
+    /// Parses all source files and the files they import, and constructs one
+    /// Abstract Syntax Tree. Every file is parsed once, however often it is
+    /// imported; the declarations of a module follow those of its imports.
+    /// The parser recovers from syntax errors, so all of them are reported
+    /// in one run: the AST then holds the intact declarations, for semantic
+    /// analysis to check as well, and HasErrors() is true.
+    /// \return Unique pointer to the constructed AST (nullptr if a file cannot be read or parsed at all)
     std::unique_ptr<AST> Phase0();
 
+    /// \brief Phase 0 reusing the modules parsed by earlier compiles
+    ///
+    /// Used by the compile server. Like Phase0(), but a file is parsed only if
+    /// the cache holds no parse of its current content. The module ASTs are
+    /// shared with the cache, so they are not merged: the returned AST has no
+    /// declarations, and Phase1() analyzes the modules as its imports.
+    /// \param cache Modules parsed by earlier compiles
+    /// \param modules Output ASTs of all modules, each after the modules it imports
+    /// \return Unique pointer to an empty AST (nullptr if a file cannot be read or parsed at all)
+    std::unique_ptr<AST> Phase0(ImportCache& cache, ModuleAsts& modules);
+
+    /// \brief Load the modules imported by a file parsed elsewhere
+    ///
+    /// Used by the language server and watch mode, which parse the importing
+    /// file themselves. Every imported file is parsed once, and not at all if
+    /// the cache holds the parse of its current content.
+    /// \param fileName Path of the importing file (imports are relative to its directory)
+    /// \param ast AST of the importing file
+    /// \param imports Output ASTs of all imported modules
+    /// \param cache Modules parsed by earlier compiles (nullptr to parse every module)
+    /// \return False if an imported file could not be read or parsed (already reported)
+    bool LoadImports(const std::string& fileName, const AST* ast, ModuleAsts& imports, ImportCache* cache = nullptr);
+
+    /// \brief Get the modules parsed by Phase0() or LoadImports()
+    /// \return Module files, each after the modules it imports
+    const std::vector<ModuleFile>& GetModules() const;
+
+    /// \brief Find the files a compile of source files reads, without parsing them
+    ///
+    /// Follows the import statements at the start of every file. Used to key
+    /// caches of compile results.
+    /// \param sourceFiles Source file paths
+    /// \param moduleFiles Output source and imported file paths
+    /// \return False if a file cannot be read or its imports cannot be scanned
+    static bool FindModuleFiles(const std::vector<std::string>& sourceFiles, std::vector<std::string>& moduleFiles);
+
+    /// \brief Phase 0 on source text held in memory
+    ///
+    /// Used by the language server for unsaved editor buffers. Errors are
+    /// reported against the given file name.
+    /// \param fileName File name for error reporting
+    /// \param text The source text
+    /// \return Unique pointer to the constructed AST (nullptr on failure)
+    std::unique_ptr<AST> Phase0FromText(const std::string& fileName, const std::string& text);
+
+    /// \brief Parse source text without status output
+    ///
+    /// Building block of incremental parsing: the text may be one declaration
+    /// span cut out of a larger file, and errors are reported with the line
+    /// numbers of that file.
+    /// \param fileName File name for error reporting
+    /// \param text The source text
+    /// \param firstLine Line of the file the text starts at
+    /// \return Unique pointer to the constructed AST (nullptr on failure, after all syntax errors were reported)
+    std::unique_ptr<AST> ParseText(const std::string& fileName, const std::string& text, const int firstLine = 1);
+
+    /// \brief Parse source text, keeping the partial AST of text with syntax errors
+    ///
+    /// Used by the language server to analyze the intact declarations of an
+    /// editor buffer that does not parse.
+    /// \param fileName File name for error reporting
+    /// \param text The source text
+    /// \param firstLine Line of the file the text starts at
+    /// \param syntaxErrors Receives the number of syntax errors reported
+    /// \return Unique pointer to the AST, partial after syntax errors (nullptr if the parser gave up)
+    std::unique_ptr<AST> ParsePartial(const std::string& fileName, const std::string& text, const int firstLine, size_t& syntaxErrors);
+
+    /// \brief Run only the lexer over source text
+    ///
+    /// Used by the benchmark to time lexing apart from parsing.
+    /// \param text The source text
+    /// \return Number of tokens
+    size_t LexText(const std::string& text);
+
     /// \brief Phase 1: Semantic analysis
     ///
     /// Performs semantic analysis on the AST including type checking,
     /// symbol table construction, and validation.
     /// \param ast Pointer to the AST to analyze
+    /// \param cache Query results of earlier analyses to reuse (nullptr for none)
+    /// \param imports ASTs of the modules the AST imports (nullptr for none)
     /// \return Unique pointer to the semantic analyzer (nullptr on failure)
-    std::unique_ptr<SemanticAnalyzer> Phase1(const AST* ast);
+    std::unique_ptr<SemanticAnalyzer> Phase1(const AST* ast, AnalysisCache* cache = nullptr, const ModuleAsts* imports = nullptr);
 
     /// \brief Check if compilation has encountered errors
     /// \return True if errors were encountered
@@ -51,9 +180,73 @@ public:
     const std::string& GetClassPrefix() const;
 
 private:
-    std::vector<std::string> sourceFiles_;
-    std::string              classPrefix_;
-    bool                     hasErrors_;
+    /// \brief A module to load: a source file, or a file named by an import declaration
+    struct PendingModule
+    {
+        std::string              fileName;
+        std::string              importer;          // Path of the importing file (empty for a source file)
+        std::string              importerCanonical; // Canonical path of the importing file (empty for a source file)
+        const ImportDeclaration* import;            // The import naming the module (nullptr for a source file)
+    };
+
+    /// \brief A module file read for parsing, and the result of the parse
+    struct LoadedModule
+    {
+        std::string          fileName;
+        std::string          canonical;
+        std::string          text;
+        std::shared_ptr<AST> ast;              // Partial after syntax errors (nullptr if the parser gave up)
+        size_t               syntaxErrors = 0;
+        uint64_t             contentHash  = 0;
+    };
+
+    /// \brief Parse source text with a parser and scanner of its own
+    ///
+    /// Touches no state of the driver, so files can be parsed on several threads.
+    /// \param fileName File name for error reporting
+    /// \param text The source text
+    /// \param firstLine Line of the file the text starts at
+    /// \param syntaxErrors Receives the number of syntax errors reported
+    /// \return Unique pointer to the AST, partial after syntax errors (nullptr if the parser gave up)
+    static std::unique_ptr<AST> ParseSource(const std::string& fileName, const std::string& text, const int firstLine, size_t& syntaxErrors);
+
+    /// \brief Parse the source files and the files they import, reporting the progress of Phase 0
+    /// \param cache Modules parsed by earlier compiles (nullptr to parse every module)
+    /// \return False if a file cannot be read or parsed at all (already reported)
+    bool LoadSourceModules(ImportCache* cache);
+
+    /// \brief Parse module files and, transitively, the modules they import
+    ///
+    /// Loads one import level at a time. The new modules of a level do not
+    /// depend on each other, so they are parsed in parallel.
+    /// \param pending The modules to load first (source files, or the imports of a file)
+    /// \param cache Modules parsed by earlier compiles (nullptr to parse every module)
+    /// \return False if a module could not be read or parsed (already reported)
+    bool LoadModules(std::vector<PendingModule> pending, ImportCache* cache = nullptr);
+
+    /// \brief Parse the modules of one import level, on worker threads if there are several
+    /// \param modules The modules read for parsing, receive their ASTs
+    static void ParseModules(std::vector<LoadedModule>& modules);
+
+    /// \brief Append a module after the modules it imports to moduleFiles_
+    /// \param canonical Canonical path of the module
+    /// \param imports Canonical paths of the modules imported by each module
+    /// \param contentHashes Content hash of each module parsed by this load
+    /// \param visited Modules already appended or being appended (an import cycle)
+    void AppendModule(const std::string& canonical, const std::map<std::string, std::vector<std::string>>& imports,
+                      const std::map<std::string, uint64_t>& contentHashes, std::set<std::string>& visited);
+
+    /// \brief Move the declarations of all loaded modules into one AST
+    /// \return AST with the declarations in module order
+    std::unique_ptr<AST> MergeModules();
+
+    std::vector<std::string>                    sourceFiles_;
+    std::string                                 classPrefix_;
+    bool                                        hasErrors_;
+    size_t                                      syntaxErrors_;  // Syntax errors of the loaded modules
+    size_t                                      reusedModules_; // Loaded modules taken from an import cache
+    std::map<std::string, std::shared_ptr<AST>> modules_;       // By canonical path; nullptr until the module is parsed
+    std::vector<ModuleFile>                     moduleFiles_;   // Each module after the modules it imports
 };
 } // namespace bbfm
 
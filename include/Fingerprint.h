@@ -0,0 +1,92 @@
+#ifndef __BBFM_FINGERPRINT_H_INCL__
+#define __BBFM_FINGERPRINT_H_INCL__
+
+// Set 8-byte alignment for all types in this header
+#pragma pack(push, 8)
+
+#include "AST.h"
+#include "SemanticAnalyzer.h"
+#include <cstdint>
+#include <string>
+
+namespace bbfm {
+/// \brief Computes stable structural fingerprints of classes and enums
+///
+/// A fingerprint is a 64-bit FNV-1a hash of the canonical form of a type:
+/// - Enums: name and values in declaration order
+/// - Classes: name, then every field of the inheritance chain (root class first)
+///   with its type, cardinality and storage modifiers, then the sorted
+///   invariants of the chain as fully parenthesized expressions
+///
+/// Enum-typed fields include the enum fingerprint, so adding an enum value changes
+/// the fingerprint of every class using it. Object references only contribute the
+/// referenced class name, which keeps fingerprints of cyclic models well defined.
+/// Comments, whitespace, redundant parentheses and invariant names do not affect
+/// the fingerprint, so two producers agree if and only if their canonical forms do.
+class SchemaFingerprinter
+{
+public:
+    /// \brief Construct a fingerprinter
+    /// \param analyzer The semantic analyzer that validated the model
+    explicit SchemaFingerprinter(const SemanticAnalyzer* analyzer);
+
+    /// \brief Destructor
+    virtual ~SchemaFingerprinter() = default;
+
+    /// \brief Get the fingerprint of a class
+    /// \param classDecl The class declaration
+    /// \return 64-bit structural fingerprint
+    uint64_t ClassFingerprint(const ClassDeclaration* classDecl) const;
+
+    /// \brief Get the fingerprint of an enum
+    /// \param enumDecl The enum declaration
+    /// \return 64-bit structural fingerprint
+    uint64_t EnumFingerprint(const EnumDeclaration* enumDecl) const;
+
+    /// \brief Get the canonical form of a class
+    /// \param classDecl The class declaration
+    /// \return One line per field and invariant
+    std::string CanonicalClass(const ClassDeclaration* classDecl) const;
+
+    /// \brief Get the canonical form of an enum
+    /// \param enumDecl The enum declaration
+    /// \return Enum name and values
+    static std::string CanonicalEnum(const EnumDeclaration* enumDecl);
+
+    /// \brief Get the canonical form of a field
+    /// \param field The field (stored or computed)
+    /// \return Name, type, cardinality, modifiers and initializer
+    std::string CanonicalField(const Field* field) const;
+
+    /// \brief Get the canonical form of an expression
+    ///
+    /// Binary operations are always parenthesized and explicit parentheses are dropped,
+    /// so "(a + b) * c" and "((a + b)) * c" have the same canonical form.
+    /// \param expr The expression
+    /// \return Canonical expression text
+    static std::string CanonicalExpression(const Expression* expr);
+
+    /// \brief Hash a string with 64-bit FNV-1a
+    /// \param text The text
+    /// \return 64-bit hash
+    static uint64_t Hash(const std::string& text);
+
+    /// \brief Format a fingerprint as 16 hexadecimal digits
+    /// \param fingerprint The fingerprint
+    /// \return Fingerprint text (e.g., "0x1f2e3d4c5b6a7988")
+    static std::string ToString(const uint64_t fingerprint);
+
+private:
+    const SemanticAnalyzer* analyzer_;
+
+    /// \brief Get the canonical type of a field
+    /// \param field The field
+    /// \return Type name, with the enum fingerprint for enum types
+    std::string CanonicalType(const Field* field) const;
+};
+} // namespace bbfm
+
+// Restore previous alignment
+#pragma pack(pop)
+
+#endif // __BBFM_FINGERPRINT_H_INCL__
@@ -0,0 +1,128 @@
+#ifndef __BBFM_INCREMENTAL_PARSER_H_INCL__
+#define __BBFM_INCREMENTAL_PARSER_H_INCL__
+
+// Set 8-byte alignment for all types in this header
+#pragma pack(push, 8)
+
+#include "AST.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace bbfm {
+/// \brief Source text of one top-level declaration
+struct DeclarationSpan
+{
+    size_t   offset; // Offset of the first character (the class, enum or import keyword)
+    size_t   length; // Length up to and including the closing brace (the semicolon of an import)
+    int      line;   // Line of the first character (1-based)
+    int      column; // Column of the first character (1-based)
+    uint64_t hash;   // Hash of the text and column (the line is not hashed, moved spans are reused)
+};
+
+/// \brief Phase 0 that reparses only changed declarations
+///
+/// A brace-matching pre-scan (aware of comments and string literals) splits the
+/// source into top-level declaration spans and hashes each one. A span whose
+/// hash matched a declaration of the previous parse reuses that Declaration
+/// subtree, with its locations moved to the new line; only the other spans are
+/// lexed and parsed. The import statements at the start of the file are
+/// always parsed. Text the pre-scan cannot split (e.g., unbalanced braces) is
+/// parsed as a whole.
+///
+/// An editor can report its edits with Edit(). The spans are kept between
+/// parses and moved by each edit, so the next parse scans only from the
+/// declaration before the first edit until a declaration after the edits
+/// starts where its moved span does, instead of splitting the whole text.
+///
+/// The parser owns the AST. Parsing moves reused declarations out of the
+/// previous AST, so anything pointing into it (e.g., a SemanticAnalyzer) must
+/// be discarded before Parse() is called again.
+class IncrementalParser
+{
+public:
+    /// \brief Construct a parser without a previous parse
+    IncrementalParser() = default;
+
+    /// \brief Destructor
+    virtual ~IncrementalParser() = default;
+
+    /// \brief Parse source text, reusing the unchanged declarations of the previous parse
+    ///
+    /// Syntax errors of all changed spans are reported. On failure the AST of
+    /// the previous successful parse is kept unchanged.
+    /// \param fileName File name for error reporting
+    /// \param text The complete source text
+    /// \return True if the text parsed
+    bool Parse(const std::string& fileName, const std::string& text);
+
+    /// \brief Record an edit of the text since the last Parse()
+    ///
+    /// Moves the spans and declarations after the edit, the next Parse() scans
+    /// only the text the recorded edits touched. Offsets are in the text with
+    /// the earlier edits applied.
+    /// \param offset Offset of the replaced text
+    /// \param removedLength Length of the replaced text
+    /// \param insertedLength Length of the replacement
+    /// \param lineDelta Lines added by the edit (negative if lines were removed)
+    void Edit(const size_t offset, const size_t removedLength, const size_t insertedLength, const int lineDelta);
+
+    /// \brief Get the AST of the last successful parse
+    /// \return Pointer to the AST or nullptr if nothing parsed yet
+    const AST* GetAst() const;
+
+    /// \brief Get the number of declarations reused by the last successful parse
+    /// \return Number of reused declarations
+    size_t GetReusedCount() const;
+
+    /// \brief Get the number of declarations parsed by the last successful parse
+    /// \return Number of parsed declarations
+    size_t GetParsedCount() const;
+
+    /// \brief Split source text into import statements and top-level declaration spans
+    /// \param text The source text
+    /// \param spans Output declaration spans in source order
+    /// \param imports Output import statement spans in source order
+    /// \return False if the text is not a sequence of imports followed by brace-delimited declarations
+    static bool SplitDeclarations(const std::string& text, std::vector<DeclarationSpan>& spans, std::vector<DeclarationSpan>& imports);
+
+    /// \brief Get the path named by an import statement span
+    /// \param text The source text
+    /// \param import The import statement span
+    /// \return The path as written, without quotes
+    static std::string ImportPath(const std::string& text, const DeclarationSpan& import);
+
+    /// \brief Set the source hashes of an AST's declarations as Parse() would
+    ///
+    /// Lets the semantic analysis cache reuse queries of files parsed as a whole.
+    /// \param text The source text the AST was parsed from
+    /// \param ast The AST
+    static void StampSourceHashes(const std::string& text, const AST* ast);
+
+private:
+    std::unique_ptr<AST>         ast_;
+    std::vector<DeclarationSpan> spans_;   // Spans of ast_'s declarations (empty after a whole-text parse)
+    std::vector<DeclarationSpan> imports_; // Spans of ast_'s imports
+    size_t                       reusedCount_ = 0;
+    size_t                       parsedCount_ = 0;
+    bool                         edited_      = false; // Edits were recorded since the last parse
+    size_t                       dirtyFirst_  = 0;     // First span touched by the recorded edits
+    size_t                       dirtyLast_   = 0;     // First span after the recorded edits (spans in between are out of date)
+
+    /// \brief Split the text after the recorded edits, keeping the spans before and after them
+    /// \param text The complete source text
+    /// \param spans Output declaration spans in source order
+    /// \param importSpans Output import statement spans in source order
+    /// \param keptBefore Output number of leading spans that are spans_ unchanged
+    /// \param keptAfter Output number of trailing spans that are the last spans_ unchanged
+    /// \return False if the text is not a sequence of imports followed by brace-delimited declarations
+    bool RescanEdits(const std::string& text, std::vector<DeclarationSpan>& spans, std::vector<DeclarationSpan>& importSpans, size_t& keptBefore,
+                     size_t& keptAfter) const;
+};
+} // namespace bbfm
+
+// Restore previous alignment
+#pragma pack(pop)
+
+#endif // __BBFM_INCREMENTAL_PARSER_H_INCL__
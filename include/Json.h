@@ -0,0 +1,226 @@
+#ifndef __BBFM_JSON_H_INCL__
+#define __BBFM_JSON_H_INCL__
+
+// Set 8-byte alignment for all types in this header
+#pragma pack(push, 8)
+
+#include "OutputBuffer.h"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace bbfm {
+/// \brief Minimal JSON document value for the language server protocol
+///
+/// Supports the JSON subset exchanged with editors: null, booleans, numbers
+/// (stored as double), strings (UTF-8, \uXXXX escapes decoded), arrays and
+/// objects. Object members are kept sorted by key.
+class JsonValue
+{
+public:
+    /// \brief Kind of JSON value
+    enum class Kind
+    {
+        NUL,
+        BOOL,
+        NUMBER,
+        STRING,
+        ARRAY,
+        OBJECT
+    };
+
+    /// \brief Construct a null value
+    JsonValue() : kind_(Kind::NUL), bool_(false), number_(0.0) {}
+
+    /// \brief Construct a boolean value
+    /// \param value The boolean
+    JsonValue(const bool value) : kind_(Kind::BOOL), bool_(value), number_(0.0) {}
+
+    /// \brief Construct a number value
+    /// \param value The number
+    JsonValue(const int value) : kind_(Kind::NUMBER), bool_(false), number_(value) {}
+
+    /// \brief Construct a number value
+    /// \param value The number
+    JsonValue(const double value) : kind_(Kind::NUMBER), bool_(false), number_(value) {}
+
+    /// \brief Construct a string value
+    /// \param value The string
+    JsonValue(const std::string& value) : kind_(Kind::STRING), bool_(false), number_(0.0), string_(value) {}
+
+    /// \brief Construct a string value
+    /// \param value The string
+    JsonValue(const char* value) : kind_(Kind::STRING), bool_(false), number_(0.0), string_(value) {}
+
+    /// \brief Create an empty array
+    /// \return The array value
+    static JsonValue MakeArray();
+
+    /// \brief Create an empty object
+    /// \return The object value
+    static JsonValue MakeObject();
+
+    /// \brief Get the kind of the value
+    /// \return The kind
+    Kind GetKind() const;
+
+    /// \brief Check if the value is null
+    /// \return True for null (including missing object members)
+    bool IsNull() const;
+
+    /// \brief Get the boolean value
+    /// \return The boolean (false if not a boolean)
+    bool AsBool() const;
+
+    /// \brief Get the number value as an integer
+    /// \return The number truncated to int (0 if not a number)
+    int AsInt() const;
+
+    /// \brief Get the number value
+    /// \return The number (0 if not a number)
+    double AsNumber() const;
+
+    /// \brief Get the string value
+    /// \return The string (empty if not a string)
+    const std::string& AsString() const;
+
+    /// \brief Get the array items
+    /// \return The items (empty if not an array)
+    const std::vector<JsonValue>& GetItems() const;
+
+    /// \brief Append an item to an array
+    /// \param item The item
+    void Append(JsonValue item);
+
+    /// \brief Get an object member
+    /// \param key The member name
+    /// \return The member, or a null value if missing or not an object
+    const JsonValue& operator[](const std::string& key) const;
+
+    /// \brief Set an object member
+    /// \param key The member name
+    /// \param value The member value
+    /// \return Reference to this object for chaining
+    JsonValue& Set(const std::string& key, JsonValue value);
+
+    /// \brief Serialize to compact JSON text
+    /// \return The JSON text
+    std::string Serialize() const;
+
+    /// \brief Parse JSON text
+    /// \param text The JSON text
+    /// \param value Output value
+    /// \return True if the text is a single valid JSON value
+    static bool Parse(const std::string& text, JsonValue& value);
+
+private:
+    Kind                             kind_;
+    bool                             bool_;
+    double                           number_;
+    std::string                      string_;
+    std::vector<JsonValue>           items_;
+    std::map<std::string, JsonValue> members_;
+
+    /// \brief Append the serialized value to a buffer
+    /// \param out Output buffer
+    void SerializeTo(OutputBuffer& out) const;
+
+    /// \brief Parse a value at a position
+    /// \param text The JSON text
+    /// \param pos Position, advanced past the value
+    /// \param value Output value
+    /// \param depth Nesting depth (bounded to reject hostile input)
+    /// \return True on success
+    static bool ParseValue(const std::string& text, size_t& pos, JsonValue& value, const int depth);
+
+    /// \brief Parse a string literal at a position
+    /// \param text The JSON text
+    /// \param pos Position of the opening quote, advanced past the closing quote
+    /// \param value Output string
+    /// \return True on success
+    static bool ParseString(const std::string& text, size_t& pos, std::string& value);
+};
+
+/// \brief Streaming writer of compact JSON text
+///
+/// Writes values straight to an output buffer in call order, without
+/// building a JsonValue tree, so documents of any size cost one pass over
+/// the data. Commas between members and items are inserted automatically;
+/// the caller keeps objects and arrays balanced and gives every object
+/// member a Key(). With an indent, every member and item starts on its own
+/// line (for files meant to be read, e.g., Arrow schemas).
+class JsonWriter
+{
+public:
+    /// \brief Construct a writer
+    /// \param out Output buffer
+    /// \param indent Spaces per nesting level, 0 for compact single-line JSON
+    explicit JsonWriter(OutputBuffer& out, const size_t indent = 0);
+
+    JsonWriter(const JsonWriter&)            = delete;
+    JsonWriter& operator=(const JsonWriter&) = delete;
+
+    /// \brief Start an object
+    /// \return Reference to this writer for chaining
+    JsonWriter& BeginObject();
+
+    /// \brief End the innermost object
+    /// \return Reference to this writer for chaining
+    JsonWriter& EndObject();
+
+    /// \brief Start an array
+    /// \return Reference to this writer for chaining
+    JsonWriter& BeginArray();
+
+    /// \brief End the innermost array
+    /// \return Reference to this writer for chaining
+    JsonWriter& EndArray();
+
+    /// \brief Write the key of the next object member
+    /// \param key The member name
+    /// \return Reference to this writer for chaining
+    JsonWriter& Key(const char* key);
+
+    /// \brief Write a string value
+    /// \param value The string
+    /// \return Reference to this writer for chaining
+    JsonWriter& String(const std::string& value);
+
+    /// \brief Write a number value
+    /// \param value The number
+    /// \return Reference to this writer for chaining
+    JsonWriter& Number(const double value);
+
+    /// \brief Write an integer value
+    /// \param value The integer
+    /// \return Reference to this writer for chaining
+    JsonWriter& Integer(const long long value);
+
+    /// \brief Write a boolean value
+    /// \param value The boolean
+    /// \return Reference to this writer for chaining
+    JsonWriter& Bool(const bool value);
+
+    /// \brief Write null
+    /// \return Reference to this writer for chaining
+    JsonWriter& Null();
+
+private:
+    OutputBuffer&     out_;
+    std::vector<bool> hasItems_; // Per open object or array: true once it has a member or item
+    bool              afterKey_;
+    size_t            indent_;
+
+    /// \brief Write the comma and line break before a value, unless it follows its key
+    void BeforeValue();
+
+    /// \brief Start a new indented line (only with an indent)
+    /// \param depth Nesting depth of the line
+    void NewLine(const size_t depth);
+};
+} // namespace bbfm
+
+// Restore previous alignment
+#pragma pack(pop)
+
+#endif // __BBFM_JSON_H_INCL__
@@ -0,0 +1,229 @@
+#ifndef __BBFM_LANGUAGE_SERVER_H_INCL__
+#define __BBFM_LANGUAGE_SERVER_H_INCL__
+
+// Set 8-byte alignment for all types in this header
+#pragma pack(push, 8)
+
+#include "AST.h"
+#include "Diagnostics.h"
+#include "Driver.h"
+#include "IncrementalParser.h"
+#include "Json.h"
+#include "SemanticAnalyzer.h"
+#include <istream>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace bbfm {
+/// \brief An open editor document
+struct LspDocument
+{
+    std::string                                    uri;     // Document URI as sent by the editor
+    std::string                                    path;    // File path used in diagnostics
+    std::string                                    text;    // Current (possibly unsaved) content
+    std::vector<std::string>                       lines;   // Content split into lines
+    int                                            version; // Editor version of the content
+    IncrementalParser                              parser;  // Reparses only changed declarations
+    AnalysisCache                                  queries; // Revalidates only classes whose inputs changed
+    const AST*                                     ast;     // Last AST that parsed (kept while the text has syntax errors)
+    ModuleAsts                                     imports; // ASTs of the files ast imports
+    bool                                           indexed; // classes and enums index ast (rebuilt when a request needs them)
+    std::map<std::string, const ClassDeclaration*> classes; // Classes of ast by name
+    std::map<std::string, const EnumDeclaration*>  enums;   // Enums of ast by name
+};
+
+/// \brief Language server for .fm models (LSP over stdin/stdout)
+///
+/// Keeps the open documents in memory and recompiles a document (Phase 0 and
+/// Phase 1, no files written) whenever the editor changes it. Documents are
+/// synced incrementally: an edited range updates the text, the edited lines
+/// and the parser's declaration spans. Phase 0 rescans and reparses only the
+/// declarations that changed since the previous version, and Phase 1
+/// revalidates only the classes that changed or use a changed type. Imported
+/// files are parsed again only when their content changed. Serves:
+/// - textDocument/publishDiagnostics: syntax and semantic errors
+/// - textDocument/definition: declarations of types, fields and invariants
+/// - textDocument/hover: types with their resolved inheritance chain and fields
+/// - textDocument/completion: member access, type names, fields and keywords
+///
+/// Positions use 0-based lines. Columns count UTF-16 code units as LSP
+/// specifies, or bytes when the client offers the "utf-8" position encoding.
+class LanguageServer
+{
+public:
+    /// \brief Construct a language server
+    /// \param in Stream the client writes requests to
+    /// \param out Stream the server writes responses and notifications to
+    /// \param classPrefix Class prefix used for compiles
+    LanguageServer(std::istream& in, std::ostream& out, const std::string& classPrefix);
+
+    /// \brief Destructor
+    virtual ~LanguageServer() = default;
+
+    /// \brief Serve requests until the client sends exit or closes the stream
+    /// \return Exit code (0 after a shutdown request, 1 otherwise)
+    int Run();
+
+private:
+    std::istream&                      in_;
+    std::ostream                       out_; // Protocol stream, unaffected by std::cout redirection
+    std::string                        classPrefix_;
+    std::map<std::string, LspDocument> documents_;     // Open documents by URI
+    ImportCache                        imports_;       // Imported modules parsed by earlier compiles of any document
+    bool                               utf8Positions_; // Columns sent and received are bytes, not UTF-16 code units
+    bool                               shutdownRequested_;
+
+    /// \brief Read one framed message
+    /// \param body Output message body
+    /// \return False at end of input
+    bool ReadMessage(std::string& body);
+
+    /// \brief Write one framed message
+    /// \param message The message
+    void Send(const JsonValue& message);
+
+    /// \brief Send the result of a request
+    /// \param id Request id
+    /// \param result The result
+    void Respond(const JsonValue& id, JsonValue result);
+
+    /// \brief Send an error reply to a request
+    /// \param id Request id
+    /// \param code JSON-RPC error code
+    /// \param message Error message
+    void RespondError(const JsonValue& id, const int code, const std::string& message);
+
+    /// \brief Dispatch one message
+    /// \param message The message
+    /// \return True if the server should exit
+    bool HandleMessage(const JsonValue& message);
+
+    /// \brief Apply a didChange content change to a document
+    ///
+    /// A range change splits only the edited lines again and records the edit
+    /// with the document's parser.
+    /// \param document The document
+    /// \param change The change (full text, or a range and its replacement)
+    void ApplyChange(LspDocument& document, const JsonValue& change) const;
+
+    /// \brief Recompile a document and publish its diagnostics
+    /// \param document The document
+    void Compile(LspDocument& document);
+
+    /// \brief Convert the diagnostics of a compile to LSP diagnostics
+    /// \param document The document (imports locate errors in imported files)
+    /// \param diagnostics Diagnostics reported by the compile
+    /// \param strayErrors Captured stderr of the compile (text not reported as a diagnostic)
+    /// \return Array of diagnostics
+    JsonValue CollectDiagnostics(const LspDocument& document, const std::vector<Diagnostic>& diagnostics, const std::string& strayErrors) const;
+
+    /// \brief Find the range of the token at a diagnostic's location
+    /// \param document The document
+    /// \param line 0-based line
+    /// \param column 0-based byte column
+    /// \return Range of the name or string literal starting at the column, else of one character
+    JsonValue TokenRange(const LspDocument& document, const int line, const int column) const;
+
+    /// \brief Answer textDocument/definition
+    /// \param document The document
+    /// \param line 0-based line
+    /// \param character 0-based column
+    /// \return Location or null
+    JsonValue Definition(const LspDocument& document, const int line, const int character) const;
+
+    /// \brief Answer textDocument/hover
+    /// \param document The document
+    /// \param line 0-based line
+    /// \param character 0-based column
+    /// \return Hover or null
+    JsonValue Hover(const LspDocument& document, const int line, const int character) const;
+
+    /// \brief Answer textDocument/completion
+    /// \param document The document
+    /// \param line 0-based line
+    /// \param character 0-based column
+    /// \return Array of completion items
+    JsonValue Completion(const LspDocument& document, const int line, const int character) const;
+
+    /// \brief Resolve the node named by the identifier at a position
+    /// \param document The document
+    /// \param line 0-based line
+    /// \param character 0-based column
+    /// \param owner Output class declaring a resolved field or invariant (nullptr for types)
+    /// \return The declaration, field or invariant, or nullptr
+    static const ASTNode* Resolve(const LspDocument& document, const int line, const int character, const ClassDeclaration*& owner);
+
+    /// \brief Resolve the class reached by a dotted receiver ending before a column
+    /// \param document The document
+    /// \param line 0-based line
+    /// \param dotColumn Column of the '.' that starts the member access
+    /// \return The receiver's class or nullptr
+    static const ClassDeclaration* ResolveReceiver(const LspDocument& document, const int line, const int dotColumn);
+
+    /// \brief Find the class whose body contains a line
+    /// \param document The document
+    /// \param line 0-based line
+    /// \return The class or nullptr
+    static const ClassDeclaration* EnclosingClass(const LspDocument& document, const int line);
+
+    /// \brief Get a class and its base classes, root class first
+    /// \param document The document
+    /// \param classDecl The class
+    /// \return The chain (stops at undefined bases and cycles)
+    static std::vector<const ClassDeclaration*> ClassChain(const LspDocument& document, const ClassDeclaration* classDecl);
+
+    /// \brief Find a field by name in a class including inherited fields
+    /// \param document The document
+    /// \param classDecl The class
+    /// \param name The field name
+    /// \param owner Output class declaring the field
+    /// \return The field or nullptr
+    static const Field* FindField(const LspDocument& document, const ClassDeclaration* classDecl, const std::string& name, const ClassDeclaration*& owner);
+
+    /// \brief Format a field as written in source
+    /// \param field The field
+    /// \return Source text, e.g. "feature episodes: Episode [0..*]"
+    static std::string FieldToString(const Field* field);
+
+    /// \brief Make an LSP range covering a name at a node's location
+    /// \param document The document declaring the node
+    /// \param node The node (declaration, field or invariant)
+    /// \param name The node's name
+    /// \return Range object
+    JsonValue NameRange(const LspDocument& document, const ASTNode* node, const std::string& name) const;
+
+    /// \brief Convert a client column to a byte column
+    /// \param document The document
+    /// \param line 0-based line
+    /// \param character 0-based column in the negotiated position encoding
+    /// \return 0-based byte column (clamped to the line)
+    int ToByteColumn(const LspDocument& document, const int line, const int character) const;
+
+    /// \brief Convert a byte column to a client column
+    /// \param document The document
+    /// \param line 0-based line
+    /// \param column 0-based byte column
+    /// \return 0-based column in the negotiated position encoding
+    int ToCharacter(const LspDocument& document, const int line, const int column) const;
+
+    /// \brief Make an LSP range
+    /// \param line 0-based line
+    /// \param startCharacter 0-based start column
+    /// \param endCharacter 0-based end column (exclusive)
+    /// \return Range object
+    static JsonValue MakeRange(const int line, const int startCharacter, const int endCharacter);
+
+    /// \brief Convert a file URI to a path
+    /// \param uri The URI
+    /// \return The decoded path (the URI itself if it is not a file URI)
+    static std::string UriToPath(const std::string& uri);
+};
+} // namespace bbfm
+
+// Restore previous alignment
+#pragma pack(pop)
+
+#endif // __BBFM_LANGUAGE_SERVER_H_INCL__
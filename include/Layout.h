@@ -0,0 +1,241 @@
+#ifndef __BBFM_LAYOUT_H_INCL__
+#define __BBFM_LAYOUT_H_INCL__
+
+// Set 8-byte alignment for all types in this header
+#pragma pack(push, 8)
+
+#include "AST.h"
+#include "Fingerprint.h"
+#include "SemanticAnalyzer.h"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace bbfm {
+/// \brief Physical storage representation of a field
+enum class StorageKind
+{
+    BOOL,            // 1 byte
+    INT64,           // Int, cardinality
+    FLOAT64,         // Real
+    TIMESTAMP64,     // Microseconds since the Unix epoch
+    TIMESPAN64,      // Microseconds
+    DATE32,          // Days since the Unix epoch
+    GUID128,         // Two 64-bit words (high, low)
+    STRING_REF,      // 32-bit offset and 32-bit length into the string heap
+    INTERNED_STRING, // 32-bit symbol id into the shared intern table
+    ENUM,            // Smallest unsigned integer holding all enum values
+    OBJECT_REF,      // Guid of the referenced object
+    ARRAY_REF        // 32-bit offset and 32-bit count into the element heap
+};
+
+/// \brief Encoding of a column in columnar storage
+enum class ColumnEncoding
+{
+    PLAIN,      // Values stored back to back
+    BITPACKED,  // Fixed bit width per value (Bool, enums)
+    DICTIONARY, // Distinct values stored once, column holds bit-packed codes
+    RLE,        // Runs of (value, run length)
+    DELTA       // First value, then differences to the previous value
+};
+
+/// \brief Resolved storage of one stored field in a record
+struct FieldLayout
+{
+    std::string  name;           // Field name
+    std::string  typeName;       // Declared type name (e.g., Guid, MediaType)
+    std::string  declaringClass; // Class that declares the field (empty for universal metadata)
+    const Field* field;          // Declaring field (nullptr for universal metadata)
+    StorageKind  storage;        // Physical representation
+    uint32_t     offset;         // Byte offset from the start of the record
+    uint32_t     size;           // Size in bytes
+    uint32_t     alignment;      // Required alignment in bytes
+    int32_t      presenceBit;    // Bit in the presence bitmap for optional fields, -1 if mandatory
+    StorageKind  elementStorage; // Storage of a single value (differs from storage for arrays)
+    uint32_t     valueBits;      // Significant bits of a single value (e.g., 2 for a 3-value enum)
+
+    /// \brief Convert a storage kind to its name
+    /// \param storage The storage kind
+    /// \return Storage kind name (e.g., "guid128")
+    static const char* StorageToString(const StorageKind storage);
+};
+
+/// \brief Resolved column of a class in columnar storage
+///
+/// Every stored field becomes one column. Optional fields carry a validity bitmap,
+/// array fields are list columns (offsets into a child column of element values).
+/// Validators and scans work on the encoded values: bit-packed enums compare codes,
+/// dictionary columns compare a predicate once per distinct value, RLE columns once
+/// per run, and delta columns keep a running sum.
+struct ColumnLayout
+{
+    std::string    name;           // Field name
+    std::string    typeName;       // Declared element type name
+    std::string    declaringClass; // Class that declares the field (empty for universal metadata)
+    StorageKind    storage;        // Storage of a single element value
+    ColumnEncoding encoding;       // Column encoding
+    uint32_t       bitWidth;       // Bits per encoded value, 0 if only known when the column is written
+    bool           nullable;       // True if the column has a validity bitmap
+    bool           list;           // True for array fields
+
+    /// \brief Convert a column encoding to its name
+    /// \param encoding The column encoding
+    /// \return Encoding name as used in [encoding(...)]
+    static const char* EncodingToString(const ColumnEncoding encoding);
+
+    /// \brief Get all column encodings
+    /// \return The encodings in declaration order
+    static const std::vector<ColumnEncoding>& GetEncodings();
+
+    /// \brief Parse an encoding name
+    /// \param name Encoding name as used in [encoding(...)]
+    /// \param encoding Output column encoding
+    /// \return True if the name is a known encoding
+    static bool EncodingFromString(const std::string& name, ColumnEncoding& encoding);
+};
+
+/// \brief Index of the persistent object store
+///
+/// Every class has a primary Guid -> record offset index on id, and every
+/// [unique] field has a unique index. Indexes on inherited fields are owned by
+/// the declaring class and shared by all subclasses, so uniqueness holds across
+/// the hierarchy. Variable-length string keys are stored as 64-bit hashes;
+/// collisions are resolved by comparing the referenced record.
+struct IndexLayout
+{
+    std::string fieldName;      // Indexed field
+    std::string declaringClass; // Class that owns the index (the class itself for id)
+    std::string fileName;       // Index file name (e.g., Podcast.rssUrl.idx)
+    StorageKind keyStorage;     // Storage of the indexed value
+    uint32_t    keySize;        // Key size in bytes
+    uint32_t    entrySize;      // Key plus 64-bit record offset, 8-byte aligned
+    bool        primary;        // True for the id index
+};
+
+/// \brief Resolved fixed-size record layout of a class
+///
+/// Records start with a presence bitmap for optional fields, followed by all
+/// stored fields (universal metadata, inherited and own fields). Fields are
+/// ordered by decreasing alignment, so there is no padding between fields; the
+/// only interior padding is the gap after the bitmap up to the first field's
+/// alignment (7 bytes for a 1-byte bitmap before the 8-aligned id).
+/// Computed features are derived and have no storage.
+struct ClassLayout
+{
+    std::string                          className;
+    std::vector<const ClassDeclaration*> classChain;    // The class and its base classes, root class first
+    std::vector<FieldLayout>             fields;        // Stored fields in offset order
+    std::vector<ColumnLayout>            columns;       // Columns in declaration order (metadata first)
+    std::vector<IndexLayout>             indexes;       // Store indexes (primary id index first)
+    std::string                          fileName;      // Append-only record file of the persistent store
+    uint32_t                             presenceBytes; // Size of the presence bitmap at offset 0
+    uint32_t                             size;          // Record size including trailing padding
+    uint32_t                             alignment;     // Record alignment
+    uint64_t                             fingerprint;   // Structural fingerprint of the class (see SchemaFingerprinter)
+
+    /// \brief Find the layout of a field by name
+    /// \param fieldName The field name
+    /// \return Pointer to the field layout or nullptr if the field is not stored
+    const FieldLayout* FindField(const std::string& fieldName) const;
+};
+
+/// \brief Computes record layouts for all classes after semantic analysis
+///
+/// The layouts are the contract between the model and generated storage code:
+/// Guids are stored inline as two 64-bit words, [interned] strings as 32-bit
+/// symbol ids, and temporal values as 64-bit integers.
+class LayoutBuilder
+{
+public:
+    /// \brief Size of the header at the start of every store file
+    ///
+    /// Magic, format version, record size, record count and reserved space; a
+    /// multiple of the record alignment, so records can be accessed in place.
+    static constexpr uint32_t STORE_HEADER_SIZE = 64;
+
+    /// \brief Offset of the class fingerprint in the store header
+    ///
+    /// The header holds an 8-byte magic, 32-bit format version, 32-bit record
+    /// size, 64-bit record count and the 64-bit class fingerprint; readers reject
+    /// files whose fingerprint differs from their own with a single compare.
+    static constexpr uint32_t STORE_FINGERPRINT_OFFSET = 24;
+
+    /// \brief Construct a layout builder
+    /// \param analyzer The semantic analyzer that validated the model
+    explicit LayoutBuilder(const SemanticAnalyzer* analyzer);
+
+    /// \brief Destructor
+    virtual ~LayoutBuilder() = default;
+
+    /// \brief Compute the layouts of all classes
+    void Build();
+
+    /// \brief Get all class layouts
+    /// \return Layouts keyed by class name
+    const std::map<std::string, ClassLayout>& GetLayouts() const;
+
+    /// \brief Get the layout of a class
+    /// \param className The class name
+    /// \return Pointer to the class layout or nullptr if the class is unknown
+    const ClassLayout* GetLayout(const std::string& className) const;
+
+    /// \brief Get the fingerprints of all enums
+    /// \return Fingerprints keyed by enum name
+    const std::map<std::string, uint64_t>& GetEnumFingerprints() const;
+
+    /// \brief Dump all class layouts to stdout
+    void DumpLayouts() const;
+
+private:
+    const SemanticAnalyzer*            analyzer_;
+    std::map<std::string, ClassLayout> layouts_;
+    std::map<std::string, uint64_t>    enumFingerprints_;
+
+    /// \brief Compute the layout of a single class
+    /// \param classDecl The class declaration
+    /// \return The class layout
+    ClassLayout BuildClassLayout(const ClassDeclaration* classDecl) const;
+
+    /// \brief Resolve the storage of a declared field
+    /// \param field The field
+    /// \param declaringClass Name of the class that declares the field
+    /// \return Field layout with storage, size and alignment set (offset is assigned later)
+    FieldLayout ResolveField(const Field* field, const std::string& declaringClass) const;
+
+    /// \brief Resolve the column of a stored field
+    /// \param fieldLayout The resolved record field
+    /// \return Column with the explicit or default encoding
+    static ColumnLayout ResolveColumn(const FieldLayout& fieldLayout);
+
+    /// \brief Get the default encoding for a column
+    ///
+    /// Bool and enum columns are bit-packed, [interned] strings are dictionary
+    /// encoded and Timestamp columns are delta encoded; everything else is plain.
+    /// \param fieldLayout The resolved record field
+    /// \return The default column encoding
+    static ColumnEncoding DefaultEncoding(const FieldLayout& fieldLayout);
+
+    /// \brief Resolve the store index of an indexed field
+    /// \param fieldLayout The resolved record field
+    /// \param owner Class that owns the index
+    /// \param primary True for the id index
+    /// \return The index layout
+    static IndexLayout ResolveIndex(const FieldLayout& fieldLayout, const std::string& owner, const bool primary);
+
+    /// \brief Get the size in bytes of an enum with the given number of values
+    /// \param valueCount Number of enum values
+    /// \return 1, 2 or 4
+    static uint32_t EnumStorageSize(const size_t valueCount);
+
+    /// \brief Get the number of bits needed to distinguish the given number of values
+    /// \param valueCount Number of distinct values
+    /// \return Bit width (at least 1)
+    static uint32_t BitWidth(const size_t valueCount);
+};
+} // namespace bbfm
+
+// Restore previous alignment
+#pragma pack(pop)
+
+#endif // __BBFM_LAYOUT_H_INCL__
@@ -0,0 +1,101 @@
+#ifndef __BBFM_MODEL_CACHE_H_INCL__
+#define __BBFM_MODEL_CACHE_H_INCL__
+
+// Set 8-byte alignment for all types in this header
+#pragma pack(push, 8)
+
+#include "AST.h"
+#include "Driver.h"
+#include "Layout.h"
+#include "SemanticAnalyzer.h"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bbfm {
+/// \brief A model that passed Phase 0 and Phase 1, with its layouts
+struct CompiledModel
+{
+    std::vector<std::string>          sourceFiles; // Canonical source file paths, in command line order
+    std::string                       classPrefix; // Class prefix the model was compiled with
+    uint64_t                          contentHash; // Combined hash of the source file contents (see HashFiles)
+    std::vector<ModuleFile>           modules;     // Every file parsed (the source file and its imports)
+    ModuleAsts                        moduleAsts;  // ASTs of the files when shared with an import cache (ast is then empty)
+    std::unique_ptr<AST>              ast;         // Parsed AST (owned, the analyzer points into it)
+    std::unique_ptr<SemanticAnalyzer> analyzer;    // Semantic analysis results
+    std::unique_ptr<LayoutBuilder>    layouts;     // Storage layouts
+};
+
+/// \brief Compiled models keyed by source files and content hash
+///
+/// Only successfully analyzed models are cached, so diagnostics of a broken
+/// file are always reported by a fresh compile. A model is reused while the
+/// content of its files and of the files they import is unchanged; editing a
+/// file replaces the entry. Entries are keyed by the sorted canonical source
+/// paths, so clients of the compile server in different working directories
+/// never share a model through equal relative paths. The same files in another
+/// order replace each other, since the order decides the declaration order. Models are shared, so a replaced entry stays alive for
+/// callers that still use it.
+class ModelCache
+{
+public:
+    /// \brief Construct an empty cache
+    ModelCache() = default;
+
+    /// \brief Destructor
+    virtual ~ModelCache() = default;
+
+    /// \brief Find a compiled model
+    /// \param sourceFiles Source file paths in command line order
+    /// \param classPrefix Class prefix
+    /// \param contentHash Combined hash of the current file contents (see HashFiles)
+    /// \return The model or nullptr if it is not cached or a file it was parsed from changed
+    std::shared_ptr<const CompiledModel> Find(const std::vector<std::string>& sourceFiles, const std::string& classPrefix, const uint64_t contentHash) const;
+
+    /// \brief Add a compiled model, replacing an older version of the same files
+    /// \param model The compiled model
+    /// \return The cached model
+    std::shared_ptr<const CompiledModel> Insert(std::unique_ptr<CompiledModel> model);
+
+    /// \brief Get the number of cached models
+    /// \return Number of cached models
+    size_t GetSize() const;
+
+    /// \brief Hash the content of a file
+    /// \param sourceFile Source file path
+    /// \param contentHash Output hash of the content
+    /// \return True if the file could be read
+    static bool HashFile(const std::string& sourceFile, uint64_t& contentHash);
+
+    /// \brief Hash the contents of several files in order
+    /// \param sourceFiles Source file paths
+    /// \param contentHash Output combined hash of the canonical paths and contents
+    /// \return True if every file could be read
+    static bool HashFiles(const std::vector<std::string>& sourceFiles, uint64_t& contentHash);
+
+    /// \brief Resolve source file paths to canonical paths
+    /// \param sourceFiles Source file paths, relative to the working directory or absolute
+    /// \param canonicalFiles Output canonical paths in the same order
+    /// \return True if every file exists
+    static bool CanonicalPaths(const std::vector<std::string>& sourceFiles, std::vector<std::string>& canonicalFiles);
+
+private:
+    using Key = std::pair<std::vector<std::string>, std::string>; // (sorted canonical source files, class prefix)
+
+    std::map<Key, std::shared_ptr<const CompiledModel>> models_;
+
+    /// \brief Get the cache key of a compile
+    /// \param canonicalFiles Canonical source file paths
+    /// \param classPrefix Class prefix
+    /// \return The key
+    static Key MakeKey(const std::vector<std::string>& canonicalFiles, const std::string& classPrefix);
+};
+} // namespace bbfm
+
+// Restore previous alignment
+#pragma pack(pop)
+
+#endif // __BBFM_MODEL_CACHE_H_INCL__
@@ -0,0 +1,59 @@
+#ifndef __BBFM_MODEL_GENERATOR_H_INCL__
+#define __BBFM_MODEL_GENERATOR_H_INCL__
+
+// Set 8-byte alignment for all types in this header
+#pragma pack(push, 8)
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace bbfm {
+/// \brief Shape of a synthetic model
+struct GeneratorOptions
+{
+    size_t   classCount         = 1000; // Number of classes
+    size_t   fieldsPerClass     = 8;    // Fields declared by every class
+    size_t   inheritanceDepth   = 3;    // Base classes above the deepest class of each chain (0 for none)
+    size_t   invariantsPerClass = 2;    // Invariants declared by every class
+    size_t   expressionSize     = 4;    // Operands of every invariant expression
+    uint64_t seed               = 1;    // Seed of the field type and reference choices
+};
+
+/// \brief Generator of valid synthetic models for benchmarks
+///
+/// Classes form inheritance chains of inheritanceDepth + 1 classes. Fields
+/// cycle through Int, Real, String, enum, class reference and array types;
+/// references and arrays point to random classes, so every type lookup and
+/// relationship path of the compiler is exercised. Invariants are arithmetic
+/// comparisons over the class's Int fields, with count() over its arrays. The
+/// same options and seed always produce the same text.
+class ModelGenerator
+{
+public:
+    /// \brief Construct a generator
+    /// \param options Shape of the model
+    explicit ModelGenerator(const GeneratorOptions& options);
+
+    /// \brief Destructor
+    virtual ~ModelGenerator() = default;
+
+    /// \brief Generate the model source text
+    /// \return The .fm source
+    std::string Generate() const;
+
+private:
+    GeneratorOptions options_;
+
+    /// \brief Number of enums declared before the classes
+    static const size_t ENUM_COUNT = 8;
+
+    /// \brief Number of field types cycled through
+    static const size_t FIELD_KINDS = 6;
+};
+} // namespace bbfm
+
+// Restore previous alignment
+#pragma pack(pop)
+
+#endif // __BBFM_MODEL_GENERATOR_H_INCL__
@@ -0,0 +1,107 @@
+#ifndef __BBFM_MODEL_WATCHER_H_INCL__
+#define __BBFM_MODEL_WATCHER_H_INCL__
+
+// Set 8-byte alignment for all types in this header
+#pragma pack(push, 8)
+
+#include "Driver.h"
+#include "IncrementalParser.h"
+#include "SemanticAnalyzer.h"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+
+namespace bbfm {
+/// \brief A model file kept warm by the watcher
+struct WatchedModel
+{
+    std::string                     path;        // Source file path
+    uint64_t                        contentHash; // Hash of the content of the last build
+    bool                            upToDate;    // Last build succeeded and its outputs are written
+    IncrementalParser               parser;      // Reparses only changed declarations
+    AnalysisCache                   queries;     // Revalidates only classes whose inputs changed
+    ModuleAsts                      imports;     // ASTs of the imported files
+    std::set<std::string>           importPaths; // Canonical paths of the imported files
+    bool                            importsRead; // All imported files were read and parsed
+    std::map<std::string, uint64_t> outputs;     // Hash of the content last written, by output path
+};
+
+/// \brief Watch mode: rebuild the .fm files of a directory whenever they change
+///
+/// Uses inotify on the directory (not its subdirectories) and on the
+/// directories of the files its models import, so it runs on Linux only;
+/// elsewhere Run() reports an error. Events arriving
+/// within DEBOUNCE_MS of each other are coalesced into one rebuild. Every
+/// file is its own model; a rebuild reparses only the changed declarations of
+/// the changed files, revalidates only the classes that changed or use a
+/// changed type, and rewrites only the outputs whose content changed. Each
+/// rebuild prints its phase timings.
+///
+/// A change to a file rebuilds the models that import it, also if the file is
+/// outside the directory; only the changed imported files are parsed again.
+/// A model whose imports could not be loaded is rebuilt whenever a .fm file
+/// is created, moved in or written, so creating the missing file fixes it.
+///
+/// Outputs are optional. With an Arrow or SQL output directory, the model
+/// <name>.fm writes <name>.arrow.json or <name>.sql there. Deleting the
+/// model deletes its outputs.
+class ModelWatcher
+{
+public:
+    /// \brief Quiet period that ends a burst of events
+    static const int DEBOUNCE_MS = 100;
+
+    /// \brief Construct a watcher
+    /// \param directory Directory to watch
+    /// \param classPrefix Class prefix used for compiles and SQL table names
+    /// \param arrowDirectory Directory for Arrow schemas (empty for none)
+    /// \param sqlDirectory Directory for SQL schemas (empty for none)
+    ModelWatcher(const std::string& directory, const std::string& classPrefix, const std::string& arrowDirectory, const std::string& sqlDirectory);
+
+    /// \brief Destructor
+    virtual ~ModelWatcher() = default;
+
+    /// \brief Build all models, then rebuild changed ones until SIGINT or SIGTERM
+    /// \return Exit code (0 on clean shutdown)
+    int Run();
+
+private:
+    std::string                         directory_;
+    std::string                         classPrefix_;
+    std::string                         arrowDirectory_;
+    std::string                         sqlDirectory_;
+    std::string                         canonicalDirectory_; // Canonical path of directory_
+    std::map<std::string, WatchedModel> models_;             // By file name within the directory
+    ImportCache                         imports_;            // Imported modules parsed by earlier builds of any model
+    std::map<std::string, int>          watches_;            // inotify watch descriptor by canonical directory (negative if it cannot be watched)
+
+    /// \brief Watch the directories of the imported files that are not watched yet
+    /// \param fd The inotify descriptor
+    void WatchImportDirectories(const int fd);
+
+    /// \brief Rebuild one model and print its phase timings
+    /// \param fileName File name within the directory
+    /// \param importChanged True if a file the model imports changed
+    void Rebuild(const std::string& fileName, const bool importChanged = false);
+
+    /// \brief Write an output file unless it already has the content
+    /// \param model The model the output belongs to
+    /// \param path Output file path
+    /// \param content The new content
+    /// \param written Output true if the file was written
+    /// \return False if the file could not be written (already reported)
+    static bool WriteOutput(WatchedModel& model, const std::string& path, const std::string& content, bool& written);
+
+    /// \brief Check if a file name denotes a model source file
+    /// \param fileName The file name
+    /// \return True for names ending in .fm
+    static bool IsModelFile(const std::string& fileName);
+};
+} // namespace bbfm
+
+// Restore previous alignment
+#pragma pack(pop)
+
+#endif // __BBFM_MODEL_WATCHER_H_INCL__
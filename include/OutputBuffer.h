@@ -0,0 +1,116 @@
+#ifndef __BBFM_OUTPUT_BUFFER_H_INCL__
+#define __BBFM_OUTPUT_BUFFER_H_INCL__
+
+// Set 8-byte alignment for all types in this header
+#pragma pack(push, 8)
+
+#include <charconv>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <type_traits>
+
+namespace bbfm {
+/// \brief Growable text buffer for dumps and printers
+///
+/// Printers append to one buffer instead of building temporary strings or
+/// pushing every token through an ostream. A buffer either collects all
+/// output in memory (GetText()), or streams it: whenever the buffered text
+/// reaches the flush size, it is written to the stream in one call,
+/// so the memory use stays bounded however large the output.
+class OutputBuffer
+{
+public:
+    /// \brief Default size at which a streaming buffer writes its text
+    static const size_t DEFAULT_FLUSH_SIZE = 64 * 1024;
+
+    /// \brief Collect the output in memory
+    OutputBuffer();
+
+    /// \brief Stream the output to an ostream (e.g., std::cout, which the compile server captures, or a file)
+    /// \param stream The stream
+    /// \param flushSize Buffered size at which the text is written
+    explicit OutputBuffer(std::ostream& stream, const size_t flushSize = DEFAULT_FLUSH_SIZE);
+
+    /// \brief Write the remaining text of a streaming buffer
+    ~OutputBuffer();
+
+    OutputBuffer(const OutputBuffer&)            = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    /// \brief Append text
+    /// \param data The text
+    /// \param size Length of the text in bytes
+    void Append(const char* data, const size_t size)
+    {
+        text_.append(data, size);
+        if (text_.size() >= flushSize_)
+        {
+            Flush();
+        }
+    }
+
+    /// \brief Append a character repeatedly (e.g., indentation)
+    /// \param count Number of characters
+    /// \param c The character
+    void AppendRepeated(const size_t count, const char c);
+
+    OutputBuffer& operator<<(const std::string& text)
+    {
+        Append(text.data(), text.size());
+        return *this;
+    }
+
+    OutputBuffer& operator<<(const char* text)
+    {
+        Append(text, std::char_traits<char>::length(text));
+        return *this;
+    }
+
+    OutputBuffer& operator<<(const char c)
+    {
+        Append(&c, 1);
+        return *this;
+    }
+
+    // A bool would print as a control character; write "true" or "false" instead
+    OutputBuffer& operator<<(const bool value) = delete;
+
+    /// \brief Append an integer in decimal
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value && !std::is_same<T, char>::value, OutputBuffer&>::type
+        operator<<(const T value)
+    {
+        char                       digits[24];
+        const std::to_chars_result end = std::to_chars(digits, digits + sizeof(digits), value);
+        Append(digits, static_cast<size_t>(end.ptr - digits));
+        return *this;
+    }
+
+    /// \brief Write the buffered text of a streaming buffer now
+    void Flush();
+
+    /// \brief Get the text of an in-memory buffer
+    /// \return All text (for a streaming buffer, only the text not written yet)
+    const std::string& GetText() const;
+
+    /// \brief Move the text out of an in-memory buffer
+    /// \return All text, leaving the buffer empty
+    std::string TakeText();
+
+    /// \brief Check if writing to the stream failed
+    /// \return True after a failed write (the rest of the output is dropped)
+    bool HasFailed() const;
+
+private:
+    std::string   text_;
+    std::ostream* stream_;    // Stream of a streaming buffer (nullptr if in memory)
+    size_t        flushSize_; // SIZE_MAX for an in-memory buffer
+    bool          failed_;
+};
+} // namespace bbfm
+
+// Restore previous alignment
+#pragma pack(pop)
+
+#endif // __BBFM_OUTPUT_BUFFER_H_INCL__
@@ -0,0 +1,31 @@
+#ifndef __BBFM_PARSECONTEXT_H_INCL__
+#define __BBFM_PARSECONTEXT_H_INCL__
+
+// Set 8-byte alignment for all types in this header
+#pragma pack(push, 8)
+
+#include "AST.h"
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace bbfm {
+/// \brief State of one parse, passed to the reentrant parser
+///
+/// The parser and the scanner keep no global state, so several files can be
+/// parsed at the same time, each with its own context and scanner.
+struct ParseContext
+{
+    std::string          fileName;                     // Attached to syntax errors and declarations
+    std::string_view     text;                         // Source being parsed, for the source line of syntax errors
+    int                  firstLine            = 1;     // Line of the file the text starts at
+    int                  syntaxErrorCount     = 0;     // Syntax errors reported (the parser recovers from most of them)
+    bool                 declarationRecovered = false; // Error recovery dropped a member of the declaration being parsed
+    std::unique_ptr<AST> ast;                          // Set when the parse completes
+};
+} // namespace bbfm
+
+// Restore previous alignment
+#pragma pack(pop)
+
+#endif // __BBFM_PARSECONTEXT_H_INCL__
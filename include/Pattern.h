@@ -0,0 +1,115 @@
+#ifndef __BBFM_PATTERN_H_INCL__
+#define __BBFM_PATTERN_H_INCL__
+
+// Set 8-byte alignment for all types in this header
+#pragma pack(push, 8)
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bbfm {
+/// \brief Minimized deterministic finite automaton for a compiled pattern
+///
+/// Input bytes are first mapped to equivalence classes, so the transition table
+/// has one row per state and one column per byte class. Matching is one table
+/// lookup per input byte with no backtracking; a pattern always has to match the
+/// whole input.
+class PatternDfa
+{
+public:
+    /// \brief Transition target meaning "no match possible any more"
+    static constexpr int32_t DEAD_STATE = -1;
+
+    /// \brief Construct a DFA from its tables
+    /// \param byteClasses Equivalence class of every input byte
+    /// \param classCount Number of byte classes (columns of the transition table)
+    /// \param transitions Row-major transition table (states x classes), DEAD_STATE for no transition
+    /// \param accepting Accepting flag per state
+    /// \param startState The start state
+    PatternDfa(
+        const std::array<uint8_t, 256>& byteClasses, const int classCount, std::vector<int32_t> transitions, std::vector<bool> accepting,
+        const int32_t startState);
+
+    /// \brief Check whether the whole input matches the pattern
+    /// \param input The input to match
+    /// \return True if the input is accepted
+    bool Matches(std::string_view input) const;
+
+    /// \brief Get the number of states
+    /// \return Number of DFA states (the dead state is implicit and not counted)
+    size_t GetStateCount() const;
+
+    /// \brief Get the number of byte equivalence classes
+    /// \return Number of columns of the transition table
+    int GetClassCount() const;
+
+    /// \brief Get the start state
+    /// \return The start state
+    int32_t GetStartState() const;
+
+    /// \brief Get the transition for a state and an input byte
+    /// \param state The current state
+    /// \param byte The input byte
+    /// \return The next state or DEAD_STATE
+    int32_t GetTransition(const int32_t state, const uint8_t byte) const;
+
+    /// \brief Check whether a state is accepting
+    /// \param state The state to check
+    /// \return True if the state is accepting
+    bool IsAccepting(const int32_t state) const;
+
+    /// \brief Get the byte class table
+    /// \return Equivalence class of every input byte
+    const std::array<uint8_t, 256>& GetByteClasses() const;
+
+    /// \brief Get the transition table
+    /// \return Row-major transition table (states x classes)
+    const std::vector<int32_t>& GetTransitions() const;
+
+private:
+    std::array<uint8_t, 256> byteClasses_;
+    int                      classCount_;
+    std::vector<int32_t>     transitions_;
+    std::vector<bool>        accepting_;
+    int32_t                  startState_;
+};
+
+/// \brief Compiles patterns to minimized DFAs at model compile time
+///
+/// Supported syntax: literals, '.', character classes ([a-z], [^0-9]), the
+/// escapes \d \D \w \W \s \S \t \n \r \xHH, grouping, alternation and the
+/// quantifiers *, +, ?, {n}, {n,} and {n,m}. '^' and '$' are accepted at the
+/// start and end of the pattern only. Constructs that need backtracking
+/// (backreferences, lookaround, word boundaries) are rejected.
+class PatternCompiler
+{
+public:
+    /// \brief Maximum number of DFA states before a pattern is rejected as too complex
+    static constexpr size_t MAX_STATES = 4096;
+
+    /// \brief Maximum repetition count in {n,m}
+    static constexpr int MAX_REPEAT = 255;
+
+    /// \brief Compile a pattern to a minimized DFA
+    /// \param pattern The pattern source
+    /// \param error Output error message if compilation fails
+    /// \return The compiled DFA (nullptr on failure)
+    static std::unique_ptr<PatternDfa> Compile(const std::string& pattern, std::string& error);
+
+private:
+    // Static-only class - prevent instantiation
+    PatternCompiler()                                  = delete;
+    ~PatternCompiler()                                 = delete;
+    PatternCompiler(const PatternCompiler&)            = delete;
+    PatternCompiler& operator=(const PatternCompiler&) = delete;
+};
+} // namespace bbfm
+
+// Restore previous alignment
+#pragma pack(pop)
+
+#endif // __BBFM_PATTERN_H_INCL__
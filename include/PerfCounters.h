@@ -0,0 +1,68 @@
+#ifndef __BBFM_PERF_COUNTERS_H_INCL__
+#define __BBFM_PERF_COUNTERS_H_INCL__
+
+// Set 8-byte alignment for all types in this header
+#pragma pack(push, 8)
+
+#include <cstdint>
+#include <string>
+
+namespace bbfm {
+/// \brief Hardware event counts of one thread
+struct PerfCounts
+{
+    uint64_t cycles       = 0;
+    uint64_t instructions = 0;
+    uint64_t cacheMisses  = 0;
+    uint64_t branchMisses = 0;
+    unsigned events       = 0; // PerfCounters::Event bits of the counts that were measured
+};
+
+/// \brief Linux hardware performance counters (perf_event_open) for --perf-counters
+///
+/// Every thread opens its own counter group on first use; only user space
+/// is counted, so the default perf_event_paranoid setting is enough. When
+/// the kernel, the CPU or a container refuses an event, that event is left
+/// out, and when it refuses all of them, Read() fails and
+/// GetUnavailableReason() says why. Counts are scaled when the kernel
+/// multiplexes the group with other users of the counters.
+class PerfCounters
+{
+public:
+    /// \brief Measured events
+    enum Event : unsigned
+    {
+        CYCLES        = 1,
+        INSTRUCTIONS  = 2,
+        CACHE_MISSES  = 4,
+        BRANCH_MISSES = 8
+    };
+
+    /// \brief Read the counters of the calling thread
+    /// \param counts Receives the counts since the thread's group was opened
+    /// \return False if no counter is available
+    static bool Read(PerfCounts& counts);
+
+    /// \brief Get the counts between two reads of the same thread
+    /// \param start Counts at the start
+    /// \param end Counts at the end
+    /// \return The differences of the events measured in both
+    static PerfCounts Difference(const PerfCounts& start, const PerfCounts& end);
+
+    /// \brief Describe why counters are unavailable
+    /// \return Reason of the first refused event (empty if none was refused)
+    static std::string GetUnavailableReason();
+
+private:
+    // Static-only class - prevent instantiation
+    PerfCounters()                               = delete;
+    ~PerfCounters()                              = delete;
+    PerfCounters(const PerfCounters&)            = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+};
+} // namespace bbfm
+
+// Restore previous alignment
+#pragma pack(pop)
+
+#endif // __BBFM_PERF_COUNTERS_H_INCL__
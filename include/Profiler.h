@@ -0,0 +1,142 @@
+#ifndef __BBFM_PROFILER_H_INCL__
+#define __BBFM_PROFILER_H_INCL__
+
+// Set 8-byte alignment for all types in this header
+#pragma pack(push, 8)
+
+#include "PerfCounters.h"
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace bbfm {
+/// \brief A timed span of a compile
+struct ProfileSpan
+{
+    std::string category;  // "phase", "pass", "module", "class" or "output"
+    std::string name;      // Phase, file or class name
+    double      startUs;   // Start, in microseconds since the session started
+    double      wallUs;    // Wall time in microseconds
+    double      cpuUs;     // CPU time of the recording thread in microseconds
+    long        peakRssKb; // Peak resident set size of the process at the end of the span
+    int         track;     // Thread that recorded the span (0 is the first thread)
+    PerfCounts  counters;  // Hardware counts of the recording thread (no events if not measured)
+};
+
+/// \brief Spans measured with hardware counters for --perf-counters
+enum class PerfCounterMode
+{
+    OFF,    // No counters
+    PHASES, // Phases and outputs
+    PASSES  // Phases, outputs and the passes of semantic analysis
+};
+
+/// \brief Process-wide recorder of compile spans for --time-report and --trace-out
+///
+/// Disabled by default; a disabled profiler records nothing and a
+/// ProfileScope costs one flag test. Recording is thread-safe, and every
+/// thread gets its own track, so phases that run on several threads show up
+/// as parallel lanes in a trace viewer.
+class Profiler
+{
+public:
+    /// \brief Discard all spans and start recording
+    static void Start();
+
+    /// \brief Stop recording (the spans are kept)
+    static void Stop();
+
+    /// \brief Check if spans are being recorded
+    /// \return True while recording
+    static bool IsEnabled();
+
+    /// \brief Record a finished span
+    /// \param span The span (its track is set from the calling thread)
+    static void Record(ProfileSpan span);
+
+    /// \brief Get the recorded spans
+    /// \return Spans in the order they finished
+    static std::vector<ProfileSpan> GetSpans();
+
+    /// \brief Select the spans measured with hardware counters
+    /// \param mode Counter mode (OFF by default)
+    static void SetPerfCounterMode(const PerfCounterMode mode);
+
+    /// \brief Get the time elapsed since Start()
+    /// \return Microseconds since the session started
+    static double Now();
+
+    /// \brief Print phase times, hardware counters (if measured) and the slowest classes
+    /// \param out Output stream
+    /// \param maxClasses Number of classes to list
+    static void WriteReport(std::ostream& out, const size_t maxClasses = 10);
+
+    /// \brief Write the spans in Chrome trace event format (about://tracing, Perfetto)
+    /// \param path Output file path
+    /// \return False if the file could not be written
+    static bool WriteTrace(const std::string& path);
+
+private:
+    // Static-only class - prevent instantiation
+    Profiler()                           = delete;
+    ~Profiler()                          = delete;
+    Profiler(const Profiler&)            = delete;
+    Profiler& operator=(const Profiler&) = delete;
+};
+
+/// \brief Records the lifetime of a scope as a span while the profiler is enabled
+///
+/// "phase" and "output" scopes also attribute heap traffic to their name
+/// while allocation tracking is enabled.
+class ProfileScope
+{
+public:
+    /// \brief Start a span
+    /// \param category Span category ("phase", "pass", "module", "class" or "output")
+    /// \param name Span name
+    ProfileScope(const char* category, const std::string& name);
+
+    /// \brief End the span and record it
+    ~ProfileScope();
+
+    ProfileScope(const ProfileScope&)            = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    bool        enabled_;
+    const char* category_;
+    std::string name_;
+    double      startUs_;
+    double      cpuStartUs_;
+    bool        countPerf_;
+    PerfCounts  perfStart_;
+    int         previousAllocPhase_; // Phase to return to in the allocation tracker (-1 if not tracked)
+};
+
+/// \brief Starts the profiler for one compile and writes its report and trace when the compile ends
+class ProfileSession
+{
+public:
+    /// \brief Start a session (does nothing if no output is requested)
+    /// \param printReport Print the time report to stdout at the end
+    /// \param tracePath Chrome trace output file (empty for none)
+    /// \param perfCounters Spans to measure with hardware counters (prints the time report unless OFF)
+    ProfileSession(const bool printReport, const std::string& tracePath, const PerfCounterMode perfCounters = PerfCounterMode::OFF);
+
+    /// \brief Stop the profiler and write the requested outputs
+    ~ProfileSession();
+
+    ProfileSession(const ProfileSession&)            = delete;
+    ProfileSession& operator=(const ProfileSession&) = delete;
+
+private:
+    bool        printReport_;
+    std::string tracePath_;
+};
+} // namespace bbfm
+
+// Restore previous alignment
+#pragma pack(pop)
+
+#endif // __BBFM_PROFILER_H_INCL__
@@ -0,0 +1,214 @@
+#ifndef __BBFM_SCHEMA_DIFF_H_INCL__
+#define __BBFM_SCHEMA_DIFF_H_INCL__
+
+// Set 8-byte alignment for all types in this header
+#pragma pack(push, 8)
+
+#include "Fingerprint.h"
+#include "Layout.h"
+#include "SemanticAnalyzer.h"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace bbfm {
+/// \brief Kind of change between two versions of a model
+enum class ChangeKind
+{
+    ENUM_ADDED,
+    ENUM_REMOVED,
+    ENUM_VALUE_ADDED,
+    ENUM_VALUE_REMOVED,    // Stored values may no longer exist
+    ENUM_CODES_REMAPPED,   // Values inserted or reordered, stored codes are translated
+    CLASS_ADDED,
+    CLASS_REMOVED,
+    CLASS_RENAMED,         // Same structure under a new name
+    FIELD_ADDED_OPTIONAL,  // Existing records have no value
+    FIELD_ADDED_MANDATORY, // Existing records get a zero value
+    FIELD_REMOVED,
+    TYPE_WIDENED,          // Every old value converts losslessly (Date -> Timestamp)
+    TYPE_CONVERTED,        // Old values convert but may change meaning or precision (Int -> Real, Int -> Timestamp)
+    TYPE_CHANGED,          // Old values cannot be converted
+    CARDINALITY_RELAXED,   // e.g., [1] -> [0..1]
+    CARDINALITY_TIGHTENED, // e.g., [0..1] -> [1]
+    STORAGE_CHANGED,       // [interned] or [encoding(...)] changed, values are kept
+    COMPUTED_CHANGED,      // Computed feature changed, nothing stored
+    INVARIANT_ADDED,       // Existing data must be validated again
+    INVARIANT_REMOVED
+};
+
+/// \brief One classified change
+struct SchemaChange
+{
+    ChangeKind  kind;
+    std::string typeName;  // Enum or class name
+    std::string fieldName; // Field, enum value or invariant (empty for type-level changes)
+    std::string detail;    // Human readable description (e.g., "Int -> Real")
+    bool        breaking;  // True if old data cannot be converted without loss or validation
+
+    /// \brief Convert a change kind to its name
+    /// \param kind The change kind
+    /// \return Change kind name (e.g., "field added (optional)")
+    static const char* KindToString(const ChangeKind kind);
+};
+
+/// \brief Kind of a step converting an old record into a new record
+enum class MigrationOpKind
+{
+    COPY,       // memcpy of a byte run (adjacent unchanged fields coalesced)
+    CONVERT,    // Per-value conversion (e.g., days -> microseconds, int64 -> float64)
+    REMAP_ENUM, // Translate enum codes through a table
+    PRESENCE,   // Move or set a presence bit
+    ZERO        // New field without a value in the old record (records start zeroed)
+};
+
+/// \brief One step of a record migration
+struct MigrationOp
+{
+    MigrationOpKind kind;
+    uint32_t        oldOffset; // Byte offset in the old record (or old presence bit)
+    uint32_t        newOffset; // Byte offset in the new record (or new presence bit)
+    uint32_t        size;      // Bytes copied or written
+    std::string     fields;    // Field names covered by the step
+    std::string     detail;    // Conversion description
+};
+
+/// \brief Migration of the records of one class
+///
+/// Converters apply the steps to every old record of a batch; a run of
+/// coalesced COPY steps is a handful of memcpy calls per record, and records
+/// whose layouts are identical are copied as whole files. String and element
+/// heaps are carried over unchanged, so their offsets stay valid.
+struct ClassMigration
+{
+    std::string              oldClassName;
+    std::string              newClassName;
+    uint32_t                 oldSize;   // Old record size
+    uint32_t                 newSize;   // New record size
+    bool                     identical; // Same fingerprint: records are copied unchanged
+    std::vector<MigrationOp> ops;       // Record steps in new offset order
+    std::vector<std::string> columns;   // Columnar steps, one per new column
+};
+
+/// \brief Compares two compiled versions of a model
+///
+/// Types are matched by name; classes and enums with equal fingerprints are
+/// unchanged and skip the field comparison entirely. Removed and added classes
+/// with the same structure are reported as renames. Fields are matched by name
+/// within the inheritance chain, and a field whose canonical form is unchanged
+/// only needs its offsets compared.
+class SchemaDiff
+{
+public:
+    /// \brief Construct a schema diff
+    /// \param oldAnalyzer Analyzer of the old model
+    /// \param oldLayouts Layouts of the old model
+    /// \param newAnalyzer Analyzer of the new model
+    /// \param newLayouts Layouts of the new model
+    SchemaDiff(const SemanticAnalyzer* oldAnalyzer, const LayoutBuilder* oldLayouts, const SemanticAnalyzer* newAnalyzer, const LayoutBuilder* newLayouts);
+
+    /// \brief Destructor
+    virtual ~SchemaDiff() = default;
+
+    /// \brief Compare the models and plan the migrations
+    void Compute();
+
+    /// \brief Get the classified changes
+    /// \return Enum changes, then class changes, in type name order
+    const std::vector<SchemaChange>& GetChanges() const;
+
+    /// \brief Get the record migrations of classes present in both models
+    /// \return Migrations in new class name order
+    const std::vector<ClassMigration>& GetMigrations() const;
+
+    /// \brief Check whether old data converts to the new model without loss
+    /// \return True if no change is breaking
+    bool IsCompatible() const;
+
+    /// \brief Dump the changes and migrations to stdout
+    void Dump() const;
+
+private:
+    const SemanticAnalyzer*            oldAnalyzer_;
+    const LayoutBuilder*               oldLayouts_;
+    const SemanticAnalyzer*            newAnalyzer_;
+    const LayoutBuilder*               newLayouts_;
+    SchemaFingerprinter                oldFingerprinter_;
+    SchemaFingerprinter                newFingerprinter_;
+    std::vector<SchemaChange>          changes_;
+    std::vector<ClassMigration>        migrations_;
+    std::map<std::string, std::string> renamedClasses_; // Old class name -> new class name
+
+    /// \brief Compare the enums of both models
+    void CompareEnums();
+
+    /// \brief Compare the classes of both models and plan their migrations
+    void CompareClasses();
+
+    /// \brief Compare the fields and invariants of a class present in both models
+    /// \param oldLayout Layout of the old class
+    /// \param newLayout Layout of the new class
+    void CompareFields(const ClassLayout& oldLayout, const ClassLayout& newLayout);
+
+    /// \brief Compare a field present in both versions of a class
+    /// \param className New class name
+    /// \param oldField The old field
+    /// \param newField The new field
+    void CompareField(const std::string& className, const Field* oldField, const Field* newField);
+
+    /// \brief Plan the record and column migration of a class
+    /// \param oldLayout Layout of the old class
+    /// \param newLayout Layout of the new class
+    /// \return The migration steps
+    ClassMigration PlanMigration(const ClassLayout& oldLayout, const ClassLayout& newLayout) const;
+
+    /// \brief Plan the conversion of one stored field
+    /// \param oldField Old field layout
+    /// \param newField New field layout
+    /// \param op Output step
+    /// \return True if old values can be carried over (false: the new field starts zeroed)
+    bool PlanFieldConversion(const FieldLayout& oldField, const FieldLayout& newField, MigrationOp& op) const;
+
+    /// \brief Describe the conversion of a value between two storages
+    /// \param from Old storage
+    /// \param to New storage
+    /// \return Conversion description, empty if values cannot be converted
+    static std::string ConversionDetail(const StorageKind from, const StorageKind to);
+
+    /// \brief Get the declared type name of a field
+    /// \param field The field
+    /// \return Primitive type name or user-defined type name
+    static std::string TypeName(const Field* field);
+
+    /// \brief Get the declared fields (stored and computed) of a class chain
+    /// \param layout The class layout
+    /// \return Fields, root class first, in declaration order
+    static std::vector<const Field*> DeclaredFields(const ClassLayout& layout);
+
+    /// \brief Check whether the values of an enum keep their codes
+    /// \param oldEnum Old enum declaration
+    /// \param newEnum New enum declaration
+    /// \return True if every old value has the same index in the new enum
+    static bool EnumCodesStable(const EnumDeclaration* oldEnum, const EnumDeclaration* newEnum);
+
+    /// \brief Get the enum declaration of a field type
+    /// \param analyzer The analyzer of the model
+    /// \param typeName The type name
+    /// \return Pointer to the enum declaration or nullptr if the type is not an enum
+    static const EnumDeclaration* FindEnum(const SemanticAnalyzer* analyzer, const std::string& typeName);
+
+    /// \brief Add a change
+    /// \param kind The change kind
+    /// \param typeName Enum or class name
+    /// \param fieldName Field, enum value or invariant
+    /// \param detail Human readable description
+    /// \param breaking True if old data cannot be converted without loss or validation
+    void AddChange(const ChangeKind kind, const std::string& typeName, const std::string& fieldName, const std::string& detail, const bool breaking);
+};
+} // namespace bbfm
+
+// Restore previous alignment
+#pragma pack(pop)
+
+#endif // __BBFM_SCHEMA_DIFF_H_INCL__
@@ -5,9 +5,13 @@
 #pragma pack(push, 8)
 
 #include "AST.h"
+#include "Pattern.h"
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace bbfm {
@@ -41,6 +45,171 @@ struct TypeSymbol
     }
 };
 
+/// \brief Aggregate over an array relationship that is maintained incrementally
+///
+/// Recorded for every aggregate function call found in invariants and computed
+/// features. Code generation uses these entries to keep a stored count or sum that
+/// is updated on insert and remove, so checking the invariant is O(1) instead of
+/// rescanning the collection.
+struct AggregateSymbol
+{
+    enum class Kind
+    {
+        COUNT,
+        SUM
+    };
+
+    Kind             kind;
+    const Field*     collection; // The array field being aggregated
+    std::string      memberName; // Element member being summed (empty for count and primitive arrays)
+    Expression::Type resultType;
+
+    /// \brief Convert aggregate kind to its function name
+    /// \param kind The aggregate kind
+    /// \return Function name as written in source
+    static const char* KindToString(const Kind kind);
+};
+
+/// \brief Pattern constraint compiled to a DFA at model compile time
+///
+/// Recorded for every matches(field, "pattern") call. Identical patterns share one
+/// compiled DFA, which generated code and evaluators use for linear-time matching.
+struct PatternSymbol
+{
+    std::string       subject; // The matched string expression (e.g., rssUrl)
+    std::string       pattern; // Pattern source without quotes
+    const PatternDfa* dfa;     // Minimized DFA owned by the analyzer
+};
+
+/// \brief Memoized result of the query "is class X valid"
+///
+/// Holds everything validating one class produced and every type name the
+/// validation looked up. The result can be reused while the class and all
+/// looked-up types are unchanged.
+struct ClassQueryResult
+{
+    /// \brief Aggregate recorded by the query, the collection field by name
+    struct Aggregate
+    {
+        AggregateSymbol::Kind kind;
+        std::string           collectionName;
+        std::string           memberName;
+        Expression::Type      resultType;
+    };
+
+    /// \brief Pattern constraint recorded by the query
+    struct Pattern
+    {
+        std::string subject;
+        std::string pattern;
+    };
+
+    /// \brief Semantic error recorded by the query
+    struct Error
+    {
+        std::string message;
+        int         lineOffset; // Line relative to the class declaration, which may have moved since
+        int         column;     // 1-based column, 0 if the error has no location
+    };
+
+    uint64_t                 inputHash;    // Hash of the class source and of the looked-up types (0 if an input has no source hash)
+    bool                     valid;        // Result of the query
+    bool                     cyclic;       // The class inherits from itself (reported after the errors of all classes)
+    std::set<std::string>    dependencies; // Type names looked up, including undefined ones
+    std::vector<Error>       errors;       // Semantic errors in report order
+    std::vector<Aggregate>   aggregates;
+    std::vector<Pattern>     patterns;
+    uint64_t                 generation; // Last analysis that used the result
+};
+
+/// \brief Query results kept between analyses of successive versions of a model
+///
+/// Pass the same cache to the analyzers of successive versions (e.g., the
+/// versions an editor sends to the language server). Only classes whose query
+/// inputs changed are validated again; the others replay their recorded
+/// results. Declarations need source hashes (see IncrementalParser), classes
+/// without one are always validated.
+///
+/// The cache also keeps the symbol table of the last analysis and, for each
+/// type, the classes whose query looked it up. After an analysis without
+/// syntax errors or duplicate types, the next one updates the tables in place:
+/// it compares each declaration with the one the table holds and visits only
+/// the queries of changed types and of the classes that looked them up.
+class AnalysisCache
+{
+public:
+    /// \brief Construct an empty cache
+    AnalysisCache() = default;
+
+    /// \brief Destructor
+    virtual ~AnalysisCache() = default;
+
+    /// \brief Start an analysis, resetting the counters
+    void BeginAnalysis();
+
+    /// \brief Find the result of the previous query for a class
+    /// \param className The class name
+    /// \return The result or nullptr
+    const ClassQueryResult* Find(const std::string& className) const;
+
+    /// \brief Keep the result of the previous query for a class
+    /// \param className The class name (must have a result)
+    void Reuse(const std::string& className);
+
+    /// \brief Store the result of a query
+    /// \param className The class name
+    /// \param result The result
+    void Store(const std::string& className, ClassQueryResult result);
+
+    /// \brief Drop the result of the query for a class
+    /// \param className The class name
+    void Drop(const std::string& className);
+
+    /// \brief End an analysis, dropping results of classes it did not query
+    void EndAnalysis();
+
+    /// \brief Get the number of query results reused by the last analysis
+    /// \return Number of reused results
+    size_t GetReusedCount() const;
+
+    /// \brief Get the number of queries computed by the last analysis
+    /// \return Number of computed results
+    size_t GetComputedCount() const;
+
+private:
+    friend class SemanticAnalyzer;
+
+    /// \brief Declaration of a type in the last analysis
+    struct TypeEntry
+    {
+        uint64_t declarationId; // Declaration::GetId(), the same while the parser reuses the declaration
+        uint64_t sourceHash;    // Declaration::GetSourceHash()
+        uint64_t generation;    // Last analysis that found the type declared
+    };
+
+    std::map<std::string, ClassQueryResult>             results_;       // By class name
+    std::map<std::string, std::set<std::string>>        dependents_;    // Classes whose query looked up a type, by type name
+    std::set<std::string>                               failedClasses_; // Classes whose query reported errors
+    std::unordered_map<std::string, TypeEntry>          types_;         // Declared types of the last analysis (looked up for every declaration)
+    std::map<std::string, TypeSymbol>                   symbolTable_;   // Tables of the last analysis, updated in place by the next one
+    std::map<std::string, std::vector<AggregateSymbol>> aggregates_;
+    std::map<std::string, std::vector<PatternSymbol>>   patterns_;
+    std::map<std::string, std::unique_ptr<PatternDfa>>  compiledPatterns_;
+    bool                                                incremental_   = false; // The tables are complete and may be updated in place
+    uint64_t                                            generation_    = 0;
+    size_t                                              reusedCount_   = 0;
+    size_t                                              computedCount_ = 0;
+
+    /// \brief Clear the tables before an analysis of the whole model (query results are kept)
+    void ClearTables();
+
+    /// \brief Add or remove a class in the dependents of the types its query looked up
+    /// \param className The class name
+    /// \param result The query result
+    /// \param add True to add, false to remove
+    void UpdateDependents(const std::string& className, const ClassQueryResult& result, const bool add);
+};
+
 /// \brief Semantic analyzer for BBFM language
 ///
 /// Performs semantic analysis including:
@@ -49,12 +218,22 @@ struct TypeSymbol
 /// - Inheritance cycle detection
 /// - Field uniqueness checking
 /// - Invariant validation
+/// - Aggregate function validation
+/// - Pattern constraint compilation
+/// - Integer temporal arithmetic (Timestamp/Timespan) validation
+/// - Quantified expression (forall/exists) validation
+///
+/// Class validation is organized as one query per class. With an AnalysisCache
+/// the query results are memoized across analyses, keyed by the class source
+/// and the types the query looked up, and the symbol table is updated in place.
 class SemanticAnalyzer
 {
 public:
     /// \brief Construct a semantic analyzer
     /// \param ast Pointer to the AST to analyze
-    explicit SemanticAnalyzer(const AST* ast);
+    /// \param cache Query results of earlier analyses (nullptr to validate every class)
+    /// \param imports ASTs of the modules the AST imports (nullptr for none)
+    explicit SemanticAnalyzer(const AST* ast, AnalysisCache* cache = nullptr, const ModuleAsts* imports = nullptr);
 
     /// \brief Destructor
     virtual ~SemanticAnalyzer() = default;
@@ -71,13 +250,64 @@ public:
     /// \return Reference to the symbol table
     const std::map<std::string, TypeSymbol>& GetSymbolTable() const;
 
-    /// \brief Dump the symbol table to stdout
-    void DumpSymbolTable() const;
+    /// \brief Get the incrementally maintained aggregates declared by a class
+    /// \param className The class name
+    /// \return Aggregates used in the class's own invariants and computed features
+    const std::vector<AggregateSymbol>& GetAggregates(const std::string& className) const;
+
+    /// \brief Get the pattern constraints declared by a class
+    /// \param className The class name
+    /// \return Patterns used in the class's own invariants and computed features
+    const std::vector<PatternSymbol>& GetPatterns(const std::string& className) const;
+
+    /// \brief Get a class and its base classes, root class first
+    /// \param classDecl The class declaration
+    /// \param chain Output vector to store the inheritance chain
+    void GetClassChain(const ClassDeclaration* classDecl, std::vector<const ClassDeclaration*>& chain) const;
+
+    /// \brief Dump the symbol table as text
+    /// \param out Output buffer
+    void DumpSymbolTable(OutputBuffer& out) const;
+
+    /// \brief Dump the symbol table as one JSON object
+    /// \param json JSON writer
+    void DumpSymbolTableJson(JsonWriter& json) const;
+
+    /// \brief Get the type name referenced by a type specification
+    /// \param typeSpec The type specification
+    /// \return Primitive or user-defined type name
+    static std::string TypeSpecToName(const TypeSpec* typeSpec);
+
+    /// \brief Get the universal metadata fields of every class
+    /// \return Map of field name to primitive type name
+    static const std::map<std::string, const char*>& GetUniversalFields();
+
+    /// \brief Get the type name of a universal metadata field
+    /// \param fieldName The field name (typeId, id, cardinality, creationDate, modificationDate, comment)
+    /// \return Primitive type name, or nullptr if the name is not a universal metadata field
+    static const char* UniversalFieldTypeName(const std::string& fieldName);
+
+    /// \brief Add the names of all universal metadata fields to a set
+    /// \param fieldNames Output set of field names
+    static void AddUniversalFieldNames(std::set<std::string>& fieldNames);
 
 private:
-    const AST*                        ast_;
-    std::map<std::string, TypeSymbol> symbolTable_;
-    bool                              hasErrors_;
+    std::vector<const Declaration*>                      declarations_; // Imported declarations first, then those of the AST
+    AnalysisCache                                        ownTables_;    // Tables of an analysis without a cache
+    AnalysisCache*                                       cache_;
+    std::map<std::string, TypeSymbol>&                   symbolTable_; // The tables of cache_ (or ownTables_)
+    std::map<std::string, std::vector<AggregateSymbol>>& aggregates_;
+    std::map<std::string, std::vector<PatternSymbol>>&   patterns_;
+    std::map<std::string, std::unique_ptr<PatternDfa>>&  compiledPatterns_;
+    bool                                                 hasErrors_;
+    ClassQueryResult*                                    currentQuery_; // Query being computed, records lookups and errors
+    const Declaration*                                  errorDeclaration_; // Declaration being analyzed, its file is attached to errors
+    const ASTNode*                                      errorNode_;        // Declaration, field or invariant being analyzed, its location is attached to errors
+    std::set<std::string>                               brokenTypes_;      // Types damaged by syntax errors and classes inheriting from them
+
+    // Variables bound by enclosing quantifiers while an expression body is analyzed,
+    // innermost last. Each maps the variable name to the collection's element type.
+    mutable std::vector<std::pair<std::string, const TypeSymbol*>> boundVariables_;
 
     /// \brief Register primitive types in symbol table
     void RegisterPrimitiveTypes();
@@ -90,11 +320,67 @@ private:
     /// \return True if successful, false if errors occurred
     bool ValidateTypeReferences();
 
+    /// \brief Update the tables of the previous analysis for the declarations that changed
+    ///
+    /// Only the queries of changed types and of the classes that looked them up
+    /// are computed, the errors of the other failed classes are replayed. Nothing
+    /// is reported if the declarations need an analysis of the whole model (syntax
+    /// errors or duplicate types).
+    /// \param valid Output true if no errors were found
+    /// \return False if the declarations need an analysis of the whole model
+    bool AnalyzeChanges(bool& valid);
+
+    /// \brief Check whether a base class of a class was damaged by a syntax error
+    /// \param classDecl The class declaration
+    /// \return True if a base class in the inheritance chain is in brokenTypes_
+    bool InheritsFromBrokenType(const ClassDeclaration* classDecl) const;
+
+    /// \brief Answer the query "is class X valid", reusing a cached result if its inputs are unchanged
+    /// \param decl The class declaration
+    /// \param cyclic Output true if the class inherits from itself (not reported yet)
+    /// \return True if valid, false if errors found
+    bool QueryClassValidity(const Declaration* decl, bool& cyclic);
+
+    /// \brief Compute the query "is class X valid" and store the result in the cache
+    /// \param decl The class declaration
+    /// \param cyclic Output true if the class inherits from itself (not reported yet)
+    /// \return True if valid, false if errors found
+    bool ComputeClassQuery(const Declaration* decl, bool& cyclic);
+
+    /// \brief Hash the inputs of a class query
+    /// \param sourceHash Source hash of the class
+    /// \param dependencies Type names the query looked up
+    /// \param inputHash Output hash
+    /// \return False if an input has no source hash (the query cannot be cached)
+    bool HashQueryInputs(const uint64_t sourceHash, const std::set<std::string>& dependencies, uint64_t& inputHash) const;
+
+    /// \brief Report the errors recorded by a cached class query
+    /// \param classDecl The class declaration
+    /// \param result The cached result
+    void ReplayQueryErrors(const ClassDeclaration* classDecl, const ClassQueryResult& result);
+
+    /// \brief Rebuild the aggregates and patterns of a class from a cached class query
+    ///
+    /// Aggregates point to fields of the AST, so they are rebuilt whenever the
+    /// class or a class it looked up was parsed again.
+    /// \param classDecl The class declaration
+    /// \param result The cached result
+    void RestoreQuerySymbols(const ClassDeclaration* classDecl, const ClassQueryResult& result);
+
+    /// \brief Report the classes that inherit from themselves
+    /// \param cyclic The class declarations, in declaration order
+    void ReportInheritanceCycles(const std::vector<const Declaration*>& cyclic);
+
     /// \brief Validate a single class declaration
     /// \param classDecl The class declaration to validate
     /// \return True if valid, false if errors found
     bool ValidateClassDeclaration(const ClassDeclaration* classDecl);
 
+    /// \brief Check whether a class inherits from itself
+    /// \param classDecl The class declaration
+    /// \return True if the inheritance chain of the class leads back to it
+    bool InheritsFromItself(const ClassDeclaration* classDecl);
+
     /// \brief Check for cycles in inheritance chain
     /// \param className Name of the class to check
     /// \param visited Set of visited class names for cycle detection
@@ -170,6 +456,90 @@ private:
     /// \return Pointer to TypeSymbol or nullptr if not found
     const TypeSymbol* GetFieldType(const ClassDeclaration* classDecl, const std::string& fieldName) const;
 
+    /// \brief Validate storage modifiers ([unique], [interned], [encoding(...)]) of a field
+    /// \param field The field to validate
+    /// \param classDecl The containing class
+    /// \return True if valid, false otherwise
+    bool ValidateFieldModifiers(const Field* field, const ClassDeclaration* classDecl);
+
+    /// \brief Find a field by name in a class including inherited fields
+    /// \param classDecl The class to search
+    /// \param fieldName The field name
+    /// \return Pointer to the field or nullptr if not found
+    const Field* LookupField(const ClassDeclaration* classDecl, const std::string& fieldName) const;
+
+    /// \brief Validate built-in function calls (aggregates, matches) in an expression recursively
+    /// \param expr The expression to validate
+    /// \param classDecl The containing class
+    /// \param errorContext Context string for error messages
+    /// \return True if valid, false otherwise
+    bool ValidateFunctionCallsInExpression(const Expression* expr, const ClassDeclaration* classDecl, const std::string& errorContext);
+
+    /// \brief Validate a single aggregate function call and record it for incremental maintenance
+    /// \param funcCall The function call expression
+    /// \param classDecl The containing class
+    /// \param errorContext Context string for error messages
+    /// \return True if valid, false otherwise
+    bool ValidateAggregate(const FunctionCall* funcCall, const ClassDeclaration* classDecl, const std::string& errorContext);
+
+    /// \brief Validate a matches(field, "pattern") call and compile its pattern to a DFA
+    /// \param funcCall The function call expression
+    /// \param classDecl The containing class
+    /// \param errorContext Context string for error messages
+    /// \return True if valid, false otherwise
+    bool ValidatePatternMatch(const FunctionCall* funcCall, const ClassDeclaration* classDecl, const std::string& errorContext);
+
+    /// \brief Validate quantified expressions (forall/exists) in an expression recursively
+    ///
+    /// Checks that each quantifier ranges over an array field, that the bound variable
+    /// does not shadow a field, and that the body is a valid boolean predicate. Member
+    /// access on the bound variable is validated against the collection's element type.
+    /// \param expr The expression to validate
+    /// \param classDecl The containing class
+    /// \param errorContext Context string for error messages
+    /// \return True if valid, false otherwise
+    bool ValidateQuantifiersInExpression(const Expression* expr, const ClassDeclaration* classDecl, const std::string& errorContext);
+
+    /// \brief Validate operand types of operators involving Timestamp and Timespan values
+    ///
+    /// Temporal values are integer microsecond counts. Arithmetic must follow the
+    /// rules of BinaryExpression::InferArithmeticType, comparisons need operands of
+    /// the same temporal type (or an Int microsecond count), and Real operands are rejected.
+    /// \param expr The expression to validate
+    /// \param classDecl The containing class
+    /// \param errorContext Context string for error messages
+    /// \return True if valid, false otherwise
+    bool ValidateTemporalOperandsInExpression(const Expression* expr, const ClassDeclaration* classDecl, const std::string& errorContext);
+
+    /// \brief Resolve the array field a quantifier or aggregate ranges over
+    /// \param collection The collection expression (field or member of a bound variable)
+    /// \param classDecl The containing class
+    /// \return Pointer to the collection field or nullptr if it cannot be resolved
+    const Field* ResolveCollectionField(const Expression* collection, const ClassDeclaration* classDecl) const;
+
+    /// \brief Check whether an expression may hold several values
+    /// \param expr The expression (field, member access or bound variable)
+    /// \param classDecl The containing class
+    /// \return True if the expression is, or is a member reached through, an array field
+    bool IsMultiValued(const Expression* expr, const ClassDeclaration* classDecl) const;
+
+    /// \brief Look up a variable bound by an enclosing quantifier
+    /// \param name The variable name
+    /// \return Element type the variable ranges over, or nullptr if not bound
+    const TypeSymbol* LookupBoundVariable(const std::string& name) const;
+
+    /// \brief Infer the result type of an aggregate function call
+    /// \param funcCall The function call expression
+    /// \param classDecl The containing class (for field lookups)
+    /// \return Expression::Type of the result, UNKNOWN if the call is not a valid aggregate
+    Expression::Type InferAggregateType(const FunctionCall* funcCall, const ClassDeclaration* classDecl) const;
+
+    /// \brief Map a function name to an aggregate kind
+    /// \param functionName The function name
+    /// \param kind Output aggregate kind
+    /// \return True if the name denotes an aggregate function
+    static bool AggregateKindFromName(const std::string& functionName, AggregateSymbol::Kind& kind);
+
     /// \brief Infer the result type of an expression
     /// \param expr The expression to analyze
     /// \param classDecl The containing class (for field lookups)
@@ -197,16 +567,39 @@ private:
     /// \return Pointer to type symbol or nullptr if not found
     const TypeSymbol* LookupType(const std::string& typeName) const;
 
-    /// \brief Annotate expression with field origin markers
+    /// \brief Count the symbol table entries by kind
+    /// \param primitiveCount Output number of primitive types
+    /// \param enumCount Output number of enumerations
+    /// \param classCount Output number of classes
+    void CountSymbols(int& primitiveCount, int& enumCount, int& classCount) const;
+
+    /// \brief Get the aggregates of a class and its base classes, each listed once
+    /// \param classDecl The class declaration
+    /// \param allAggregates Output pairs of (declared by the class itself, aggregate)
+    void GetAllAggregates(const ClassDeclaration* classDecl, std::vector<std::pair<bool, const AggregateSymbol*>>& allAggregates) const;
+
+    /// \brief Print a field modifier as written in the model
+    /// \param out Output buffer
+    /// \param modifier The modifier
+    static void PrintModifier(OutputBuffer& out, const Modifier* modifier);
+
+    /// \brief Print an expression with field origin markers
+    /// \param out Output buffer
     /// \param expr The expression to annotate
     /// \param classDecl The containing class
     /// \param localFields Set of locally declared fields
-    /// \return String representation with <base>/<self> markers
-    std::string AnnotateExpressionWithOrigin(const Expression* expr, const ClassDeclaration* classDecl, const std::set<const Field*>& localFields) const;
+    void AnnotateExpressionWithOrigin(
+        OutputBuffer& out, const Expression* expr, const ClassDeclaration* classDecl, const std::set<const Field*>& localFields) const;
 
-    /// \brief Report a semantic error
+    /// \brief Report a semantic error at the node being analyzed
     /// \param message The error message
     void ReportError(const std::string& message);
+
+    /// \brief Report a semantic error in the declaration being analyzed
+    /// \param message The error message
+    /// \param line 1-based line (0 for no location)
+    /// \param column 1-based column (0 for no location)
+    void ReportError(const std::string& message, const int line, const int column);
 };
 } // namespace bbfm
 
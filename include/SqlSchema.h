@@ -0,0 +1,106 @@
+#ifndef __BBFM_SQL_SCHEMA_H_INCL__
+#define __BBFM_SQL_SCHEMA_H_INCL__
+
+// Set 8-byte alignment for all types in this header
+#pragma pack(push, 8)
+
+#include "AST.h"
+#include "Layout.h"
+#include "SemanticAnalyzer.h"
+#include <ostream>
+#include <set>
+#include <string>
+
+namespace bbfm {
+/// \brief Emits SQLite DDL and loader statements from the class layouts
+///
+/// Every class becomes a table holding its stored fields (universal metadata,
+/// inherited and own fields), keyed by id:
+/// - Array fields become junction tables (owner, position, value)
+/// - [unique] fields get UNIQUE indexes
+/// - Enums are TEXT columns restricted to their values
+/// - Object references get foreign keys, except references to a class with
+///   subclasses: a subclass row lives in the subclass table only
+/// - Invariants become CHECK constraints when they only use stored fields,
+///   computed features, literals and operators; others are listed as comments
+///
+/// For each table an INSERT statement with positional parameters (?1, ?2, ...)
+/// is emitted in column order, for loaders that bind columns by position and
+/// run batches of rows per transaction.
+class SqlSchemaWriter
+{
+public:
+    /// \brief Construct a SQL schema writer
+    /// \param analyzer The semantic analyzer that validated the model
+    /// \param layouts The computed class layouts
+    /// \param tablePrefix Prefix for table names (the class prefix)
+    SqlSchemaWriter(const SemanticAnalyzer* analyzer, const LayoutBuilder* layouts, const std::string& tablePrefix);
+
+    /// \brief Destructor
+    virtual ~SqlSchemaWriter() = default;
+
+    /// \brief Write the DDL of all classes
+    /// \param out Output stream
+    void Write(std::ostream& out) const;
+
+private:
+    const SemanticAnalyzer* analyzer_;
+    const LayoutBuilder*    layouts_;
+    std::string             tablePrefix_;
+
+    /// \brief Maximum depth when inlining computed features into CHECK constraints
+    static constexpr int MAX_INLINE_DEPTH = 16;
+
+    /// \brief Write the table, junction tables, indexes and loader statements of a class
+    /// \param out Output stream
+    /// \param layout The class layout
+    /// \param baseClasses Names of the classes other classes inherit from
+    void WriteClass(std::ostream& out, const ClassLayout& layout, const std::set<std::string>& baseClasses) const;
+
+    /// \brief Get the SQL column type and constraints of a column
+    /// \param column The column
+    /// \param baseClasses Names of the classes other classes inherit from (references to them get no foreign key)
+    /// \return Column definition without the column name (e.g., "INTEGER NOT NULL")
+    std::string ColumnDefinition(const ColumnLayout& column, const std::set<std::string>& baseClasses) const;
+
+    /// \brief Get the SQL type of a single value
+    /// \param storage Storage of the value
+    /// \return SQLite type name (INTEGER, REAL, TEXT or BLOB)
+    static const char* SqlType(const StorageKind storage);
+
+    /// \brief Translate an expression to a SQL expression
+    /// \param expr The expression
+    /// \param layout The class layout (for field lookups)
+    /// \param depth Current computed feature inlining depth
+    /// \param sql Output SQL expression
+    /// \return True if the expression can be expressed in SQL
+    bool ExpressionToSql(const Expression* expr, const ClassLayout& layout, const int depth, std::string& sql) const;
+
+    /// \brief Check whether an expression yields a string
+    /// \param expr The expression
+    /// \param layout The class layout (for field lookups)
+    /// \return True for string literals and String fields
+    bool IsStringExpression(const Expression* expr, const ClassLayout& layout) const;
+
+    /// \brief Find a field (stored or computed) by name in the class chain
+    /// \param layout The class layout
+    /// \param fieldName The field name
+    /// \return Pointer to the field or nullptr if not declared
+    static const Field* FindDeclaredField(const ClassLayout& layout, const std::string& fieldName);
+
+    /// \brief Quote an SQL identifier
+    /// \param name The identifier
+    /// \return Quoted identifier
+    static std::string QuoteIdentifier(const std::string& name);
+
+    /// \brief Convert a BBFM string literal (with its double quotes) to an SQL string literal
+    /// \param literal The literal as written in source
+    /// \return Single-quoted SQL string literal
+    static std::string StringLiteralToSql(const std::string& literal);
+};
+} // namespace bbfm
+
+// Restore previous alignment
+#pragma pack(pop)
+
+#endif // __BBFM_SQL_SCHEMA_H_INCL__
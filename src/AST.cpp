@@ -1,19 +1,44 @@
 #include "AST.h"
 #include "Common.h"
-#include <iostream>
+#include "Json.h"
+#include <atomic>
 #include <string>
 
+namespace {
+/// \brief Write the source location of a node, if it has one
+void WriteLocation(bbfm::JsonWriter& json, const bbfm::ASTNode& node)
+{
+    if (node.GetLine() > 0)
+    {
+        json.Key("line").Integer(node.GetLine()).Key("column").Integer(node.GetColumn());
+    }
+}
+} // namespace
+
 namespace bbfm {
 // ============================================================================
 // Helper Functions
 // ============================================================================
 
-void ASTNode::PrintIndent(const int indent) const
+void ASTNode::PrintIndent(OutputBuffer& out, const int indent) const
 {
-    for (int i = 0; i < indent; ++i)
-    {
-        std::cout << "  ";
-    }
+    out.AppendRepeated(2 * static_cast<size_t>(indent), ' ');
+}
+
+void ASTNode::SetLocation(const int line, const int column)
+{
+    line_   = line;
+    column_ = column;
+}
+
+int ASTNode::GetLine() const
+{
+    return line_;
+}
+
+int ASTNode::GetColumn() const
+{
+    return column_;
 }
 
 // ============================================================================
@@ -60,10 +85,15 @@ const char* PrimitiveTypeSpec::TypeToString(const PrimitiveType type)
     }
 }
 
-void PrimitiveTypeSpec::Dump(const int indent) const
+void PrimitiveTypeSpec::Dump(OutputBuffer& out, const int indent) const
 {
     UNREFERENCED_PARAMETER(indent);
-    std::cout << TypeToString(type_);
+    out << TypeToString(type_);
+}
+
+void PrimitiveTypeSpec::DumpJson(JsonWriter& json) const
+{
+    json.BeginObject().Key("kind").String("primitive").Key("name").String(TypeToString(type_)).EndObject();
 }
 
 // ============================================================================
@@ -85,10 +115,15 @@ bool UserDefinedTypeSpec::IsUserDefined() const
     return true;
 }
 
-void UserDefinedTypeSpec::Dump(const int indent) const
+void UserDefinedTypeSpec::Dump(OutputBuffer& out, const int indent) const
 {
     UNREFERENCED_PARAMETER(indent);
-    std::cout << typeName_;
+    out << typeName_;
+}
+
+void UserDefinedTypeSpec::DumpJson(JsonWriter& json) const
+{
+    json.BeginObject().Key("kind").String("named").Key("name").String(typeName_).EndObject();
 }
 
 // ============================================================================
@@ -134,29 +169,75 @@ bool CardinalityModifier::IsArray() const
     return -1 == maxCardinality_ || maxCardinality_ > 1;
 }
 
-void CardinalityModifier::Dump(const int indent) const
+void CardinalityModifier::Dump(OutputBuffer& out, const int indent) const
 {
     UNREFERENCED_PARAMETER(indent);
-    std::cout << "[" << minCardinality_;
+    out << "[" << minCardinality_;
     if (maxCardinality_ == -1)
     {
-        std::cout << "..*";
+        out << "..*";
     }
     else if (maxCardinality_ != minCardinality_)
     {
-        std::cout << ".." << maxCardinality_;
+        out << ".." << maxCardinality_;
+    }
+    out << "]";
+}
+
+void CardinalityModifier::DumpJson(JsonWriter& json) const
+{
+    json.BeginObject().Key("kind").String("cardinality").Key("min").Integer(minCardinality_).Key("max");
+    if (-1 == maxCardinality_)
+    {
+        json.Null();
+    }
+    else
+    {
+        json.Integer(maxCardinality_);
     }
-    std::cout << "]";
+    json.EndObject();
 }
 
 // ============================================================================
 // UniqueModifier Implementation
 // ============================================================================
 
-void UniqueModifier::Dump(const int indent) const
+void UniqueModifier::Dump(OutputBuffer& out, const int indent) const
+{
+    UNREFERENCED_PARAMETER(indent);
+    out << "[unique]";
+}
+
+void UniqueModifier::DumpJson(JsonWriter& json) const
+{
+    json.BeginObject().Key("kind").String("unique").EndObject();
+}
+
+void InternedModifier::Dump(OutputBuffer& out, const int indent) const
+{
+    UNREFERENCED_PARAMETER(indent);
+    out << "[interned]";
+}
+
+void InternedModifier::DumpJson(JsonWriter& json) const
+{
+    json.BeginObject().Key("kind").String("interned").EndObject();
+}
+
+const std::string& EncodingModifier::GetEncoding() const
+{
+    return encoding_;
+}
+
+void EncodingModifier::Dump(OutputBuffer& out, const int indent) const
 {
     UNREFERENCED_PARAMETER(indent);
-    std::cout << "[unique]";
+    out << "[encoding(" << encoding_ << ")]";
+}
+
+void EncodingModifier::DumpJson(JsonWriter& json) const
+{
+    json.BeginObject().Key("kind").String("encoding").Key("encoding").String(encoding_).EndObject();
 }
 
 // ============================================================================
@@ -217,30 +298,79 @@ bool Field::HasUniqueConstraint() const
     return false;
 }
 
-void Field::Dump(const int indent) const
+bool Field::IsInterned() const
 {
-    PrintIndent(indent);
+    for (const auto& mod : modifiers_)
+    {
+        if (mod->GetType() == ModifierType::INTERNED)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+const EncodingModifier* Field::GetEncodingModifier() const
+{
+    for (const auto& mod : modifiers_)
+    {
+        if (mod->GetType() == ModifierType::ENCODING)
+        {
+            return static_cast<const EncodingModifier*>(mod.get());
+        }
+    }
+    return nullptr;
+}
+
+void Field::Dump(OutputBuffer& out, const int indent) const
+{
+    PrintIndent(out, indent);
     if (isStatic_)
     {
-        std::cout << "static ";
+        out << "static ";
     }
-    std::cout << "feature " << name_ << ": ";
-    type_->Dump(0);
+    out << "feature " << name_ << ": ";
+    type_->Dump(out, 0);
 
     // Print modifiers
     for (const auto& mod : modifiers_)
     {
-        std::cout << " ";
-        mod->Dump(0);
+        out << " ";
+        mod->Dump(out, 0);
     }
 
     // Print initializer if present
     if (nullptr != initializer_)
     {
-        std::cout << " = " << initializer_->ToString();
+        out << " = ";
+        initializer_->Print(out);
     }
 
-    std::cout << ";\n";
+    out << ";\n";
+}
+
+void Field::DumpJson(JsonWriter& json) const
+{
+    json.BeginObject().Key("name").String(name_);
+    WriteLocation(json, *this);
+    json.Key("type");
+    type_->DumpJson(json);
+    json.Key("modifiers").BeginArray();
+    for (const auto& mod : modifiers_)
+    {
+        mod->DumpJson(json);
+    }
+    json.EndArray();
+    if (isStatic_)
+    {
+        json.Key("static").Bool(true);
+    }
+    if (nullptr != initializer_)
+    {
+        json.Key("initializer");
+        initializer_->DumpJson(json);
+    }
+    json.EndObject();
 }
 
 // ============================================================================
@@ -259,21 +389,51 @@ const Expression* Invariant::GetExpression() const
     return expression_.get();
 }
 
-void Invariant::Dump(const int indent) const
+void Invariant::Dump(OutputBuffer& out, const int indent) const
+{
+    PrintIndent(out, indent);
+    out << "invariant " << name_ << ": ";
+    if (nullptr != expression_)
+    {
+        expression_->Print(out);
+    }
+    out << ";\n";
+}
+
+void Invariant::DumpJson(JsonWriter& json) const
 {
-    PrintIndent(indent);
-    std::cout << "invariant " << name_ << ": ";
+    json.BeginObject().Key("name").String(name_);
+    WriteLocation(json, *this);
     if (nullptr != expression_)
     {
-        std::cout << expression_->ToString();
+        json.Key("expression");
+        expression_->DumpJson(json);
     }
-    std::cout << ";\n";
+    json.EndObject();
 }
 
 // ============================================================================
 // EnumDeclaration Implementation
 // ============================================================================
 
+const std::string& ImportDeclaration::GetPath() const
+{
+    return path_;
+}
+
+void ImportDeclaration::Dump(OutputBuffer& out, const int indent) const
+{
+    PrintIndent(out, indent);
+    out << "import \"" << path_ << "\";\n";
+}
+
+void ImportDeclaration::DumpJson(JsonWriter& json) const
+{
+    json.BeginObject().Key("path").String(path_);
+    WriteLocation(json, *this);
+    json.EndObject();
+}
+
 const std::string& EnumDeclaration::GetName() const
 {
     return name_;
@@ -284,24 +444,36 @@ const std::vector<std::string>& EnumDeclaration::GetValues() const
     return values_;
 }
 
-void EnumDeclaration::Dump(const int indent) const
+void EnumDeclaration::Dump(OutputBuffer& out, const int indent) const
 {
-    PrintIndent(indent);
-    std::cout << "enum " << name_ << " {\n";
+    PrintIndent(out, indent);
+    out << "enum " << name_ << " {\n";
 
     for (size_t i = 0; i < values_.size(); ++i)
     {
-        PrintIndent(indent + 1);
-        std::cout << values_[i];
+        PrintIndent(out, indent + 1);
+        out << values_[i];
         if (i < values_.size() - 1)
         {
-            std::cout << ",";
+            out << ",";
         }
-        std::cout << "\n";
+        out << "\n";
     }
 
-    PrintIndent(indent);
-    std::cout << "}\n";
+    PrintIndent(out, indent);
+    out << "}\n";
+}
+
+void EnumDeclaration::DumpJson(JsonWriter& json) const
+{
+    json.BeginObject().Key("kind").String("enum").Key("name").String(name_);
+    WriteLocation(json, *this);
+    json.Key("values").BeginArray();
+    for (const std::string& value : values_)
+    {
+        json.String(value);
+    }
+    json.EndArray().EndObject();
 }
 
 // ============================================================================
@@ -333,30 +505,54 @@ const std::vector<std::unique_ptr<Invariant>>& ClassDeclaration::GetInvariants()
     return invariants_;
 }
 
-void ClassDeclaration::Dump(const int indent) const
+void ClassDeclaration::Dump(OutputBuffer& out, const int indent) const
 {
-    PrintIndent(indent);
-    std::cout << "class " << name_;
+    PrintIndent(out, indent);
+    out << "class " << name_;
 
     if (false == baseType_.empty())
     {
-        std::cout << " inherits " << baseType_;
+        out << " inherits " << baseType_;
     }
 
-    std::cout << " {\n";
+    out << " {\n";
 
     for (const auto& field : fields_)
     {
-        field->Dump(indent + 1);
+        field->Dump(out, indent + 1);
     }
 
     for (const auto& invariant : invariants_)
     {
-        invariant->Dump(indent + 1);
+        invariant->Dump(out, indent + 1);
     }
 
-    PrintIndent(indent);
-    std::cout << "}\n";
+    PrintIndent(out, indent);
+    out << "}\n";
+}
+
+void ClassDeclaration::DumpJson(JsonWriter& json) const
+{
+    json.BeginObject().Key("kind").String("class").Key("name").String(name_);
+    WriteLocation(json, *this);
+    if (false == baseType_.empty())
+    {
+        json.Key("inherits").String(baseType_);
+    }
+
+    json.Key("fields").BeginArray();
+    for (const auto& field : fields_)
+    {
+        field->DumpJson(json);
+    }
+    json.EndArray();
+
+    json.Key("invariants").BeginArray();
+    for (const auto& invariant : invariants_)
+    {
+        invariant->DumpJson(json);
+    }
+    json.EndArray().EndObject();
 }
 
 // ============================================================================
@@ -378,15 +574,114 @@ const ClassDeclaration* Declaration::AsClass() const
     return Kind::CLASS == kind_ ? static_cast<const ClassDeclaration*>(declaration_.get()) : nullptr;
 }
 
-void Declaration::Dump(const int indent) const
+void Declaration::ShiftLines(const int delta)
+{
+    // Only the declaration, its fields and its invariants record locations
+    declaration_->SetLocation(declaration_->GetLine() + delta, declaration_->GetColumn());
+    if (Kind::CLASS == kind_)
+    {
+        const ClassDeclaration* classDecl = AsClass();
+        for (const auto& field : classDecl->GetFields())
+        {
+            field->SetLocation(field->GetLine() + delta, field->GetColumn());
+        }
+        for (const auto& invariant : classDecl->GetInvariants())
+        {
+            invariant->SetLocation(invariant->GetLine() + delta, invariant->GetColumn());
+        }
+    }
+}
+
+void Declaration::SetSourceHash(const uint64_t hash)
 {
-    declaration_->Dump(indent);
+    sourceHash_ = hash;
+}
+
+uint64_t Declaration::GetSourceHash() const
+{
+    return sourceHash_;
+}
+
+void Declaration::SetSourceFile(const std::string& sourceFile)
+{
+    sourceFile_ = sourceFile;
+}
+
+const std::string& Declaration::GetSourceFile() const
+{
+    return sourceFile_;
+}
+
+void Declaration::SetHadSyntaxError(const bool hadSyntaxError)
+{
+    hadSyntaxError_ = hadSyntaxError;
+}
+
+bool Declaration::HadSyntaxError() const
+{
+    return hadSyntaxError_;
+}
+
+uint64_t Declaration::GetId() const
+{
+    return id_;
+}
+
+uint64_t Declaration::NextId()
+{
+    static std::atomic<uint64_t> nextId{1};
+    return nextId++;
+}
+
+void Declaration::Dump(OutputBuffer& out, const int indent) const
+{
+    declaration_->Dump(out, indent);
+}
+
+void Declaration::DumpJson(JsonWriter& json) const
+{
+    declaration_->DumpJson(json);
 }
 
 // ============================================================================
 // Expression System Implementation
 // ============================================================================
 
+// Expression
+const char* Expression::TypeToString(const Type type)
+{
+    switch (type)
+    {
+        case Type::INT:
+            return "Int";
+        case Type::REAL:
+            return "Real";
+        case Type::BOOL:
+            return "Bool";
+        case Type::STRING:
+            return "String";
+        case Type::TIMESTAMP:
+            return "Timestamp";
+        case Type::TIMESPAN:
+            return "Timespan";
+        case Type::DATE:
+            return "Date";
+        case Type::GUID:
+            return "Guid";
+        case Type::VOID:
+            return "Void";
+        default:
+            return "Unknown";
+    }
+}
+
+std::string Expression::ToString() const
+{
+    OutputBuffer out;
+    Print(out);
+    return out.TakeText();
+}
+
 // BinaryExpression
 BinaryExpression::BinaryExpression(std::unique_ptr<Expression> left, const Op op, std::unique_ptr<Expression> right) :
     left_(std::move(left)), right_(std::move(right)), op_(op)
@@ -417,42 +712,127 @@ Expression::Type BinaryExpression::GetResultType() const
         case Op::DIV:
         case Op::MOD:
         {
-            // Result type is the "wider" of the two operands
-            Type leftType  = left_->GetResultType();
-            Type rightType = right_->GetResultType();
+            return InferArithmeticType(op_, left_->GetResultType(), right_->GetResultType());
+        }
+
+        default:
+            return Type::UNKNOWN;
+    }
+}
+
+Expression::Type BinaryExpression::InferArithmeticType(const Op op, const Type leftType, const Type rightType)
+{
+    const bool leftNumeric  = (Type::INT == leftType || Type::REAL == leftType);
+    const bool rightNumeric = (Type::INT == rightType || Type::REAL == rightType);
+
+    // Plain numbers: Int stays Int, anything with Real widens to Real
+    if (leftNumeric && rightNumeric)
+    {
+        return (Type::INT == leftType && Type::INT == rightType) ? Type::INT : Type::REAL;
+    }
+
+    // String concatenation
+    if (Type::STRING == leftType && Type::STRING == rightType)
+    {
+        return (Op::ADD == op) ? Type::STRING : Type::UNKNOWN;
+    }
+
+    // An Int next to a temporal value in + and - is a microsecond count (t + 1000, d - 1)
+    const bool leftTemporal  = (Type::TIMESTAMP == leftType || Type::TIMESPAN == leftType);
+    const bool rightTemporal = (Type::TIMESTAMP == rightType || Type::TIMESPAN == rightType);
+    const bool addOrSub      = (Op::ADD == op || Op::SUB == op);
+    const Type left          = (addOrSub && Type::INT == leftType && rightTemporal) ? Type::TIMESPAN : leftType;
+    const Type right         = (addOrSub && leftTemporal && Type::INT == rightType) ? Type::TIMESPAN : rightType;
+
+    // Temporal arithmetic on integer microseconds
+    switch (op)
+    {
+        case Op::ADD:
+            if (Type::TIMESTAMP == left && Type::TIMESPAN == right)
+            {
+                return Type::TIMESTAMP;
+            }
+            if (Type::TIMESPAN == left && Type::TIMESTAMP == right)
+            {
+                return Type::TIMESTAMP;
+            }
+            if (Type::TIMESPAN == left && Type::TIMESPAN == right)
+            {
+                return Type::TIMESPAN;
+            }
+            break;
+
+        case Op::SUB:
+            if (Type::TIMESTAMP == left && Type::TIMESTAMP == right)
+            {
+                return Type::TIMESPAN;
+            }
+            if (Type::TIMESTAMP == left && Type::TIMESPAN == right)
+            {
+                return Type::TIMESTAMP;
+            }
+            if (Type::TIMESPAN == left && Type::TIMESPAN == right)
+            {
+                return Type::TIMESPAN;
+            }
+            break;
 
-            // If either is REAL, result is REAL
-            if (Type::REAL == leftType || Type::REAL == rightType || Type::TIMESTAMP == leftType || Type::TIMESTAMP == rightType ||
-                Type::TIMESPAN == leftType || Type::TIMESPAN == rightType)
+        case Op::MUL:
+            if ((Type::TIMESPAN == left && Type::INT == right) || (Type::INT == left && Type::TIMESPAN == right))
             {
-                return Type::REAL;
+                return Type::TIMESPAN;
             }
+            break;
 
-            // Otherwise, if both are INT, result is INT
-            if (Type::INT == leftType && Type::INT == rightType)
+        case Op::DIV:
+            if (Type::TIMESPAN == left && Type::INT == right)
+            {
+                return Type::TIMESPAN;
+            }
+            if (Type::TIMESPAN == left && Type::TIMESPAN == right)
             {
                 return Type::INT;
             }
+            break;
 
-            return Type::UNKNOWN;
-        }
+        case Op::MOD:
+            if (Type::TIMESPAN == left && Type::TIMESPAN == right)
+            {
+                return Type::TIMESPAN;
+            }
+            break;
 
         default:
-            return Type::UNKNOWN;
+            break;
     }
+
+    return Type::UNKNOWN;
+}
+
+void BinaryExpression::Print(OutputBuffer& out) const
+{
+    out << '(';
+    left_->Print(out);
+    out << ' ' << OpToString(op_) << ' ';
+    right_->Print(out);
+    out << ')';
 }
 
-std::string BinaryExpression::ToString() const
+void BinaryExpression::Dump(OutputBuffer& out, const int indent) const
 {
-    return "(" + left_->ToString() + " " + std::string(OpToString(op_)) + " " + right_->ToString() + ")";
+    PrintIndent(out, indent);
+    out << "BinaryExpression [" << OpToString(op_) << "]\n";
+    left_->Dump(out, indent + 1);
+    right_->Dump(out, indent + 1);
 }
 
-void BinaryExpression::Dump(const int indent) const
+void BinaryExpression::DumpJson(JsonWriter& json) const
 {
-    PrintIndent(indent);
-    std::cout << "BinaryExpression [" << OpToString(op_) << "]\n";
-    left_->Dump(indent + 1);
-    right_->Dump(indent + 1);
+    json.BeginObject().Key("kind").String("binary").Key("op").String(OpToString(op_)).Key("left");
+    left_->DumpJson(json);
+    json.Key("right");
+    right_->DumpJson(json);
+    json.EndObject();
 }
 
 const Expression* BinaryExpression::GetLeft() const
@@ -523,16 +903,24 @@ Expression::Type UnaryExpression::GetResultType() const
     }
 }
 
-std::string UnaryExpression::ToString() const
+void UnaryExpression::Print(OutputBuffer& out) const
 {
-    return std::string(OpToString(op_)) + operand_->ToString();
+    out << OpToString(op_);
+    operand_->Print(out);
 }
 
-void UnaryExpression::Dump(const int indent) const
+void UnaryExpression::Dump(OutputBuffer& out, const int indent) const
 {
-    PrintIndent(indent);
-    std::cout << "UnaryExpression [" << OpToString(op_) << "]\n";
-    operand_->Dump(indent + 1);
+    PrintIndent(out, indent);
+    out << "UnaryExpression [" << OpToString(op_) << "]\n";
+    operand_->Dump(out, indent + 1);
+}
+
+void UnaryExpression::DumpJson(JsonWriter& json) const
+{
+    json.BeginObject().Key("kind").String("unary").Key("op").String(OpToString(op_)).Key("operand");
+    operand_->DumpJson(json);
+    json.EndObject();
 }
 
 const Expression* UnaryExpression::GetOperand() const
@@ -567,15 +955,20 @@ Expression::Type FieldReference::GetResultType() const
     return Type::UNKNOWN;
 }
 
-std::string FieldReference::ToString() const
+void FieldReference::Print(OutputBuffer& out) const
 {
-    return fieldName_;
+    out << fieldName_;
 }
 
-void FieldReference::Dump(const int indent) const
+void FieldReference::Dump(OutputBuffer& out, const int indent) const
 {
-    PrintIndent(indent);
-    std::cout << "FieldReference: " << fieldName_ << "\n";
+    PrintIndent(out, indent);
+    out << "FieldReference: " << fieldName_ << "\n";
+}
+
+void FieldReference::DumpJson(JsonWriter& json) const
+{
+    json.BeginObject().Key("kind").String("field").Key("name").String(fieldName_).EndObject();
 }
 
 const std::string& FieldReference::GetFieldName() const
@@ -595,16 +988,24 @@ Expression::Type MemberAccessExpression::GetResultType() const
     return Type::UNKNOWN;
 }
 
-std::string MemberAccessExpression::ToString() const
+void MemberAccessExpression::Print(OutputBuffer& out) const
+{
+    object_->Print(out);
+    out << '.' << memberName_;
+}
+
+void MemberAccessExpression::Dump(OutputBuffer& out, const int indent) const
 {
-    return object_->ToString() + "." + memberName_;
+    PrintIndent(out, indent);
+    out << "MemberAccess: ." << memberName_ << "\n";
+    object_->Dump(out, indent + 2);
 }
 
-void MemberAccessExpression::Dump(const int indent) const
+void MemberAccessExpression::DumpJson(JsonWriter& json) const
 {
-    PrintIndent(indent);
-    std::cout << "MemberAccess: ." << memberName_ << "\n";
-    object_->Dump(indent + 2);
+    json.BeginObject().Key("kind").String("member").Key("object");
+    object_->DumpJson(json);
+    json.Key("member").String(memberName_).EndObject();
 }
 
 const Expression* MemberAccessExpression::GetObject() const
@@ -631,27 +1032,58 @@ Expression::Type LiteralExpression::GetResultType() const
     return type_;
 }
 
-std::string LiteralExpression::ToString() const
+void LiteralExpression::Print(OutputBuffer& out) const
 {
     switch (type_)
     {
         case Type::INT:
-            return std::to_string(intValue_);
+            out << intValue_;
+            break;
         case Type::REAL:
-            return std::to_string(realValue_);
+            out << std::to_string(realValue_);
+            break;
         case Type::STRING:
-            return "\"" + stringValue_ + "\"";
+            out << '"' << stringValue_ << '"';
+            break;
         case Type::BOOL:
-            return boolValue_ ? "true" : "false";
+            out << (boolValue_ ? "true" : "false");
+            break;
         default:
-            return "?";
+            out << '?';
+            break;
     }
 }
 
-void LiteralExpression::Dump(const int indent) const
+void LiteralExpression::Dump(OutputBuffer& out, const int indent) const
 {
-    PrintIndent(indent);
-    std::cout << "Literal: " << ToString() << "\n";
+    PrintIndent(out, indent);
+    out << "Literal: ";
+    Print(out);
+    out << "\n";
+}
+
+void LiteralExpression::DumpJson(JsonWriter& json) const
+{
+    json.BeginObject().Key("kind").String("literal").Key("type").String(TypeToString(type_)).Key("value");
+    switch (type_)
+    {
+        case Type::INT:
+            json.Integer(intValue_);
+            break;
+        case Type::REAL:
+            json.Number(realValue_);
+            break;
+        case Type::STRING:
+            json.String(stringValue_);
+            break;
+        case Type::BOOL:
+            json.Bool(boolValue_);
+            break;
+        default:
+            json.Null();
+            break;
+    }
+    json.EndObject();
 }
 
 int64_t LiteralExpression::GetIntValue() const
@@ -686,31 +1118,40 @@ Expression::Type FunctionCall::GetResultType() const
     return Type::UNKNOWN;
 }
 
-std::string FunctionCall::ToString() const
+void FunctionCall::Print(OutputBuffer& out) const
 {
-    std::string result = functionName_ + "(";
+    out << functionName_ << '(';
     for (size_t i = 0; i < arguments_.size(); ++i)
     {
         if (i > 0)
         {
-            result += ", ";
+            out << ", ";
         }
-        result += arguments_[i]->ToString();
+        arguments_[i]->Print(out);
     }
-    result += ")";
-    return result;
+    out << ')';
 }
 
-void FunctionCall::Dump(const int indent) const
+void FunctionCall::Dump(OutputBuffer& out, const int indent) const
 {
-    PrintIndent(indent);
-    std::cout << "FunctionCall: " << functionName_ << "\n";
+    PrintIndent(out, indent);
+    out << "FunctionCall: " << functionName_ << "\n";
     for (const auto& arg : arguments_)
     {
-        arg->Dump(indent + 1);
+        arg->Dump(out, indent + 1);
     }
 }
 
+void FunctionCall::DumpJson(JsonWriter& json) const
+{
+    json.BeginObject().Key("kind").String("call").Key("function").String(functionName_).Key("arguments").BeginArray();
+    for (const auto& arg : arguments_)
+    {
+        arg->DumpJson(json);
+    }
+    json.EndArray().EndObject();
+}
+
 const std::string& FunctionCall::GetFunctionName() const
 {
     return functionName_;
@@ -729,16 +1170,25 @@ Expression::Type ParenthesizedExpression::GetResultType() const
     return expr_->GetResultType();
 }
 
-std::string ParenthesizedExpression::ToString() const
+void ParenthesizedExpression::Print(OutputBuffer& out) const
+{
+    out << '(';
+    expr_->Print(out);
+    out << ')';
+}
+
+void ParenthesizedExpression::Dump(OutputBuffer& out, const int indent) const
 {
-    return "(" + expr_->ToString() + ")";
+    PrintIndent(out, indent);
+    out << "ParenthesizedExpression\n";
+    expr_->Dump(out, indent + 1);
 }
 
-void ParenthesizedExpression::Dump(const int indent) const
+void ParenthesizedExpression::DumpJson(JsonWriter& json) const
 {
-    PrintIndent(indent);
-    std::cout << "ParenthesizedExpression\n";
-    expr_->Dump(indent + 1);
+    json.BeginObject().Key("kind").String("parenthesized").Key("expression");
+    expr_->DumpJson(json);
+    json.EndObject();
 }
 
 const Expression* ParenthesizedExpression::GetExpression() const
@@ -746,6 +1196,78 @@ const Expression* ParenthesizedExpression::GetExpression() const
     return expr_.get();
 }
 
+// QuantifiedExpression
+QuantifiedExpression::QuantifiedExpression(
+    const Quantifier quantifier, const std::string& variableName, std::unique_ptr<Expression> collection, std::unique_ptr<Expression> body) :
+    quantifier_(quantifier), variableName_(variableName), collection_(std::move(collection)), body_(std::move(body))
+{
+}
+
+Expression::Type QuantifiedExpression::GetResultType() const
+{
+    return Type::BOOL;
+}
+
+void QuantifiedExpression::Print(OutputBuffer& out) const
+{
+    out << '(' << QuantifierToString(quantifier_) << ' ' << variableName_ << " in ";
+    collection_->Print(out);
+    out << ": ";
+    body_->Print(out);
+    out << ')';
+}
+
+void QuantifiedExpression::Dump(OutputBuffer& out, const int indent) const
+{
+    PrintIndent(out, indent);
+    out << "QuantifiedExpression [" << QuantifierToString(quantifier_) << " " << variableName_ << "]\n";
+    collection_->Dump(out, indent + 1);
+    body_->Dump(out, indent + 1);
+}
+
+void QuantifiedExpression::DumpJson(JsonWriter& json) const
+{
+    json.BeginObject().Key("kind").String("quantified").Key("quantifier").String(QuantifierToString(quantifier_));
+    json.Key("variable").String(variableName_).Key("collection");
+    collection_->DumpJson(json);
+    json.Key("body");
+    body_->DumpJson(json);
+    json.EndObject();
+}
+
+QuantifiedExpression::Quantifier QuantifiedExpression::GetQuantifier() const
+{
+    return quantifier_;
+}
+
+const std::string& QuantifiedExpression::GetVariableName() const
+{
+    return variableName_;
+}
+
+const Expression* QuantifiedExpression::GetCollection() const
+{
+    return collection_.get();
+}
+
+const Expression* QuantifiedExpression::GetBody() const
+{
+    return body_.get();
+}
+
+const char* QuantifiedExpression::QuantifierToString(const Quantifier quantifier)
+{
+    switch (quantifier)
+    {
+        case Quantifier::FORALL:
+            return "forall";
+        case Quantifier::EXISTS:
+            return "exists";
+        default:
+            return "?";
+    }
+}
+
 // ============================================================================
 // AST Implementation
 // ============================================================================
@@ -755,18 +1277,98 @@ const std::vector<std::unique_ptr<Declaration>>& AST::GetDeclarations() const
     return declarations_;
 }
 
-void AST::Dump(const int indent) const
+std::vector<std::unique_ptr<Declaration>> AST::TakeDeclarations()
 {
-    PrintIndent(indent);
-    std::cout << "=== BBFM Program AST ===\n\n";
+    std::vector<std::unique_ptr<Declaration>> declarations = std::move(declarations_);
+    declarations_.clear();
+    return declarations;
+}
 
+void AST::SetImports(std::vector<std::unique_ptr<ImportDeclaration>> imports)
+{
+    imports_ = std::move(imports);
+}
+
+const std::vector<std::unique_ptr<ImportDeclaration>>& AST::GetImports() const
+{
+    return imports_;
+}
+
+std::vector<std::unique_ptr<ImportDeclaration>> AST::TakeImports()
+{
+    std::vector<std::unique_ptr<ImportDeclaration>> imports = std::move(imports_);
+    imports_.clear();
+    return imports;
+}
+
+void AST::Dump(OutputBuffer& out, const int indent) const
+{
+    PrintIndent(out, indent);
+    out << "=== BBFM Program AST ===\n\n";
+
+    for (const auto& import : imports_)
+    {
+        import->Dump(out, indent);
+    }
+    if (false == imports_.empty())
+    {
+        out << "\n";
+    }
+
+    for (const auto& decl : declarations_)
+    {
+        decl->Dump(out, indent);
+        out << "\n";
+    }
+
+    PrintIndent(out, indent);
+    out << "=== End of AST ===\n";
+}
+
+void AST::DumpJson(JsonWriter& json) const
+{
+    json.BeginObject().Key("imports").BeginArray();
+    for (const auto& import : imports_)
+    {
+        import->DumpJson(json);
+    }
+    json.EndArray();
+
+    json.Key("declarations").BeginArray();
     for (const auto& decl : declarations_)
     {
-        decl->Dump(indent);
-        std::cout << "\n";
+        decl->DumpJson(json);
+    }
+    json.EndArray().EndObject();
+}
+
+void AST::DumpModules(const std::vector<std::shared_ptr<const AST>>& modules, OutputBuffer& out)
+{
+    // A merged AST has the declarations of every module and no imports
+    out << "=== BBFM Program AST ===\n\n";
+    for (const auto& module : modules)
+    {
+        for (const auto& decl : module->declarations_)
+        {
+            decl->Dump(out, 0);
+            out << "\n";
+        }
     }
+    out << "=== End of AST ===\n";
+}
+
+void AST::DumpModulesJson(const std::vector<std::shared_ptr<const AST>>& modules, JsonWriter& json)
+{
+    json.BeginObject().Key("imports").BeginArray().EndArray();
 
-    PrintIndent(indent);
-    std::cout << "=== End of AST ===\n";
+    json.Key("declarations").BeginArray();
+    for (const auto& module : modules)
+    {
+        for (const auto& decl : module->declarations_)
+        {
+            decl->DumpJson(json);
+        }
+    }
+    json.EndArray().EndObject();
 }
 } // namespace bbfm
@@ -0,0 +1,387 @@
+#include "AllocTracker.h"
+#include "Console.h"
+#include "Json.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace {
+// Table sizes; phases and sites beyond them count as the first entry
+const int    MAX_PHASES     = 64;
+const int    MAX_SITES      = 256;
+const size_t MAX_PHASE_NAME = 64;
+
+/// \brief Counters of a phase or site
+struct AllocCounters
+{
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> frees{0};
+};
+
+/// \brief A snapshot of one row of the report
+struct AllocRow
+{
+    std::string name;
+    uint64_t    allocations;
+    uint64_t    bytes;
+    uint64_t    frees;
+};
+
+std::atomic<bool> g_enabled{false};
+std::mutex        g_mutex; // Guards registration of phases and sites
+AllocCounters     g_phases[MAX_PHASES];
+char              g_phaseNames[MAX_PHASES][MAX_PHASE_NAME] = {"(outside phases)"};
+int               g_phaseCount = 1;
+std::atomic<int>  g_phase{0}; // Phases run one after the other, worker threads count towards the active one
+AllocCounters     g_sites[MAX_SITES];
+const char*       g_siteNames[MAX_SITES] = {"(no site)"};
+int               g_siteCount            = 1;
+thread_local int  t_site                 = 0;
+
+/// \brief Copy counters into report rows
+std::vector<AllocRow> Snapshot(const AllocCounters* counters, const int count, const std::function<const char*(int)>& name)
+{
+    std::vector<AllocRow> rows;
+    for (int i = 0; i < count; ++i)
+    {
+        const uint64_t allocations = counters[i].allocations.load(std::memory_order_relaxed);
+        const uint64_t frees       = counters[i].frees.load(std::memory_order_relaxed);
+        if (0 != allocations || 0 != frees)
+        {
+            rows.push_back({name(i), allocations, counters[i].bytes.load(std::memory_order_relaxed), frees});
+        }
+    }
+    return rows;
+}
+
+std::vector<AllocRow> PhaseRows()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return Snapshot(g_phases, g_phaseCount, [](const int i) { return g_phaseNames[i]; });
+}
+
+/// \brief Sites by number of allocations, most first
+std::vector<AllocRow> SiteRows()
+{
+    std::vector<AllocRow> rows;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        rows = Snapshot(g_sites, g_siteCount, [](const int i) { return g_siteNames[i]; });
+    }
+    std::stable_sort(rows.begin(), rows.end(), [](const AllocRow& a, const AllocRow& b) { return a.allocations > b.allocations; });
+    return rows;
+}
+
+/// \brief Format a row of the allocation report
+std::string FormatRow(const std::string& name, const uint64_t allocations, const uint64_t bytes, const uint64_t frees)
+{
+    char row[192];
+    snprintf(row, sizeof(row), "  %-36s %12llu %10.2f %12llu %9.1f", name.c_str(), static_cast<unsigned long long>(allocations),
+        static_cast<double>(bytes) / (1024.0 * 1024.0), static_cast<unsigned long long>(frees),
+        0 == allocations ? 0.0 : static_cast<double>(bytes) / static_cast<double>(allocations));
+    return row;
+}
+
+std::string FormatHeading(const char* name)
+{
+    char row[192];
+    snprintf(row, sizeof(row), "  %-36s %12s %10s %12s %9s", name, "Allocs", "MB", "Frees", "Avg B");
+    return row;
+}
+
+bbfm::JsonValue RowsToJson(const std::vector<AllocRow>& rows)
+{
+    bbfm::JsonValue items = bbfm::JsonValue::MakeArray();
+    for (const AllocRow& row : rows)
+    {
+        bbfm::JsonValue item = bbfm::JsonValue::MakeObject();
+        item.Set("name", row.name).Set("allocations", static_cast<double>(row.allocations)).Set("bytes", static_cast<double>(row.bytes));
+        item.Set("frees", static_cast<double>(row.frees));
+        items.Append(std::move(item));
+    }
+    return items;
+}
+} // namespace
+
+namespace bbfm {
+bool AllocTracker::IsAvailable()
+{
+#ifdef BBFM_ALLOC_TRACKING
+    return true;
+#else
+    return false;
+#endif
+}
+
+void AllocTracker::Start()
+{
+    for (AllocCounters& counters : g_phases)
+    {
+        counters.allocations = 0;
+        counters.bytes       = 0;
+        counters.frees       = 0;
+    }
+    for (AllocCounters& counters : g_sites)
+    {
+        counters.allocations = 0;
+        counters.bytes       = 0;
+        counters.frees       = 0;
+    }
+    g_phase.store(0);
+    g_enabled.store(true);
+}
+
+void AllocTracker::Stop()
+{
+    g_enabled.store(false);
+}
+
+bool AllocTracker::IsEnabled()
+{
+    return g_enabled.load(std::memory_order_relaxed);
+}
+
+int AllocTracker::EnterPhase(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    int                         phase = 0;
+    while (phase < g_phaseCount && 0 != strncmp(g_phaseNames[phase], name.c_str(), MAX_PHASE_NAME - 1))
+    {
+        ++phase;
+    }
+    if (phase == g_phaseCount && g_phaseCount < MAX_PHASES)
+    {
+        snprintf(g_phaseNames[phase], MAX_PHASE_NAME, "%s", name.c_str());
+        ++g_phaseCount;
+    }
+    return g_phase.exchange(phase < MAX_PHASES ? phase : 0);
+}
+
+void AllocTracker::LeavePhase(const int previous)
+{
+    g_phase.store(previous);
+}
+
+int AllocTracker::RegisterSite(const char* name)
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    for (int site = 1; site < g_siteCount; ++site)
+    {
+        if (0 == strcmp(g_siteNames[site], name))
+        {
+            return site;
+        }
+    }
+    if (g_siteCount == MAX_SITES)
+    {
+        return 0;
+    }
+    g_siteNames[g_siteCount] = name;
+    return g_siteCount++;
+}
+
+int AllocTracker::SetCurrentSite(const int site)
+{
+    const int previous = t_site;
+    t_site             = site;
+    return previous;
+}
+
+void AllocTracker::RecordAllocation(const size_t bytes)
+{
+    if (!g_enabled.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    AllocCounters& phase = g_phases[g_phase.load(std::memory_order_relaxed)];
+    phase.allocations.fetch_add(1, std::memory_order_relaxed);
+    phase.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    AllocCounters& site = g_sites[t_site];
+    site.allocations.fetch_add(1, std::memory_order_relaxed);
+    site.bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void AllocTracker::RecordFree()
+{
+    if (!g_enabled.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    g_phases[g_phase.load(std::memory_order_relaxed)].frees.fetch_add(1, std::memory_order_relaxed);
+    g_sites[t_site].frees.fetch_add(1, std::memory_order_relaxed);
+}
+
+void AllocTracker::WriteReport(std::ostream& out, const size_t maxSites)
+{
+    out << "\nAllocation report:\n";
+    out << FormatHeading("Phase") << "\n";
+    uint64_t allocations = 0;
+    uint64_t bytes       = 0;
+    uint64_t frees       = 0;
+    for (const AllocRow& row : PhaseRows())
+    {
+        out << FormatRow(row.name, row.allocations, row.bytes, row.frees) << "\n";
+        allocations += row.allocations;
+        bytes += row.bytes;
+        frees += row.frees;
+    }
+    out << FormatRow("Total", allocations, bytes, frees) << "\n";
+
+    // Innermost BBFM_ALLOC_SITE of the allocating thread, by number of allocations
+    const std::vector<AllocRow> sites = SiteRows();
+    char                        summary[96];
+    snprintf(summary, sizeof(summary), "\nHottest allocation sites (%zu of %zu):\n", std::min(maxSites, sites.size()), sites.size());
+    out << summary;
+    out << FormatHeading("Site") << "\n";
+    for (size_t i = 0; i < sites.size() && i < maxSites; ++i)
+    {
+        out << FormatRow(sites[i].name, sites[i].allocations, sites[i].bytes, sites[i].frees) << "\n";
+    }
+}
+
+bool AllocTracker::WriteJson(const std::string& path)
+{
+    JsonValue report = JsonValue::MakeObject();
+    report.Set("phases", RowsToJson(PhaseRows())).Set("sites", RowsToJson(SiteRows()));
+
+    std::ofstream out(path, std::ios::binary);
+    return out.is_open() && (out << report.Serialize() << "\n") && out.flush();
+}
+
+AllocSession::AllocSession(const bool printReport, const std::string& jsonPath) : printReport_(printReport), jsonPath_(jsonPath)
+{
+    if (printReport_ || false == jsonPath_.empty())
+    {
+        AllocTracker::Start();
+    }
+}
+
+AllocSession::~AllocSession()
+{
+    if (!printReport_ && jsonPath_.empty())
+    {
+        return;
+    }
+    AllocTracker::Stop();
+    if (printReport_)
+    {
+        AllocTracker::WriteReport(std::cout);
+    }
+    if (false == jsonPath_.empty() && !AllocTracker::WriteJson(jsonPath_))
+    {
+        Console::ReportError("Error: Could not write allocation report to '" + jsonPath_ + "'");
+    }
+}
+} // namespace bbfm
+
+#ifdef BBFM_ALLOC_TRACKING
+// glibc's allocator under its internal names, called by the interposed functions below
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void  __libc_free(void* pointer);
+void* __libc_memalign(size_t alignment, size_t size);
+
+void* malloc(size_t size) noexcept
+{
+    bbfm::AllocTracker::RecordAllocation(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) noexcept
+{
+    bbfm::AllocTracker::RecordAllocation(count * size);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size) noexcept
+{
+    if (nullptr != pointer)
+    {
+        bbfm::AllocTracker::RecordFree();
+    }
+    bbfm::AllocTracker::RecordAllocation(size);
+    return __libc_realloc(pointer, size);
+}
+
+void free(void* pointer) noexcept
+{
+    if (nullptr != pointer)
+    {
+        bbfm::AllocTracker::RecordFree();
+    }
+    __libc_free(pointer);
+}
+
+void* memalign(size_t alignment, size_t size) noexcept
+{
+    bbfm::AllocTracker::RecordAllocation(size);
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) noexcept
+{
+    bbfm::AllocTracker::RecordAllocation(size);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** pointer, size_t alignment, size_t size) noexcept
+{
+    if (0 == alignment || 0 != (alignment & (alignment - 1)) || 0 != alignment % sizeof(void*))
+    {
+        return EINVAL;
+    }
+    bbfm::AllocTracker::RecordAllocation(size);
+    *pointer = __libc_memalign(alignment, size);
+    return nullptr == *pointer ? ENOMEM : 0;
+}
+}
+
+// The remaining forms of operator new/delete in libstdc++ end in these or in malloc
+void* operator new(size_t size)
+{
+    void* pointer = malloc(0 == size ? 1 : size);
+    if (nullptr == pointer)
+    {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+    free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept
+{
+    free(pointer);
+}
+#endif
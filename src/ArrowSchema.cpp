@@ -0,0 +1,169 @@
+#include "ArrowSchema.h"
+#include <utility>
+#include <vector>
+
+namespace bbfm {
+ArrowSchemaWriter::ArrowSchemaWriter(const SemanticAnalyzer* analyzer, const LayoutBuilder* layouts) : analyzer_(analyzer), layouts_(layouts) {}
+
+void ArrowSchemaWriter::Write(std::ostream& out) const
+{
+    int          dictionaryId = 0;
+    OutputBuffer buffer(out);
+    JsonWriter   json(buffer, 2);
+
+    json.BeginObject().Key("schemas").BeginArray();
+    for (const auto& entry : layouts_->GetLayouts())
+    {
+        WriteClassSchema(json, entry.second, dictionaryId);
+    }
+    json.EndArray().EndObject();
+    buffer << '\n';
+}
+
+void ArrowSchemaWriter::WriteClassSchema(JsonWriter& json, const ClassLayout& layout, int& dictionaryId) const
+{
+    json.BeginObject().Key("name").String(layout.className);
+
+    json.Key("fields").BeginArray();
+    for (const auto& column : layout.columns)
+    {
+        WriteField(json, column, dictionaryId);
+    }
+    json.EndArray();
+
+    json.Key("metadata").BeginArray();
+    WriteMetadata(json, "bbfm:class", layout.className);
+    WriteMetadata(json, "bbfm:fingerprint", SchemaFingerprinter::ToString(layout.fingerprint));
+    json.EndArray().EndObject();
+}
+
+void ArrowSchemaWriter::WriteField(JsonWriter& json, const ColumnLayout& column, int& dictionaryId) const
+{
+    const bool isEnum = (StorageKind::ENUM == column.storage);
+    const bool isUuid = (StorageKind::GUID128 == column.storage || StorageKind::OBJECT_REF == column.storage);
+
+    // Enums always map to dictionaries of their value names
+    const bool isDictionary = isEnum || ColumnEncoding::DICTIONARY == column.encoding;
+
+    const EnumDeclaration* enumDecl = nullptr;
+    if (isEnum)
+    {
+        const auto& symbolTable = analyzer_->GetSymbolTable();
+        auto        symbol      = symbolTable.find(column.typeName);
+        enumDecl                = (symbolTable.end() != symbol) ? symbol->second.enumDecl : nullptr;
+    }
+
+    // Lists carry 32-bit offsets into the child column
+    if (column.list)
+    {
+        json.BeginObject().Key("name").String(column.name).Key("nullable").Bool(false);
+        json.Key("type").BeginObject().Key("name").String("list").EndObject();
+        json.Key("children").BeginArray();
+    }
+
+    // Value field (the list child for arrays)
+    json.BeginObject().Key("name").String(column.list ? "item" : column.name).Key("nullable").Bool(column.nullable && !column.list);
+    json.Key("type");
+    WriteValueType(json, column);
+    json.Key("children").BeginArray().EndArray();
+
+    if (isDictionary)
+    {
+        // Dictionary indices only need to cover the distinct values
+        int indexBits = 32;
+        if (nullptr != enumDecl)
+        {
+            const size_t valueCount = enumDecl->GetValues().size();
+            indexBits               = (valueCount <= 0x80) ? 8 : (valueCount <= 0x8000) ? 16 : 32;
+        }
+        json.Key("dictionary").BeginObject().Key("id").Integer(dictionaryId++);
+        json.Key("indexType").BeginObject().Key("name").String("int").Key("bitWidth").Integer(indexBits).Key("isSigned").Bool(true).EndObject();
+        json.Key("isOrdered").Bool(isEnum).EndObject();
+    }
+
+    // Custom metadata: Guid extension type, referenced class, enum values, encoding
+    std::vector<std::pair<std::string, std::string>> metadata;
+    if (isUuid)
+    {
+        metadata.push_back({"ARROW:extension:name", "arrow.uuid"});
+        metadata.push_back({"ARROW:extension:metadata", ""});
+    }
+    if (StorageKind::OBJECT_REF == column.storage)
+    {
+        metadata.push_back({"bbfm:reference", column.typeName});
+    }
+    if (nullptr != enumDecl)
+    {
+        std::string values;
+        for (const auto& enumValue : enumDecl->GetValues())
+        {
+            values += (values.empty() ? "" : ",") + enumValue;
+        }
+        metadata.push_back({"bbfm:enum", column.typeName});
+        metadata.push_back({"bbfm:enumValues", values});
+    }
+    if (ColumnEncoding::PLAIN != column.encoding && ColumnEncoding::DICTIONARY != column.encoding)
+    {
+        metadata.push_back({"bbfm:encoding", ColumnLayout::EncodingToString(column.encoding)});
+    }
+
+    if (false == metadata.empty())
+    {
+        json.Key("metadata").BeginArray();
+        for (const auto& entry : metadata)
+        {
+            WriteMetadata(json, entry.first, entry.second);
+        }
+        json.EndArray();
+    }
+    json.EndObject();
+
+    if (column.list)
+    {
+        json.EndArray().EndObject();
+    }
+}
+
+void ArrowSchemaWriter::WriteValueType(JsonWriter& json, const ColumnLayout& column)
+{
+    json.BeginObject();
+    switch (column.storage)
+    {
+        case StorageKind::BOOL:
+            json.Key("name").String("bool");
+            break;
+        case StorageKind::INT64:
+            json.Key("name").String("int").Key("bitWidth").Integer(64).Key("isSigned").Bool(true);
+            break;
+        case StorageKind::FLOAT64:
+            json.Key("name").String("floatingpoint").Key("precision").String("DOUBLE");
+            break;
+        case StorageKind::TIMESTAMP64:
+            json.Key("name").String("timestamp").Key("unit").String("MICROSECOND").Key("timezone").String("UTC");
+            break;
+        case StorageKind::TIMESPAN64:
+            json.Key("name").String("duration").Key("unit").String("MICROSECOND");
+            break;
+        case StorageKind::DATE32:
+            json.Key("name").String("date").Key("unit").String("DAY");
+            break;
+        case StorageKind::GUID128:
+        case StorageKind::OBJECT_REF:
+            json.Key("name").String("fixedsizebinary").Key("byteWidth").Integer(16);
+            break;
+        case StorageKind::STRING_REF:
+        case StorageKind::INTERNED_STRING:
+        case StorageKind::ENUM:
+        default:
+            // Enum dictionaries hold the value names
+            json.Key("name").String("utf8");
+            break;
+    }
+    json.EndObject();
+}
+
+void ArrowSchemaWriter::WriteMetadata(JsonWriter& json, const std::string& key, const std::string& value)
+{
+    json.BeginObject().Key("key").String(key).Key("value").String(value).EndObject();
+}
+} // namespace bbfm
@@ -0,0 +1,326 @@
+#include "CompileCache.h"
+#include "Common.h"
+#include "Fingerprint.h"
+#include "ModelCache.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+#include <mach-o/dyld.h>
+#endif
+
+namespace {
+// First line of every entry file, changed when the format changes
+const char* const ENTRY_MAGIC = "BBFM-CACHE 1\n";
+
+// Temporary files older than this are left over by crashed writers
+const time_t STALE_TEMPORARY_SECONDS = 3600;
+
+/// \brief Find the path of the running compiler's binary
+/// \return False if the platform has no way to find it
+bool ExecutablePath(std::string& path)
+{
+#if defined(__linux__)
+    path = "/proc/self/exe";
+    return true;
+#elif defined(__APPLE__)
+    uint32_t size = 0;
+    _NSGetExecutablePath(nullptr, &size);
+    std::vector<char> buffer(size + 1, '\0');
+    if (0 != _NSGetExecutablePath(buffer.data(), &size))
+    {
+        return false;
+    }
+    path = buffer.data();
+    return true;
+#else
+    return false;
+#endif
+}
+
+/// \brief Append a length-prefixed field
+void AppendField(std::string& data, const std::string& field)
+{
+    data += std::to_string(field.size()) + "\n" + field;
+}
+
+/// \brief Read a length-prefixed field
+/// \return False if the data is truncated or malformed
+bool ReadField(const std::string& data, size_t& pos, std::string& field)
+{
+    const size_t newline = data.find('\n', pos);
+    if (std::string::npos == newline || newline == pos)
+    {
+        return false;
+    }
+    char*                    end    = nullptr;
+    const unsigned long long length = strtoull(data.c_str() + pos, &end, 10);
+    if (end != data.c_str() + newline || length > data.size() - newline - 1)
+    {
+        return false;
+    }
+    field = data.substr(newline + 1, static_cast<size_t>(length));
+    pos   = newline + 1 + static_cast<size_t>(length);
+    return true;
+}
+
+/// \brief Read a field holding a decimal number
+bool ReadNumber(const std::string& data, size_t& pos, long& number)
+{
+    std::string field;
+    if (!ReadField(data, pos, field) || field.empty())
+    {
+        return false;
+    }
+    char* end = nullptr;
+    number    = strtol(field.c_str(), &end, 10);
+    return end == field.c_str() + field.size();
+}
+
+/// \brief Create a directory and its missing parents
+bool MakeDirectories(const std::string& path)
+{
+    for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1))
+    {
+        const std::string prefix = path.substr(0, slash);
+        if (0 != mkdir(prefix.c_str(), 0777) && EEXIST != errno)
+        {
+            return false;
+        }
+        if (std::string::npos == slash)
+        {
+            return true;
+        }
+    }
+}
+} // namespace
+
+namespace bbfm {
+CompileCache::CompileCache(const std::string& directory, const uint64_t maxBytes) : directory_(directory), maxBytes_(maxBytes)
+{
+    MakeDirectories(directory_);
+}
+
+bool CompileCache::MakeKey(const std::vector<std::string>& args, const std::vector<std::string>& inputFiles, std::string& key)
+{
+    // Without an identity a rebuilt compiler could hit entries of another build, so nothing is cached
+    if (CompilerIdentity().empty())
+    {
+        return false;
+    }
+
+    key = "compiler=" + CompilerIdentity() + "\n";
+    for (const std::string& arg : args)
+    {
+        key += "arg=" + arg + "\n";
+    }
+    for (const std::string& inputFile : inputFiles)
+    {
+        uint64_t contentHash = 0;
+        if (!ModelCache::HashFile(inputFile, contentHash))
+        {
+            return false;
+        }
+        key += "input=" + inputFile + ":" + SchemaFingerprinter::ToString(contentHash) + "\n";
+    }
+    return true;
+}
+
+bool CompileCache::Lookup(const std::string& key, CachedCompile& entry) const
+{
+    const std::string path = EntryPath(key);
+    std::ifstream     infile(path, std::ios::binary);
+    if (!infile.is_open())
+    {
+        return false;
+    }
+    std::ostringstream content;
+    content << infile.rdbuf();
+    const std::string data = content.str();
+
+    // A different key with the same hash is a miss
+    size_t      pos = 0;
+    std::string storedKey;
+    if (0 != data.compare(0, strlen(ENTRY_MAGIC), ENTRY_MAGIC))
+    {
+        return false;
+    }
+    pos = strlen(ENTRY_MAGIC);
+    if (!ReadField(data, pos, storedKey) || storedKey != key)
+    {
+        return false;
+    }
+
+    long exitCode  = 0;
+    long fileCount = 0;
+    if (!ReadNumber(data, pos, exitCode) || !ReadField(data, pos, entry.out) || !ReadField(data, pos, entry.err) || !ReadNumber(data, pos, fileCount) ||
+        fileCount < 0)
+    {
+        return false;
+    }
+    entry.exitCode = static_cast<int>(exitCode);
+    entry.files.clear();
+    for (long i = 0; i < fileCount; ++i)
+    {
+        std::pair<std::string, std::string> file;
+        if (!ReadField(data, pos, file.first) || !ReadField(data, pos, file.second))
+        {
+            return false;
+        }
+        entry.files.push_back(std::move(file));
+    }
+    if (pos != data.size())
+    {
+        return false;
+    }
+
+    // Mark the entry as recently used
+    utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+    return true;
+}
+
+bool CompileCache::Store(const std::string& key, const CachedCompile& entry) const
+{
+    std::string data = ENTRY_MAGIC;
+    AppendField(data, key);
+    AppendField(data, std::to_string(entry.exitCode));
+    AppendField(data, entry.out);
+    AppendField(data, entry.err);
+    AppendField(data, std::to_string(entry.files.size()));
+    for (const auto& file : entry.files)
+    {
+        AppendField(data, file.first);
+        AppendField(data, file.second);
+    }
+
+    // Write a private temporary file, then publish it with an atomic rename
+    std::string temporary = directory_ + "/.tmp.XXXXXX";
+    const int   fd        = mkstemp(&temporary[0]);
+    if (fd < 0)
+    {
+        return false;
+    }
+    size_t written = 0;
+    while (written < data.size())
+    {
+        const ssize_t result = write(fd, data.data() + written, data.size() - written);
+        if (result < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        if (result <= 0)
+        {
+            break;
+        }
+        written += static_cast<size_t>(result);
+    }
+    fchmod(fd, 0644);
+    const bool complete = (written == data.size()) && 0 == close(fd);
+    if (!complete || 0 != rename(temporary.c_str(), EntryPath(key).c_str()))
+    {
+        unlink(temporary.c_str());
+        return false;
+    }
+
+    Evict();
+    return true;
+}
+
+std::string CompileCache::EntryPath(const std::string& key) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.entry", static_cast<unsigned long long>(SchemaFingerprinter::Hash(key)));
+    return directory_ + "/" + name;
+}
+
+void CompileCache::Evict() const
+{
+    struct EntryFile
+    {
+        std::string path;
+        time_t      lastUsed;
+        uint64_t    size;
+    };
+
+    DIR* dir = opendir(directory_.c_str());
+    if (nullptr == dir)
+    {
+        return;
+    }
+    std::vector<EntryFile> entries;
+    uint64_t               totalSize = 0;
+    const time_t           now       = time(nullptr);
+    for (const dirent* item = readdir(dir); nullptr != item; item = readdir(dir))
+    {
+        const std::string name = item->d_name;
+        const std::string path = directory_ + "/" + name;
+        struct stat       info;
+        if (0 != stat(path.c_str(), &info) || !S_ISREG(info.st_mode))
+        {
+            continue;
+        }
+        if (0 == name.rfind(".tmp.", 0))
+        {
+            if (now - info.st_mtime > STALE_TEMPORARY_SECONDS)
+            {
+                unlink(path.c_str());
+            }
+            continue;
+        }
+        if (name.size() > 6 && 0 == name.compare(name.size() - 6, 6, ".entry"))
+        {
+            entries.push_back(EntryFile{path, info.st_mtime, static_cast<uint64_t>(info.st_size)});
+            totalSize += static_cast<uint64_t>(info.st_size);
+        }
+    }
+    closedir(dir);
+
+    // Least recently used first; another process may already have removed an entry
+    std::sort(entries.begin(), entries.end(), [](const EntryFile& a, const EntryFile& b) { return a.lastUsed < b.lastUsed; });
+    for (const EntryFile& entry : entries)
+    {
+        if (totalSize <= maxBytes_)
+        {
+            break;
+        }
+        unlink(entry.path.c_str());
+        totalSize -= entry.size;
+    }
+}
+
+const std::string& CompileCache::CompilerIdentity()
+{
+    // A rebuilt compiler must not reuse entries of another build with the same version. Relinking
+    // replaces or rewrites the binary, which changes its inode, size or modification time, so the
+    // stat identity tells builds apart without reading the whole binary on every run.
+    static const std::string identity = []()
+    {
+        std::string path;
+        struct stat info;
+        if (!ExecutablePath(path) || 0 != stat(path.c_str(), &info))
+        {
+            return std::string();
+        }
+#ifdef __APPLE__
+        const long modifiedNanoseconds = info.st_mtimespec.tv_nsec;
+#else
+        const long modifiedNanoseconds = info.st_mtim.tv_nsec;
+#endif
+        std::ostringstream stream;
+        stream << BBFM_COMPILER_VERSION << " " << info.st_dev << ":" << info.st_ino << ":" << info.st_size << ":"
+               << info.st_mtime << "." << modifiedNanoseconds;
+        return stream.str();
+    }();
+    return identity;
+}
+} // namespace bbfm
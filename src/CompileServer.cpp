@@ -0,0 +1,320 @@
+#include "CompileServer.h"
+#include "Console.h"
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <iostream>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+// Set by SIGINT/SIGTERM to stop the accept loop
+volatile sig_atomic_t g_stopRequested = 0;
+
+void OnStopSignal(int)
+{
+    g_stopRequested = 1;
+}
+
+/// \brief Fill a Unix socket address
+/// \return False if the path does not fit
+bool MakeAddress(const std::string& socketPath, sockaddr_un& address)
+{
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path))
+    {
+        return false;
+    }
+    memcpy(address.sun_path, socketPath.c_str(), socketPath.size());
+    return true;
+}
+} // namespace
+
+namespace bbfm {
+CompileServer::CompileServer(const std::string& socketPath, RequestHandler handler) : socketPath_(socketPath), handler_(std::move(handler)) {}
+
+int CompileServer::Run()
+{
+    // The server changes directory per request, so keep an absolute socket path
+    if (false == socketPath_.empty() && '/' != socketPath_[0])
+    {
+        char cwd[4096];
+        if (nullptr != getcwd(cwd, sizeof(cwd)))
+        {
+            socketPath_ = std::string(cwd) + "/" + socketPath_;
+        }
+    }
+
+    sockaddr_un address;
+    if (!MakeAddress(socketPath_, address))
+    {
+        Console::ReportError("Error: Socket path '" + socketPath_ + "' is too long");
+        return 1;
+    }
+
+    // Refuse to take over the socket of a running server, remove a stale one
+    const int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe >= 0 && 0 == connect(probe, reinterpret_cast<const sockaddr*>(&address), sizeof(address)))
+    {
+        close(probe);
+        Console::ReportError("Error: A compile server is already listening on '" + socketPath_ + "'");
+        return 1;
+    }
+    if (probe >= 0)
+    {
+        close(probe);
+    }
+    unlink(socketPath_.c_str());
+
+    const int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0 || 0 != bind(listenFd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) || 0 != listen(listenFd, 16))
+    {
+        Console::ReportError("Error: Could not listen on '" + socketPath_ + "': " + strerror(errno));
+        if (listenFd >= 0)
+        {
+            close(listenFd);
+        }
+        return 1;
+    }
+
+    // No SA_RESTART, so a signal interrupts accept()
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = OnStopSignal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    Console::ReportStatus("Compile server listening on " + socketPath_);
+
+    while (0 == g_stopRequested)
+    {
+        const int clientFd = accept(listenFd, nullptr, nullptr);
+        if (clientFd < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            Console::ReportError("Error: accept failed: " + std::string(strerror(errno)));
+            break;
+        }
+
+        // A client that stops reading its reply must not block the server either
+        timeval sendTimeout;
+        sendTimeout.tv_sec  = CLIENT_TIMEOUT_MS / 1000;
+        sendTimeout.tv_usec = 0;
+        setsockopt(clientFd, SOL_SOCKET, SO_SNDTIMEO, &sendTimeout, sizeof(sendTimeout));
+
+        HandleConnection(clientFd);
+        close(clientFd);
+    }
+
+    close(listenFd);
+    unlink(socketPath_.c_str());
+    Console::ReportStatus("Compile server stopped (" + std::to_string(cache_.GetSize()) + " cached model(s), " + std::to_string(imports_.GetSize()) +
+                          " cached file(s))");
+    return 0;
+}
+
+void CompileServer::HandleConnection(const int fd)
+{
+    std::string request;
+    if (!ReadAll(fd, request, CLIENT_TIMEOUT_MS))
+    {
+        if (ETIMEDOUT == errno)
+        {
+            Console::ReportStatus("Compile server dropped a connection that sent no complete request within " +
+                                  std::to_string(CLIENT_TIMEOUT_MS / 1000) + " seconds");
+        }
+        return;
+    }
+
+    // Fields: working directory, argument count, arguments
+    std::vector<std::string> fields;
+    size_t                   start = 0;
+    for (size_t end = request.find('\0'); std::string::npos != end; end = request.find('\0', start))
+    {
+        fields.push_back(request.substr(start, end - start));
+        start = end + 1;
+    }
+
+    size_t argCount = 0;
+    if (fields.size() >= 2)
+    {
+        argCount = strtoul(fields[1].c_str(), nullptr, 10);
+    }
+    if (fields.size() < 2 || fields.size() != argCount + 2 || 0 == argCount)
+    {
+        const std::string message = "Error: Malformed compile server request\n";
+        WriteAll(fd, "1 0 " + std::to_string(message.size()) + "\n" + message);
+        return;
+    }
+    const std::vector<std::string> args(fields.begin() + 2, fields.end());
+
+    // Run the command line in the client's directory with captured output
+    char               serverCwd[4096];
+    const bool         hasServerCwd = (nullptr != getcwd(serverCwd, sizeof(serverCwd)));
+    std::ostringstream out;
+    std::ostringstream err;
+    std::streambuf*    savedOut = std::cout.rdbuf(out.rdbuf());
+    std::streambuf*    savedErr = std::cerr.rdbuf(err.rdbuf());
+
+    int exitCode = 1;
+    if (0 != chdir(fields[0].c_str()))
+    {
+        std::cerr << "Error: Could not change to directory '" << fields[0] << "'" << std::endl;
+    }
+    else
+    {
+        try
+        {
+            exitCode = handler_(args, cache_, imports_);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Error: " << e.what() << std::endl;
+        }
+    }
+
+    std::cout.rdbuf(savedOut);
+    std::cerr.rdbuf(savedErr);
+    if (hasServerCwd && 0 != chdir(serverCwd))
+    {
+        Console::ReportError("Error: Could not return to directory '" + std::string(serverCwd) + "'");
+    }
+
+    const std::string outText = out.str();
+    const std::string errText = err.str();
+    WriteAll(fd, std::to_string(exitCode) + " " + std::to_string(outText.size()) + " " + std::to_string(errText.size()) + "\n" + outText + errText);
+}
+
+bool CompileServer::Forward(const std::string& socketPath, const std::vector<std::string>& args, int& exitCode)
+{
+    sockaddr_un address;
+    const int   fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || !MakeAddress(socketPath, address) || 0 != connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)))
+    {
+        Console::ReportError("Could not connect to compile server at '" + socketPath + "', compiling locally");
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return false;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    char cwd[4096];
+    if (nullptr == getcwd(cwd, sizeof(cwd)))
+    {
+        Console::ReportError("Error: Could not determine the working directory");
+        close(fd);
+        exitCode = 1;
+        return true;
+    }
+
+    std::string request = std::string(cwd) + '\0' + std::to_string(args.size()) + '\0';
+    for (const auto& arg : args)
+    {
+        request += arg + '\0';
+    }
+
+    // The server compiles one request at a time, so a busy or hung server could keep the client waiting forever
+    std::string reply;
+    const bool  exchanged = WriteAll(fd, request) && 0 == shutdown(fd, SHUT_WR) && ReadAll(fd, reply, SERVER_TIMEOUT_MS);
+    const bool  timedOut  = !exchanged && ETIMEDOUT == errno;
+    close(fd);
+    if (timedOut)
+    {
+        Console::ReportError("Compile server at '" + socketPath + "' did not reply within " + std::to_string(SERVER_TIMEOUT_MS / 1000) + " s, compiling locally");
+        return false;
+    }
+
+    // Reply header: exit code, stdout size, stderr size
+    exitCode        = 1;
+    size_t outSize  = 0;
+    size_t errSize  = 0;
+    size_t header   = reply.find('\n');
+    if (!exchanged || std::string::npos == header || 3 != sscanf(reply.c_str(), "%d %zu %zu", &exitCode, &outSize, &errSize) ||
+        header + 1 + outSize + errSize != reply.size())
+    {
+        Console::ReportError("Invalid reply from compile server at '" + socketPath + "', compiling locally");
+        return false;
+    }
+
+    std::cout << reply.substr(header + 1, outSize) << std::flush;
+    std::cerr << reply.substr(header + 1 + outSize, errSize) << std::flush;
+    return true;
+}
+
+bool CompileServer::ReadAll(const int fd, std::string& data, const int timeoutMs)
+{
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+
+    char buffer[65536];
+    for (;;)
+    {
+        // The deadline covers the whole read, so a client trickling bytes is dropped as well
+        if (timeoutMs >= 0)
+        {
+            const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+            pollfd     pending   = {fd, POLLIN, 0};
+            const int  ready     = (remaining > 0) ? poll(&pending, 1, static_cast<int>(remaining)) : 0;
+            if (0 == ready)
+            {
+                errno = ETIMEDOUT;
+                return false;
+            }
+            if (ready < 0)
+            {
+                if (EINTR == errno && 0 == g_stopRequested)
+                {
+                    continue;
+                }
+                return false;
+            }
+        }
+
+        const ssize_t count = read(fd, buffer, sizeof(buffer));
+        if (count > 0)
+        {
+            data.append(buffer, static_cast<size_t>(count));
+        }
+        else if (0 == count)
+        {
+            return true;
+        }
+        else if (EINTR != errno)
+        {
+            return false;
+        }
+    }
+}
+
+bool CompileServer::WriteAll(const int fd, const std::string& data)
+{
+    size_t written = 0;
+    while (written < data.size())
+    {
+        const ssize_t count = write(fd, data.data() + written, data.size() - written);
+        if (count > 0)
+        {
+            written += static_cast<size_t>(count);
+        }
+        else if (count < 0 && EINTR != errno)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace bbfm
@@ -1,14 +1,14 @@
 #include "Console.h"
-#include <iostream>
+#include "Diagnostics.h"
 
 namespace bbfm {
 void Console::ReportError(const std::string& message)
 {
-    std::cerr << message << std::endl;
+    Diagnostics::Report(Diagnostic::Severity::ERROR, message);
 }
 
 void Console::ReportStatus(const std::string& message)
 {
-    std::cout << message << std::endl;
+    Diagnostics::ReportStatus(message);
 }
 } // namespace bbfm
@@ -0,0 +1,316 @@
+#include "Diagnostics.h"
+#include "Common.h"
+#include "Json.h"
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <set>
+
+namespace {
+/// \brief Diagnostics of one thread, registered while the thread lives
+struct ThreadBuffer
+{
+    std::mutex                    mutex; // Only contended while a session flushes
+    std::vector<bbfm::Diagnostic> items;
+
+    ThreadBuffer();
+    ~ThreadBuffer();
+};
+
+std::mutex                    g_registryMutex; // Guards g_buffers and g_orphans
+std::vector<ThreadBuffer*>    g_buffers;
+std::vector<bbfm::Diagnostic> g_orphans; // Buffered by threads that have ended
+std::mutex                    g_outputMutex; // Orders direct writes to the streams
+std::atomic<int>              g_sessions{0};
+std::atomic<uint64_t>         g_sequence{0};
+
+ThreadBuffer::ThreadBuffer()
+{
+    std::lock_guard<std::mutex> lock(g_registryMutex);
+    g_buffers.push_back(this);
+}
+
+ThreadBuffer::~ThreadBuffer()
+{
+    std::lock_guard<std::mutex> lock(g_registryMutex);
+    g_orphans.insert(g_orphans.end(), std::make_move_iterator(items.begin()), std::make_move_iterator(items.end()));
+    g_buffers.erase(std::find(g_buffers.begin(), g_buffers.end(), this));
+}
+
+ThreadBuffer& LocalBuffer()
+{
+    thread_local ThreadBuffer buffer;
+    return buffer;
+}
+
+const char* SeverityName(const bbfm::Diagnostic::Severity severity)
+{
+    switch (severity)
+    {
+        case bbfm::Diagnostic::Severity::NOTE:
+            return "note";
+        case bbfm::Diagnostic::Severity::WARNING:
+            return "warning";
+        default:
+            return "error";
+    }
+}
+
+/// \brief Render one diagnostic as text
+void RenderText(const bbfm::Diagnostic& diagnostic, std::string& out)
+{
+    if (diagnostic.file.empty())
+    {
+        out += diagnostic.message;
+        out += '\n';
+        return;
+    }
+    out += diagnostic.file;
+    out += ':' + std::to_string(diagnostic.line);
+    if (diagnostic.column > 0)
+    {
+        out += ':' + std::to_string(diagnostic.column);
+    }
+    out += ": ";
+    out += SeverityName(diagnostic.severity);
+    out += ": ";
+    out += diagnostic.message;
+    out += '\n';
+
+    // The source line with a caret under the column
+    if (false == diagnostic.sourceLine.empty())
+    {
+        out += diagnostic.sourceLine;
+        out += '\n';
+        out.append(static_cast<size_t>(std::max(diagnostic.column - 1, 0)), ' ');
+        out += "^\n";
+    }
+}
+
+bbfm::JsonValue ToJson(const bbfm::Diagnostic& diagnostic)
+{
+    bbfm::JsonValue item = bbfm::JsonValue::MakeObject();
+    item.Set("severity", SeverityName(diagnostic.severity)).Set("message", diagnostic.message);
+    if (false == diagnostic.file.empty())
+    {
+        item.Set("file", diagnostic.file).Set("line", diagnostic.line).Set("column", diagnostic.column);
+    }
+    return item;
+}
+
+bbfm::JsonValue ToSarif(const bbfm::Diagnostic& diagnostic)
+{
+    bbfm::JsonValue result = bbfm::JsonValue::MakeObject();
+    result.Set("level", SeverityName(diagnostic.severity)).Set("message", bbfm::JsonValue::MakeObject().Set("text", diagnostic.message));
+    if (false == diagnostic.file.empty())
+    {
+        bbfm::JsonValue region = bbfm::JsonValue::MakeObject();
+        region.Set("startLine", std::max(diagnostic.line, 1));
+        if (diagnostic.column > 0)
+        {
+            region.Set("startColumn", diagnostic.column);
+        }
+        bbfm::JsonValue physical = bbfm::JsonValue::MakeObject();
+        physical.Set("artifactLocation", bbfm::JsonValue::MakeObject().Set("uri", diagnostic.file)).Set("region", std::move(region));
+        bbfm::JsonValue locations = bbfm::JsonValue::MakeArray();
+        locations.Append(bbfm::JsonValue::MakeObject().Set("physicalLocation", std::move(physical)));
+        result.Set("locations", std::move(locations));
+    }
+    return result;
+}
+} // namespace
+
+namespace bbfm {
+void Diagnostics::Report(Diagnostic diagnostic)
+{
+    diagnostic.sequence = g_sequence++;
+    if (0 == g_sessions.load())
+    {
+        std::string text;
+        RenderText(diagnostic, text);
+        std::lock_guard<std::mutex> lock(g_outputMutex);
+        std::cerr << text;
+        return;
+    }
+
+    ThreadBuffer&               buffer = LocalBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.items.push_back(std::move(diagnostic));
+}
+
+void Diagnostics::Report(const Diagnostic::Severity severity, const std::string& message)
+{
+    Diagnostic diagnostic;
+    diagnostic.severity = severity;
+    diagnostic.message  = message;
+    Report(std::move(diagnostic));
+}
+
+void Diagnostics::ReportStatus(const std::string& message)
+{
+    std::lock_guard<std::mutex> lock(g_outputMutex);
+    std::cout << message << '\n';
+}
+
+std::string Diagnostics::Render(const std::vector<Diagnostic>& diagnostics, const DiagnosticFormat format, const size_t suppressed)
+{
+    if (DiagnosticFormat::TEXT == format)
+    {
+        std::string out;
+        for (const Diagnostic& diagnostic : diagnostics)
+        {
+            RenderText(diagnostic, out);
+        }
+        if (0 != suppressed)
+        {
+            out += std::to_string(suppressed) + " more diagnostic(s) not shown (see --error-limit)\n";
+        }
+        return out;
+    }
+
+    if (DiagnosticFormat::JSON == format)
+    {
+        JsonValue items = JsonValue::MakeArray();
+        for (const Diagnostic& diagnostic : diagnostics)
+        {
+            items.Append(ToJson(diagnostic));
+        }
+        JsonValue document = JsonValue::MakeObject();
+        document.Set("diagnostics", std::move(items)).Set("suppressed", static_cast<double>(suppressed));
+        return document.Serialize() + "\n";
+    }
+
+    JsonValue results = JsonValue::MakeArray();
+    for (const Diagnostic& diagnostic : diagnostics)
+    {
+        results.Append(ToSarif(diagnostic));
+    }
+    JsonValue driver = JsonValue::MakeObject();
+    driver.Set("name", "model-compiler").Set("version", BBFM_COMPILER_VERSION);
+    JsonValue run = JsonValue::MakeObject();
+    run.Set("tool", JsonValue::MakeObject().Set("driver", std::move(driver))).Set("results", std::move(results));
+    run.Set("properties", JsonValue::MakeObject().Set("suppressed", static_cast<double>(suppressed)));
+    JsonValue runs = JsonValue::MakeArray();
+    runs.Append(std::move(run));
+    JsonValue log = JsonValue::MakeObject();
+    log.Set("$schema", "https://json.schemastore.org/sarif-2.1.0.json").Set("version", "2.1.0").Set("runs", std::move(runs));
+    return log.Serialize() + "\n";
+}
+
+bool Diagnostics::ParseFormat(const std::string& name, DiagnosticFormat& format)
+{
+    if ("text" == name)
+    {
+        format = DiagnosticFormat::TEXT;
+    }
+    else if ("json" == name)
+    {
+        format = DiagnosticFormat::JSON;
+    }
+    else if ("sarif" == name)
+    {
+        format = DiagnosticFormat::SARIF;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+std::vector<Diagnostic> Diagnostics::TakeBuffered()
+{
+    std::vector<Diagnostic> diagnostics;
+    {
+        std::lock_guard<std::mutex> lock(g_registryMutex);
+        diagnostics.swap(g_orphans);
+        for (ThreadBuffer* buffer : g_buffers)
+        {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            diagnostics.insert(diagnostics.end(), std::make_move_iterator(buffer->items.begin()), std::make_move_iterator(buffer->items.end()));
+            buffer->items.clear();
+        }
+    }
+
+    // Located diagnostics by file, line and column, then the others in the order they were reported
+    std::sort(diagnostics.begin(), diagnostics.end(),
+        [](const Diagnostic& a, const Diagnostic& b)
+        {
+            if (a.file.empty() != b.file.empty())
+            {
+                return b.file.empty();
+            }
+            if (a.file.empty())
+            {
+                return a.sequence < b.sequence;
+            }
+            if (a.file != b.file)
+            {
+                return a.file < b.file;
+            }
+            if (a.line != b.line)
+            {
+                return a.line < b.line;
+            }
+            if (a.column != b.column)
+            {
+                return a.column < b.column;
+            }
+            return a.sequence < b.sequence;
+        });
+
+    // The same message at the same place is shown once
+    std::set<std::string>   seen;
+    std::vector<Diagnostic> unique;
+    unique.reserve(diagnostics.size());
+    for (Diagnostic& diagnostic : diagnostics)
+    {
+        const std::string key = std::to_string(static_cast<int>(diagnostic.severity)) + ":" + std::to_string(diagnostic.line) + ":" +
+                                std::to_string(diagnostic.column) + ":" + diagnostic.file + "\n" + diagnostic.message;
+        if (seen.insert(key).second)
+        {
+            unique.push_back(std::move(diagnostic));
+        }
+    }
+    return unique;
+}
+
+DiagnosticSession::DiagnosticSession(const DiagnosticFormat format, const size_t errorLimit) : format_(format), errorLimit_(errorLimit)
+{
+    ++g_sessions;
+}
+
+DiagnosticSession::~DiagnosticSession()
+{
+    Write(true);
+    --g_sessions;
+}
+
+void DiagnosticSession::Flush()
+{
+    if (DiagnosticFormat::TEXT == format_)
+    {
+        Write(false);
+    }
+}
+
+void DiagnosticSession::Write(const bool always)
+{
+    std::vector<Diagnostic> diagnostics = Diagnostics::TakeBuffered();
+    size_t                  suppressed  = 0;
+    if (0 != errorLimit_ && diagnostics.size() > errorLimit_)
+    {
+        suppressed = diagnostics.size() - errorLimit_;
+        diagnostics.resize(errorLimit_);
+    }
+
+    // Status messages first, then all diagnostics in one write
+    std::lock_guard<std::mutex> lock(g_outputMutex);
+    std::cout.flush();
+    if (false == diagnostics.empty() || (always && DiagnosticFormat::TEXT != format_))
+    {
+        std::cerr << Diagnostics::Render(diagnostics, format_, suppressed) << std::flush;
+    }
+}
+} // namespace bbfm
@@ -1,117 +1,546 @@
 #include "Driver.h"
 #include "AST.h"
+#include "AllocTracker.h"
 #include "Console.h"
+#include "Diagnostics.h"
+#include "Fingerprint.h"
+#include "IncrementalParser.h"
+#include "ParseContext.h"
+#include "Profiler.h"
 #include "SemanticAnalyzer.h"
+#include <algorithm>
+#include <atomic>
 #include <cstdio>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <set>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
-// External C functions from Flex/Bison
-extern "C" {
-    extern FILE* yyin;
-}
+// Token codes and semantic values of the reentrant parser
+#include "parser.h"
 
-extern int yyparse(void);
+// The reentrant flex scanner (model-compiler.l), every parse creates its own
+int  yylex_init(yyscan_t* scanner);
+int  yylex_init_extra(bbfm::ParseContext* context, yyscan_t* scanner);
+int  yylex_destroy(yyscan_t scanner);
+void yyrestart(FILE* inputFile, yyscan_t scanner);
+void yyset_lineno(int line, yyscan_t scanner);
+void yyset_column(int column, yyscan_t scanner);
 
-// Global AST variable used for communication between parser and driver.
-// This must be global because yyparse() has signature int yyparse(void)
-// with no parameters or return value for the AST. The parser sets this
-// variable when parsing completes, and the driver retrieves it afterward.
-// This is the standard pattern for Bison parsers.
-extern std::unique_ptr<bbfm::AST> g_ast;
+namespace {
+/// \brief Resolve an imported path against the directory of the importing file
+std::string ResolveImport(const std::string& importer, const std::string& path)
+{
+    const size_t slash = importer.rfind('/');
+    if ((false == path.empty() && '/' == path[0]) || std::string::npos == slash)
+    {
+        return path;
+    }
+    return importer.substr(0, slash + 1) + path;
+}
 
-// Global filename and source lines for error reporting
-extern std::string              g_current_filename;
-extern std::vector<std::string> g_source_lines;
+/// \brief Get the canonical path of an existing file
+bool CanonicalPath(const std::string& fileName, std::string& canonical)
+{
+    char* resolved = realpath(fileName.c_str(), nullptr);
+    if (nullptr == resolved)
+    {
+        return false;
+    }
+    canonical = resolved;
+    free(resolved);
+    return true;
+}
+
+/// \brief Read the content of a file
+bool ReadFile(const std::string& fileName, std::string& text)
+{
+    std::ifstream infile(fileName, std::ios::binary);
+    if (!infile.is_open())
+    {
+        return false;
+    }
+    std::ostringstream content;
+    content << infile.rdbuf();
+    text = content.str();
+    return true;
+}
+} // namespace
 
 namespace bbfm {
+// ============================================================================
+// ImportCache Implementation
+// ============================================================================
+
+std::shared_ptr<AST> ImportCache::Find(const std::string& canonical, const uint64_t contentHash) const
+{
+    auto it = modules_.find(canonical);
+    if (modules_.end() == it || it->second.first != contentHash)
+    {
+        return nullptr;
+    }
+    return it->second.second;
+}
+
+void ImportCache::Insert(const std::string& canonical, const uint64_t contentHash, std::shared_ptr<AST> ast)
+{
+    modules_[canonical] = {contentHash, std::move(ast)};
+}
+
+size_t ImportCache::GetSize() const
+{
+    return modules_.size();
+}
+
 // ============================================================================
 // Driver Implementation
 // ============================================================================
 
 Driver::Driver(std::vector<std::string> sourceFiles, const std::string& classPrefix) :
-    sourceFiles_(std::move(sourceFiles)), classPrefix_(classPrefix), hasErrors_(false)
+    sourceFiles_(std::move(sourceFiles)), classPrefix_(classPrefix), hasErrors_(false), syntaxErrors_(0), reusedModules_(0)
 {
 }
 
 std::unique_ptr<AST> Driver::Phase0()
 {
-    // Currently we only support single file compilation
-    // Multi-file support will be added later
+    ProfileScope profile("phase", "Phase 0 (Lexical Analysis)");
+    if (!LoadSourceModules(nullptr))
+    {
+        return nullptr;
+    }
+    return MergeModules();
+}
+
+std::unique_ptr<AST> Driver::Phase0(ImportCache& cache, ModuleAsts& modules)
+{
+    ProfileScope profile("phase", "Phase 0 (Lexical Analysis)");
+    modules.clear();
+    if (!LoadSourceModules(&cache))
+    {
+        return nullptr;
+    }
+
+    // The module ASTs are shared with the cache, their declarations stay in place
+    for (const ModuleFile& module : moduleFiles_)
+    {
+        modules.push_back(modules_[module.path]);
+    }
+    return std::make_unique<AST>(std::vector<std::unique_ptr<Declaration>>());
+}
+
+bool Driver::LoadSourceModules(ImportCache* cache)
+{
     if (sourceFiles_.empty())
     {
         Console::ReportError("Error: No source files provided");
         hasErrors_ = true;
-        return nullptr;
+        return false;
     }
 
-    if (sourceFiles_.size() > 1)
+    Console::ReportStatus("Phase 0 (Lexical Analysis) started...");
+
+    // Every source file is a module; all errors are reported before giving up
+    std::vector<PendingModule> sourceModules;
+    for (const std::string& sourceFile : sourceFiles_)
+    {
+        sourceModules.push_back(PendingModule{sourceFile, "", "", nullptr});
+    }
+    if (!LoadModules(std::move(sourceModules), cache))
     {
-        Console::ReportError("Error: Multi-file compilation not yet supported");
         hasErrors_ = true;
-        return nullptr;
+        return false;
+    }
+
+    if (0 != reusedModules_)
+    {
+        Console::ReportStatus("Phase 0: " + std::to_string(moduleFiles_.size() - reusedModules_) + " of " + std::to_string(moduleFiles_.size()) +
+                              " modules parsed (" + std::to_string(reusedModules_) + " unchanged)");
+    }
+    else if (moduleFiles_.size() > 1)
+    {
+        Console::ReportStatus("Phase 0: " + std::to_string(moduleFiles_.size()) + " modules parsed");
+    }
+
+    // The intact declarations still go through semantic analysis, so one run reports every error
+    if (0 != syntaxErrors_)
+    {
+        Console::ReportStatus("Phase 0 (Lexical Analysis) failed with " + std::to_string(syntaxErrors_) + " syntax error(s).");
+        return true;
+    }
+    Console::ReportStatus("Phase 0 (Lexical Analysis) completed successfully!");
+    return true;
+}
+
+bool Driver::LoadImports(const std::string& fileName, const AST* ast, ModuleAsts& imports, ImportCache* cache)
+{
+    imports.clear();
+
+    // The importing file counts as loaded, so an import cycle back to it ends there
+    std::string canonical;
+    if (CanonicalPath(fileName, canonical))
+    {
+        modules_.emplace(canonical, nullptr);
+    }
+
+    // The imports of the file are the roots of the module order
+    std::vector<PendingModule> pending;
+    for (const auto& import : ast->GetImports())
+    {
+        pending.push_back(PendingModule{ResolveImport(fileName, import->GetPath()), fileName, "", import.get()});
     }
 
-    const std::string& filename = sourceFiles_[0];
+    const size_t syntaxErrors = syntaxErrors_;
+    if (!LoadModules(std::move(pending), cache) || syntaxErrors != syntaxErrors_)
+    {
+        hasErrors_ = true;
+        return false;
+    }
 
-    // Set global filename for error reporting
-    g_current_filename = filename;
+    // The module ASTs are shared with the cache, their declarations stay in place
+    for (const ModuleFile& module : moduleFiles_)
+    {
+        imports.push_back(modules_[module.path]);
+    }
+    return true;
+}
 
-    // Read source file lines for error reporting
-    g_source_lines.clear();
-    std::ifstream infile(filename);
-    if (infile.is_open())
+const std::vector<ModuleFile>& Driver::GetModules() const
+{
+    return moduleFiles_;
+}
+
+bool Driver::FindModuleFiles(const std::vector<std::string>& sourceFiles, std::vector<std::string>& moduleFiles)
+{
+    moduleFiles.clear();
+    std::set<std::string>    visited;
+    std::vector<std::string> pending(sourceFiles.rbegin(), sourceFiles.rend());
+    while (false == pending.empty())
     {
-        std::string line;
-        while (std::getline(infile, line))
+        const std::string fileName = pending.back();
+        pending.pop_back();
+
+        std::string canonical;
+        std::string text;
+        if (!CanonicalPath(fileName, canonical) || !ReadFile(canonical, text))
+        {
+            return false;
+        }
+        if (!visited.insert(canonical).second)
+        {
+            continue;
+        }
+        moduleFiles.push_back(fileName);
+
+        std::vector<DeclarationSpan> spans;
+        std::vector<DeclarationSpan> imports;
+        if (!IncrementalParser::SplitDeclarations(text, spans, imports))
         {
-            g_source_lines.push_back(line);
+            return false;
+        }
+        for (const DeclarationSpan& import : imports)
+        {
+            pending.push_back(ResolveImport(fileName, IncrementalParser::ImportPath(text, import)));
         }
-        infile.close();
     }
+    return true;
+}
+
+bool Driver::LoadModules(std::vector<PendingModule> pending, ImportCache* cache)
+{
+    bool                                            success = true;
+    std::map<std::string, std::vector<std::string>> imports;       // Canonical paths imported by each module ("" for the roots)
+    std::map<std::string, uint64_t>                 contentHashes; // Of the modules parsed by this load
 
-    // Open the source file for parsing
-    yyin = fopen(filename.c_str(), "r");
-    if (nullptr == yyin)
+    // One import level at a time: the new modules of a level are parsed together
+    while (false == pending.empty())
+    {
+        std::vector<LoadedModule> level;
+        std::vector<LoadedModule> reused; // Unchanged modules of the cache
+        for (const PendingModule& module : pending)
+        {
+            std::string canonical;
+            std::string text;
+            if (!CanonicalPath(module.fileName, canonical) || !ReadFile(canonical, text))
+            {
+                if (nullptr == module.import)
+                {
+                    Console::ReportError("Error: Could not open file '" + module.fileName + "'");
+                }
+                else
+                {
+                    Diagnostic diagnostic;
+                    diagnostic.file    = module.importer;
+                    diagnostic.line    = module.import->GetLine();
+                    diagnostic.column  = module.import->GetColumn();
+                    diagnostic.message = "Could not open imported file '" + module.import->GetPath() + "'";
+                    Diagnostics::Report(std::move(diagnostic));
+                }
+                success = false;
+                continue;
+            }
+            imports[module.importerCanonical].push_back(canonical);
+
+            // A module is parsed once per build, however often it is imported
+            if (modules_.emplace(canonical, nullptr).second)
+            {
+                LoadedModule loaded;
+                loaded.fileName  = module.fileName;
+                loaded.canonical = canonical;
+                loaded.text      = std::move(text);
+
+                // An unchanged module is not parsed again
+                if (nullptr != cache)
+                {
+                    loaded.contentHash = SchemaFingerprinter::Hash(loaded.text);
+                    loaded.ast         = cache->Find(canonical, loaded.contentHash);
+                }
+                (nullptr != loaded.ast ? reused : level).push_back(std::move(loaded));
+            }
+        }
+
+        ParseModules(level);
+        for (LoadedModule& module : level)
+        {
+            if (nullptr != cache && nullptr != module.ast && 0 == module.syntaxErrors)
+            {
+                cache->Insert(module.canonical, module.contentHash, module.ast);
+            }
+        }
+        reusedModules_ += reused.size();
+        level.insert(level.end(), std::make_move_iterator(reused.begin()), std::make_move_iterator(reused.end()));
+
+        // The imports of this level's modules are the next level
+        pending.clear();
+        for (LoadedModule& module : level)
+        {
+            syntaxErrors_ += module.syntaxErrors;
+            if (0 != module.syntaxErrors)
+            {
+                hasErrors_ = true;
+            }
+            if (nullptr == module.ast)
+            {
+                hasErrors_ = true;
+                success    = false;
+                continue;
+            }
+            for (const auto& import : module.ast->GetImports())
+            {
+                pending.push_back(PendingModule{ResolveImport(module.fileName, import->GetPath()), module.fileName, module.canonical, import.get()});
+            }
+            contentHashes[module.canonical] = module.contentHash;
+            modules_[module.canonical]      = module.ast;
+        }
+    }
+
+    // Every module after the modules it imports, as a recursive load would order them
+    std::set<std::string> visited;
+    auto                  roots = imports.find("");
+    if (imports.end() != roots)
+    {
+        for (const std::string& root : roots->second)
+        {
+            AppendModule(root, imports, contentHashes, visited);
+        }
+    }
+    return success;
+}
+
+void Driver::ParseModules(std::vector<LoadedModule>& modules)
+{
+    std::atomic<size_t> next{0};
+    auto                parseModules = [&modules, &next]()
+    {
+        for (size_t i = next++; i < modules.size(); i = next++)
+        {
+            LoadedModule& module = modules[i];
+            ProfileScope  profile("module", module.fileName);
+            module.ast         = ParseSource(module.fileName, module.text, 1, module.syntaxErrors);
+            module.contentHash = SchemaFingerprinter::Hash(module.text);
+            if (nullptr != module.ast)
+            {
+                IncrementalParser::StampSourceHashes(module.text, module.ast.get());
+            }
+        }
+    };
+
+    // The calling thread parses too; a single module needs no worker
+    const size_t             workers = std::min<size_t>(modules.size(), std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < workers; ++i)
+    {
+        threads.emplace_back(parseModules);
+    }
+    parseModules();
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+void Driver::AppendModule(const std::string& canonical, const std::map<std::string, std::vector<std::string>>& imports,
+                          const std::map<std::string, uint64_t>& contentHashes, std::set<std::string>& visited)
+{
+    // Modules loaded before, or that failed to parse, are not part of this load
+    auto contentHash = contentHashes.find(canonical);
+    if (contentHashes.end() == contentHash || !visited.insert(canonical).second)
+    {
+        return;
+    }
+    auto moduleImports = imports.find(canonical);
+    if (imports.end() != moduleImports)
+    {
+        for (const std::string& import : moduleImports->second)
+        {
+            AppendModule(import, imports, contentHashes, visited);
+        }
+    }
+    moduleFiles_.push_back(ModuleFile{canonical, contentHash->second});
+}
+
+std::unique_ptr<AST> Driver::MergeModules()
+{
+    std::vector<std::unique_ptr<Declaration>> declarations;
+    for (const ModuleFile& module : moduleFiles_)
+    {
+        for (std::unique_ptr<Declaration>& decl : modules_[module.path]->TakeDeclarations())
+        {
+            declarations.push_back(std::move(decl));
+        }
+    }
+    return std::make_unique<AST>(std::move(declarations));
+}
+
+std::unique_ptr<AST> Driver::Phase0FromText(const std::string& fileName, const std::string& text)
+{
+    Console::ReportStatus("Phase 0 (Lexical Analysis) started...");
+    std::unique_ptr<AST> ast = ParseText(fileName, text);
+    if (nullptr != ast)
+    {
+        Console::ReportStatus("Phase 0 (Lexical Analysis) completed successfully!");
+    }
+    return ast;
+}
+
+std::unique_ptr<AST> Driver::ParseText(const std::string& fileName, const std::string& text, const int firstLine)
+{
+    size_t               syntaxErrors = 0;
+    std::unique_ptr<AST> ast          = ParsePartial(fileName, text, firstLine, syntaxErrors);
+    if (0 != syntaxErrors)
+    {
+        return nullptr;
+    }
+    return ast;
+}
+
+std::unique_ptr<AST> Driver::ParsePartial(const std::string& fileName, const std::string& text, const int firstLine, size_t& syntaxErrors)
+{
+    std::unique_ptr<AST> ast = ParseSource(fileName, text, firstLine, syntaxErrors);
+    if (nullptr == ast || 0 != syntaxErrors)
     {
-        Console::ReportError("Error: Could not open file '" + filename + "'");
         hasErrors_ = true;
+    }
+    return ast;
+}
+
+size_t Driver::LexText(const std::string& text)
+{
+    static char emptyText[] = "\n";
+    FILE*       input       = text.empty() ? fmemopen(emptyText, 1, "r") : fmemopen(const_cast<char*>(text.data()), text.size(), "r");
+    yyscan_t    scanner     = nullptr;
+    if (nullptr == input)
+    {
+        return 0;
+    }
+    if (0 != yylex_init(&scanner))
+    {
+        fclose(input);
+        return 0;
+    }
+    yyrestart(input, scanner);
+
+    YYSTYPE value;
+    YYLTYPE location;
+    size_t  tokenCount = 0;
+    for (int token = yylex(&value, &location, scanner); 0 != token; token = yylex(&value, &location, scanner))
+    {
+        // The lexer allocates the text of these tokens for the parser
+        if (IDENTIFIER == token || STRING_LITERAL == token || REAL_LITERAL == token || BOOL_LITERAL == token)
+        {
+            free(value.string);
+        }
+        ++tokenCount;
+    }
+
+    yylex_destroy(scanner);
+    fclose(input);
+    return tokenCount;
+}
+
+std::unique_ptr<AST> Driver::ParseSource(const std::string& fileName, const std::string& text, const int firstLine, size_t& syntaxErrors)
+{
+    syntaxErrors = 0;
+
+    // fmemopen() rejects an empty buffer, an empty document parses like a blank line
+    static char emptyText[] = "\n";
+    FILE*       input       = text.empty() ? fmemopen(emptyText, 1, "r") : fmemopen(const_cast<char*>(text.data()), text.size(), "r");
+    yyscan_t    scanner     = nullptr;
+    if (nullptr == input)
+    {
+        Console::ReportError("Error: Could not read source text of '" + fileName + "'");
         return nullptr;
     }
 
-    Console::ReportStatus("Phase 0 (Lexical Analysis) started...");
+    // The scanner reports unknown characters through the context
+    ParseContext context;
+    context.fileName  = fileName;
+    context.text      = text;
+    context.firstLine = firstLine;
+    if (0 != yylex_init_extra(&context, &scanner))
+    {
+        Console::ReportError("Error: Could not create a scanner for '" + fileName + "'");
+        fclose(input);
+        return nullptr;
+    }
 
-    // Parse the file
-    int result = yyparse();
+    // A scanner of its own, so files can be parsed at the same time
+    yyrestart(input, scanner);
+    yyset_lineno(firstLine, scanner);
+    yyset_column(1, scanner);
 
-    // Close the file
-    if (yyin != stdin)
+    // Parse the source
+    int result = 0;
     {
-        fclose(yyin);
+        BBFM_ALLOC_SITE("Parser (AST construction)");
+        result = yyparse(scanner, context);
     }
 
-    // Check parsing result
+    yylex_destroy(scanner);
+    fclose(input);
+
+    // The parser recovers from most syntax errors and only gives up on the rest (e.g., at the end of the file)
+    syntaxErrors = static_cast<size_t>(context.syntaxErrorCount);
     if (0 != result)
     {
-        hasErrors_ = true;
         return nullptr;
     }
 
-    // Transfer ownership of AST from global to caller
-    if (nullptr == g_ast)
+    // Transfer ownership of AST from the context to the caller
+    if (nullptr == context.ast)
     {
         Console::ReportError("Error: Parser succeeded but no AST was created");
-        hasErrors_ = true;
         return nullptr;
     }
 
-    Console::ReportStatus("Phase 0 (Lexical Analysis) completed successfully!");
-    return std::move(g_ast);
+    return std::move(context.ast);
 }
 
-std::unique_ptr<SemanticAnalyzer> Driver::Phase1(const AST* ast)
+std::unique_ptr<SemanticAnalyzer> Driver::Phase1(const AST* ast, AnalysisCache* cache, const ModuleAsts* imports)
 {
     if (nullptr == ast)
     {
@@ -120,17 +549,24 @@ std::unique_ptr<SemanticAnalyzer> Driver::Phase1(const AST* ast)
         return nullptr;
     }
 
+    ProfileScope profile("phase", "Phase 1 (Semantic Analysis)");
     Console::ReportStatus("Phase 1 (Semantic Analysis) started...");
 
-    auto analyzer = std::make_unique<SemanticAnalyzer>(ast);
+    auto analyzer = std::make_unique<SemanticAnalyzer>(ast, cache, imports);
 
     if (!analyzer->Analyze())
     {
-        Console::ReportError("Phase 1 (Semantic Analysis) failed with errors.");
+        Console::ReportStatus("Phase 1 (Semantic Analysis) failed with errors.");
         hasErrors_ = true;
         return nullptr;
     }
 
+    // After syntax errors only the declarations that parsed were analyzed, and the compile still fails
+    if (0 != syntaxErrors_)
+    {
+        Console::ReportStatus("Phase 1 (Semantic Analysis) found no errors in the declarations that parsed.");
+        return analyzer;
+    }
     Console::ReportStatus("Phase 1 (Semantic Analysis) completed successfully!");
     return analyzer;
 }
@@ -0,0 +1,190 @@
+#include "Fingerprint.h"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+namespace bbfm {
+SchemaFingerprinter::SchemaFingerprinter(const SemanticAnalyzer* analyzer) : analyzer_(analyzer) {}
+
+uint64_t SchemaFingerprinter::ClassFingerprint(const ClassDeclaration* classDecl) const
+{
+    return Hash(CanonicalClass(classDecl));
+}
+
+uint64_t SchemaFingerprinter::EnumFingerprint(const EnumDeclaration* enumDecl) const
+{
+    return Hash(CanonicalEnum(enumDecl));
+}
+
+std::string SchemaFingerprinter::CanonicalClass(const ClassDeclaration* classDecl) const
+{
+    std::vector<const ClassDeclaration*> chain;
+    analyzer_->GetClassChain(classDecl, chain);
+
+    std::string canonical = "class " + classDecl->GetName() + "\n";
+
+    // Fields in layout order: inherited fields first, declaration order within a class
+    std::vector<std::string> invariants;
+    for (const ClassDeclaration* current : chain)
+    {
+        for (const auto& field : current->GetFields())
+        {
+            canonical += "  " + CanonicalField(field.get()) + "\n";
+        }
+        for (const auto& invariant : current->GetInvariants())
+        {
+            invariants.push_back(CanonicalExpression(invariant->GetExpression()));
+        }
+    }
+
+    // Invariants are a conjunction, so their order does not matter
+    std::sort(invariants.begin(), invariants.end());
+    for (const auto& invariant : invariants)
+    {
+        canonical += "  invariant " + invariant + "\n";
+    }
+
+    return canonical;
+}
+
+std::string SchemaFingerprinter::CanonicalEnum(const EnumDeclaration* enumDecl)
+{
+    // Value order is significant: values are stored as their index
+    std::string canonical = "enum " + enumDecl->GetName() + " {";
+    for (const auto& value : enumDecl->GetValues())
+    {
+        canonical += " " + value;
+    }
+    return canonical + " }\n";
+}
+
+std::string SchemaFingerprinter::CanonicalField(const Field* field) const
+{
+    std::string canonical = field->GetName() + ": " + CanonicalType(field);
+
+    // Fields without a cardinality modifier are mandatory single values
+    const CardinalityModifier* cardinality = field->GetCardinalityModifier();
+    const int                  minCount    = (nullptr != cardinality) ? cardinality->GetMin() : 1;
+    const int                  maxCount    = (nullptr != cardinality) ? cardinality->GetMax() : 1;
+    canonical += " [" + std::to_string(minCount) + ".." + (-1 == maxCount ? std::string("*") : std::to_string(maxCount)) + "]";
+
+    if (field->HasUniqueConstraint())
+    {
+        canonical += " unique";
+    }
+    if (field->IsInterned())
+    {
+        canonical += " interned";
+    }
+    const EncodingModifier* encoding = field->GetEncodingModifier();
+    if (nullptr != encoding)
+    {
+        canonical += " encoding(" + encoding->GetEncoding() + ")";
+    }
+    if (field->IsComputed())
+    {
+        canonical += " = " + CanonicalExpression(field->GetInitializer());
+    }
+
+    return canonical;
+}
+
+std::string SchemaFingerprinter::CanonicalType(const Field* field) const
+{
+    const TypeSpec* typeSpec = field->GetType();
+    if (typeSpec->IsPrimitive())
+    {
+        return PrimitiveTypeSpec::TypeToString(static_cast<const PrimitiveTypeSpec*>(typeSpec)->GetType());
+    }
+
+    const std::string& typeName    = static_cast<const UserDefinedTypeSpec*>(typeSpec)->GetTypeName();
+    const auto&        symbolTable = analyzer_->GetSymbolTable();
+    auto               symbol      = symbolTable.find(typeName);
+    if (symbolTable.end() != symbol && TypeSymbol::Kind::ENUM == symbol->second.kind)
+    {
+        return typeName + "#" + ToString(EnumFingerprint(symbol->second.enumDecl));
+    }
+    return typeName;
+}
+
+std::string SchemaFingerprinter::CanonicalExpression(const Expression* expr)
+{
+    if (nullptr == expr)
+    {
+        return "?";
+    }
+
+    const BinaryExpression* binExpr = dynamic_cast<const BinaryExpression*>(expr);
+    if (nullptr != binExpr)
+    {
+        return "(" + CanonicalExpression(binExpr->GetLeft()) + " " + BinaryExpression::OpToString(binExpr->GetOperator()) + " " +
+               CanonicalExpression(binExpr->GetRight()) + ")";
+    }
+
+    const UnaryExpression* unaryExpr = dynamic_cast<const UnaryExpression*>(expr);
+    if (nullptr != unaryExpr)
+    {
+        return "(" + std::string(UnaryExpression::OpToString(unaryExpr->GetOperator())) + CanonicalExpression(unaryExpr->GetOperand()) + ")";
+    }
+
+    const ParenthesizedExpression* parenExpr = dynamic_cast<const ParenthesizedExpression*>(expr);
+    if (nullptr != parenExpr)
+    {
+        return CanonicalExpression(parenExpr->GetExpression());
+    }
+
+    const MemberAccessExpression* memberExpr = dynamic_cast<const MemberAccessExpression*>(expr);
+    if (nullptr != memberExpr)
+    {
+        return CanonicalExpression(memberExpr->GetObject()) + "." + memberExpr->GetMemberName();
+    }
+
+    const FunctionCall* funcCall = dynamic_cast<const FunctionCall*>(expr);
+    if (nullptr != funcCall)
+    {
+        std::string canonical = funcCall->GetFunctionName() + "(";
+        for (size_t i = 0; i < funcCall->GetArguments().size(); ++i)
+        {
+            canonical += (0 == i ? "" : ", ") + CanonicalExpression(funcCall->GetArguments()[i].get());
+        }
+        return canonical + ")";
+    }
+
+    const QuantifiedExpression* quantExpr = dynamic_cast<const QuantifiedExpression*>(expr);
+    if (nullptr != quantExpr)
+    {
+        return "(" + std::string(QuantifiedExpression::QuantifierToString(quantExpr->GetQuantifier())) + " " + quantExpr->GetVariableName() + " in " +
+               CanonicalExpression(quantExpr->GetCollection()) + ": " + CanonicalExpression(quantExpr->GetBody()) + ")";
+    }
+
+    const LiteralExpression* literal = dynamic_cast<const LiteralExpression*>(expr);
+    if (nullptr != literal && Expression::Type::REAL == literal->GetResultType())
+    {
+        // Round-trip precision, independent of the default stream formatting
+        char text[32];
+        snprintf(text, sizeof(text), "%.17g", literal->GetRealValue());
+        return text;
+    }
+
+    // Literals and field references
+    return expr->ToString();
+}
+
+uint64_t SchemaFingerprinter::Hash(const std::string& text)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const char c : text)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+std::string SchemaFingerprinter::ToString(const uint64_t fingerprint)
+{
+    char text[24];
+    snprintf(text, sizeof(text), "0x%016llx", static_cast<unsigned long long>(fingerprint));
+    return text;
+}
+} // namespace bbfm
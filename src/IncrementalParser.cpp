@@ -0,0 +1,477 @@
+#include "IncrementalParser.h"
+#include "Driver.h"
+#include "Fingerprint.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <functional>
+#include <map>
+
+namespace {
+/// \brief Skip a comment starting at pos
+/// \return False if the text at pos is not a comment or a block comment is unterminated
+bool SkipComment(const std::string& text, size_t& pos, int& line, size_t& lineStart)
+{
+    if (0 == text.compare(pos, 2, "//"))
+    {
+        while (pos < text.size() && '\n' != text[pos])
+        {
+            ++pos;
+        }
+        return true;
+    }
+    if (0 == text.compare(pos, 2, "/*"))
+    {
+        const size_t end = text.find("*/", pos + 2);
+        if (std::string::npos == end)
+        {
+            return false;
+        }
+        for (; pos < end + 2; ++pos)
+        {
+            if ('\n' == text[pos])
+            {
+                ++line;
+                lineStart = pos + 1;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+/// \brief Check for a keyword at pos followed by a non-identifier character
+bool IsKeywordAt(const std::string& text, const size_t pos, const char* keyword)
+{
+    const size_t length = strlen(keyword);
+    return 0 == text.compare(pos, length, keyword) &&
+           (pos + length == text.size() || (0 == isalnum(static_cast<unsigned char>(text[pos + length])) && '_' != text[pos + length]));
+}
+
+/// \brief Split text into import statements and declaration spans, from a position at the top level
+/// \param pos Offset to start at
+/// \param line Line of pos (1-based)
+/// \param lineStart Offset of the start of that line
+/// \param spans Declaration spans, the spans found are appended
+/// \param imports Import statement spans, the imports found are appended
+/// \param stop Called with the offset and column of each declaration or import before it is scanned,
+///             scanning ends if it returns true (may be empty)
+/// \return False if the text is not a sequence of imports followed by brace-delimited declarations
+bool ScanDeclarations(const std::string& text, size_t pos, int line, size_t lineStart, std::vector<bbfm::DeclarationSpan>& spans,
+                      std::vector<bbfm::DeclarationSpan>& imports, const std::function<bool(size_t offset, int column)>& stop)
+{
+    while (pos < text.size())
+    {
+        const char c = text[pos];
+        if ('\n' == c)
+        {
+            ++pos;
+            ++line;
+            lineStart = pos;
+            continue;
+        }
+        if (' ' == c || '\t' == c || '\r' == c)
+        {
+            ++pos;
+            continue;
+        }
+        if ('/' == c)
+        {
+            if (!SkipComment(text, pos, line, lineStart))
+            {
+                return false;
+            }
+            continue;
+        }
+
+        bbfm::DeclarationSpan span;
+        span.offset = pos;
+        span.line   = line;
+        span.column = static_cast<int>(pos - lineStart) + 1;
+        if (stop && stop(span.offset, span.column))
+        {
+            return true;
+        }
+
+        // An import: "import" up to its semicolon, only before the first declaration
+        if (IsKeywordAt(text, pos, "import"))
+        {
+            if (false == spans.empty())
+            {
+                return false;
+            }
+            bool inString = false;
+            for (; pos < text.size() && (inString || ';' != text[pos]); ++pos)
+            {
+                if ('"' == text[pos])
+                {
+                    inString = !inString;
+                }
+                else if ('\\' == text[pos] && inString)
+                {
+                    ++pos;
+                }
+                else if ('\n' == text[pos] || '{' == text[pos] || '}' == text[pos])
+                {
+                    return false;
+                }
+            }
+            if (pos >= text.size())
+            {
+                return false;
+            }
+            ++pos;
+            span.length = pos - span.offset;
+            span.hash   = bbfm::SchemaFingerprinter::Hash(text.substr(span.offset, span.length));
+            imports.push_back(span);
+            continue;
+        }
+
+        // A declaration: "class" or "enum" up to the brace that closes its body
+        if (!IsKeywordAt(text, pos, "class") && !IsKeywordAt(text, pos, "enum"))
+        {
+            return false;
+        }
+
+        int  depth  = 0;
+        bool closed = false;
+        while (!closed && pos < text.size())
+        {
+            const char d = text[pos];
+            if ('\n' == d)
+            {
+                ++pos;
+                ++line;
+                lineStart = pos;
+            }
+            else if ('/' == d && SkipComment(text, pos, line, lineStart))
+            {
+                continue;
+            }
+            else if ('"' == d)
+            {
+                // String literal (escapes and line breaks as in the lexer)
+                for (++pos; pos < text.size() && '"' != text[pos]; ++pos)
+                {
+                    if ('\\' == text[pos])
+                    {
+                        ++pos;
+                    }
+                    if (pos < text.size() && '\n' == text[pos])
+                    {
+                        ++line;
+                        lineStart = pos + 1;
+                    }
+                }
+                if (pos >= text.size() || '"' != text[pos])
+                {
+                    return false;
+                }
+                ++pos;
+            }
+            else if ('{' == d)
+            {
+                ++depth;
+                ++pos;
+            }
+            else if ('}' == d)
+            {
+                ++pos;
+                closed = (--depth <= 0);
+            }
+            else if (';' == d && 0 == depth)
+            {
+                return false;
+            }
+            else
+            {
+                ++pos;
+            }
+        }
+        if (!closed || 0 != depth)
+        {
+            return false;
+        }
+
+        span.length = pos - span.offset;
+        span.hash   = bbfm::SchemaFingerprinter::Hash(std::to_string(span.column) + ":" + text.substr(span.offset, span.length));
+        spans.push_back(span);
+    }
+    return true;
+}
+} // namespace
+
+namespace bbfm {
+bool IncrementalParser::Parse(const std::string& fileName, const std::string& text)
+{
+    Driver driver({fileName});
+
+    // After edits only the edited declarations are scanned, the others keep their spans
+    std::vector<DeclarationSpan> spans;
+    std::vector<DeclarationSpan> importSpans;
+    size_t                       keptBefore = 0;
+    size_t                       keptAfter  = 0;
+    const bool                   split = (edited_ && false == spans_.empty()) ? RescanEdits(text, spans, importSpans, keptBefore, keptAfter)
+                                                                              : SplitDeclarations(text, spans, importSpans);
+    if (!split)
+    {
+        // Not splittable: parse as a whole, the parser reports the errors
+        std::unique_ptr<AST> ast = driver.ParseText(fileName, text);
+        if (nullptr == ast)
+        {
+            return false;
+        }
+        ast_         = std::move(ast);
+        reusedCount_ = 0;
+        parsedCount_ = ast_->GetDeclarations().size();
+        spans_.clear();
+        imports_.clear();
+        edited_ = false;
+        return true;
+    }
+
+    // Imports are few and cheap, they are parsed together every time
+    std::vector<std::unique_ptr<ImportDeclaration>> imports;
+    if (false == importSpans.empty())
+    {
+        std::unique_ptr<AST> importAst = driver.ParseText(fileName, text.substr(0, importSpans.back().offset + importSpans.back().length));
+        if (nullptr == importAst)
+        {
+            return false;
+        }
+        imports = importAst->TakeImports();
+    }
+
+    // Kept spans are the declarations they were, the others are matched to the remaining previous declarations, identical spans in order
+    const size_t                    NOT_REUSED = static_cast<size_t>(-1);
+    std::vector<size_t>             reusedFrom(spans.size(), NOT_REUSED);
+    std::multimap<uint64_t, size_t> previousSpans;
+    for (size_t i = keptBefore; i < spans_.size() - keptAfter; ++i)
+    {
+        previousSpans.emplace(spans_[i].hash, i);
+    }
+    for (size_t i = 0; i < keptBefore; ++i)
+    {
+        reusedFrom[i] = i;
+    }
+    for (size_t i = 0; i < keptAfter; ++i)
+    {
+        reusedFrom[spans.size() - keptAfter + i] = spans_.size() - keptAfter + i;
+    }
+
+    // Parse the changed spans before touching the previous AST, so it survives errors
+    std::vector<std::unique_ptr<Declaration>> parsed(spans.size());
+    bool                                      success = true;
+    for (size_t i = keptBefore; i < spans.size() - keptAfter; ++i)
+    {
+        auto it = previousSpans.find(spans[i].hash);
+        if (previousSpans.end() != it)
+        {
+            reusedFrom[i] = it->second;
+            previousSpans.erase(it);
+            continue;
+        }
+
+        // Indent the span to its column, so error columns match the file
+        std::string spanText(static_cast<size_t>(spans[i].column - 1), ' ');
+        spanText.append(text, spans[i].offset, spans[i].length);
+
+        std::unique_ptr<AST> spanAst = driver.ParseText(fileName, spanText, spans[i].line);
+        if (nullptr == spanAst)
+        {
+            success = false;
+            continue;
+        }
+        std::vector<std::unique_ptr<Declaration>> declarations = spanAst->TakeDeclarations();
+        if (1 != declarations.size())
+        {
+            success = false;
+            continue;
+        }
+        parsed[i] = std::move(declarations[0]);
+        parsed[i]->SetSourceHash(spans[i].hash);
+    }
+    if (!success)
+    {
+        return false;
+    }
+
+    // Assemble the new AST from reused and parsed declarations
+    std::vector<std::unique_ptr<Declaration>> previous;
+    if (nullptr != ast_)
+    {
+        previous = ast_->TakeDeclarations();
+    }
+
+    std::vector<std::unique_ptr<Declaration>> declarations;
+    declarations.reserve(spans.size());
+    reusedCount_ = 0;
+    parsedCount_ = 0;
+    for (size_t i = 0; i < spans.size(); ++i)
+    {
+        if (NOT_REUSED == reusedFrom[i])
+        {
+            declarations.push_back(std::move(parsed[i]));
+            ++parsedCount_;
+        }
+        else
+        {
+            std::unique_ptr<Declaration>& reused = previous[reusedFrom[i]];
+            const int                     delta  = spans[i].line - spans_[reusedFrom[i]].line;
+            if (0 != delta)
+            {
+                reused->ShiftLines(delta);
+            }
+            declarations.push_back(std::move(reused));
+            ++reusedCount_;
+        }
+    }
+
+    ast_ = std::make_unique<AST>(std::move(declarations));
+    ast_->SetImports(std::move(imports));
+    spans_   = std::move(spans);
+    imports_ = std::move(importSpans);
+    edited_  = false;
+    return true;
+}
+
+void IncrementalParser::Edit(const size_t offset, const size_t removedLength, const size_t insertedLength, const int lineDelta)
+{
+    // Without spans the next parse splits the whole text anyway
+    if (spans_.empty())
+    {
+        return;
+    }
+
+    // Find the spans the edit touches; spans of earlier edits are out of date and already rescanned
+    const size_t end   = offset + removedLength;
+    size_t       first = spans_.size(); // First span not before the edit
+    size_t       last  = spans_.size(); // First span after the edit
+    for (size_t i = 0; i < spans_.size(); ++i)
+    {
+        if (edited_ && i >= dirtyFirst_ && i < dirtyLast_)
+        {
+            continue;
+        }
+        if (spans_[i].offset + spans_[i].length <= offset)
+        {
+            continue;
+        }
+        first = std::min(first, i);
+        if (spans_[i].offset >= end)
+        {
+            last = i;
+            break;
+        }
+    }
+
+    // Spans after the edit move with their declarations, which keep matching them
+    for (size_t i = last; i < spans_.size(); ++i)
+    {
+        spans_[i].offset = spans_[i].offset + insertedLength - removedLength;
+        if (0 != lineDelta)
+        {
+            spans_[i].line += lineDelta;
+            ast_->GetDeclarations()[i]->ShiftLines(lineDelta);
+        }
+    }
+
+    dirtyFirst_ = edited_ ? std::min(dirtyFirst_, first) : first;
+    dirtyLast_  = edited_ ? std::max(dirtyLast_, last) : last;
+    edited_     = true;
+}
+
+const AST* IncrementalParser::GetAst() const
+{
+    return ast_.get();
+}
+
+size_t IncrementalParser::GetReusedCount() const
+{
+    return reusedCount_;
+}
+
+size_t IncrementalParser::GetParsedCount() const
+{
+    return parsedCount_;
+}
+
+bool IncrementalParser::SplitDeclarations(const std::string& text, std::vector<DeclarationSpan>& spans, std::vector<DeclarationSpan>& imports)
+{
+    spans.clear();
+    imports.clear();
+    return ScanDeclarations(text, 0, 1, 0, spans, imports, nullptr);
+}
+
+std::string IncrementalParser::ImportPath(const std::string& text, const DeclarationSpan& import)
+{
+    const size_t open  = text.find('"', import.offset);
+    const size_t close = text.rfind('"', import.offset + import.length);
+    if (std::string::npos == open || std::string::npos == close || close <= open)
+    {
+        return "";
+    }
+    return text.substr(open + 1, close - open - 1);
+}
+
+bool IncrementalParser::RescanEdits(const std::string& text, std::vector<DeclarationSpan>& spans, std::vector<DeclarationSpan>& importSpans,
+                                    size_t& keptBefore, size_t& keptAfter) const
+{
+    // Scanning starts at the end of the last declaration before the edits
+    size_t pos       = 0;
+    int    line      = 1;
+    size_t lineStart = 0;
+    keptBefore       = dirtyFirst_;
+    keptAfter        = 0;
+    if (0 != keptBefore)
+    {
+        const DeclarationSpan& kept = spans_[keptBefore - 1];
+        pos                         = kept.offset + kept.length;
+        line                        = kept.line + static_cast<int>(std::count(text.begin() + kept.offset, text.begin() + pos, '\n'));
+        const size_t newline        = text.rfind('\n', pos - 1);
+        lineStart                   = (std::string::npos == newline) ? 0 : newline + 1;
+        spans.assign(spans_.begin(), spans_.begin() + keptBefore);
+        importSpans = imports_;
+    }
+
+    // Scanning stops at a declaration after the edits that starts where its moved span does,
+    // from there the text is unchanged
+    size_t next    = dirtyLast_;
+    size_t resumed = spans_.size();
+    auto   stop    = [&](const size_t offset, const int column)
+    {
+        while (next < spans_.size() && spans_[next].offset < offset)
+        {
+            ++next;
+        }
+        if (next < spans_.size() && spans_[next].offset == offset && spans_[next].column == column)
+        {
+            resumed = next;
+            return true;
+        }
+        return false;
+    };
+    if (!ScanDeclarations(text, pos, line, lineStart, spans, importSpans, stop))
+    {
+        return false;
+    }
+
+    keptAfter = spans_.size() - resumed;
+    spans.insert(spans.end(), spans_.begin() + resumed, spans_.end());
+    return true;
+}
+
+void IncrementalParser::StampSourceHashes(const std::string& text, const AST* ast)
+{
+    std::vector<DeclarationSpan> spans;
+    std::vector<DeclarationSpan> imports;
+    if (!SplitDeclarations(text, spans, imports) || spans.size() != ast->GetDeclarations().size())
+    {
+        return;
+    }
+    for (size_t i = 0; i < spans.size(); ++i)
+    {
+        ast->GetDeclarations()[i]->SetSourceHash(spans[i].hash);
+    }
+}
+} // namespace bbfm
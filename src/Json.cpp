@@ -0,0 +1,591 @@
+#include "Json.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+// Deepest nesting accepted by the parser
+const int MAX_DEPTH = 256;
+
+void SkipWhitespace(const std::string& text, size_t& pos)
+{
+    while (pos < text.size() && (' ' == text[pos] || '\t' == text[pos] || '\n' == text[pos] || '\r' == text[pos]))
+    {
+        ++pos;
+    }
+}
+
+/// \brief Append a code point as UTF-8
+void AppendUtf8(std::string& out, const unsigned codePoint)
+{
+    if (codePoint < 0x80)
+    {
+        out += static_cast<char>(codePoint);
+    }
+    else if (codePoint < 0x800)
+    {
+        out += static_cast<char>(0xC0 | (codePoint >> 6));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+    else if (codePoint < 0x10000)
+    {
+        out += static_cast<char>(0xE0 | (codePoint >> 12));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+    else
+    {
+        out += static_cast<char>(0xF0 | (codePoint >> 18));
+        out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+
+/// \brief Append a string literal, escaping quotes, backslashes and control characters
+void AppendString(bbfm::OutputBuffer& out, const std::string& value)
+{
+    out << '"';
+
+    // Runs of characters that need no escape are appended at once
+    size_t start = 0;
+    for (size_t i = 0; i < value.size(); ++i)
+    {
+        const unsigned char c = static_cast<unsigned char>(value[i]);
+        if ('"' != c && '\\' != c && c >= 0x20)
+        {
+            continue;
+        }
+        out.Append(value.data() + start, i - start);
+        start = i + 1;
+        switch (c)
+        {
+            case '"':
+                out << "\\\"";
+                break;
+            case '\\':
+                out << "\\\\";
+                break;
+            case '\n':
+                out << "\\n";
+                break;
+            case '\r':
+                out << "\\r";
+                break;
+            case '\t':
+                out << "\\t";
+                break;
+            default:
+            {
+                char buffer[8];
+                snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                out << buffer;
+            }
+        }
+    }
+    out.Append(value.data() + start, value.size() - start);
+    out << '"';
+}
+
+/// \brief Append a number (integral values without a fraction, others with full precision)
+void AppendNumber(bbfm::OutputBuffer& out, const double value)
+{
+    char buffer[32];
+    if (std::isfinite(value) && value == std::floor(value) && std::fabs(value) < 1e15)
+    {
+        snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(value));
+    }
+    else
+    {
+        snprintf(buffer, sizeof(buffer), "%.17g", std::isfinite(value) ? value : 0.0);
+    }
+    out << buffer;
+}
+
+/// \brief Parse four hex digits
+bool ParseHex4(const std::string& text, const size_t pos, unsigned& value)
+{
+    if (pos + 4 > text.size())
+    {
+        return false;
+    }
+    value = 0;
+    for (size_t i = pos; i < pos + 4; ++i)
+    {
+        const char c = text[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9')
+        {
+            value |= static_cast<unsigned>(c - '0');
+        }
+        else if (c >= 'a' && c <= 'f')
+        {
+            value |= static_cast<unsigned>(c - 'a' + 10);
+        }
+        else if (c >= 'A' && c <= 'F')
+        {
+            value |= static_cast<unsigned>(c - 'A' + 10);
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace
+
+namespace bbfm {
+JsonValue JsonValue::MakeArray()
+{
+    JsonValue value;
+    value.kind_ = Kind::ARRAY;
+    return value;
+}
+
+JsonValue JsonValue::MakeObject()
+{
+    JsonValue value;
+    value.kind_ = Kind::OBJECT;
+    return value;
+}
+
+JsonValue::Kind JsonValue::GetKind() const
+{
+    return kind_;
+}
+
+bool JsonValue::IsNull() const
+{
+    return Kind::NUL == kind_;
+}
+
+bool JsonValue::AsBool() const
+{
+    return Kind::BOOL == kind_ && bool_;
+}
+
+int JsonValue::AsInt() const
+{
+    return Kind::NUMBER == kind_ ? static_cast<int>(number_) : 0;
+}
+
+double JsonValue::AsNumber() const
+{
+    return Kind::NUMBER == kind_ ? number_ : 0.0;
+}
+
+const std::string& JsonValue::AsString() const
+{
+    static const std::string empty;
+    return Kind::STRING == kind_ ? string_ : empty;
+}
+
+const std::vector<JsonValue>& JsonValue::GetItems() const
+{
+    return items_;
+}
+
+void JsonValue::Append(JsonValue item)
+{
+    kind_ = Kind::ARRAY;
+    items_.push_back(std::move(item));
+}
+
+const JsonValue& JsonValue::operator[](const std::string& key) const
+{
+    static const JsonValue null;
+    auto                   it = members_.find(key);
+    return members_.end() == it ? null : it->second;
+}
+
+JsonValue& JsonValue::Set(const std::string& key, JsonValue value)
+{
+    kind_         = Kind::OBJECT;
+    members_[key] = std::move(value);
+    return *this;
+}
+
+std::string JsonValue::Serialize() const
+{
+    OutputBuffer out;
+    SerializeTo(out);
+    return out.TakeText();
+}
+
+void JsonValue::SerializeTo(OutputBuffer& out) const
+{
+    switch (kind_)
+    {
+        case Kind::NUL:
+            out << "null";
+            break;
+        case Kind::BOOL:
+            out << (bool_ ? "true" : "false");
+            break;
+        case Kind::NUMBER:
+            AppendNumber(out, number_);
+            break;
+        case Kind::STRING:
+            AppendString(out, string_);
+            break;
+        case Kind::ARRAY:
+            out << '[';
+            for (size_t i = 0; i < items_.size(); ++i)
+            {
+                if (i > 0)
+                {
+                    out << ',';
+                }
+                items_[i].SerializeTo(out);
+            }
+            out << ']';
+            break;
+        case Kind::OBJECT:
+        {
+            out << '{';
+            bool first = true;
+            for (const auto& member : members_)
+            {
+                if (!first)
+                {
+                    out << ',';
+                }
+                first = false;
+                AppendString(out, member.first);
+                out << ':';
+                member.second.SerializeTo(out);
+            }
+            out << '}';
+            break;
+        }
+    }
+}
+
+bool JsonValue::Parse(const std::string& text, JsonValue& value)
+{
+    size_t pos = 0;
+    if (!ParseValue(text, pos, value, 0))
+    {
+        return false;
+    }
+    SkipWhitespace(text, pos);
+    return pos == text.size();
+}
+
+bool JsonValue::ParseValue(const std::string& text, size_t& pos, JsonValue& value, const int depth)
+{
+    SkipWhitespace(text, pos);
+    if (pos >= text.size() || depth > MAX_DEPTH)
+    {
+        return false;
+    }
+
+    const char c = text[pos];
+    if ('{' == c)
+    {
+        value = MakeObject();
+        ++pos;
+        SkipWhitespace(text, pos);
+        if (pos < text.size() && '}' == text[pos])
+        {
+            ++pos;
+            return true;
+        }
+        for (;;)
+        {
+            std::string key;
+            JsonValue   member;
+            SkipWhitespace(text, pos);
+            if (!ParseString(text, pos, key))
+            {
+                return false;
+            }
+            SkipWhitespace(text, pos);
+            if (pos >= text.size() || ':' != text[pos])
+            {
+                return false;
+            }
+            ++pos;
+            if (!ParseValue(text, pos, member, depth + 1))
+            {
+                return false;
+            }
+            value.members_[key] = std::move(member);
+            SkipWhitespace(text, pos);
+            if (pos < text.size() && ',' == text[pos])
+            {
+                ++pos;
+                continue;
+            }
+            if (pos < text.size() && '}' == text[pos])
+            {
+                ++pos;
+                return true;
+            }
+            return false;
+        }
+    }
+    if ('[' == c)
+    {
+        value = MakeArray();
+        ++pos;
+        SkipWhitespace(text, pos);
+        if (pos < text.size() && ']' == text[pos])
+        {
+            ++pos;
+            return true;
+        }
+        for (;;)
+        {
+            JsonValue item;
+            if (!ParseValue(text, pos, item, depth + 1))
+            {
+                return false;
+            }
+            value.items_.push_back(std::move(item));
+            SkipWhitespace(text, pos);
+            if (pos < text.size() && ',' == text[pos])
+            {
+                ++pos;
+                continue;
+            }
+            if (pos < text.size() && ']' == text[pos])
+            {
+                ++pos;
+                return true;
+            }
+            return false;
+        }
+    }
+    if ('"' == c)
+    {
+        std::string string;
+        if (!ParseString(text, pos, string))
+        {
+            return false;
+        }
+        value = JsonValue(string);
+        return true;
+    }
+    if (0 == text.compare(pos, 4, "true"))
+    {
+        pos += 4;
+        value = JsonValue(true);
+        return true;
+    }
+    if (0 == text.compare(pos, 5, "false"))
+    {
+        pos += 5;
+        value = JsonValue(false);
+        return true;
+    }
+    if (0 == text.compare(pos, 4, "null"))
+    {
+        pos += 4;
+        value = JsonValue();
+        return true;
+    }
+
+    // Number
+    const char*  start  = text.c_str() + pos;
+    char*        end    = nullptr;
+    const double number = strtod(start, &end);
+    if (end == start)
+    {
+        return false;
+    }
+    pos += static_cast<size_t>(end - start);
+    value = JsonValue(number);
+    return true;
+}
+
+bool JsonValue::ParseString(const std::string& text, size_t& pos, std::string& value)
+{
+    if (pos >= text.size() || '"' != text[pos])
+    {
+        return false;
+    }
+    ++pos;
+    value.clear();
+    while (pos < text.size())
+    {
+        const char c = text[pos++];
+        if ('"' == c)
+        {
+            return true;
+        }
+        if ('\\' != c)
+        {
+            value += c;
+            continue;
+        }
+        if (pos >= text.size())
+        {
+            return false;
+        }
+        const char escape = text[pos++];
+        switch (escape)
+        {
+            case '"':
+            case '\\':
+            case '/':
+                value += escape;
+                break;
+            case 'b':
+                value += '\b';
+                break;
+            case 'f':
+                value += '\f';
+                break;
+            case 'n':
+                value += '\n';
+                break;
+            case 'r':
+                value += '\r';
+                break;
+            case 't':
+                value += '\t';
+                break;
+            case 'u':
+            {
+                unsigned codePoint = 0;
+                if (!ParseHex4(text, pos, codePoint))
+                {
+                    return false;
+                }
+                pos += 4;
+
+                // Combine a UTF-16 surrogate pair
+                unsigned low = 0;
+                if (codePoint >= 0xD800 && codePoint < 0xDC00 && 0 == text.compare(pos, 2, "\\u") && ParseHex4(text, pos + 2, low) && low >= 0xDC00 &&
+                    low < 0xE000)
+                {
+                    codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                    pos += 6;
+                }
+                AppendUtf8(value, codePoint);
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return false;
+}
+
+JsonWriter::JsonWriter(OutputBuffer& out, const size_t indent) : out_(out), afterKey_(false), indent_(indent)
+{
+}
+
+void JsonWriter::BeforeValue()
+{
+    if (afterKey_)
+    {
+        afterKey_ = false;
+        return;
+    }
+    if (false == hasItems_.empty())
+    {
+        if (hasItems_.back())
+        {
+            out_ << ',';
+        }
+        hasItems_.back() = true;
+        NewLine(hasItems_.size());
+    }
+}
+
+void JsonWriter::NewLine(const size_t depth)
+{
+    if (indent_ > 0)
+    {
+        out_ << '\n';
+        out_.AppendRepeated(depth * indent_, ' ');
+    }
+}
+
+JsonWriter& JsonWriter::BeginObject()
+{
+    BeforeValue();
+    out_ << '{';
+    hasItems_.push_back(false);
+    return *this;
+}
+
+JsonWriter& JsonWriter::EndObject()
+{
+    const bool hasItems = hasItems_.back();
+    hasItems_.pop_back();
+    if (hasItems)
+    {
+        NewLine(hasItems_.size());
+    }
+    out_ << '}';
+    return *this;
+}
+
+JsonWriter& JsonWriter::BeginArray()
+{
+    BeforeValue();
+    out_ << '[';
+    hasItems_.push_back(false);
+    return *this;
+}
+
+JsonWriter& JsonWriter::EndArray()
+{
+    const bool hasItems = hasItems_.back();
+    hasItems_.pop_back();
+    if (hasItems)
+    {
+        NewLine(hasItems_.size());
+    }
+    out_ << ']';
+    return *this;
+}
+
+JsonWriter& JsonWriter::Key(const char* key)
+{
+    BeforeValue();
+    AppendString(out_, key);
+    out_ << ((indent_ > 0) ? ": " : ":");
+    afterKey_ = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::String(const std::string& value)
+{
+    BeforeValue();
+    AppendString(out_, value);
+    return *this;
+}
+
+JsonWriter& JsonWriter::Number(const double value)
+{
+    BeforeValue();
+    AppendNumber(out_, value);
+    return *this;
+}
+
+JsonWriter& JsonWriter::Integer(const long long value)
+{
+    BeforeValue();
+    out_ << value;
+    return *this;
+}
+
+JsonWriter& JsonWriter::Bool(const bool value)
+{
+    BeforeValue();
+    out_ << (value ? "true" : "false");
+    return *this;
+}
+
+JsonWriter& JsonWriter::Null()
+{
+    BeforeValue();
+    out_ << "null";
+    return *this;
+}
+} // namespace bbfm
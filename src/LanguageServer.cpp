@@ -0,0 +1,1095 @@
+#include "LanguageServer.h"
+#include "Common.h"
+#include "Diagnostics.h"
+#include "Driver.h"
+#include "SemanticAnalyzer.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <strings.h>
+
+namespace {
+// JSON-RPC error codes
+const int PARSE_ERROR      = -32700;
+const int INVALID_REQUEST  = -32600;
+const int METHOD_NOT_FOUND = -32601;
+
+// LSP enumerations
+const int SYNC_INCREMENTAL       = 2;
+const int SEVERITY_ERROR         = 1;
+const int SEVERITY_WARNING       = 2;
+const int SEVERITY_INFORMATION   = 3;
+const int COMPLETION_FUNCTION    = 3;
+const int COMPLETION_FIELD       = 5;
+const int COMPLETION_CLASS       = 7;
+const int COMPLETION_KEYWORD     = 14;
+const int COMPLETION_ENUM        = 13;
+const int COMPLETION_ENUM_MEMBER = 20;
+
+bool IsIdentifierChar(const char c)
+{
+    return 0 != isalnum(static_cast<unsigned char>(c)) || '_' == c;
+}
+
+/// \brief Find the identifier touching a column
+/// \return False if there is no identifier at the column
+bool WordAt(const std::string& text, const int character, int& start, int& end)
+{
+    const int size = static_cast<int>(text.size());
+    start          = std::min(std::max(character, 0), size);
+    end            = start;
+    while (start > 0 && IsIdentifierChar(text[start - 1]))
+    {
+        --start;
+    }
+    while (end < size && IsIdentifierChar(text[end]))
+    {
+        ++end;
+    }
+    return start < end && 0 == isdigit(static_cast<unsigned char>(text[start]));
+}
+
+/// \brief Find the '.' before a column, skipping blanks
+/// \return Column of the '.' or -1
+int DotBefore(const std::string& text, int column)
+{
+    while (column > 0 && ' ' == text[column - 1])
+    {
+        --column;
+    }
+    return (column > 0 && '.' == text[column - 1]) ? column - 1 : -1;
+}
+
+void SplitLines(const std::string& text, std::vector<std::string>& lines)
+{
+    lines.clear();
+    std::istringstream stream(text);
+    std::string        line;
+    while (std::getline(stream, line))
+    {
+        lines.push_back(line);
+    }
+}
+
+/// \brief Convert a UTF-16 column to a byte column
+/// \return Byte column of the character, or the size of the line past its end
+int Utf16ToByteColumn(const std::string& text, const int units)
+{
+    int    counted = 0;
+    size_t column  = 0;
+    while (column < text.size() && counted < units)
+    {
+        // A 4-byte sequence is a surrogate pair in UTF-16
+        const unsigned char lead = static_cast<unsigned char>(text[column]);
+        counted += (lead >= 0xF0) ? 2 : 1;
+        ++column;
+        while (column < text.size() && 0x80 == (static_cast<unsigned char>(text[column]) & 0xC0))
+        {
+            ++column;
+        }
+    }
+    return static_cast<int>(column);
+}
+
+/// \brief Convert a byte column to a UTF-16 column
+int ByteToUtf16Column(const std::string& text, const int column)
+{
+    int units = 0;
+    for (size_t i = 0; i < text.size() && i < static_cast<size_t>(std::max(column, 0)); ++i)
+    {
+        const unsigned char c = static_cast<unsigned char>(text[i]);
+        if (0x80 != (c & 0xC0))
+        {
+            units += (c >= 0xF0) ? 2 : 1;
+        }
+    }
+    // Columns past the end of the line (e.g., a missing token at end of line) keep their distance
+    return units + std::max(column - static_cast<int>(text.size()), 0);
+}
+
+int CountLines(const std::string& text)
+{
+    return static_cast<int>(std::count(text.begin(), text.end(), '\n'));
+}
+
+void IndexDeclarations(bbfm::LspDocument& document)
+{
+    document.classes.clear();
+    document.enums.clear();
+    document.indexed = true;
+    for (const auto& decl : document.ast->GetDeclarations())
+    {
+        if (nullptr != decl->AsClass())
+        {
+            document.classes.emplace(decl->AsClass()->GetName(), decl->AsClass());
+        }
+        else if (nullptr != decl->AsEnum())
+        {
+            document.enums.emplace(decl->AsEnum()->GetName(), decl->AsEnum());
+        }
+    }
+}
+
+bbfm::JsonValue MakeCompletionItem(const std::string& label, const int kind, const std::string& detail)
+{
+    bbfm::JsonValue item = bbfm::JsonValue::MakeObject();
+    item.Set("label", label).Set("kind", kind);
+    if (false == detail.empty())
+    {
+        item.Set("detail", detail);
+    }
+    return item;
+}
+} // namespace
+
+namespace bbfm {
+LanguageServer::LanguageServer(std::istream& in, std::ostream& out, const std::string& classPrefix) :
+    in_(in), out_(out.rdbuf()), classPrefix_(classPrefix), utf8Positions_(false), shutdownRequested_(false)
+{
+}
+
+int LanguageServer::Run()
+{
+    // Keep stray status output off the protocol stream
+    std::streambuf* savedOut = std::cout.rdbuf(std::cerr.rdbuf());
+
+    std::string body;
+    bool        exitRequested = false;
+    while (!exitRequested && ReadMessage(body))
+    {
+        JsonValue message;
+        if (!JsonValue::Parse(body, message) || JsonValue::Kind::OBJECT != message.GetKind())
+        {
+            RespondError(JsonValue(), PARSE_ERROR, "Invalid JSON message");
+            continue;
+        }
+        exitRequested = HandleMessage(message);
+    }
+
+    std::cout.rdbuf(savedOut);
+    return shutdownRequested_ ? 0 : 1;
+}
+
+bool LanguageServer::ReadMessage(std::string& body)
+{
+    // Headers end with an empty line, only Content-Length is used
+    size_t      contentLength = 0;
+    bool        hasLength     = false;
+    std::string header;
+    for (;;)
+    {
+        if (!std::getline(in_, header))
+        {
+            return false;
+        }
+        if (false == header.empty() && '\r' == header.back())
+        {
+            header.pop_back();
+        }
+        if (header.empty())
+        {
+            if (hasLength)
+            {
+                break;
+            }
+            continue;
+        }
+        if (0 == strncasecmp(header.c_str(), "Content-Length:", 15))
+        {
+            contentLength = strtoul(header.c_str() + 15, nullptr, 10);
+            hasLength     = true;
+        }
+    }
+
+    body.assign(contentLength, '\0');
+    in_.read(&body[0], static_cast<std::streamsize>(contentLength));
+    return static_cast<size_t>(in_.gcount()) == contentLength;
+}
+
+void LanguageServer::Send(const JsonValue& message)
+{
+    const std::string body = message.Serialize();
+    out_ << "Content-Length: " << body.size() << "\r\n\r\n" << body << std::flush;
+}
+
+void LanguageServer::Respond(const JsonValue& id, JsonValue result)
+{
+    JsonValue response = JsonValue::MakeObject();
+    response.Set("jsonrpc", "2.0").Set("id", id).Set("result", std::move(result));
+    Send(response);
+}
+
+void LanguageServer::RespondError(const JsonValue& id, const int code, const std::string& message)
+{
+    JsonValue error = JsonValue::MakeObject();
+    error.Set("code", code).Set("message", message);
+
+    JsonValue response = JsonValue::MakeObject();
+    response.Set("jsonrpc", "2.0").Set("id", id).Set("error", std::move(error));
+    Send(response);
+}
+
+bool LanguageServer::HandleMessage(const JsonValue& message)
+{
+    const std::string& method    = message["method"].AsString();
+    const JsonValue&   id        = message["id"];
+    const JsonValue&   params    = message["params"];
+    const bool         isRequest = !id.IsNull();
+
+    // Replies to server-initiated requests are not used
+    if (method.empty())
+    {
+        if (isRequest && message["result"].IsNull() && message["error"].IsNull())
+        {
+            RespondError(id, INVALID_REQUEST, "Missing method");
+        }
+        return false;
+    }
+
+    if ("initialize" == method)
+    {
+        // Columns count UTF-16 code units unless the client accepts byte columns
+        utf8Positions_ = false;
+        for (const auto& encoding : params["capabilities"]["general"]["positionEncodings"].GetItems())
+        {
+            utf8Positions_ = utf8Positions_ || "utf-8" == encoding.AsString();
+        }
+
+        JsonValue completion = JsonValue::MakeObject();
+        JsonValue triggers   = JsonValue::MakeArray();
+        triggers.Append(".");
+        completion.Set("triggerCharacters", std::move(triggers));
+
+        JsonValue capabilities = JsonValue::MakeObject();
+        capabilities.Set("positionEncoding", utf8Positions_ ? "utf-8" : "utf-16")
+            .Set("textDocumentSync", SYNC_INCREMENTAL)
+            .Set("definitionProvider", true)
+            .Set("hoverProvider", true)
+            .Set("completionProvider", std::move(completion));
+
+        JsonValue serverInfo = JsonValue::MakeObject();
+        serverInfo.Set("name", "model-compiler").Set("version", BBFM_COMPILER_VERSION);
+
+        JsonValue result = JsonValue::MakeObject();
+        result.Set("capabilities", std::move(capabilities)).Set("serverInfo", std::move(serverInfo));
+        Respond(id, std::move(result));
+        return false;
+    }
+    if ("shutdown" == method)
+    {
+        shutdownRequested_ = true;
+        Respond(id, JsonValue());
+        return false;
+    }
+    if ("exit" == method)
+    {
+        return true;
+    }
+
+    const JsonValue&   textDocument = params["textDocument"];
+    const std::string& uri          = textDocument["uri"].AsString();
+    if ("textDocument/didOpen" == method)
+    {
+        LspDocument&       document = documents_[uri];
+        const std::string& text     = textDocument["text"].AsString();
+        document.parser.Edit(0, document.text.size(), text.size(), CountLines(text) - CountLines(document.text));
+        document.ast     = nullptr;
+        document.uri     = uri;
+        document.path    = UriToPath(uri);
+        document.text    = text;
+        document.version = textDocument["version"].AsInt();
+        SplitLines(document.text, document.lines);
+        Compile(document);
+        return false;
+    }
+    if ("textDocument/didChange" == method)
+    {
+        auto it = documents_.find(uri);
+        if (documents_.end() != it)
+        {
+            for (const auto& change : params["contentChanges"].GetItems())
+            {
+                ApplyChange(it->second, change);
+            }
+            it->second.version = textDocument["version"].AsInt();
+            Compile(it->second);
+        }
+        return false;
+    }
+    if ("textDocument/didClose" == method)
+    {
+        documents_.erase(uri);
+
+        JsonValue clear = JsonValue::MakeObject();
+        clear.Set("uri", uri).Set("diagnostics", JsonValue::MakeArray());
+
+        JsonValue notification = JsonValue::MakeObject();
+        notification.Set("jsonrpc", "2.0").Set("method", "textDocument/publishDiagnostics").Set("params", std::move(clear));
+        Send(notification);
+        return false;
+    }
+
+    if ("textDocument/definition" == method || "textDocument/hover" == method || "textDocument/completion" == method)
+    {
+        auto it = documents_.find(uri);
+        if (documents_.end() == it || nullptr == it->second.ast)
+        {
+            Respond(id, "textDocument/completion" == method ? JsonValue::MakeArray() : JsonValue());
+            return false;
+        }
+        if (!it->second.indexed)
+        {
+            IndexDeclarations(it->second);
+        }
+
+        const int line      = params["position"]["line"].AsInt();
+        const int character = ToByteColumn(it->second, line, params["position"]["character"].AsInt());
+        if ("textDocument/definition" == method)
+        {
+            Respond(id, Definition(it->second, line, character));
+        }
+        else if ("textDocument/hover" == method)
+        {
+            Respond(id, Hover(it->second, line, character));
+        }
+        else
+        {
+            Respond(id, Completion(it->second, line, character));
+        }
+        return false;
+    }
+
+    // Unknown notifications (e.g., initialized, didSave, $/cancelRequest) are ignored
+    if (isRequest)
+    {
+        RespondError(id, METHOD_NOT_FOUND, "Unsupported method '" + method + "'");
+    }
+    return false;
+}
+
+void LanguageServer::ApplyChange(LspDocument& document, const JsonValue& change) const
+{
+    std::string&              text  = document.text;
+    std::vector<std::string>& lines = document.lines;
+    const JsonValue&          range = change["range"];
+    if (range.IsNull())
+    {
+        const std::string& replacement = change["text"].AsString();
+        document.parser.Edit(0, text.size(), replacement.size(), CountLines(replacement) - CountLines(text));
+        text = replacement;
+        SplitLines(text, lines);
+        return;
+    }
+
+    // SplitLines() drops the empty line after a final newline, every line ends at a '\n' here
+    if (text.empty() || '\n' == text.back())
+    {
+        lines.emplace_back();
+    }
+
+    // Convert both positions to a line, a column and an offset into the text
+    size_t lineIndex[2] = {0, 0};
+    size_t columns[2]   = {0, 0};
+    size_t offsets[2]   = {0, 0};
+    for (int i = 0; i < 2; ++i)
+    {
+        const JsonValue& position = range[0 == i ? "start" : "end"];
+        const size_t     line     = static_cast<size_t>(std::max(position["line"].AsInt(), 0));
+        lineIndex[i]              = std::min(line, lines.size() - 1);
+        columns[i]                = (line < lines.size()) ? static_cast<size_t>(ToByteColumn(document, static_cast<int>(line), position["character"].AsInt()))
+                                                          : lines.back().size();
+        for (size_t previous = 0; previous < lineIndex[i]; ++previous)
+        {
+            offsets[i] += lines[previous].size() + 1;
+        }
+        offsets[i] += columns[i];
+    }
+
+    if (offsets[1] < offsets[0])
+    {
+        std::swap(lineIndex[0], lineIndex[1]);
+        std::swap(columns[0], columns[1]);
+        std::swap(offsets[0], offsets[1]);
+    }
+
+    const std::string& replacement = change["text"].AsString();
+    document.parser.Edit(offsets[0], offsets[1] - offsets[0], replacement.size(),
+                         CountLines(replacement) - static_cast<int>(lineIndex[1] - lineIndex[0]));
+    text.replace(offsets[0], offsets[1] - offsets[0], replacement);
+
+    // Only the edited lines are split again
+    const std::string        edited = lines[lineIndex[0]].substr(0, columns[0]) + replacement + lines[lineIndex[1]].substr(columns[1]);
+    std::vector<std::string> editedLines(1);
+    for (const char c : edited)
+    {
+        if ('\n' == c)
+        {
+            editedLines.emplace_back();
+        }
+        else
+        {
+            editedLines.back().push_back(c);
+        }
+    }
+    if (editedLines.size() == lineIndex[1] - lineIndex[0] + 1)
+    {
+        std::move(editedLines.begin(), editedLines.end(), lines.begin() + static_cast<std::ptrdiff_t>(lineIndex[0]));
+    }
+    else
+    {
+        lines.erase(lines.begin() + static_cast<std::ptrdiff_t>(lineIndex[0]), lines.begin() + static_cast<std::ptrdiff_t>(lineIndex[1]) + 1);
+        lines.insert(lines.begin() + static_cast<std::ptrdiff_t>(lineIndex[0]), std::make_move_iterator(editedLines.begin()),
+                     std::make_move_iterator(editedLines.end()));
+    }
+    if (lines.back().empty())
+    {
+        lines.pop_back();
+    }
+}
+
+void LanguageServer::Compile(LspDocument& document)
+{
+    // Compile with captured output, the errors become diagnostics
+    std::ostringstream status;
+    std::ostringstream errors;
+    std::streambuf*    savedOut = std::cout.rdbuf(status.rdbuf());
+    std::streambuf*    savedErr = std::cerr.rdbuf(errors.rdbuf());
+
+    std::vector<Diagnostic> reported;
+    {
+        // All errors are published; the records are taken before the session ends, so it writes nothing
+        DiagnosticSession diagnostics(DiagnosticFormat::TEXT, 0);
+        Driver            driver({document.path}, classPrefix_);
+        if (document.parser.Parse(document.path, document.text))
+        {
+            // Declarations are indexed when a request needs them, not on every keystroke
+            document.ast     = document.parser.GetAst();
+            document.indexed = false;
+
+            // Imported files are read from disk and parsed if they changed, their errors are reported at the imports
+            if (driver.LoadImports(document.path, document.ast, document.imports, &imports_))
+            {
+                driver.Phase1(document.ast, &document.queries, &document.imports);
+            }
+        }
+        else
+        {
+            // As in a CLI compile, the whole text is parsed with error recovery (reporting the syntax errors again) and its
+            // intact declarations are analyzed. The recovered AST only yields diagnostics: requests keep the last AST that
+            // parsed, and the caches keep its queries.
+            Diagnostics::TakeBuffered();
+            size_t               syntaxErrors = 0;
+            std::unique_ptr<AST> recovered    = driver.ParsePartial(document.path, document.text, 1, syntaxErrors);
+            ModuleAsts           imports;
+            if (nullptr != recovered && driver.LoadImports(document.path, recovered.get(), imports, &imports_))
+            {
+                driver.Phase1(recovered.get(), nullptr, &imports);
+            }
+        }
+        reported = Diagnostics::TakeBuffered();
+    }
+
+    std::cout.rdbuf(savedOut);
+    std::cerr.rdbuf(savedErr);
+
+    JsonValue params = JsonValue::MakeObject();
+    params.Set("uri", document.uri).Set("version", document.version).Set("diagnostics", CollectDiagnostics(document, reported, errors.str()));
+
+    JsonValue notification = JsonValue::MakeObject();
+    notification.Set("jsonrpc", "2.0").Set("method", "textDocument/publishDiagnostics").Set("params", std::move(params));
+    Send(notification);
+}
+
+JsonValue LanguageServer::CollectDiagnostics(const LspDocument& document, const std::vector<Diagnostic>& diagnostics, const std::string& strayErrors) const
+{
+    JsonValue items = JsonValue::MakeArray();
+    auto      add   = [&items](JsonValue range, const int severity, const std::string& message)
+    {
+        JsonValue item = JsonValue::MakeObject();
+        item.Set("range", std::move(range)).Set("severity", severity).Set("source", "model-compiler").Set("message", message);
+        items.Append(std::move(item));
+    };
+
+    for (const Diagnostic& diagnostic : diagnostics)
+    {
+        // Without a location (e.g., an unreadable file) a diagnostic is shown at the start of the document
+        JsonValue  range   = MakeRange(0, 0, 0);
+        const bool located = (false == diagnostic.file.empty() && 0 != diagnostic.line);
+        if (located && diagnostic.file != document.path)
+        {
+            // An error in an imported file is shown at the document's first import
+            if (nullptr != document.ast && false == document.ast->GetImports().empty())
+            {
+                const ImportDeclaration* import = document.ast->GetImports()[0].get();
+                const int                line   = std::max(import->GetLine() - 1, 0);
+                const int                column = std::max(import->GetColumn() - 1, 0);
+                range = MakeRange(line, ToCharacter(document, line, column), ToCharacter(document, line, column + static_cast<int>(import->GetPath().size()) + 2));
+            }
+        }
+        else if (located)
+        {
+            range = TokenRange(document, diagnostic.line - 1, std::max(diagnostic.column - 1, 0));
+        }
+
+        int severity = SEVERITY_ERROR;
+        switch (diagnostic.severity)
+        {
+            case Diagnostic::Severity::NOTE:
+                severity = SEVERITY_INFORMATION;
+                break;
+            case Diagnostic::Severity::WARNING:
+                severity = SEVERITY_WARNING;
+                break;
+            case Diagnostic::Severity::ERROR:
+                severity = SEVERITY_ERROR;
+                break;
+        }
+        add(std::move(range), severity, diagnostic.message);
+    }
+
+    // Text written to stderr directly (e.g., an unreadable file) has no location
+    std::istringstream stream(strayErrors);
+    std::string        line;
+    while (std::getline(stream, line))
+    {
+        if (false == line.empty())
+        {
+            add(MakeRange(0, 0, 0), SEVERITY_ERROR, line);
+        }
+    }
+    return items;
+}
+
+JsonValue LanguageServer::TokenRange(const LspDocument& document, const int line, const int column) const
+{
+    int end = column + 1;
+    if (line < static_cast<int>(document.lines.size()))
+    {
+        int                wordStart = 0;
+        int                wordEnd   = 0;
+        const std::string& lineText  = document.lines[line];
+        if (WordAt(lineText, column, wordStart, wordEnd) && wordStart == column)
+        {
+            end = wordEnd;
+        }
+        else if (column < static_cast<int>(lineText.size()) && '"' == lineText[column])
+        {
+            // A string literal, e.g., the path of an import
+            const size_t close = lineText.find('"', static_cast<size_t>(column) + 1);
+            end                = (std::string::npos == close) ? end : static_cast<int>(close) + 1;
+        }
+    }
+    return MakeRange(line, ToCharacter(document, line, column), ToCharacter(document, line, end));
+}
+
+JsonValue LanguageServer::Definition(const LspDocument& document, const int line, const int character) const
+{
+    const ClassDeclaration* owner = nullptr;
+    const ASTNode*          node  = Resolve(document, line, character, owner);
+    if (nullptr == node)
+    {
+        return JsonValue();
+    }
+
+    std::string name;
+    if (nullptr != dynamic_cast<const ClassDeclaration*>(node))
+    {
+        name = static_cast<const ClassDeclaration*>(node)->GetName();
+    }
+    else if (nullptr != dynamic_cast<const EnumDeclaration*>(node))
+    {
+        name = static_cast<const EnumDeclaration*>(node)->GetName();
+    }
+    else if (nullptr != dynamic_cast<const Field*>(node))
+    {
+        name = static_cast<const Field*>(node)->GetName();
+    }
+    else
+    {
+        name = static_cast<const Invariant*>(node)->GetName();
+    }
+
+    JsonValue location = JsonValue::MakeObject();
+    location.Set("uri", document.uri).Set("range", NameRange(document, node, name));
+    return location;
+}
+
+JsonValue LanguageServer::Hover(const LspDocument& document, const int line, const int character) const
+{
+    const ClassDeclaration* owner = nullptr;
+    const ASTNode*          node  = Resolve(document, line, character, owner);
+    if (nullptr == node)
+    {
+        return JsonValue();
+    }
+
+    std::ostringstream text;
+    text << "```\n";
+    const ClassDeclaration* classDecl = dynamic_cast<const ClassDeclaration*>(node);
+    const EnumDeclaration*  enumDecl  = dynamic_cast<const EnumDeclaration*>(node);
+    const Field*            field     = dynamic_cast<const Field*>(node);
+    const Invariant*        invariant = dynamic_cast<const Invariant*>(node);
+    if (nullptr != field)
+    {
+        text << FieldToString(field) << "\n```\n";
+        text << "Declared in class `" << owner->GetName() << "`";
+
+        // Show the resolved chain of a class-typed field
+        auto it = document.classes.find(SemanticAnalyzer::TypeSpecToName(field->GetType()));
+        if (document.classes.end() != it)
+        {
+            classDecl = it->second;
+            text << "\n\n```\n";
+        }
+    }
+    else if (nullptr != invariant)
+    {
+        text << "invariant " << invariant->GetName() << ": " << (nullptr != invariant->GetExpression() ? invariant->GetExpression()->ToString() : "")
+             << "\n```\n";
+        text << "Declared in class `" << owner->GetName() << "`";
+    }
+    else if (nullptr != enumDecl)
+    {
+        text << "enum " << enumDecl->GetName() << " {";
+        const std::vector<std::string>& values = enumDecl->GetValues();
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            text << (0 == i ? " " : ", ") << values[i];
+        }
+        text << " }\n```";
+    }
+
+    // A class with all fields it inherits
+    if (nullptr != classDecl)
+    {
+        text << "class " << classDecl->GetName();
+        if (classDecl->HasExplicitBase())
+        {
+            text << " inherits " << classDecl->GetBaseType();
+        }
+        text << " {\n";
+        for (const ClassDeclaration* chainClass : ClassChain(document, classDecl))
+        {
+            for (const auto& chainField : chainClass->GetFields())
+            {
+                text << "    " << FieldToString(chainField.get()) << ";";
+                if (chainClass != classDecl)
+                {
+                    text << " // from " << chainClass->GetName();
+                }
+                text << "\n";
+            }
+        }
+        text << "}\n```";
+    }
+
+    JsonValue contents = JsonValue::MakeObject();
+    contents.Set("kind", "markdown").Set("value", text.str());
+
+    JsonValue hover = JsonValue::MakeObject();
+    hover.Set("contents", std::move(contents));
+    return hover;
+}
+
+JsonValue LanguageServer::Completion(const LspDocument& document, const int line, const int character) const
+{
+    JsonValue items = JsonValue::MakeArray();
+    if (line < 0 || line >= static_cast<int>(document.lines.size()))
+    {
+        return items;
+    }
+
+    // Text before the cursor without the identifier being typed
+    const std::string& text  = document.lines[line];
+    int                start = std::min(std::max(character, 0), static_cast<int>(text.size()));
+    while (start > 0 && IsIdentifierChar(text[start - 1]))
+    {
+        --start;
+    }
+    const std::string prefix = text.substr(0, start);
+
+    // Member access: fields of the receiver's class
+    const int dot = DotBefore(text, start);
+    if (dot >= 0)
+    {
+        const ClassDeclaration* receiver = ResolveReceiver(document, line, dot);
+        if (nullptr != receiver)
+        {
+            for (const ClassDeclaration* chainClass : ClassChain(document, receiver))
+            {
+                for (const auto& field : chainClass->GetFields())
+                {
+                    items.Append(MakeCompletionItem(field->GetName(), COMPLETION_FIELD, FieldToString(field.get())));
+                }
+            }
+            std::set<std::string> universalFields;
+            SemanticAnalyzer::AddUniversalFieldNames(universalFields);
+            for (const auto& name : universalFields)
+            {
+                items.Append(MakeCompletionItem(name, COMPLETION_FIELD, std::string(SemanticAnalyzer::UniversalFieldTypeName(name)) + " (universal)"));
+            }
+        }
+        return items;
+    }
+
+    // Type position: after "feature name:" or "inherits"
+    static const std::regex featureType("feature\\s+\\w+\\s*:\\s*$");
+    static const std::regex baseType("inherits\\s*$");
+    const bool              isBaseType = std::regex_search(prefix, baseType);
+    if (isBaseType || std::regex_search(prefix, featureType))
+    {
+        for (const auto& entry : document.classes)
+        {
+            items.Append(MakeCompletionItem(entry.first, COMPLETION_CLASS, "class"));
+        }
+        if (!isBaseType)
+        {
+            for (const auto& entry : document.enums)
+            {
+                items.Append(MakeCompletionItem(entry.first, COMPLETION_ENUM, "enum"));
+            }
+            for (const char* primitive : {"String", "Int", "Real", "Bool", "Timestamp", "Timespan", "Date", "Guid"})
+            {
+                items.Append(MakeCompletionItem(primitive, COMPLETION_KEYWORD, "primitive type"));
+            }
+        }
+        return items;
+    }
+
+    // Class body: members, expression functions and keywords
+    const ClassDeclaration* enclosing = EnclosingClass(document, line);
+    if (nullptr == enclosing)
+    {
+        items.Append(MakeCompletionItem("class", COMPLETION_KEYWORD, ""));
+        items.Append(MakeCompletionItem("enum", COMPLETION_KEYWORD, ""));
+        return items;
+    }
+
+    for (const ClassDeclaration* chainClass : ClassChain(document, enclosing))
+    {
+        for (const auto& field : chainClass->GetFields())
+        {
+            items.Append(MakeCompletionItem(field->GetName(), COMPLETION_FIELD, FieldToString(field.get())));
+        }
+    }
+    for (const auto& entry : document.enums)
+    {
+        for (const auto& value : entry.second->GetValues())
+        {
+            items.Append(MakeCompletionItem(value, COMPLETION_ENUM_MEMBER, entry.first));
+        }
+    }
+    for (const char* function : {"count", "sum", "matches"})
+    {
+        items.Append(MakeCompletionItem(function, COMPLETION_FUNCTION, ""));
+    }
+    for (const char* keyword : {"feature", "invariant", "forall", "exists", "in", "true", "false"})
+    {
+        items.Append(MakeCompletionItem(keyword, COMPLETION_KEYWORD, ""));
+    }
+    return items;
+}
+
+const ASTNode* LanguageServer::Resolve(const LspDocument& document, const int line, const int character, const ClassDeclaration*& owner)
+{
+    owner = nullptr;
+    int start = 0;
+    int end   = 0;
+    if (line < 0 || line >= static_cast<int>(document.lines.size()) || !WordAt(document.lines[line], character, start, end))
+    {
+        return nullptr;
+    }
+    const std::string word = document.lines[line].substr(start, end - start);
+
+    // Member of a dotted receiver
+    const int dot = DotBefore(document.lines[line], start);
+    if (dot >= 0)
+    {
+        const ClassDeclaration* receiver = ResolveReceiver(document, line, dot);
+        return (nullptr != receiver) ? FindField(document, receiver, word, owner) : nullptr;
+    }
+
+    // Type names
+    auto classIt = document.classes.find(word);
+    if (document.classes.end() != classIt)
+    {
+        return classIt->second;
+    }
+    auto enumIt = document.enums.find(word);
+    if (document.enums.end() != enumIt)
+    {
+        return enumIt->second;
+    }
+
+    // Fields and invariants of the enclosing class
+    const ClassDeclaration* enclosing = EnclosingClass(document, line);
+    if (nullptr == enclosing)
+    {
+        return nullptr;
+    }
+    const Field* field = FindField(document, enclosing, word, owner);
+    if (nullptr != field)
+    {
+        return field;
+    }
+    for (const ClassDeclaration* chainClass : ClassChain(document, enclosing))
+    {
+        for (const auto& invariant : chainClass->GetInvariants())
+        {
+            if (invariant->GetName() == word)
+            {
+                owner = chainClass;
+                return invariant.get();
+            }
+        }
+    }
+    return nullptr;
+}
+
+const ClassDeclaration* LanguageServer::ResolveReceiver(const LspDocument& document, const int line, const int dotColumn)
+{
+    const std::string& text = document.lines[line];
+    int                end  = dotColumn;
+    while (end > 0 && ' ' == text[end - 1])
+    {
+        --end;
+    }
+    int start = end;
+    while (start > 0 && IsIdentifierChar(text[start - 1]))
+    {
+        --start;
+    }
+    if (start == end)
+    {
+        return nullptr;
+    }
+    const std::string name = text.substr(start, end - start);
+
+    // The receiver is itself a member access, a quantifier variable or a field
+    const ClassDeclaration* scope     = nullptr;
+    const int               outerDot  = DotBefore(text, start);
+    std::smatch             match;
+    const std::string       before    = text.substr(0, start);
+    const std::regex        quantifier("(?:forall|exists)\\s+" + name + "\\s+in\\s+([A-Za-z_][A-Za-z0-9_]*(?:\\s*\\.\\s*[A-Za-z_][A-Za-z0-9_]*)*)");
+    if (outerDot >= 0)
+    {
+        scope = ResolveReceiver(document, line, outerDot);
+    }
+    else if (std::regex_search(before, match, quantifier))
+    {
+        // Walk the collection path from the enclosing class to the element type
+        const ClassDeclaration* element = EnclosingClass(document, line);
+        std::istringstream      path(match[1].str());
+        std::string             segment;
+        while (nullptr != element && std::getline(path, segment, '.'))
+        {
+            segment.erase(0, segment.find_first_not_of(" \t"));
+            segment.erase(segment.find_last_not_of(" \t") + 1);
+
+            const ClassDeclaration* owner = nullptr;
+            const Field*            field = FindField(document, element, segment, owner);
+            auto                    it    = (nullptr != field) ? document.classes.find(SemanticAnalyzer::TypeSpecToName(field->GetType()))
+                                                               : document.classes.end();
+            element                       = (document.classes.end() != it) ? it->second : nullptr;
+        }
+        return element;
+    }
+    else
+    {
+        scope = EnclosingClass(document, line);
+    }
+
+    if (nullptr == scope)
+    {
+        return nullptr;
+    }
+    const ClassDeclaration* owner = nullptr;
+    const Field*            field = FindField(document, scope, name, owner);
+    if (nullptr == field)
+    {
+        return nullptr;
+    }
+    auto it = document.classes.find(SemanticAnalyzer::TypeSpecToName(field->GetType()));
+    return (document.classes.end() != it) ? it->second : nullptr;
+}
+
+const ClassDeclaration* LanguageServer::EnclosingClass(const LspDocument& document, const int line)
+{
+    // A declaration extends to the next one, declarations are in source order
+    const ClassDeclaration* enclosing = nullptr;
+    for (const auto& decl : document.ast->GetDeclarations())
+    {
+        const ASTNode* node = (nullptr != decl->AsClass()) ? static_cast<const ASTNode*>(decl->AsClass()) : decl->AsEnum();
+        if (node->GetLine() - 1 > line)
+        {
+            break;
+        }
+        enclosing = decl->AsClass();
+    }
+    return enclosing;
+}
+
+std::vector<const ClassDeclaration*> LanguageServer::ClassChain(const LspDocument& document, const ClassDeclaration* classDecl)
+{
+    std::vector<const ClassDeclaration*> chain;
+    std::set<const ClassDeclaration*>    visited;
+    while (nullptr != classDecl && visited.insert(classDecl).second)
+    {
+        chain.insert(chain.begin(), classDecl);
+        auto it   = document.classes.find(classDecl->GetBaseType());
+        classDecl = (classDecl->HasExplicitBase() && document.classes.end() != it) ? it->second : nullptr;
+    }
+    return chain;
+}
+
+const Field* LanguageServer::FindField(const LspDocument& document, const ClassDeclaration* classDecl, const std::string& name, const ClassDeclaration*& owner)
+{
+    for (const ClassDeclaration* chainClass : ClassChain(document, classDecl))
+    {
+        for (const auto& field : chainClass->GetFields())
+        {
+            if (field->GetName() == name)
+            {
+                owner = chainClass;
+                return field.get();
+            }
+        }
+    }
+    return nullptr;
+}
+
+std::string LanguageServer::FieldToString(const Field* field)
+{
+    std::string text = "feature " + field->GetName() + ": " + SemanticAnalyzer::TypeSpecToName(field->GetType());
+
+    std::vector<std::string> modifiers;
+    for (const auto& modifier : field->GetModifiers())
+    {
+        const CardinalityModifier* cardinality = dynamic_cast<const CardinalityModifier*>(modifier.get());
+        const EncodingModifier*    encoding    = dynamic_cast<const EncodingModifier*>(modifier.get());
+        if (nullptr != cardinality)
+        {
+            // [1] is the default and not shown
+            if (cardinality->IsUnbounded())
+            {
+                modifiers.push_back(std::to_string(cardinality->GetMin()) + "..*");
+            }
+            else if (0 == cardinality->GetMin() && 1 == cardinality->GetMax())
+            {
+                modifiers.push_back("optional");
+            }
+            else if (cardinality->GetMin() == cardinality->GetMax())
+            {
+                if (1 != cardinality->GetMin())
+                {
+                    modifiers.push_back(std::to_string(cardinality->GetMin()));
+                }
+            }
+            else
+            {
+                modifiers.push_back(std::to_string(cardinality->GetMin()) + ".." + std::to_string(cardinality->GetMax()));
+            }
+        }
+        else if (nullptr != encoding)
+        {
+            modifiers.push_back("encoding(" + encoding->GetEncoding() + ")");
+        }
+        else if (nullptr != dynamic_cast<const UniqueModifier*>(modifier.get()))
+        {
+            modifiers.push_back("unique");
+        }
+        else if (nullptr != dynamic_cast<const InternedModifier*>(modifier.get()))
+        {
+            modifiers.push_back("interned");
+        }
+    }
+    if (false == modifiers.empty())
+    {
+        text += " [";
+        for (size_t i = 0; i < modifiers.size(); ++i)
+        {
+            text += (0 == i ? "" : ", ") + modifiers[i];
+        }
+        text += "]";
+    }
+
+    if (field->IsComputed() && nullptr != field->GetInitializer())
+    {
+        text += " = " + field->GetInitializer()->ToString();
+    }
+    return text;
+}
+
+JsonValue LanguageServer::NameRange(const LspDocument& document, const ASTNode* node, const std::string& name) const
+{
+    if (node->GetLine() <= 0)
+    {
+        return MakeRange(0, 0, 0);
+    }
+    const int line   = node->GetLine() - 1;
+    const int column = node->GetColumn() - 1;
+    return MakeRange(line, ToCharacter(document, line, column), ToCharacter(document, line, column + static_cast<int>(name.size())));
+}
+
+int LanguageServer::ToByteColumn(const LspDocument& document, const int line, const int character) const
+{
+    if (line < 0 || line >= static_cast<int>(document.lines.size()))
+    {
+        return std::max(character, 0);
+    }
+    const std::string& text = document.lines[line];
+    return utf8Positions_ ? std::min(std::max(character, 0), static_cast<int>(text.size())) : Utf16ToByteColumn(text, character);
+}
+
+int LanguageServer::ToCharacter(const LspDocument& document, const int line, const int column) const
+{
+    if (utf8Positions_ || line < 0 || line >= static_cast<int>(document.lines.size()))
+    {
+        return column;
+    }
+    return ByteToUtf16Column(document.lines[line], column);
+}
+
+JsonValue LanguageServer::MakeRange(const int line, const int startCharacter, const int endCharacter)
+{
+    JsonValue start = JsonValue::MakeObject();
+    start.Set("line", line).Set("character", startCharacter);
+
+    JsonValue end = JsonValue::MakeObject();
+    end.Set("line", line).Set("character", endCharacter);
+
+    JsonValue range = JsonValue::MakeObject();
+    range.Set("start", std::move(start)).Set("end", std::move(end));
+    return range;
+}
+
+std::string LanguageServer::UriToPath(const std::string& uri)
+{
+    if (0 != uri.rfind("file://", 0))
+    {
+        return uri;
+    }
+
+    // Decode percent escapes (e.g., %20)
+    std::string path;
+    for (size_t i = 7; i < uri.size(); ++i)
+    {
+        if ('%' == uri[i] && i + 2 < uri.size() && 0 != isxdigit(static_cast<unsigned char>(uri[i + 1])) &&
+            0 != isxdigit(static_cast<unsigned char>(uri[i + 2])))
+        {
+            path += static_cast<char>(strtol(uri.substr(i + 1, 2).c_str(), nullptr, 16));
+            i += 2;
+        }
+        else
+        {
+            path += uri[i];
+        }
+    }
+    return path;
+}
+} // namespace bbfm
@@ -0,0 +1,513 @@
+#include "Layout.h"
+#include "AllocTracker.h"
+#include <algorithm>
+#include <iostream>
+#include <set>
+
+namespace bbfm {
+// ============================================================================
+// FieldLayout / ClassLayout Implementation
+// ============================================================================
+
+const char* FieldLayout::StorageToString(const StorageKind storage)
+{
+    switch (storage)
+    {
+        case StorageKind::BOOL:
+            return "bool";
+        case StorageKind::INT64:
+            return "int64";
+        case StorageKind::FLOAT64:
+            return "float64";
+        case StorageKind::TIMESTAMP64:
+            return "timestamp64";
+        case StorageKind::TIMESPAN64:
+            return "timespan64";
+        case StorageKind::DATE32:
+            return "date32";
+        case StorageKind::GUID128:
+            return "guid128";
+        case StorageKind::STRING_REF:
+            return "string-ref";
+        case StorageKind::INTERNED_STRING:
+            return "interned-string";
+        case StorageKind::ENUM:
+            return "enum";
+        case StorageKind::OBJECT_REF:
+            return "object-ref";
+        case StorageKind::ARRAY_REF:
+            return "array-ref";
+        default:
+            return "unknown";
+    }
+}
+
+const char* ColumnLayout::EncodingToString(const ColumnEncoding encoding)
+{
+    switch (encoding)
+    {
+        case ColumnEncoding::PLAIN:
+            return "plain";
+        case ColumnEncoding::BITPACKED:
+            return "bitpacked";
+        case ColumnEncoding::DICTIONARY:
+            return "dictionary";
+        case ColumnEncoding::RLE:
+            return "rle";
+        case ColumnEncoding::DELTA:
+            return "delta";
+        default:
+            return "unknown";
+    }
+}
+
+const std::vector<ColumnEncoding>& ColumnLayout::GetEncodings()
+{
+    static const std::vector<ColumnEncoding> encodings = {
+        ColumnEncoding::PLAIN, ColumnEncoding::BITPACKED, ColumnEncoding::DICTIONARY, ColumnEncoding::RLE, ColumnEncoding::DELTA};
+    return encodings;
+}
+
+bool ColumnLayout::EncodingFromString(const std::string& name, ColumnEncoding& encoding)
+{
+    for (const ColumnEncoding candidate : GetEncodings())
+    {
+        if (name == EncodingToString(candidate))
+        {
+            encoding = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+const FieldLayout* ClassLayout::FindField(const std::string& fieldName) const
+{
+    for (const auto& field : fields)
+    {
+        if (field.name == fieldName)
+        {
+            return &field;
+        }
+    }
+    return nullptr;
+}
+
+// ============================================================================
+// LayoutBuilder Implementation
+// ============================================================================
+
+LayoutBuilder::LayoutBuilder(const SemanticAnalyzer* analyzer) : analyzer_(analyzer) {}
+
+void LayoutBuilder::Build()
+{
+    BBFM_ALLOC_SITE("LayoutBuilder::Build");
+
+    layouts_.clear();
+    enumFingerprints_.clear();
+
+    SchemaFingerprinter fingerprinter(analyzer_);
+    for (const auto& entry : analyzer_->GetSymbolTable())
+    {
+        if (TypeSymbol::Kind::CLASS == entry.second.kind)
+        {
+            ClassLayout layout = BuildClassLayout(entry.second.classDecl);
+            layout.fingerprint = fingerprinter.ClassFingerprint(entry.second.classDecl);
+            layouts_.insert({entry.first, layout});
+        }
+        else if (TypeSymbol::Kind::ENUM == entry.second.kind)
+        {
+            enumFingerprints_.insert({entry.first, fingerprinter.EnumFingerprint(entry.second.enumDecl)});
+        }
+    }
+}
+
+const std::map<std::string, ClassLayout>& LayoutBuilder::GetLayouts() const
+{
+    return layouts_;
+}
+
+const ClassLayout* LayoutBuilder::GetLayout(const std::string& className) const
+{
+    auto it = layouts_.find(className);
+    return (layouts_.end() != it) ? &it->second : nullptr;
+}
+
+const std::map<std::string, uint64_t>& LayoutBuilder::GetEnumFingerprints() const
+{
+    return enumFingerprints_;
+}
+
+ClassLayout LayoutBuilder::BuildClassLayout(const ClassDeclaration* classDecl) const
+{
+    ClassLayout layout;
+    layout.className     = classDecl->GetName();
+    layout.presenceBytes = 0;
+    layout.size          = 0;
+    layout.alignment     = 1;
+    layout.fingerprint   = 0;
+
+    // Universal metadata stored in every record. typeId is the same for all
+    // instances of a class, so it belongs to the class and not to the record.
+    layout.fields.push_back({"id", "Guid", "", nullptr, StorageKind::GUID128, 0, 16, 8, -1, StorageKind::GUID128, 128});
+    layout.fields.push_back({"cardinality", "Int", "", nullptr, StorageKind::INT64, 0, 8, 8, -1, StorageKind::INT64, 64});
+    layout.fields.push_back({"creationDate", "Timestamp", "", nullptr, StorageKind::TIMESTAMP64, 0, 8, 8, -1, StorageKind::TIMESTAMP64, 64});
+    layout.fields.push_back({"modificationDate", "Timestamp", "", nullptr, StorageKind::TIMESTAMP64, 0, 8, 8, -1, StorageKind::TIMESTAMP64, 64});
+    layout.fields.push_back({"comment", "String", "", nullptr, StorageKind::STRING_REF, 0, 8, 4, -1, StorageKind::STRING_REF, 0});
+
+    // Collect the inheritance chain, root class first
+    std::vector<const ClassDeclaration*>& chain = layout.classChain;
+    std::set<std::string>                 visited;
+    const auto&                           symbolTable = analyzer_->GetSymbolTable();
+    for (const ClassDeclaration* current = classDecl; nullptr != current && 0 == visited.count(current->GetName());)
+    {
+        visited.insert(current->GetName());
+        chain.insert(chain.begin(), current);
+
+        auto base = current->HasExplicitBase() ? symbolTable.find(current->GetBaseType()) : symbolTable.end();
+        current   = (symbolTable.end() != base && TypeSymbol::Kind::CLASS == base->second.kind) ? base->second.classDecl : nullptr;
+    }
+
+    // Stored fields of the whole chain; computed features have no storage
+    int32_t presenceBits = 0;
+    for (const ClassDeclaration* current : chain)
+    {
+        for (const auto& field : current->GetFields())
+        {
+            if (field->IsComputed())
+            {
+                continue;
+            }
+
+            FieldLayout fieldLayout = ResolveField(field.get(), current->GetName());
+
+            const CardinalityModifier* cardinality = field->GetCardinalityModifier();
+            if (nullptr != cardinality && cardinality->IsOptional() && !cardinality->IsArray())
+            {
+                fieldLayout.presenceBit = presenceBits++;
+            }
+            layout.fields.push_back(fieldLayout);
+        }
+    }
+
+    // Columns follow declaration order, before the record fields are reordered
+    for (const auto& fieldLayout : layout.fields)
+    {
+        layout.columns.push_back(ResolveColumn(fieldLayout));
+    }
+
+    // Persistent store: one record file, a primary id index and one index per [unique] field
+    layout.fileName = layout.className + ".records";
+    for (const auto& fieldLayout : layout.fields)
+    {
+        if (nullptr == fieldLayout.field && "id" == fieldLayout.name)
+        {
+            layout.indexes.push_back(ResolveIndex(fieldLayout, layout.className, true));
+        }
+        else if (nullptr != fieldLayout.field && fieldLayout.field->HasUniqueConstraint())
+        {
+            layout.indexes.push_back(ResolveIndex(fieldLayout, fieldLayout.declaringClass, false));
+        }
+    }
+
+    // Order by decreasing alignment (stable, so declaration order is kept within a
+    // group). Every size is a multiple of its alignment, so fields need no padding
+    // between them; only the first field is aligned up past the presence bitmap.
+    std::stable_sort(
+        layout.fields.begin(), layout.fields.end(), [](const FieldLayout& a, const FieldLayout& b) { return a.alignment > b.alignment; });
+
+    layout.presenceBytes = static_cast<uint32_t>((presenceBits + 7) / 8);
+
+    uint32_t offset = layout.presenceBytes;
+    for (auto& field : layout.fields)
+    {
+        offset       = (offset + field.alignment - 1) / field.alignment * field.alignment;
+        field.offset = offset;
+        offset += field.size;
+
+        layout.alignment = std::max(layout.alignment, field.alignment);
+    }
+    layout.size = (offset + layout.alignment - 1) / layout.alignment * layout.alignment;
+
+    return layout;
+}
+
+FieldLayout LayoutBuilder::ResolveField(const Field* field, const std::string& declaringClass) const
+{
+    FieldLayout layout{field->GetName(), "", declaringClass, field, StorageKind::INT64, 0, 8, 8, -1, StorageKind::INT64, 64};
+
+    // Arrays live in a side heap, the record only keeps offset and count
+    const CardinalityModifier* cardinality = field->GetCardinalityModifier();
+    const bool                 isArray     = (nullptr != cardinality && cardinality->IsArray());
+
+    const TypeSpec* typeSpec = field->GetType();
+    if (typeSpec->IsPrimitive())
+    {
+        const PrimitiveType type = static_cast<const PrimitiveTypeSpec*>(typeSpec)->GetType();
+        layout.typeName          = PrimitiveTypeSpec::TypeToString(type);
+
+        switch (type)
+        {
+            case PrimitiveType::BOOL:
+                layout.storage   = StorageKind::BOOL;
+                layout.size      = 1;
+                layout.alignment = 1;
+                layout.valueBits = 1;
+                break;
+            case PrimitiveType::INT:
+                layout.storage = StorageKind::INT64;
+                break;
+            case PrimitiveType::REAL:
+                layout.storage = StorageKind::FLOAT64;
+                break;
+            case PrimitiveType::TIMESTAMP:
+                layout.storage = StorageKind::TIMESTAMP64;
+                break;
+            case PrimitiveType::TIMESPAN:
+                layout.storage = StorageKind::TIMESPAN64;
+                break;
+            case PrimitiveType::DATE:
+                layout.storage   = StorageKind::DATE32;
+                layout.size      = 4;
+                layout.alignment = 4;
+                layout.valueBits = 32;
+                break;
+            case PrimitiveType::GUID:
+                layout.storage   = StorageKind::GUID128;
+                layout.size      = 16;
+                layout.valueBits = 128;
+                break;
+            case PrimitiveType::STRING:
+            default:
+                if (field->IsInterned())
+                {
+                    layout.storage   = StorageKind::INTERNED_STRING;
+                    layout.size      = 4;
+                    layout.alignment = 4;
+                    layout.valueBits = 32;
+                }
+                else
+                {
+                    layout.storage   = StorageKind::STRING_REF;
+                    layout.size      = 8;
+                    layout.alignment = 4;
+                    layout.valueBits = 0; // Variable length
+                }
+                break;
+        }
+    }
+    else
+    {
+        layout.typeName = static_cast<const UserDefinedTypeSpec*>(typeSpec)->GetTypeName();
+
+        const auto& symbolTable = analyzer_->GetSymbolTable();
+        auto        symbol      = symbolTable.find(layout.typeName);
+        if (symbolTable.end() != symbol && TypeSymbol::Kind::ENUM == symbol->second.kind)
+        {
+            layout.storage   = StorageKind::ENUM;
+            layout.size      = EnumStorageSize(symbol->second.enumDecl->GetValues().size());
+            layout.alignment = layout.size;
+            layout.valueBits = BitWidth(symbol->second.enumDecl->GetValues().size());
+        }
+        else
+        {
+            // Objects are referenced by their Guid
+            layout.storage   = StorageKind::OBJECT_REF;
+            layout.size      = 16;
+            layout.valueBits = 128;
+        }
+    }
+
+    layout.elementStorage = layout.storage;
+
+    if (isArray)
+    {
+        // Elements live in the element heap; the record only stores the slice
+        layout.storage   = StorageKind::ARRAY_REF;
+        layout.size      = 8;
+        layout.alignment = 4;
+    }
+
+    return layout;
+}
+
+ColumnLayout LayoutBuilder::ResolveColumn(const FieldLayout& fieldLayout)
+{
+    ColumnLayout column;
+    column.name           = fieldLayout.name;
+    column.typeName       = fieldLayout.typeName;
+    column.declaringClass = fieldLayout.declaringClass;
+    column.storage        = fieldLayout.elementStorage;
+    column.nullable       = (fieldLayout.presenceBit >= 0);
+    column.list           = (StorageKind::ARRAY_REF == fieldLayout.storage);
+    column.encoding       = DefaultEncoding(fieldLayout);
+
+    // An explicit [encoding(...)] overrides the default (validated during semantic analysis)
+    const EncodingModifier* encodingMod = (nullptr != fieldLayout.field) ? fieldLayout.field->GetEncodingModifier() : nullptr;
+    if (nullptr != encodingMod)
+    {
+        ColumnLayout::EncodingFromString(encodingMod->GetEncoding(), column.encoding);
+    }
+
+    switch (column.encoding)
+    {
+        case ColumnEncoding::BITPACKED:
+        case ColumnEncoding::RLE:
+            // Values (or run values) need only their significant bits
+            column.bitWidth = fieldLayout.valueBits;
+            break;
+        case ColumnEncoding::DICTIONARY:
+        case ColumnEncoding::DELTA:
+            // Code and delta widths depend on the data
+            column.bitWidth = 0;
+            break;
+        case ColumnEncoding::PLAIN:
+        default:
+            // Whole bytes per value, as in the record
+            column.bitWidth = (fieldLayout.valueBits + 7) / 8 * 8;
+            if (StorageKind::ENUM == fieldLayout.elementStorage && column.bitWidth > 8)
+            {
+                column.bitWidth = (column.bitWidth > 16) ? 32 : 16;
+            }
+            break;
+    }
+
+    return column;
+}
+
+ColumnEncoding LayoutBuilder::DefaultEncoding(const FieldLayout& fieldLayout)
+{
+    switch (fieldLayout.elementStorage)
+    {
+        case StorageKind::BOOL:
+        case StorageKind::ENUM:
+            return ColumnEncoding::BITPACKED;
+        case StorageKind::INTERNED_STRING:
+            return ColumnEncoding::DICTIONARY;
+        case StorageKind::TIMESTAMP64:
+            return ColumnEncoding::DELTA;
+        default:
+            return ColumnEncoding::PLAIN;
+    }
+}
+
+IndexLayout LayoutBuilder::ResolveIndex(const FieldLayout& fieldLayout, const std::string& owner, const bool primary)
+{
+    IndexLayout index;
+    index.fieldName      = fieldLayout.name;
+    index.declaringClass = owner;
+    index.fileName       = owner + "." + fieldLayout.name + ".idx";
+    index.keyStorage     = fieldLayout.storage;
+    index.primary        = primary;
+
+    // Fixed-size values are their own key; strings are keyed by a 64-bit hash
+    index.keySize   = (StorageKind::STRING_REF == fieldLayout.storage) ? 8 : fieldLayout.size;
+    index.entrySize = (index.keySize + 8 + 7) / 8 * 8;
+
+    return index;
+}
+
+uint32_t LayoutBuilder::BitWidth(const size_t valueCount)
+{
+    uint32_t bits = 1;
+    while (bits < 64 && (static_cast<uint64_t>(1) << bits) < valueCount)
+    {
+        ++bits;
+    }
+    return bits;
+}
+
+uint32_t LayoutBuilder::EnumStorageSize(const size_t valueCount)
+{
+    if (valueCount <= 0x100)
+    {
+        return 1;
+    }
+    if (valueCount <= 0x10000)
+    {
+        return 2;
+    }
+    return 4;
+}
+
+void LayoutBuilder::DumpLayouts() const
+{
+    std::cout << "========================================\n";
+    std::cout << "Storage Layout\n";
+    std::cout << "========================================\n\n";
+
+    for (const auto& entry : enumFingerprints_)
+    {
+        std::cout << "  enum " << entry.first << " (fingerprint " << SchemaFingerprinter::ToString(entry.second) << ")\n";
+    }
+    if (false == enumFingerprints_.empty())
+    {
+        std::cout << "\n";
+    }
+
+    for (const auto& entry : layouts_)
+    {
+        const ClassLayout& layout = entry.second;
+        std::cout << "  class " << layout.className << " (size " << layout.size << ", align " << layout.alignment << ", fingerprint "
+                  << SchemaFingerprinter::ToString(layout.fingerprint) << ") {\n";
+
+        if (layout.presenceBytes > 0)
+        {
+            std::cout << "    @0 presence bitmap: " << layout.presenceBytes << " byte(s)\n";
+        }
+
+        for (const auto& field : layout.fields)
+        {
+            std::cout << "    @" << field.offset << " " << field.name << ": " << FieldLayout::StorageToString(field.storage) << " (" << field.size
+                      << " bytes, " << field.typeName;
+            if (field.declaringClass.empty())
+            {
+                std::cout << ", metadata";
+            }
+            else if (field.declaringClass != layout.className)
+            {
+                std::cout << ", from " << field.declaringClass;
+            }
+            if (field.presenceBit >= 0)
+            {
+                std::cout << ", presence bit " << field.presenceBit;
+            }
+            std::cout << ")\n";
+        }
+
+        std::cout << "    Columns:\n";
+        for (const auto& column : layout.columns)
+        {
+            std::cout << "      " << column.name << ": " << (column.list ? "list<" : "") << column.typeName << (column.list ? ">" : "") << " "
+                      << ColumnLayout::EncodingToString(column.encoding);
+            if (column.bitWidth > 0)
+            {
+                std::cout << "(" << column.bitWidth << " bit" << (1 == column.bitWidth ? "" : "s") << ")";
+            }
+            if (column.nullable)
+            {
+                std::cout << ", nullable";
+            }
+            std::cout << "\n";
+        }
+
+        std::cout << "    Store:\n";
+        std::cout << "      " << layout.fileName << ": " << STORE_HEADER_SIZE << "-byte header (fingerprint @" << STORE_FINGERPRINT_OFFSET << "), " << layout.size
+                  << "-byte records\n";
+        for (const auto& index : layout.indexes)
+        {
+            std::cout << "      " << index.fileName << ": " << (index.primary ? "primary" : "unique") << " index on " << index.fieldName << ", "
+                      << FieldLayout::StorageToString(index.keyStorage) << " key, " << index.entrySize << "-byte entries";
+            if (index.declaringClass != layout.className)
+            {
+                std::cout << ", shared with " << index.declaringClass;
+            }
+            std::cout << "\n";
+        }
+
+        std::cout << "  }\n\n";
+    }
+
+    std::cout << "========================================\n";
+}
+} // namespace bbfm
@@ -0,0 +1,112 @@
+#include "ModelCache.h"
+#include "Fingerprint.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace bbfm {
+std::shared_ptr<const CompiledModel> ModelCache::Find(const std::vector<std::string>& sourceFiles, const std::string& classPrefix, const uint64_t contentHash) const
+{
+    std::vector<std::string> canonicalFiles;
+    if (!CanonicalPaths(sourceFiles, canonicalFiles))
+    {
+        return nullptr;
+    }
+    auto it = models_.find(MakeKey(canonicalFiles, classPrefix));
+    if (models_.end() == it || it->second->contentHash != contentHash || it->second->sourceFiles != canonicalFiles)
+    {
+        return nullptr;
+    }
+
+    // The model must have been parsed from these very files
+    for (const std::string& canonicalFile : canonicalFiles)
+    {
+        const auto& modules = it->second->modules;
+        if (modules.end() == std::find_if(modules.begin(), modules.end(), [&](const ModuleFile& module) { return module.path == canonicalFile; }))
+        {
+            return nullptr;
+        }
+    }
+    for (const ModuleFile& module : it->second->modules)
+    {
+        uint64_t moduleHash = 0;
+        if (!HashFile(module.path, moduleHash) || moduleHash != module.contentHash)
+        {
+            return nullptr;
+        }
+    }
+    return it->second;
+}
+
+std::shared_ptr<const CompiledModel> ModelCache::Insert(std::unique_ptr<CompiledModel> model)
+{
+    std::shared_ptr<const CompiledModel>& slot = models_[MakeKey(model->sourceFiles, model->classPrefix)];
+    slot                                       = std::move(model);
+    return slot;
+}
+
+size_t ModelCache::GetSize() const
+{
+    return models_.size();
+}
+
+bool ModelCache::HashFile(const std::string& sourceFile, uint64_t& contentHash)
+{
+    std::ifstream infile(sourceFile, std::ios::binary);
+    if (!infile.is_open())
+    {
+        return false;
+    }
+
+    std::ostringstream content;
+    content << infile.rdbuf();
+    contentHash = SchemaFingerprinter::Hash(content.str());
+    return true;
+}
+
+bool ModelCache::HashFiles(const std::vector<std::string>& sourceFiles, uint64_t& contentHash)
+{
+    std::vector<std::string> canonicalFiles;
+    if (!CanonicalPaths(sourceFiles, canonicalFiles))
+    {
+        return false;
+    }
+
+    std::string combined;
+    for (const std::string& canonicalFile : canonicalFiles)
+    {
+        uint64_t fileHash = 0;
+        if (!HashFile(canonicalFile, fileHash))
+        {
+            return false;
+        }
+        combined += canonicalFile + '\0' + SchemaFingerprinter::ToString(fileHash) + '\0';
+    }
+    contentHash = SchemaFingerprinter::Hash(combined);
+    return true;
+}
+
+bool ModelCache::CanonicalPaths(const std::vector<std::string>& sourceFiles, std::vector<std::string>& canonicalFiles)
+{
+    canonicalFiles.clear();
+    for (const std::string& sourceFile : sourceFiles)
+    {
+        char* resolved = realpath(sourceFile.c_str(), nullptr);
+        if (nullptr == resolved)
+        {
+            return false;
+        }
+        canonicalFiles.emplace_back(resolved);
+        free(resolved);
+    }
+    return true;
+}
+
+ModelCache::Key ModelCache::MakeKey(const std::vector<std::string>& canonicalFiles, const std::string& classPrefix)
+{
+    std::vector<std::string> sorted = canonicalFiles;
+    std::sort(sorted.begin(), sorted.end());
+    return {std::move(sorted), classPrefix};
+}
+} // namespace bbfm
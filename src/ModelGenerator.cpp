@@ -0,0 +1,94 @@
+#include "ModelGenerator.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace bbfm {
+ModelGenerator::ModelGenerator(const GeneratorOptions& options) : options_(options) {}
+
+std::string ModelGenerator::Generate() const
+{
+    std::mt19937_64 random(options_.seed);
+    std::string     text = "// Synthetic model: " + std::to_string(options_.classCount) + " classes, " + std::to_string(options_.fieldsPerClass) +
+                       " fields, inheritance depth " + std::to_string(options_.inheritanceDepth) + ", " + std::to_string(options_.invariantsPerClass) +
+                       " invariants of " + std::to_string(options_.expressionSize) + " operands\n\n";
+
+    for (size_t e = 0; e < ENUM_COUNT; ++e)
+    {
+        text += "enum E" + std::to_string(e) + " {\n    V0,\n    V1,\n    V2,\n    V3\n}\n\n";
+    }
+
+    const size_t      chainLength = options_.inheritanceDepth + 1;
+    const char* const operators[] = {" + ", " - ", " * "};
+    for (size_t i = 0; i < options_.classCount; ++i)
+    {
+        const std::string name = "C" + std::to_string(i);
+        text += "class " + name;
+        if (0 != i % chainLength)
+        {
+            text += " inherits C" + std::to_string(i - 1);
+        }
+        text += " {\n";
+
+        // Field names carry the class number, so they never clash with inherited ones
+        std::vector<std::string> intFields;
+        std::vector<std::string> arrayFields;
+        for (size_t j = 0; j < options_.fieldsPerClass; ++j)
+        {
+            const std::string field = "f" + std::to_string(i) + "_" + std::to_string(j);
+            std::string       type;
+            switch (j % FIELD_KINDS)
+            {
+                case 0:
+                    type = "Int";
+                    intFields.push_back(field);
+                    break;
+                case 1:
+                    type = "Real";
+                    break;
+                case 2:
+                    type = "String";
+                    break;
+                case 3:
+                    type = "E" + std::to_string(random() % ENUM_COUNT);
+                    break;
+                case 4:
+                    type = "C" + std::to_string(random() % options_.classCount) + " [optional]";
+                    break;
+                default:
+                    type = "C" + std::to_string(random() % options_.classCount) + " [0..*]";
+                    arrayFields.push_back(field);
+                    break;
+            }
+            text += "    feature " + field + ": " + type + ";\n";
+        }
+
+        for (size_t k = 0; k < options_.invariantsPerClass; ++k)
+        {
+            std::string expression;
+            for (size_t o = 0; o < std::max<size_t>(options_.expressionSize, 1); ++o)
+            {
+                if (o > 0)
+                {
+                    expression += operators[(k + o) % 3];
+                }
+                if (false == intFields.empty() && 0 == o % 2)
+                {
+                    expression += intFields[(k + o / 2) % intFields.size()];
+                }
+                else if (false == arrayFields.empty() && 3 == o % 4)
+                {
+                    expression += "count(" + arrayFields[(k + o / 4) % arrayFields.size()] + ")";
+                }
+                else
+                {
+                    expression += std::to_string(o + 1);
+                }
+            }
+            text += "    invariant inv" + std::to_string(i) + "_" + std::to_string(k) + ": " + expression + " >= 0;\n";
+        }
+        text += "}\n\n";
+    }
+    return text;
+}
+} // namespace bbfm
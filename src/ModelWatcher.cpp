@@ -0,0 +1,442 @@
+#include "ModelWatcher.h"
+#include "ArrowSchema.h"
+#include "Console.h"
+#include "Diagnostics.h"
+#include "Driver.h"
+#include "Fingerprint.h"
+#include "Layout.h"
+#include "ModelCache.h"
+#include "SqlSchema.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <unistd.h>
+#include <vector>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+namespace {
+/// \brief Milliseconds elapsed between two time points, formatted
+std::string FormatDuration(const std::chrono::steady_clock::time_point start, const std::chrono::steady_clock::time_point end)
+{
+    char text[32];
+    snprintf(text, sizeof(text), "%.1f ms", std::chrono::duration<double, std::milli>(end - start).count());
+    return text;
+}
+
+#ifdef __linux__
+// Events watched on the directory and on the directories of imported files
+const uint32_t WATCH_MASK = IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+
+// Set by SIGINT/SIGTERM to stop the watch loop
+volatile sig_atomic_t g_stopRequested = 0;
+
+void OnStopSignal(int)
+{
+    g_stopRequested = 1;
+}
+
+/// \brief Read the pending inotify events and collect the paths they concern
+/// \param fd The inotify descriptor
+/// \param directories Watch descriptor by canonical directory; a removed directory is dropped
+/// \param mainWatch Watch descriptor of the watched directory
+/// \param changed Output paths of every file an event concerns
+/// \param arrived Output paths of the files created, moved in or written
+/// \return False if the watched directory itself went away
+bool ReadEvents(const int fd, std::map<std::string, int>& directories, const int mainWatch, std::set<std::string>& changed, std::set<std::string>& arrived)
+{
+    alignas(inotify_event) char buffer[4096];
+    const ssize_t               length = read(fd, buffer, sizeof(buffer));
+    for (ssize_t offset = 0; offset < length;)
+    {
+        const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+        offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+        const auto directory = std::find_if(directories.begin(), directories.end(), [&](const auto& entry) { return event->wd == entry.second; });
+        if (0 != (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)))
+        {
+            if (mainWatch == event->wd)
+            {
+                return false;
+            }
+            // A directory of imported files went away; it is watched again if it comes back
+            if (directories.end() != directory)
+            {
+                directories.erase(directory);
+            }
+            continue;
+        }
+        if (directories.end() == directory || 0 == event->len)
+        {
+            continue;
+        }
+        const std::string path = directory->first + "/" + event->name;
+        changed.insert(path);
+        if (0 != (event->mask & (IN_CREATE | IN_MOVED_TO | IN_MODIFY | IN_CLOSE_WRITE)))
+        {
+            arrived.insert(path);
+        }
+    }
+    return true;
+}
+
+/// \brief Split the file name off a path
+std::string FileNameOf(const std::string& path)
+{
+    const size_t slash = path.rfind('/');
+    return (std::string::npos == slash) ? path : path.substr(slash + 1);
+}
+#endif
+} // namespace
+
+namespace bbfm {
+ModelWatcher::ModelWatcher(const std::string& directory, const std::string& classPrefix, const std::string& arrowDirectory, const std::string& sqlDirectory)
+    : directory_(directory), classPrefix_(classPrefix), arrowDirectory_(arrowDirectory), sqlDirectory_(sqlDirectory)
+{
+}
+
+int ModelWatcher::Run()
+{
+#ifndef __linux__
+    // Only inotify is supported
+    Console::ReportError("Error: --watch needs Linux (inotify)");
+    return 1;
+#else
+    const int fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (fd < 0)
+    {
+        Console::ReportError("Error: inotify is not available: " + std::string(strerror(errno)));
+        return 1;
+    }
+    const int mainWatch = inotify_add_watch(fd, directory_.c_str(), WATCH_MASK);
+    if (mainWatch < 0)
+    {
+        Console::ReportError("Error: Could not watch '" + directory_ + "': " + strerror(errno));
+        close(fd);
+        return 1;
+    }
+
+    // Imports are tracked by canonical path
+    char* canonical     = realpath(directory_.c_str(), nullptr);
+    canonicalDirectory_ = (nullptr != canonical) ? canonical : directory_;
+    free(canonical);
+    watches_.clear();
+    watches_[canonicalDirectory_] = mainWatch;
+
+    // No SA_RESTART, so a signal interrupts poll()
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = OnStopSignal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    // Initial build of every model in the directory, in name order
+    std::vector<std::string> fileNames;
+    DIR*                     dir = opendir(directory_.c_str());
+    if (nullptr != dir)
+    {
+        for (const dirent* entry = readdir(dir); nullptr != entry; entry = readdir(dir))
+        {
+            if (IsModelFile(entry->d_name))
+            {
+                fileNames.push_back(entry->d_name);
+            }
+        }
+        closedir(dir);
+    }
+    std::sort(fileNames.begin(), fileNames.end());
+    for (const std::string& fileName : fileNames)
+    {
+        Rebuild(fileName);
+    }
+    WatchImportDirectories(fd);
+
+    Console::ReportStatus("Watching " + directory_ + " for changes to .fm files (" + std::to_string(models_.size()) + " model(s))");
+
+    bool watching = true;
+    while (watching && 0 == g_stopRequested)
+    {
+        // Wait for the first event, then until the directory is quiet for DEBOUNCE_MS
+        pollfd                pfd     = {fd, POLLIN, 0};
+        std::set<std::string> changed;
+        std::set<std::string> arrived;
+        int                   timeout = -1;
+        for (;;)
+        {
+            const int ready = poll(&pfd, 1, timeout);
+            if (ready < 0 && EINTR == errno)
+            {
+                break;
+            }
+            if (ready <= 0)
+            {
+                break;
+            }
+            if (!ReadEvents(fd, watches_, mainWatch, changed, arrived))
+            {
+                Console::ReportError("Error: Watched directory '" + directory_ + "' was removed or moved");
+                watching = false;
+                break;
+            }
+            timeout = DEBOUNCE_MS;
+        }
+        if (0 != g_stopRequested)
+        {
+            break;
+        }
+
+        // The changed models of the directory first
+        const std::string prefix = canonicalDirectory_ + "/";
+        for (const std::string& path : changed)
+        {
+            const std::string fileName = FileNameOf(path);
+            if (path == prefix + fileName && IsModelFile(fileName))
+            {
+                Rebuild(fileName);
+            }
+        }
+
+        // A model whose imports failed may be missing a file that was just created; other files
+        // (notes, editor swap files, the outputs) cannot fix it and would only rebuild it again
+        const bool modelArrived = std::any_of(arrived.begin(), arrived.end(), [](const std::string& path) { return IsModelFile(FileNameOf(path)); });
+
+        // Then the unchanged models that import a changed file, wherever it is
+        std::vector<std::string> importers;
+        for (const auto& entry : models_)
+        {
+            if (0 != changed.count(prefix + entry.first))
+            {
+                continue;
+            }
+            bool importChanged = !entry.second.importsRead && modelArrived;
+            for (const std::string& path : changed)
+            {
+                importChanged = importChanged || 0 != entry.second.importPaths.count(path);
+            }
+            if (importChanged)
+            {
+                importers.push_back(entry.first);
+            }
+        }
+        for (const std::string& fileName : importers)
+        {
+            Rebuild(fileName, true);
+        }
+        WatchImportDirectories(fd);
+    }
+
+    close(fd);
+    Console::ReportStatus("Watch stopped");
+    return watching ? 0 : 1;
+#endif
+}
+
+#ifdef __linux__
+void ModelWatcher::WatchImportDirectories(const int fd)
+{
+    // Directories no longer imported stay watched; their events match no model.
+    // A directory that cannot be watched is recorded too, so it is reported once.
+    for (const auto& entry : models_)
+    {
+        for (const std::string& importPath : entry.second.importPaths)
+        {
+            const std::string directory = importPath.substr(0, importPath.rfind('/'));
+            if (directory.empty() || 0 != watches_.count(directory))
+            {
+                continue;
+            }
+            const int watch     = inotify_add_watch(fd, directory.c_str(), WATCH_MASK);
+            watches_[directory] = watch;
+            if (watch < 0)
+            {
+                Console::ReportError("Error: Could not watch '" + directory + "' (imported by " + entry.first + "): " + strerror(errno));
+            }
+        }
+    }
+}
+#endif
+
+void ModelWatcher::Rebuild(const std::string& fileName, const bool importChanged)
+{
+    const std::string path = directory_ + "/" + fileName;
+
+    std::ifstream infile(path, std::ios::binary);
+    if (!infile.is_open())
+    {
+        auto removed = models_.find(fileName);
+        if (models_.end() != removed)
+        {
+            // The outputs of a deleted model are stale
+            Console::ReportStatus("\n" + fileName + ": removed");
+            for (const auto& output : removed->second.outputs)
+            {
+                if (0 == unlink(output.first.c_str()))
+                {
+                    Console::ReportStatus("  Output removed: " + output.first);
+                }
+                else if (ENOENT != errno)
+                {
+                    Console::ReportError("Error: Could not remove '" + output.first + "': " + strerror(errno));
+                }
+            }
+            models_.erase(removed);
+        }
+        return;
+    }
+    std::ostringstream content;
+    content << infile.rdbuf();
+    const std::string text        = content.str();
+    const uint64_t    contentHash = SchemaFingerprinter::Hash(text);
+
+    auto          inserted = models_.try_emplace(fileName);
+    WatchedModel& model    = inserted.first->second;
+    if (inserted.second)
+    {
+        model.path        = path;
+        model.contentHash = 0;
+        model.upToDate    = false;
+        model.importsRead = true;
+    }
+    else if (contentHash == model.contentHash && !importChanged)
+    {
+        // Saved without changes, or an event of an earlier burst
+        return;
+    }
+    model.contentHash = contentHash;
+
+    Console::ReportStatus("\n" + fileName + (importChanged ? ": rebuilding (import changed)" : ": rebuilding"));
+    const auto        start = std::chrono::steady_clock::now();
+    DiagnosticSession diagnostics;
+
+    // Phase 0: only changed declarations are parsed
+    if (!model.parser.Parse(path, text))
+    {
+        model.upToDate = false;
+        diagnostics.Flush();
+        Console::ReportStatus("  Phase 0 failed after " + FormatDuration(start, std::chrono::steady_clock::now()) + ", outputs kept");
+        return;
+    }
+    const auto parsed = std::chrono::steady_clock::now();
+    Console::ReportStatus("  Phase 0: " + FormatDuration(start, parsed) + " (" + std::to_string(model.parser.GetParsedCount()) + " declaration(s) parsed, " +
+                          std::to_string(model.parser.GetReusedCount()) + " reused)");
+
+    // Imported files are parsed again only if they changed, each once
+    Driver driver({path}, classPrefix_);
+    model.importsRead = driver.LoadImports(path, model.parser.GetAst(), model.imports, &imports_);
+    model.importPaths.clear();
+    for (const ModuleFile& module : driver.GetModules())
+    {
+        model.importPaths.insert(module.path);
+    }
+    if (!model.importsRead)
+    {
+        model.upToDate = false;
+        diagnostics.Flush();
+        Console::ReportStatus("  Imports failed, outputs kept");
+        return;
+    }
+
+    // Phase 1: only classes whose query inputs changed are validated
+    SemanticAnalyzer analyzer(model.parser.GetAst(), &model.queries, &model.imports);
+    const bool       valid    = analyzer.Analyze();
+    const auto       analyzed = std::chrono::steady_clock::now();
+    Console::ReportStatus("  Phase 1: " + FormatDuration(parsed, analyzed) + " (" + std::to_string(model.queries.GetComputedCount()) + " class(es) validated, " +
+                          std::to_string(model.queries.GetReusedCount()) + " reused)");
+    if (!valid)
+    {
+        model.upToDate = false;
+        diagnostics.Flush();
+        Console::ReportStatus("  Phase 1 failed, outputs kept");
+        return;
+    }
+
+    // Outputs are always generated; deleting a declaration reparses nothing, but changes them.
+    // WriteOutput leaves a file alone if its content is the same.
+    if (arrowDirectory_.empty() && sqlDirectory_.empty())
+    {
+        model.upToDate = true;
+        return;
+    }
+
+    LayoutBuilder layouts(&analyzer);
+    layouts.Build();
+
+    const std::string stem      = fileName.substr(0, fileName.size() - 3);
+    bool              success   = true;
+    int               written   = 0;
+    int               unchanged = 0;
+    if (false == arrowDirectory_.empty())
+    {
+        std::ostringstream schema;
+        ArrowSchemaWriter  schemaWriter(&analyzer, &layouts);
+        schemaWriter.Write(schema);
+
+        bool outputWritten = false;
+        success            = WriteOutput(model, arrowDirectory_ + "/" + stem + ".arrow.json", schema.str(), outputWritten) && success;
+        outputWritten ? ++written : ++unchanged;
+    }
+    if (false == sqlDirectory_.empty())
+    {
+        std::ostringstream sql;
+        SqlSchemaWriter    sqlWriter(&analyzer, &layouts, classPrefix_);
+        sqlWriter.Write(sql);
+
+        bool outputWritten = false;
+        success            = WriteOutput(model, sqlDirectory_ + "/" + stem + ".sql", sql.str(), outputWritten) && success;
+        outputWritten ? ++written : ++unchanged;
+    }
+    model.upToDate = success;
+
+    Console::ReportStatus("  Outputs: " + FormatDuration(analyzed, std::chrono::steady_clock::now()) + " (" + std::to_string(written) + " written, " +
+                          std::to_string(unchanged) + " unchanged)");
+}
+
+bool ModelWatcher::WriteOutput(WatchedModel& model, const std::string& path, const std::string& content, bool& written)
+{
+    written = false;
+
+    // Leave the file (and its modification time) alone if the content is the same
+    const uint64_t contentHash = SchemaFingerprinter::Hash(content);
+    auto           previous    = model.outputs.find(path);
+    if (model.outputs.end() == previous)
+    {
+        uint64_t existingHash = 0;
+        if (ModelCache::HashFile(path, existingHash))
+        {
+            previous = model.outputs.insert({path, existingHash}).first;
+        }
+    }
+    if (model.outputs.end() != previous && contentHash == previous->second)
+    {
+        return true;
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out.is_open() || !(out << content) || !out.flush())
+    {
+        Console::ReportError("Error: Could not write '" + path + "'");
+        model.outputs.erase(path);
+        return false;
+    }
+    model.outputs[path] = contentHash;
+    written             = true;
+    return true;
+}
+
+bool ModelWatcher::IsModelFile(const std::string& fileName)
+{
+    return fileName.size() > 3 && 0 == fileName.compare(fileName.size() - 3, 3, ".fm") && '.' != fileName[0];
+}
+} // namespace bbfm
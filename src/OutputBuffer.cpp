@@ -0,0 +1,63 @@
+#include "OutputBuffer.h"
+#include <cstdint>
+
+namespace bbfm {
+OutputBuffer::OutputBuffer() : stream_(nullptr), flushSize_(SIZE_MAX), failed_(false)
+{
+}
+
+OutputBuffer::OutputBuffer(std::ostream& stream, const size_t flushSize) : stream_(&stream), flushSize_(flushSize), failed_(false)
+{
+    text_.reserve(flushSize);
+}
+
+OutputBuffer::~OutputBuffer()
+{
+    Flush();
+}
+
+void OutputBuffer::AppendRepeated(const size_t count, const char c)
+{
+    text_.append(count, c);
+    if (text_.size() >= flushSize_)
+    {
+        Flush();
+    }
+}
+
+void OutputBuffer::Flush()
+{
+    if (nullptr == stream_)
+    {
+        return;
+    }
+
+    if (!failed_ && false == text_.empty())
+    {
+        stream_->write(text_.data(), static_cast<std::streamsize>(text_.size()));
+        failed_ = stream_->fail();
+    }
+    text_.clear();
+    if (!failed_)
+    {
+        stream_->flush();
+    }
+}
+
+const std::string& OutputBuffer::GetText() const
+{
+    return text_;
+}
+
+std::string OutputBuffer::TakeText()
+{
+    std::string text = std::move(text_);
+    text_.clear();
+    return text;
+}
+
+bool OutputBuffer::HasFailed() const
+{
+    return failed_;
+}
+} // namespace bbfm
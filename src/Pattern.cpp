@@ -0,0 +1,901 @@
+#include "Pattern.h"
+#include <algorithm>
+#include <bitset>
+#include <map>
+#include <utility>
+
+namespace bbfm {
+namespace {
+// ============================================================================
+// Pattern Syntax Tree
+// ============================================================================
+
+using ByteSet = std::bitset<256>;
+
+/// \brief Node of the parsed pattern
+struct PatternNode
+{
+    enum class Kind
+    {
+        EMPTY,     // matches the empty string
+        BYTES,     // matches one byte out of a set
+        CONCAT,    // left then right
+        ALTERNATE, // left or right
+        REPEAT     // child repeated min..max times (max -1 for unbounded)
+    };
+
+    Kind                         kind = Kind::EMPTY;
+    ByteSet                      bytes;
+    std::unique_ptr<PatternNode> left;
+    std::unique_ptr<PatternNode> right;
+    int                          min = 0;
+    int                          max = 0;
+};
+
+/// \brief Recursive descent parser for the supported pattern syntax
+class PatternParser
+{
+public:
+    explicit PatternParser(const std::string& pattern) : pattern_(pattern), pos_(0) {}
+
+    std::unique_ptr<PatternNode> Parse(std::string& error)
+    {
+        // Patterns always match the whole value, so leading '^' and trailing '$' are redundant
+        size_t end = pattern_.size();
+        if (0 < end && '^' == pattern_[0])
+        {
+            pos_ = 1;
+        }
+        if (end > pos_ && '$' == pattern_[end - 1] && !IsEscaped(end - 1))
+        {
+            --end;
+        }
+        end_ = end;
+
+        std::unique_ptr<PatternNode> node = ParseAlternation();
+        if (error_.empty() && pos_ < end_)
+        {
+            Fail("unmatched ')'");
+        }
+
+        if (false == error_.empty())
+        {
+            error = error_ + " at offset " + std::to_string(pos_);
+            return nullptr;
+        }
+        return node;
+    }
+
+private:
+    const std::string& pattern_;
+    size_t             pos_;
+    size_t             end_ = 0;
+    std::string        error_;
+
+    bool AtEnd() const
+    {
+        return pos_ >= end_ || false == error_.empty();
+    }
+
+    bool IsEscaped(size_t index) const
+    {
+        size_t backslashes = 0;
+        while (index > 0 && '\\' == pattern_[index - 1])
+        {
+            ++backslashes;
+            --index;
+        }
+        return 1 == backslashes % 2;
+    }
+
+    void Fail(const std::string& message)
+    {
+        if (error_.empty())
+        {
+            error_ = message;
+        }
+    }
+
+    static std::unique_ptr<PatternNode> MakeBytes(const ByteSet& bytes)
+    {
+        auto node   = std::make_unique<PatternNode>();
+        node->kind  = PatternNode::Kind::BYTES;
+        node->bytes = bytes;
+        return node;
+    }
+
+    static std::unique_ptr<PatternNode> MakeBinary(const PatternNode::Kind kind, std::unique_ptr<PatternNode> left, std::unique_ptr<PatternNode> right)
+    {
+        auto node   = std::make_unique<PatternNode>();
+        node->kind  = kind;
+        node->left  = std::move(left);
+        node->right = std::move(right);
+        return node;
+    }
+
+    std::unique_ptr<PatternNode> ParseAlternation()
+    {
+        std::unique_ptr<PatternNode> node = ParseConcatenation();
+        while (!AtEnd() && '|' == pattern_[pos_])
+        {
+            ++pos_;
+            node = MakeBinary(PatternNode::Kind::ALTERNATE, std::move(node), ParseConcatenation());
+        }
+        return node;
+    }
+
+    std::unique_ptr<PatternNode> ParseConcatenation()
+    {
+        std::unique_ptr<PatternNode> node = std::make_unique<PatternNode>();
+        while (!AtEnd() && '|' != pattern_[pos_] && ')' != pattern_[pos_])
+        {
+            std::unique_ptr<PatternNode> item = ParseRepetition();
+            if (PatternNode::Kind::EMPTY == node->kind)
+            {
+                node = std::move(item);
+            }
+            else
+            {
+                node = MakeBinary(PatternNode::Kind::CONCAT, std::move(node), std::move(item));
+            }
+        }
+        return node;
+    }
+
+    std::unique_ptr<PatternNode> ParseRepetition()
+    {
+        std::unique_ptr<PatternNode> node       = ParseAtom();
+        bool                         quantified = false;
+
+        while (!AtEnd())
+        {
+            int        min = 0;
+            int        max = 0;
+            const char c   = pattern_[pos_];
+            if ('*' == c)
+            {
+                min = 0;
+                max = -1;
+                ++pos_;
+            }
+            else if ('+' == c)
+            {
+                min = 1;
+                max = -1;
+                ++pos_;
+            }
+            else if ('?' == c)
+            {
+                min = 0;
+                max = 1;
+                ++pos_;
+            }
+            else if ('{' == c)
+            {
+                if (!ParseBounds(min, max))
+                {
+                    return node;
+                }
+            }
+            else
+            {
+                break;
+            }
+
+            // Lazy and possessive quantifiers only make sense for backtracking engines
+            if (quantified)
+            {
+                Fail("nested quantifier (lazy and possessive quantifiers are not supported)");
+                return node;
+            }
+            quantified = true;
+
+            auto repeat  = std::make_unique<PatternNode>();
+            repeat->kind = PatternNode::Kind::REPEAT;
+            repeat->left = std::move(node);
+            repeat->min  = min;
+            repeat->max  = max;
+            node         = std::move(repeat);
+        }
+
+        return node;
+    }
+
+    bool ParseNumber(int& value)
+    {
+        size_t start = pos_;
+        value        = 0;
+        while (pos_ < end_ && '0' <= pattern_[pos_] && '9' >= pattern_[pos_])
+        {
+            value = value * 10 + (pattern_[pos_] - '0');
+            if (value > PatternCompiler::MAX_REPEAT)
+            {
+                Fail("repetition count exceeds " + std::to_string(PatternCompiler::MAX_REPEAT));
+                return false;
+            }
+            ++pos_;
+        }
+        return pos_ > start;
+    }
+
+    bool ParseBounds(int& min, int& max)
+    {
+        ++pos_; // '{'
+        if (!ParseNumber(min))
+        {
+            Fail("expected repetition count after '{' (use \\{ for a literal brace)");
+            return false;
+        }
+
+        max = min;
+        if (pos_ < end_ && ',' == pattern_[pos_])
+        {
+            ++pos_;
+            max = -1;
+            if (pos_ < end_ && '}' != pattern_[pos_] && !ParseNumber(max))
+            {
+                Fail("invalid repetition bound");
+                return false;
+            }
+        }
+
+        if (pos_ >= end_ || '}' != pattern_[pos_])
+        {
+            Fail("expected '}' to close repetition");
+            return false;
+        }
+        ++pos_;
+
+        if (-1 != max && max < min)
+        {
+            Fail("repetition bounds out of order");
+            return false;
+        }
+        return true;
+    }
+
+    std::unique_ptr<PatternNode> ParseAtom()
+    {
+        const char c = pattern_[pos_];
+        switch (c)
+        {
+            case '(':
+            {
+                ++pos_;
+                if (pos_ < end_ && '?' == pattern_[pos_])
+                {
+                    Fail("group modifiers and lookaround '(?' are not supported");
+                    return std::make_unique<PatternNode>();
+                }
+                std::unique_ptr<PatternNode> node = ParseAlternation();
+                if (pos_ >= end_ || ')' != pattern_[pos_])
+                {
+                    Fail("missing ')'");
+                    return node;
+                }
+                ++pos_;
+                return node;
+            }
+            case '[':
+                return ParseClass();
+            case '.':
+            {
+                ++pos_;
+                ByteSet any;
+                any.set();
+                any.reset('\n');
+                return MakeBytes(any);
+            }
+            case '\\':
+            {
+                ByteSet bytes;
+                ParseEscape(bytes, false);
+                return MakeBytes(bytes);
+            }
+            case '*':
+            case '+':
+            case '?':
+            case '{':
+                Fail(std::string("quantifier '") + c + "' without operand");
+                return std::make_unique<PatternNode>();
+            case '^':
+            case '$':
+                Fail("anchors are only supported at the start and end of a pattern (patterns always match the whole value)");
+                return std::make_unique<PatternNode>();
+            default:
+            {
+                ++pos_;
+                ByteSet bytes;
+                bytes.set(static_cast<uint8_t>(c));
+                return MakeBytes(bytes);
+            }
+        }
+    }
+
+    static int HexDigit(const char c)
+    {
+        if ('0' <= c && '9' >= c)
+        {
+            return c - '0';
+        }
+        if ('a' <= c && 'f' >= c)
+        {
+            return c - 'a' + 10;
+        }
+        if ('A' <= c && 'F' >= c)
+        {
+            return c - 'A' + 10;
+        }
+        return -1;
+    }
+
+    /// Parse an escape sequence; returns true if it denotes a single byte (usable in a range)
+    bool ParseEscape(ByteSet& bytes, const bool inClass)
+    {
+        ++pos_; // '\'
+        if (pos_ >= end_)
+        {
+            Fail("trailing backslash");
+            return false;
+        }
+
+        const char c = pattern_[pos_++];
+        ByteSet    digits;
+        ByteSet    word;
+        ByteSet    space;
+        for (int b = '0'; b <= '9'; ++b)
+        {
+            digits.set(b);
+        }
+        word = digits;
+        for (int b = 'a'; b <= 'z'; ++b)
+        {
+            word.set(b);
+            word.set(b - 'a' + 'A');
+        }
+        word.set('_');
+        for (const char s : std::string(" \t\n\r\f\v"))
+        {
+            space.set(static_cast<uint8_t>(s));
+        }
+
+        switch (c)
+        {
+            case 'd':
+                bytes |= digits;
+                return false;
+            case 'D':
+                bytes |= ~digits;
+                return false;
+            case 'w':
+                bytes |= word;
+                return false;
+            case 'W':
+                bytes |= ~word;
+                return false;
+            case 's':
+                bytes |= space;
+                return false;
+            case 'S':
+                bytes |= ~space;
+                return false;
+            case 't':
+                bytes.set('\t');
+                return true;
+            case 'n':
+                bytes.set('\n');
+                return true;
+            case 'r':
+                bytes.set('\r');
+                return true;
+            case 'x':
+            {
+                int high = (pos_ < end_) ? HexDigit(pattern_[pos_]) : -1;
+                int low  = (pos_ + 1 < end_) ? HexDigit(pattern_[pos_ + 1]) : -1;
+                if (high < 0 || low < 0)
+                {
+                    Fail("expected two hex digits after \\x");
+                    return false;
+                }
+                pos_ += 2;
+                bytes.set(static_cast<uint8_t>(high * 16 + low));
+                return true;
+            }
+            case 'b':
+            case 'B':
+                Fail(inClass ? "\\b is not supported in character classes" : "word boundaries are not supported");
+                return false;
+            default:
+                break;
+        }
+
+        if ('1' <= c && '9' >= c)
+        {
+            Fail("backreferences are not supported");
+            return false;
+        }
+        if (('a' <= c && 'z' >= c) || ('A' <= c && 'Z' >= c) || '0' == c)
+        {
+            Fail(std::string("unknown escape '\\") + c + "'");
+            return false;
+        }
+
+        // Escaped punctuation stands for itself
+        bytes.set(static_cast<uint8_t>(c));
+        return true;
+    }
+
+    std::unique_ptr<PatternNode> ParseClass()
+    {
+        ++pos_; // '['
+        bool negated = false;
+        if (pos_ < end_ && '^' == pattern_[pos_])
+        {
+            negated = true;
+            ++pos_;
+        }
+
+        ByteSet bytes;
+        bool    first = true;
+        while (pos_ < end_ && (first || ']' != pattern_[pos_]) && error_.empty())
+        {
+            first = false;
+
+            if ('[' == pattern_[pos_] && pos_ + 1 < end_ && ':' == pattern_[pos_ + 1])
+            {
+                Fail("POSIX character classes are not supported");
+                break;
+            }
+
+            // Parse the lower end of a potential range
+            ByteSet lowSet;
+            bool    single = true;
+            if ('\\' == pattern_[pos_])
+            {
+                single = ParseEscape(lowSet, true);
+            }
+            else
+            {
+                lowSet.set(static_cast<uint8_t>(pattern_[pos_++]));
+            }
+
+            if (single && pos_ + 1 < end_ && '-' == pattern_[pos_] && ']' != pattern_[pos_ + 1])
+            {
+                ++pos_; // '-'
+                ByteSet highSet;
+                bool    highSingle = true;
+                if ('\\' == pattern_[pos_])
+                {
+                    highSingle = ParseEscape(highSet, true);
+                }
+                else
+                {
+                    highSet.set(static_cast<uint8_t>(pattern_[pos_++]));
+                }
+
+                if (!highSingle)
+                {
+                    Fail("invalid range end in character class");
+                    break;
+                }
+
+                int low  = 0;
+                int high = 0;
+                while (!lowSet.test(low))
+                {
+                    ++low;
+                }
+                while (!highSet.test(high))
+                {
+                    ++high;
+                }
+                if (high < low)
+                {
+                    Fail("character range out of order");
+                    break;
+                }
+                for (int b = low; b <= high; ++b)
+                {
+                    bytes.set(b);
+                }
+            }
+            else
+            {
+                bytes |= lowSet;
+            }
+        }
+
+        if (error_.empty() && (pos_ >= end_ || ']' != pattern_[pos_]))
+        {
+            Fail("missing ']'");
+        }
+        ++pos_;
+
+        if (negated)
+        {
+            bytes.flip();
+        }
+        return MakeBytes(bytes);
+    }
+};
+
+// ============================================================================
+// Thompson NFA
+// ============================================================================
+
+/// \brief NFA with epsilon transitions and at most one byte-set transition per state
+struct Nfa
+{
+    struct State
+    {
+        std::vector<int> epsilon;
+        int              byteSet = -1; // index into byteSets, -1 for none
+        int              next    = -1; // target of the byte-set transition
+    };
+
+    std::vector<State>   states;
+    std::vector<ByteSet> byteSets;
+    bool                 tooLarge = false;
+
+    int AddState()
+    {
+        if (states.size() >= PatternCompiler::MAX_STATES * 16)
+        {
+            tooLarge = true;
+        }
+        states.emplace_back();
+        return static_cast<int>(states.size()) - 1;
+    }
+
+    /// Build the fragment for a node between the given entry and exit states
+    void Build(const PatternNode* node, const int entry, const int exit)
+    {
+        if (tooLarge)
+        {
+            return;
+        }
+
+        switch (node->kind)
+        {
+            case PatternNode::Kind::EMPTY:
+                states[entry].epsilon.push_back(exit);
+                break;
+            case PatternNode::Kind::BYTES:
+            {
+                int index = -1;
+                for (size_t i = 0; i < byteSets.size(); ++i)
+                {
+                    if (byteSets[i] == node->bytes)
+                    {
+                        index = static_cast<int>(i);
+                        break;
+                    }
+                }
+                if (-1 == index)
+                {
+                    byteSets.push_back(node->bytes);
+                    index = static_cast<int>(byteSets.size()) - 1;
+                }
+                int from = AddState();
+                states[entry].epsilon.push_back(from);
+                states[from].byteSet = index;
+                states[from].next    = exit;
+                break;
+            }
+            case PatternNode::Kind::CONCAT:
+            {
+                int middle = AddState();
+                Build(node->left.get(), entry, middle);
+                Build(node->right.get(), middle, exit);
+                break;
+            }
+            case PatternNode::Kind::ALTERNATE:
+                Build(node->left.get(), entry, exit);
+                Build(node->right.get(), entry, exit);
+                break;
+            case PatternNode::Kind::REPEAT:
+            {
+                // Mandatory copies first, then either optional copies or a loop
+                int current = entry;
+                for (int i = 0; i < node->min; ++i)
+                {
+                    int next = AddState();
+                    Build(node->left.get(), current, next);
+                    current = next;
+                }
+
+                if (-1 == node->max)
+                {
+                    int loop = AddState();
+                    states[current].epsilon.push_back(loop);
+                    Build(node->left.get(), loop, loop);
+                    states[loop].epsilon.push_back(exit);
+                }
+                else
+                {
+                    for (int i = node->min; i < node->max; ++i)
+                    {
+                        states[current].epsilon.push_back(exit);
+                        int next = AddState();
+                        Build(node->left.get(), current, next);
+                        current = next;
+                    }
+                    states[current].epsilon.push_back(exit);
+                }
+                break;
+            }
+        }
+    }
+
+    void Closure(std::vector<int>& set) const
+    {
+        std::vector<bool> seen(states.size(), false);
+        std::vector<int>  stack(set.begin(), set.end());
+        for (int s : set)
+        {
+            seen[s] = true;
+        }
+
+        while (false == stack.empty())
+        {
+            int s = stack.back();
+            stack.pop_back();
+            for (int t : states[s].epsilon)
+            {
+                if (!seen[t])
+                {
+                    seen[t] = true;
+                    set.push_back(t);
+                    stack.push_back(t);
+                }
+            }
+        }
+
+        std::sort(set.begin(), set.end());
+    }
+};
+} // namespace
+
+// ============================================================================
+// PatternDfa Implementation
+// ============================================================================
+
+PatternDfa::PatternDfa(
+    const std::array<uint8_t, 256>& byteClasses, const int classCount, std::vector<int32_t> transitions, std::vector<bool> accepting,
+    const int32_t startState) :
+    byteClasses_(byteClasses),
+    classCount_(classCount),
+    transitions_(std::move(transitions)),
+    accepting_(std::move(accepting)),
+    startState_(startState)
+{
+}
+
+bool PatternDfa::Matches(std::string_view input) const
+{
+    int32_t state = startState_;
+    for (const char c : input)
+    {
+        state = transitions_[static_cast<size_t>(state) * classCount_ + byteClasses_[static_cast<uint8_t>(c)]];
+        if (DEAD_STATE == state)
+        {
+            return false;
+        }
+    }
+    return accepting_[state];
+}
+
+size_t PatternDfa::GetStateCount() const
+{
+    return accepting_.size();
+}
+
+int PatternDfa::GetClassCount() const
+{
+    return classCount_;
+}
+
+int32_t PatternDfa::GetStartState() const
+{
+    return startState_;
+}
+
+int32_t PatternDfa::GetTransition(const int32_t state, const uint8_t byte) const
+{
+    return transitions_[static_cast<size_t>(state) * classCount_ + byteClasses_[byte]];
+}
+
+bool PatternDfa::IsAccepting(const int32_t state) const
+{
+    return accepting_[state];
+}
+
+const std::array<uint8_t, 256>& PatternDfa::GetByteClasses() const
+{
+    return byteClasses_;
+}
+
+const std::vector<int32_t>& PatternDfa::GetTransitions() const
+{
+    return transitions_;
+}
+
+// ============================================================================
+// PatternCompiler Implementation
+// ============================================================================
+
+std::unique_ptr<PatternDfa> PatternCompiler::Compile(const std::string& pattern, std::string& error)
+{
+    // Parse
+    PatternParser                parser(pattern);
+    std::unique_ptr<PatternNode> root = parser.Parse(error);
+    if (nullptr == root)
+    {
+        return nullptr;
+    }
+
+    // Thompson construction
+    Nfa nfa;
+    int nfaStart  = nfa.AddState();
+    int nfaAccept = nfa.AddState();
+    nfa.Build(root.get(), nfaStart, nfaAccept);
+    if (nfa.tooLarge)
+    {
+        error = "pattern is too complex";
+        return nullptr;
+    }
+
+    // Byte equivalence classes: bytes that no byte set distinguishes share a column
+    std::array<uint8_t, 256> byteClasses{};
+    int                      classCount = 1;
+    for (const ByteSet& set : nfa.byteSets)
+    {
+        std::map<std::pair<int, bool>, int> refined;
+        for (int b = 0; b < 256; ++b)
+        {
+            auto key = std::make_pair(static_cast<int>(byteClasses[b]), set.test(b));
+            auto it  = refined.find(key);
+            if (refined.end() == it)
+            {
+                it = refined.insert({key, static_cast<int>(refined.size())}).first;
+            }
+            byteClasses[b] = static_cast<uint8_t>(it->second);
+        }
+        classCount = static_cast<int>(refined.size());
+    }
+
+    std::vector<int> representative(classCount, 0);
+    for (int b = 255; b >= 0; --b)
+    {
+        representative[byteClasses[b]] = b;
+    }
+
+    // Subset construction (the empty set becomes the implicit dead state)
+    std::map<std::vector<int>, int32_t> dfaIndex;
+    std::vector<std::vector<int>>       dfaSets;
+    std::vector<int32_t>                transitions;
+
+    std::vector<int> startSet = {nfaStart};
+    nfa.Closure(startSet);
+    dfaIndex.insert({startSet, 0});
+    dfaSets.push_back(startSet);
+
+    for (size_t current = 0; current < dfaSets.size(); ++current)
+    {
+        for (int c = 0; c < classCount; ++c)
+        {
+            std::vector<int> target;
+            for (int s : dfaSets[current])
+            {
+                const Nfa::State& state = nfa.states[s];
+                if (-1 != state.byteSet && nfa.byteSets[state.byteSet].test(representative[c]))
+                {
+                    target.push_back(state.next);
+                }
+            }
+
+            if (target.empty())
+            {
+                transitions.push_back(PatternDfa::DEAD_STATE);
+                continue;
+            }
+
+            nfa.Closure(target);
+            target.erase(std::unique(target.begin(), target.end()), target.end());
+
+            auto it = dfaIndex.find(target);
+            if (dfaIndex.end() == it)
+            {
+                if (dfaSets.size() >= MAX_STATES)
+                {
+                    error = "pattern is too complex (more than " + std::to_string(MAX_STATES) + " states)";
+                    return nullptr;
+                }
+                it = dfaIndex.insert({target, static_cast<int32_t>(dfaSets.size())}).first;
+                dfaSets.push_back(target);
+            }
+            transitions.push_back(it->second);
+        }
+    }
+
+    const size_t      stateCount = dfaSets.size();
+    std::vector<bool> accepting(stateCount, false);
+    for (size_t s = 0; s < stateCount; ++s)
+    {
+        accepting[s] = std::binary_search(dfaSets[s].begin(), dfaSets[s].end(), nfaAccept);
+    }
+
+    // Moore minimization: refine the accepting/non-accepting partition until
+    // states in a block agree on the block of every successor
+    std::vector<int> block(stateCount);
+    for (size_t s = 0; s < stateCount; ++s)
+    {
+        block[s] = accepting[s] ? 1 : 0;
+    }
+
+    size_t blockCount = 0;
+    while (true)
+    {
+        std::map<std::vector<int>, int> signatures;
+        std::vector<int>                refined(stateCount);
+        for (size_t s = 0; s < stateCount; ++s)
+        {
+            std::vector<int> signature;
+            signature.reserve(classCount + 1);
+            signature.push_back(block[s]);
+            for (int c = 0; c < classCount; ++c)
+            {
+                int32_t target = transitions[s * classCount + c];
+                signature.push_back(PatternDfa::DEAD_STATE == target ? -1 : block[target]);
+            }
+
+            auto it = signatures.find(signature);
+            if (signatures.end() == it)
+            {
+                it = signatures.insert({std::move(signature), static_cast<int>(signatures.size())}).first;
+            }
+            refined[s] = it->second;
+        }
+
+        block = std::move(refined);
+        if (signatures.size() == blockCount)
+        {
+            break;
+        }
+        blockCount = signatures.size();
+    }
+
+    // Build the minimized tables, numbering blocks in discovery order from the start state
+    std::vector<int32_t> blockIndex(blockCount, -1);
+    std::vector<size_t>  blockRepresentative;
+    blockIndex[block[0]] = 0;
+    blockRepresentative.push_back(0);
+    for (size_t i = 0; i < blockRepresentative.size(); ++i)
+    {
+        for (int c = 0; c < classCount; ++c)
+        {
+            int32_t target = transitions[blockRepresentative[i] * classCount + c];
+            if (PatternDfa::DEAD_STATE != target && -1 == blockIndex[block[target]])
+            {
+                blockIndex[block[target]] = static_cast<int32_t>(blockRepresentative.size());
+                blockRepresentative.push_back(static_cast<size_t>(target));
+            }
+        }
+    }
+
+    std::vector<int32_t> minimizedTransitions;
+    std::vector<bool>    minimizedAccepting;
+    minimizedTransitions.reserve(blockRepresentative.size() * classCount);
+    for (size_t representativeState : blockRepresentative)
+    {
+        for (int c = 0; c < classCount; ++c)
+        {
+            int32_t target = transitions[representativeState * classCount + c];
+            minimizedTransitions.push_back(PatternDfa::DEAD_STATE == target ? PatternDfa::DEAD_STATE : blockIndex[block[target]]);
+        }
+        minimizedAccepting.push_back(accepting[representativeState]);
+    }
+
+    return std::make_unique<PatternDfa>(byteClasses, classCount, std::move(minimizedTransitions), std::move(minimizedAccepting), 0);
+}
+} // namespace bbfm
@@ -0,0 +1,178 @@
+#include "PerfCounters.h"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+// First errno of a refused event (0 if none was refused)
+std::atomic<int> g_error{0};
+
+#ifdef __linux__
+/// \brief Events of a counter group, the first one leads
+struct EventConfig
+{
+    bbfm::PerfCounters::Event event;
+    uint64_t                  config;
+};
+
+const EventConfig EVENTS[] = {
+    {bbfm::PerfCounters::CYCLES, PERF_COUNT_HW_CPU_CYCLES},
+    {bbfm::PerfCounters::INSTRUCTIONS, PERF_COUNT_HW_INSTRUCTIONS},
+    {bbfm::PerfCounters::CACHE_MISSES, PERF_COUNT_HW_CACHE_MISSES},
+    {bbfm::PerfCounters::BRANCH_MISSES, PERF_COUNT_HW_BRANCH_MISSES},
+};
+const size_t EVENT_COUNT = sizeof(EVENTS) / sizeof(EVENTS[0]);
+
+/// \brief Counter group of one thread, opened on first use
+class ThreadCounters
+{
+public:
+    ThreadCounters()
+    {
+        for (size_t i = 0; i < EVENT_COUNT; ++i)
+        {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size           = sizeof(attr);
+            attr.type           = PERF_TYPE_HARDWARE;
+            attr.config         = EVENTS[i].config;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv     = 1;
+            attr.read_format    = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            attr.disabled       = (-1 == leader_) ? 1 : 0;
+
+            // pid 0 and cpu -1: the calling thread on any CPU
+            const int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader_, 0));
+            if (-1 == fd)
+            {
+                int expected = 0;
+                g_error.compare_exchange_strong(expected, errno);
+                continue;
+            }
+            fds_[count_]    = fd;
+            events_[count_] = EVENTS[i].event;
+            ++count_;
+            if (-1 == leader_)
+            {
+                leader_ = fd;
+            }
+        }
+        if (-1 != leader_)
+        {
+            ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+    }
+
+    ~ThreadCounters()
+    {
+        for (size_t i = 0; i < count_; ++i)
+        {
+            close(fds_[i]);
+        }
+    }
+
+    ThreadCounters(const ThreadCounters&)            = delete;
+    ThreadCounters& operator=(const ThreadCounters&) = delete;
+
+    bool Read(bbfm::PerfCounts& counts) const
+    {
+        counts = bbfm::PerfCounts();
+        if (-1 == leader_)
+        {
+            return false;
+        }
+
+        // nr, time enabled, time running, then one value per event
+        uint64_t data[3 + EVENT_COUNT];
+        if (read(leader_, data, sizeof(data)) < static_cast<ssize_t>((3 + count_) * sizeof(uint64_t)) || 0 == data[2])
+        {
+            return false;
+        }
+        const double scale = static_cast<double>(data[1]) / static_cast<double>(data[2]);
+        for (size_t i = 0; i < count_ && i < data[0]; ++i)
+        {
+            const uint64_t value = static_cast<uint64_t>(static_cast<double>(data[3 + i]) * scale);
+            switch (events_[i])
+            {
+                case bbfm::PerfCounters::CYCLES:
+                    counts.cycles = value;
+                    break;
+                case bbfm::PerfCounters::INSTRUCTIONS:
+                    counts.instructions = value;
+                    break;
+                case bbfm::PerfCounters::CACHE_MISSES:
+                    counts.cacheMisses = value;
+                    break;
+                case bbfm::PerfCounters::BRANCH_MISSES:
+                    counts.branchMisses = value;
+                    break;
+            }
+            counts.events |= events_[i];
+        }
+        return true;
+    }
+
+private:
+    int                       fds_[EVENT_COUNT];
+    bbfm::PerfCounters::Event events_[EVENT_COUNT];
+    size_t                    count_  = 0;
+    int                       leader_ = -1;
+};
+#endif
+} // namespace
+
+namespace bbfm {
+bool PerfCounters::Read(PerfCounts& counts)
+{
+#ifdef __linux__
+    thread_local const ThreadCounters counters;
+    return counters.Read(counts);
+#else
+    g_error.store(ENOSYS);
+    counts = PerfCounts();
+    return false;
+#endif
+}
+
+PerfCounts PerfCounters::Difference(const PerfCounts& start, const PerfCounts& end)
+{
+    // Scaled counts of a multiplexed group can step back slightly
+    const auto delta = [](const uint64_t before, const uint64_t after) { return after > before ? after - before : 0; };
+
+    PerfCounts difference;
+    difference.events       = start.events & end.events;
+    difference.cycles       = (0 != (difference.events & CYCLES)) ? delta(start.cycles, end.cycles) : 0;
+    difference.instructions = (0 != (difference.events & INSTRUCTIONS)) ? delta(start.instructions, end.instructions) : 0;
+    difference.cacheMisses  = (0 != (difference.events & CACHE_MISSES)) ? delta(start.cacheMisses, end.cacheMisses) : 0;
+    difference.branchMisses = (0 != (difference.events & BRANCH_MISSES)) ? delta(start.branchMisses, end.branchMisses) : 0;
+    return difference;
+}
+
+std::string PerfCounters::GetUnavailableReason()
+{
+    const int error = g_error.load();
+    switch (error)
+    {
+        case 0:
+            return std::string();
+        case EACCES:
+        case EPERM:
+            return "permission denied (see /proc/sys/kernel/perf_event_paranoid, or the container's seccomp profile)";
+        case ENOENT:
+        case EOPNOTSUPP:
+            return "event not supported by this CPU or virtual machine";
+        case ENOSYS:
+            return "perf_event_open is not available on this system";
+        default:
+            return strerror(error);
+    }
+}
+} // namespace bbfm
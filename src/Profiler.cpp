@@ -0,0 +1,367 @@
+#include "Profiler.h"
+#include "AllocTracker.h"
+#include "Console.h"
+#include "Json.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sys/resource.h>
+
+namespace {
+std::atomic<bool>                     g_enabled{false};
+std::mutex                            g_mutex; // Guards g_spans
+std::vector<bbfm::ProfileSpan>        g_spans;
+std::chrono::steady_clock::time_point g_start = std::chrono::steady_clock::now();
+std::atomic<int>                      g_nextTrack{0};
+std::atomic<bbfm::PerfCounterMode>    g_perfMode{bbfm::PerfCounterMode::OFF};
+
+/// \brief Get the track of the calling thread, numbered in order of first use
+int CurrentTrack()
+{
+    thread_local const int track = g_nextTrack++;
+    return track;
+}
+
+/// \brief CPU time consumed by the calling thread in microseconds
+double ThreadCpuUs()
+{
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return static_cast<double>(now.tv_sec) * 1e6 + static_cast<double>(now.tv_nsec) / 1e3;
+}
+
+/// \brief Peak resident set size of the process in KB
+long PeakRssKb()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/// \brief Format the heading of a time report table
+std::string FormatHeading(const char* name, const bool withRss)
+{
+    char row[160];
+    snprintf(row, sizeof(row), withRss ? "  %-36s %10s %10s %12s" : "  %-36s %10s %10s", name, "Wall ms", "CPU ms", "Peak RSS MB");
+    return row;
+}
+
+/// \brief Format a row of the time report (without the RSS column if peakRssKb is negative)
+std::string FormatRow(const std::string& name, const double wallUs, const double cpuUs, const long peakRssKb)
+{
+    char row[160];
+    if (peakRssKb >= 0)
+    {
+        snprintf(row, sizeof(row), "  %-36s %10.2f %10.2f %12.1f", name.c_str(), wallUs / 1e3, cpuUs / 1e3, static_cast<double>(peakRssKb) / 1024.0);
+    }
+    else
+    {
+        snprintf(row, sizeof(row), "  %-36s %10.2f %10.2f", name.c_str(), wallUs / 1e3, cpuUs / 1e3);
+    }
+    return row;
+}
+/// \brief Check if spans of a category are measured with hardware counters
+bool CountsPerf(const char* category)
+{
+    const bbfm::PerfCounterMode mode = g_perfMode.load(std::memory_order_relaxed);
+    if (bbfm::PerfCounterMode::OFF == mode)
+    {
+        return false;
+    }
+    return 0 == strcmp(category, "phase") || 0 == strcmp(category, "output") || (bbfm::PerfCounterMode::PASSES == mode && 0 == strcmp(category, "pass"));
+}
+
+/// \brief Format a counter in millions, or "-" if it was not measured
+std::string FormatMillions(const bbfm::PerfCounts& counts, const unsigned event, const uint64_t value)
+{
+    char cell[32];
+    snprintf(cell, sizeof(cell), "%10.2f", static_cast<double>(value) / 1e6);
+    return (0 != (counts.events & event)) ? std::string(cell) : std::string("         -");
+}
+
+/// \brief Format a ratio, or "-" if one of its counters was not measured
+std::string FormatRatio(const bool measured, const double numerator, const double denominator)
+{
+    char cell[32];
+    snprintf(cell, sizeof(cell), "%10.2f", numerator / denominator);
+    return (measured && denominator > 0.0) ? std::string(cell) : std::string("         -");
+}
+
+/// \brief Format a row of the hardware counter table
+std::string FormatCounterRow(const std::string& name, const bbfm::PerfCounts& counts)
+{
+    using bbfm::PerfCounters;
+    const double instructions = static_cast<double>(counts.instructions);
+    const bool   hasInstr     = 0 != (counts.events & PerfCounters::INSTRUCTIONS);
+
+    char label[64];
+    snprintf(label, sizeof(label), "  %-36s", name.c_str());
+    return std::string(label) + " " + FormatMillions(counts, PerfCounters::CYCLES, counts.cycles) + " " +
+           FormatMillions(counts, PerfCounters::INSTRUCTIONS, counts.instructions) + " " +
+           FormatRatio(hasInstr && 0 != (counts.events & PerfCounters::CYCLES), instructions, static_cast<double>(counts.cycles)) + " " +
+           FormatRatio(hasInstr && 0 != (counts.events & PerfCounters::CACHE_MISSES), static_cast<double>(counts.cacheMisses) * 1000.0, instructions) + " " +
+           FormatRatio(hasInstr && 0 != (counts.events & PerfCounters::BRANCH_MISSES), static_cast<double>(counts.branchMisses) * 1000.0, instructions);
+}
+} // namespace
+
+namespace bbfm {
+void Profiler::Start()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_spans.clear();
+    g_start = std::chrono::steady_clock::now();
+    g_enabled.store(true);
+}
+
+void Profiler::Stop()
+{
+    g_enabled.store(false);
+}
+
+void Profiler::SetPerfCounterMode(const PerfCounterMode mode)
+{
+    g_perfMode.store(mode);
+}
+
+bool Profiler::IsEnabled()
+{
+    return g_enabled.load(std::memory_order_relaxed);
+}
+
+void Profiler::Record(ProfileSpan span)
+{
+    span.track = CurrentTrack();
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_spans.push_back(std::move(span));
+}
+
+std::vector<ProfileSpan> Profiler::GetSpans()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return g_spans;
+}
+
+double Profiler::Now()
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - g_start).count();
+}
+
+void Profiler::WriteReport(std::ostream& out, const size_t maxClasses)
+{
+    std::vector<ProfileSpan> spans = GetSpans();
+    std::stable_sort(spans.begin(), spans.end(), [](const ProfileSpan& a, const ProfileSpan& b) { return a.startUs < b.startUs; });
+
+    // Phases and outputs in the order they ran
+    out << "\nTime report:\n";
+    out << FormatHeading("Phase", true) << "\n";
+    double first = -1.0;
+    double last  = 0.0;
+    double cpuUs = 0.0;
+    long   rssKb = 0;
+    for (const ProfileSpan& span : spans)
+    {
+        if ("phase" == span.category || "output" == span.category)
+        {
+            out << FormatRow(span.name, span.wallUs, span.cpuUs, span.peakRssKb) << "\n";
+            first = (first < 0.0) ? span.startUs : std::min(first, span.startUs);
+            last  = std::max(last, span.startUs + span.wallUs);
+            cpuUs += span.cpuUs;
+            rssKb = std::max(rssKb, span.peakRssKb);
+        }
+    }
+    if (first >= 0.0)
+    {
+        out << FormatRow("Total", last - first, cpuUs, rssKb) << "\n";
+    }
+
+    // Hardware counters of the same spans, passes indented below their phase
+    if (PerfCounterMode::OFF != g_perfMode.load())
+    {
+        bool measured = false;
+        for (const ProfileSpan& span : spans)
+        {
+            measured = measured || 0 != span.counters.events;
+        }
+        if (!measured)
+        {
+            out << "\nHardware counters unavailable: " << PerfCounters::GetUnavailableReason() << "\n";
+        }
+        else
+        {
+            char heading[160];
+            snprintf(heading, sizeof(heading), "  %-36s %10s %10s %10s %10s %10s", "Phase", "Cycles M", "Instr M", "IPC", "Cache MPKI", "Branch MPKI");
+            out << "\nHardware counters (user space, MPKI: misses per 1000 instructions):\n" << heading << "\n";
+            for (const ProfileSpan& span : spans)
+            {
+                if (0 != span.counters.events)
+                {
+                    out << FormatCounterRow(("pass" == span.category ? "  " : "") + span.name, span.counters) << "\n";
+                }
+            }
+        }
+    }
+
+    // Classes by validation cost, to find pathological ones
+    std::vector<ProfileSpan> classes;
+    double                   classUs = 0.0;
+    for (const ProfileSpan& span : spans)
+    {
+        if ("class" == span.category)
+        {
+            classes.push_back(span);
+            classUs += span.wallUs;
+        }
+    }
+    if (classes.empty())
+    {
+        return;
+    }
+    std::stable_sort(classes.begin(), classes.end(), [](const ProfileSpan& a, const ProfileSpan& b) { return a.wallUs > b.wallUs; });
+
+    char summary[128];
+    snprintf(summary, sizeof(summary), "\nSlowest classes (semantic validation, %zu of %zu, %.2f ms in total):\n", std::min(maxClasses, classes.size()),
+        classes.size(), classUs / 1e3);
+    out << summary;
+    out << FormatHeading("Class", false) << "\n";
+    for (size_t i = 0; i < classes.size() && i < maxClasses; ++i)
+    {
+        out << FormatRow(classes[i].name, classes[i].wallUs, classes[i].cpuUs, -1) << "\n";
+    }
+}
+
+bool Profiler::WriteTrace(const std::string& path)
+{
+    const std::vector<ProfileSpan> spans = GetSpans();
+
+    JsonValue events      = JsonValue::MakeArray();
+    JsonValue processName = JsonValue::MakeObject();
+    processName.Set("name", "process_name").Set("ph", "M").Set("pid", 1).Set("tid", 0).Set("args", JsonValue::MakeObject().Set("name", "model-compiler"));
+    events.Append(std::move(processName));
+
+    // One named track per thread
+    std::map<int, bool> tracks;
+    for (const ProfileSpan& span : spans)
+    {
+        tracks[span.track] = true;
+    }
+    for (const auto& track : tracks)
+    {
+        const std::string name       = (0 == track.first) ? std::string("Main thread") : "Thread " + std::to_string(track.first);
+        JsonValue         threadName = JsonValue::MakeObject();
+        threadName.Set("name", "thread_name").Set("ph", "M").Set("pid", 1).Set("tid", track.first).Set("args", JsonValue::MakeObject().Set("name", name));
+        events.Append(std::move(threadName));
+    }
+
+    // Complete events ("X"), times in microseconds
+    for (const ProfileSpan& span : spans)
+    {
+        JsonValue args = JsonValue::MakeObject();
+        args.Set("cpu_ms", span.cpuUs / 1e3).Set("peak_rss_kb", static_cast<double>(span.peakRssKb));
+        if (0 != (span.counters.events & PerfCounters::CYCLES))
+        {
+            args.Set("cycles", static_cast<double>(span.counters.cycles));
+        }
+        if (0 != (span.counters.events & PerfCounters::INSTRUCTIONS))
+        {
+            args.Set("instructions", static_cast<double>(span.counters.instructions));
+        }
+        if (0 != (span.counters.events & PerfCounters::CACHE_MISSES))
+        {
+            args.Set("cache_misses", static_cast<double>(span.counters.cacheMisses));
+        }
+        if (0 != (span.counters.events & PerfCounters::BRANCH_MISSES))
+        {
+            args.Set("branch_misses", static_cast<double>(span.counters.branchMisses));
+        }
+
+        JsonValue event = JsonValue::MakeObject();
+        event.Set("name", span.name).Set("cat", span.category).Set("ph", "X").Set("ts", span.startUs).Set("dur", span.wallUs);
+        event.Set("pid", 1).Set("tid", span.track).Set("args", std::move(args));
+        events.Append(std::move(event));
+    }
+
+    JsonValue trace = JsonValue::MakeObject();
+    trace.Set("traceEvents", std::move(events)).Set("displayTimeUnit", "ms");
+
+    std::ofstream out(path, std::ios::binary);
+    return out.is_open() && (out << trace.Serialize() << "\n") && out.flush();
+}
+
+ProfileScope::ProfileScope(const char* category, const std::string& name) :
+    enabled_(Profiler::IsEnabled()), category_(category), startUs_(0.0), cpuStartUs_(0.0), countPerf_(false), previousAllocPhase_(-1)
+{
+    if (AllocTracker::IsEnabled() && (0 == strcmp(category, "phase") || 0 == strcmp(category, "output")))
+    {
+        previousAllocPhase_ = AllocTracker::EnterPhase(name);
+    }
+    if (enabled_)
+    {
+        name_       = name;
+        startUs_    = Profiler::Now();
+        cpuStartUs_ = ThreadCpuUs();
+        countPerf_  = CountsPerf(category) && PerfCounters::Read(perfStart_);
+    }
+}
+
+ProfileScope::~ProfileScope()
+{
+    if (previousAllocPhase_ >= 0)
+    {
+        AllocTracker::LeavePhase(previousAllocPhase_);
+    }
+    if (enabled_ && Profiler::IsEnabled())
+    {
+        ProfileSpan span;
+        span.category  = category_;
+        span.name      = std::move(name_);
+        span.startUs   = startUs_;
+        span.wallUs    = Profiler::Now() - startUs_;
+        span.cpuUs     = ThreadCpuUs() - cpuStartUs_;
+        span.peakRssKb = PeakRssKb();
+        span.track     = 0;
+        if (countPerf_)
+        {
+            PerfCounts perfEnd;
+            if (PerfCounters::Read(perfEnd))
+            {
+                span.counters = PerfCounters::Difference(perfStart_, perfEnd);
+            }
+        }
+        Profiler::Record(std::move(span));
+    }
+}
+
+ProfileSession::ProfileSession(const bool printReport, const std::string& tracePath, const PerfCounterMode perfCounters) :
+    printReport_(printReport || PerfCounterMode::OFF != perfCounters), tracePath_(tracePath)
+{
+    Profiler::SetPerfCounterMode(perfCounters);
+    if (printReport_ || false == tracePath_.empty())
+    {
+        Profiler::Start();
+    }
+}
+
+ProfileSession::~ProfileSession()
+{
+    if (!printReport_ && tracePath_.empty())
+    {
+        return;
+    }
+    Profiler::Stop();
+    if (printReport_)
+    {
+        Profiler::WriteReport(std::cout);
+    }
+    if (false == tracePath_.empty() && !Profiler::WriteTrace(tracePath_))
+    {
+        Console::ReportError("Error: Could not write trace to '" + tracePath_ + "'");
+    }
+}
+} // namespace bbfm
@@ -0,0 +1,769 @@
+#include "SchemaDiff.h"
+#include <algorithm>
+#include <iostream>
+#include <set>
+
+namespace bbfm {
+// ============================================================================
+// SchemaChange Implementation
+// ============================================================================
+
+const char* SchemaChange::KindToString(const ChangeKind kind)
+{
+    switch (kind)
+    {
+        case ChangeKind::ENUM_ADDED:
+            return "enum added";
+        case ChangeKind::ENUM_REMOVED:
+            return "enum removed";
+        case ChangeKind::ENUM_VALUE_ADDED:
+            return "enum value added";
+        case ChangeKind::ENUM_VALUE_REMOVED:
+            return "enum value removed";
+        case ChangeKind::ENUM_CODES_REMAPPED:
+            return "enum codes remapped";
+        case ChangeKind::CLASS_ADDED:
+            return "class added";
+        case ChangeKind::CLASS_REMOVED:
+            return "class removed";
+        case ChangeKind::CLASS_RENAMED:
+            return "class renamed";
+        case ChangeKind::FIELD_ADDED_OPTIONAL:
+            return "field added (optional)";
+        case ChangeKind::FIELD_ADDED_MANDATORY:
+            return "field added (mandatory)";
+        case ChangeKind::FIELD_REMOVED:
+            return "field removed";
+        case ChangeKind::TYPE_WIDENED:
+            return "type widened";
+        case ChangeKind::TYPE_CONVERTED:
+            return "type converted";
+        case ChangeKind::TYPE_CHANGED:
+            return "type changed";
+        case ChangeKind::CARDINALITY_RELAXED:
+            return "cardinality relaxed";
+        case ChangeKind::CARDINALITY_TIGHTENED:
+            return "cardinality tightened";
+        case ChangeKind::STORAGE_CHANGED:
+            return "storage changed";
+        case ChangeKind::COMPUTED_CHANGED:
+            return "computed feature changed";
+        case ChangeKind::INVARIANT_ADDED:
+            return "invariant added";
+        case ChangeKind::INVARIANT_REMOVED:
+            return "invariant removed";
+        default:
+            return "unknown";
+    }
+}
+
+// ============================================================================
+// SchemaDiff Implementation
+// ============================================================================
+
+SchemaDiff::SchemaDiff(
+    const SemanticAnalyzer* oldAnalyzer, const LayoutBuilder* oldLayouts, const SemanticAnalyzer* newAnalyzer, const LayoutBuilder* newLayouts) :
+    oldAnalyzer_(oldAnalyzer),
+    oldLayouts_(oldLayouts),
+    newAnalyzer_(newAnalyzer),
+    newLayouts_(newLayouts),
+    oldFingerprinter_(oldAnalyzer),
+    newFingerprinter_(newAnalyzer)
+{
+}
+
+void SchemaDiff::Compute()
+{
+    changes_.clear();
+    migrations_.clear();
+
+    CompareEnums();
+    CompareClasses();
+}
+
+const std::vector<SchemaChange>& SchemaDiff::GetChanges() const
+{
+    return changes_;
+}
+
+const std::vector<ClassMigration>& SchemaDiff::GetMigrations() const
+{
+    return migrations_;
+}
+
+bool SchemaDiff::IsCompatible() const
+{
+    return std::none_of(changes_.begin(), changes_.end(), [](const SchemaChange& change) { return change.breaking; });
+}
+
+void SchemaDiff::AddChange(const ChangeKind kind, const std::string& typeName, const std::string& fieldName, const std::string& detail, const bool breaking)
+{
+    changes_.push_back({kind, typeName, fieldName, detail, breaking});
+}
+
+void SchemaDiff::CompareEnums()
+{
+    const auto& oldEnums = oldLayouts_->GetEnumFingerprints();
+    const auto& newEnums = newLayouts_->GetEnumFingerprints();
+
+    for (const auto& entry : newEnums)
+    {
+        auto oldEntry = oldEnums.find(entry.first);
+        if (oldEnums.end() == oldEntry)
+        {
+            AddChange(ChangeKind::ENUM_ADDED, entry.first, "", "", false);
+            continue;
+        }
+
+        // Equal fingerprints: same values in the same order
+        if (oldEntry->second == entry.second)
+        {
+            continue;
+        }
+
+        const EnumDeclaration*          oldEnum   = FindEnum(oldAnalyzer_, entry.first);
+        const EnumDeclaration*          newEnum   = FindEnum(newAnalyzer_, entry.first);
+        const std::vector<std::string>& oldValues = oldEnum->GetValues();
+        const std::vector<std::string>& newValues = newEnum->GetValues();
+
+        for (const auto& value : oldValues)
+        {
+            if (newValues.end() == std::find(newValues.begin(), newValues.end(), value))
+            {
+                AddChange(ChangeKind::ENUM_VALUE_REMOVED, entry.first, value, "", true);
+            }
+        }
+        for (const auto& value : newValues)
+        {
+            if (oldValues.end() == std::find(oldValues.begin(), oldValues.end(), value))
+            {
+                AddChange(ChangeKind::ENUM_VALUE_ADDED, entry.first, value, "", false);
+            }
+        }
+        if (!EnumCodesStable(oldEnum, newEnum))
+        {
+            AddChange(ChangeKind::ENUM_CODES_REMAPPED, entry.first, "", "stored codes are translated", false);
+        }
+    }
+
+    for (const auto& entry : oldEnums)
+    {
+        if (0 == newEnums.count(entry.first))
+        {
+            AddChange(ChangeKind::ENUM_REMOVED, entry.first, "", "", false);
+        }
+    }
+}
+
+void SchemaDiff::CompareClasses()
+{
+    const auto& oldClasses = oldLayouts_->GetLayouts();
+    const auto& newClasses = newLayouts_->GetLayouts();
+
+    // A removed and an added class with the same structure (the canonical form
+    // without the name) are a rename. Renames are found first, so references to
+    // a renamed class are not reported as type changes.
+    std::map<uint64_t, const ClassLayout*> removedByStructure;
+    for (const auto& entry : oldClasses)
+    {
+        if (0 == newClasses.count(entry.first))
+        {
+            const std::string canonical = oldFingerprinter_.CanonicalClass(entry.second.classChain.back());
+            removedByStructure.insert({SchemaFingerprinter::Hash(canonical.substr(canonical.find('\n'))), &entry.second});
+        }
+    }
+
+    renamedClasses_.clear();
+    for (const auto& entry : newClasses)
+    {
+        if (0 == oldClasses.count(entry.first))
+        {
+            const std::string canonical = newFingerprinter_.CanonicalClass(entry.second.classChain.back());
+            auto              match     = removedByStructure.find(SchemaFingerprinter::Hash(canonical.substr(canonical.find('\n'))));
+            if (removedByStructure.end() != match)
+            {
+                renamedClasses_.insert({match->second->className, entry.first});
+                removedByStructure.erase(match);
+            }
+        }
+    }
+
+    for (const auto& entry : newClasses)
+    {
+        auto oldEntry = oldClasses.find(entry.first);
+        if (oldClasses.end() != oldEntry)
+        {
+            // Equal fingerprints imply equal layouts, so the field comparison is skipped
+            if (oldEntry->second.fingerprint != entry.second.fingerprint)
+            {
+                CompareFields(oldEntry->second, entry.second);
+            }
+            migrations_.push_back(PlanMigration(oldEntry->second, entry.second));
+            continue;
+        }
+
+        auto renamed = std::find_if(renamedClasses_.begin(), renamedClasses_.end(), [&entry](const auto& rename) { return rename.second == entry.first; });
+        if (renamedClasses_.end() != renamed)
+        {
+            const ClassLayout& oldLayout = oldClasses.at(renamed->first);
+            AddChange(ChangeKind::CLASS_RENAMED, entry.first, "", renamed->first + " -> " + entry.first, false);
+            migrations_.push_back(PlanMigration(oldLayout, entry.second));
+        }
+        else
+        {
+            AddChange(ChangeKind::CLASS_ADDED, entry.first, "", "", false);
+        }
+    }
+
+    for (const auto& entry : oldClasses)
+    {
+        if (0 == newClasses.count(entry.first) && 0 == renamedClasses_.count(entry.first))
+        {
+            AddChange(ChangeKind::CLASS_REMOVED, entry.first, "", "stored objects are dropped", true);
+        }
+    }
+}
+
+void SchemaDiff::CompareFields(const ClassLayout& oldLayout, const ClassLayout& newLayout)
+{
+    const std::string&              className = newLayout.className;
+    const std::vector<const Field*> oldFields = DeclaredFields(oldLayout);
+    const std::vector<const Field*> newFields = DeclaredFields(newLayout);
+
+    auto findField = [](const std::vector<const Field*>& fields, const std::string& name) -> const Field*
+    {
+        for (const Field* field : fields)
+        {
+            if (field->GetName() == name)
+            {
+                return field;
+            }
+        }
+        return nullptr;
+    };
+
+    for (const Field* newField : newFields)
+    {
+        const Field* oldField = findField(oldFields, newField->GetName());
+        if (nullptr == oldField)
+        {
+            const CardinalityModifier* cardinality = newField->GetCardinalityModifier();
+            if (newField->IsComputed())
+            {
+                AddChange(ChangeKind::COMPUTED_CHANGED, className, newField->GetName(), "added", false);
+            }
+            else if (nullptr != cardinality && cardinality->IsOptional())
+            {
+                AddChange(ChangeKind::FIELD_ADDED_OPTIONAL, className, newField->GetName(), TypeName(newField), false);
+            }
+            else
+            {
+                AddChange(ChangeKind::FIELD_ADDED_MANDATORY, className, newField->GetName(), TypeName(newField) + ", existing objects get a zero value", true);
+            }
+            continue;
+        }
+
+        // Unchanged canonical form: only the offsets may differ
+        if (oldFingerprinter_.CanonicalField(oldField) != newFingerprinter_.CanonicalField(newField))
+        {
+            CompareField(className, oldField, newField);
+        }
+    }
+
+    for (const Field* oldField : oldFields)
+    {
+        if (nullptr == findField(newFields, oldField->GetName()))
+        {
+            if (oldField->IsComputed())
+            {
+                AddChange(ChangeKind::COMPUTED_CHANGED, className, oldField->GetName(), "removed", false);
+            }
+            else
+            {
+                AddChange(ChangeKind::FIELD_REMOVED, className, oldField->GetName(), "stored values are dropped", true);
+            }
+        }
+    }
+
+    // Invariants are compared in canonical form, independent of their names and order
+    std::multiset<std::string> oldInvariants;
+    std::multiset<std::string> newInvariants;
+    for (const ClassDeclaration* classDecl : oldLayout.classChain)
+    {
+        for (const auto& invariant : classDecl->GetInvariants())
+        {
+            oldInvariants.insert(SchemaFingerprinter::CanonicalExpression(invariant->GetExpression()));
+        }
+    }
+    for (const ClassDeclaration* classDecl : newLayout.classChain)
+    {
+        for (const auto& invariant : classDecl->GetInvariants())
+        {
+            const std::string canonical = SchemaFingerprinter::CanonicalExpression(invariant->GetExpression());
+            if (0 == oldInvariants.count(canonical))
+            {
+                AddChange(ChangeKind::INVARIANT_ADDED, className, invariant->GetName(), canonical, true);
+            }
+            newInvariants.insert(canonical);
+        }
+    }
+    for (const ClassDeclaration* classDecl : oldLayout.classChain)
+    {
+        for (const auto& invariant : classDecl->GetInvariants())
+        {
+            const std::string canonical = SchemaFingerprinter::CanonicalExpression(invariant->GetExpression());
+            if (0 == newInvariants.count(canonical))
+            {
+                AddChange(ChangeKind::INVARIANT_REMOVED, className, invariant->GetName(), canonical, false);
+            }
+        }
+    }
+}
+
+void SchemaDiff::CompareField(const std::string& className, const Field* oldField, const Field* newField)
+{
+    const std::string& name = newField->GetName();
+
+    if (oldField->IsComputed() || newField->IsComputed())
+    {
+        if (oldField->IsComputed() && newField->IsComputed())
+        {
+            AddChange(ChangeKind::COMPUTED_CHANGED, className, name, SchemaFingerprinter::CanonicalExpression(newField->GetInitializer()), false);
+        }
+        else
+        {
+            AddChange(ChangeKind::TYPE_CHANGED, className, name, oldField->IsComputed() ? "computed -> stored" : "stored -> computed", true);
+        }
+        return;
+    }
+
+    // Type (references to a renamed class keep their type)
+    auto              renamed = renamedClasses_.find(TypeName(oldField));
+    const std::string oldType = (renamedClasses_.end() != renamed) ? renamed->second : TypeName(oldField);
+    const std::string newType = TypeName(newField);
+    if (oldType != newType)
+    {
+        // Only Date -> Timestamp keeps every old value. The Int conversions are planned,
+        // but are breaking: int64 -> float64 rounds above 2^53, and a count does not
+        // become a point in time or a duration just by reading it as microseconds.
+        const std::string detail = oldType + " -> " + newType;
+        if ("Date" == oldType && "Timestamp" == newType)
+        {
+            AddChange(ChangeKind::TYPE_WIDENED, className, name, detail, false);
+        }
+        else if ("Int" == oldType && "Real" == newType)
+        {
+            AddChange(ChangeKind::TYPE_CONVERTED, className, name, detail + ", values above 2^53 are rounded", true);
+        }
+        else if ("Int" == oldType && ("Timestamp" == newType || "Timespan" == newType))
+        {
+            AddChange(ChangeKind::TYPE_CONVERTED, className, name, detail + ", values are read as microseconds", true);
+        }
+        else
+        {
+            AddChange(ChangeKind::TYPE_CHANGED, className, name, detail, true);
+        }
+    }
+
+    // Cardinality
+    const CardinalityModifier* oldCardinality = oldField->GetCardinalityModifier();
+    const CardinalityModifier* newCardinality = newField->GetCardinalityModifier();
+    const int                  oldMin         = (nullptr != oldCardinality) ? oldCardinality->GetMin() : 1;
+    const int                  oldMax         = (nullptr != oldCardinality) ? oldCardinality->GetMax() : 1;
+    const int                  newMin         = (nullptr != newCardinality) ? newCardinality->GetMin() : 1;
+    const int                  newMax         = (nullptr != newCardinality) ? newCardinality->GetMax() : 1;
+    auto                       toString       = [](const int minCount, const int maxCount)
+    { return "[" + std::to_string(minCount) + ".." + (-1 == maxCount ? std::string("*") : std::to_string(maxCount)) + "]"; };
+
+    if (oldMin != newMin || oldMax != newMax)
+    {
+        const bool        oldArray = (-1 == oldMax || oldMax > 1);
+        const bool        newArray = (-1 == newMax || newMax > 1);
+        const std::string detail   = toString(oldMin, oldMax) + " -> " + toString(newMin, newMax);
+        if (oldArray != newArray)
+        {
+            AddChange(ChangeKind::TYPE_CHANGED, className, name, detail, true);
+        }
+        else
+        {
+            const bool relaxed = newMin <= oldMin && (-1 == newMax || (-1 != oldMax && newMax >= oldMax));
+            AddChange(relaxed ? ChangeKind::CARDINALITY_RELAXED : ChangeKind::CARDINALITY_TIGHTENED, className, name, detail, !relaxed);
+        }
+    }
+
+    // Storage modifiers keep the values
+    if (oldField->IsInterned() != newField->IsInterned())
+    {
+        AddChange(ChangeKind::STORAGE_CHANGED, className, name, newField->IsInterned() ? "[interned] added" : "[interned] removed", false);
+    }
+    const EncodingModifier* oldEncoding = oldField->GetEncodingModifier();
+    const EncodingModifier* newEncoding = newField->GetEncodingModifier();
+    const std::string       oldName     = (nullptr != oldEncoding) ? oldEncoding->GetEncoding() : "default";
+    const std::string       newName     = (nullptr != newEncoding) ? newEncoding->GetEncoding() : "default";
+    if (oldName != newName)
+    {
+        AddChange(ChangeKind::STORAGE_CHANGED, className, name, "encoding " + oldName + " -> " + newName, false);
+    }
+
+    // [unique] is a constraint on the stored data
+    if (oldField->HasUniqueConstraint() != newField->HasUniqueConstraint())
+    {
+        if (newField->HasUniqueConstraint())
+        {
+            AddChange(ChangeKind::INVARIANT_ADDED, className, name, "[unique]", true);
+        }
+        else
+        {
+            AddChange(ChangeKind::INVARIANT_REMOVED, className, name, "[unique]", false);
+        }
+    }
+}
+
+ClassMigration SchemaDiff::PlanMigration(const ClassLayout& oldLayout, const ClassLayout& newLayout) const
+{
+    ClassMigration migration;
+    migration.oldClassName = oldLayout.className;
+    migration.newClassName = newLayout.className;
+    migration.oldSize      = oldLayout.size;
+    migration.newSize      = newLayout.size;
+    migration.identical    = (oldLayout.fingerprint == newLayout.fingerprint);
+
+    if (migration.identical)
+    {
+        migration.ops.push_back({MigrationOpKind::COPY, 0, 0, newLayout.size, "record", ""});
+        return migration;
+    }
+
+    // Presence bitmap: copied as a whole if every optional field keeps its bit
+    std::vector<MigrationOp> presenceOps;
+    bool                     presenceIdentity = (oldLayout.presenceBytes == newLayout.presenceBytes);
+    for (const auto& newField : newLayout.fields)
+    {
+        const FieldLayout* oldField = oldLayout.FindField(newField.name);
+        if (newField.presenceBit < 0)
+        {
+            presenceIdentity = presenceIdentity && (nullptr == oldField || oldField->presenceBit < 0);
+            continue;
+        }
+
+        MigrationOp op;
+        if (nullptr == oldField || !PlanFieldConversion(*oldField, newField, op))
+        {
+            presenceIdentity = false;
+            continue;
+        }
+        const uint32_t newBit = static_cast<uint32_t>(newField.presenceBit);
+        if (oldField->presenceBit >= 0)
+        {
+            const uint32_t oldBit = static_cast<uint32_t>(oldField->presenceBit);
+            presenceIdentity      = presenceIdentity && (oldBit == newBit);
+            presenceOps.push_back({MigrationOpKind::PRESENCE, oldBit, newBit, 0, newField.name, "move bit"});
+        }
+        else
+        {
+            presenceIdentity = false;
+            presenceOps.push_back({MigrationOpKind::PRESENCE, 0, newBit, 0, newField.name, "set bit"});
+        }
+    }
+    for (const auto& oldField : oldLayout.fields)
+    {
+        // Bits of removed optional fields must not be carried over
+        presenceIdentity = presenceIdentity && (oldField.presenceBit < 0 || nullptr != newLayout.FindField(oldField.name));
+    }
+
+    if (newLayout.presenceBytes > 0)
+    {
+        if (presenceIdentity)
+        {
+            migration.ops.push_back({MigrationOpKind::COPY, 0, 0, newLayout.presenceBytes, "presence bitmap", ""});
+        }
+        else
+        {
+            migration.ops.insert(migration.ops.end(), presenceOps.begin(), presenceOps.end());
+        }
+    }
+
+    // Fields in new offset order; adjacent copies are coalesced into one memcpy
+    for (const auto& newField : newLayout.fields)
+    {
+        const FieldLayout* oldField = oldLayout.FindField(newField.name);
+        MigrationOp        op;
+        if (nullptr == oldField || !PlanFieldConversion(*oldField, newField, op))
+        {
+            migration.ops.push_back({MigrationOpKind::ZERO, 0, newField.offset, newField.size, newField.name, ""});
+            continue;
+        }
+
+        MigrationOp* previous = migration.ops.empty() ? nullptr : &migration.ops.back();
+        if (MigrationOpKind::COPY == op.kind && nullptr != previous && MigrationOpKind::COPY == previous->kind &&
+            previous->oldOffset + previous->size == op.oldOffset && previous->newOffset + previous->size == op.newOffset)
+        {
+            previous->size += op.size;
+            previous->fields += ", " + op.fields;
+        }
+        else
+        {
+            migration.ops.push_back(op);
+        }
+    }
+
+    // Columnar data: unchanged columns are reused as they are
+    for (const auto& newColumn : newLayout.columns)
+    {
+        const ColumnLayout* oldColumn = nullptr;
+        for (const auto& column : oldLayout.columns)
+        {
+            if (column.name == newColumn.name)
+            {
+                oldColumn = &column;
+                break;
+            }
+        }
+
+        std::string step = newColumn.name + ": ";
+        if (nullptr == oldColumn || oldColumn->list != newColumn.list)
+        {
+            step += newColumn.nullable ? "new column (all null)" : "new column (all zero)";
+        }
+        else if (oldColumn->storage != newColumn.storage)
+        {
+            const std::string conversion = ConversionDetail(oldColumn->storage, newColumn.storage);
+            step += conversion.empty() ? "new column (not convertible)" : "convert " + conversion;
+        }
+        else if (StorageKind::ENUM == newColumn.storage &&
+                 !EnumCodesStable(FindEnum(oldAnalyzer_, oldColumn->typeName), FindEnum(newAnalyzer_, newColumn.typeName)))
+        {
+            step += "remap enum codes";
+        }
+        else if (oldColumn->encoding != newColumn.encoding || oldColumn->bitWidth != newColumn.bitWidth)
+        {
+            auto encodingName = [](const ColumnLayout& column)
+            {
+                const std::string name = ColumnLayout::EncodingToString(column.encoding);
+                return (column.bitWidth > 0) ? name + "(" + std::to_string(column.bitWidth) + ")" : name;
+            };
+            step += "re-encode " + encodingName(*oldColumn) + " -> " + encodingName(newColumn);
+        }
+        else if (oldColumn->nullable != newColumn.nullable)
+        {
+            step += newColumn.nullable ? "reuse values, add validity bitmap" : "reuse values, drop validity bitmap";
+        }
+        else
+        {
+            step += "reuse";
+        }
+        migration.columns.push_back(step);
+    }
+
+    return migration;
+}
+
+bool SchemaDiff::PlanFieldConversion(const FieldLayout& oldField, const FieldLayout& newField, MigrationOp& op) const
+{
+    op = {MigrationOpKind::COPY, oldField.offset, newField.offset, newField.size, newField.name, ""};
+
+    // Single values and arrays do not convert into each other
+    if ((StorageKind::ARRAY_REF == oldField.storage) != (StorageKind::ARRAY_REF == newField.storage))
+    {
+        return false;
+    }
+
+    const bool isArray = (StorageKind::ARRAY_REF == newField.storage);
+    if (oldField.elementStorage != newField.elementStorage)
+    {
+        const std::string conversion = ConversionDetail(oldField.elementStorage, newField.elementStorage);
+        if (conversion.empty())
+        {
+            return false;
+        }
+        op.kind   = MigrationOpKind::CONVERT;
+        op.detail = isArray ? "elements " + conversion + " (element heap rewritten)" : conversion;
+        return true;
+    }
+
+    if (StorageKind::ENUM == newField.elementStorage)
+    {
+        const EnumDeclaration* oldEnum = FindEnum(oldAnalyzer_, oldField.typeName);
+        const EnumDeclaration* newEnum = FindEnum(newAnalyzer_, newField.typeName);
+        if (nullptr == oldEnum || nullptr == newEnum)
+        {
+            return false;
+        }
+        if (!EnumCodesStable(oldEnum, newEnum))
+        {
+            op.kind   = MigrationOpKind::REMAP_ENUM;
+            op.detail = std::to_string(oldEnum->GetValues().size()) + " -> " + std::to_string(newEnum->GetValues().size()) + " values";
+            if (isArray)
+            {
+                op.detail += " (element heap rewritten)";
+            }
+        }
+        else if (oldField.size != newField.size)
+        {
+            op.kind   = MigrationOpKind::CONVERT;
+            op.detail = "zero-extend " + std::to_string(oldField.size) + " -> " + std::to_string(newField.size) + " bytes";
+        }
+    }
+
+    return true;
+}
+
+std::string SchemaDiff::ConversionDetail(const StorageKind from, const StorageKind to)
+{
+    const std::string conversion = std::string(FieldLayout::StorageToString(from)) + " -> " + FieldLayout::StorageToString(to);
+
+    if (StorageKind::INT64 == from && StorageKind::FLOAT64 == to)
+    {
+        return conversion + " (exact up to 2^53)";
+    }
+    if (StorageKind::DATE32 == from && StorageKind::TIMESTAMP64 == to)
+    {
+        return conversion + " (days to microseconds)";
+    }
+    if (StorageKind::INT64 == from && (StorageKind::TIMESTAMP64 == to || StorageKind::TIMESPAN64 == to))
+    {
+        return conversion + " (same bits, read as microseconds)";
+    }
+    if (StorageKind::STRING_REF == from && StorageKind::INTERNED_STRING == to)
+    {
+        return conversion + " (intern)";
+    }
+    if (StorageKind::INTERNED_STRING == from && StorageKind::STRING_REF == to)
+    {
+        return conversion + " (resolve symbol)";
+    }
+    return "";
+}
+
+bool SchemaDiff::EnumCodesStable(const EnumDeclaration* oldEnum, const EnumDeclaration* newEnum)
+{
+    if (nullptr == oldEnum || nullptr == newEnum)
+    {
+        return false;
+    }
+
+    const std::vector<std::string>& oldValues = oldEnum->GetValues();
+    const std::vector<std::string>& newValues = newEnum->GetValues();
+    if (oldValues.size() > newValues.size())
+    {
+        return false;
+    }
+    return std::equal(oldValues.begin(), oldValues.end(), newValues.begin());
+}
+
+const EnumDeclaration* SchemaDiff::FindEnum(const SemanticAnalyzer* analyzer, const std::string& typeName)
+{
+    const auto& symbolTable = analyzer->GetSymbolTable();
+    auto        symbol      = symbolTable.find(typeName);
+    return (symbolTable.end() != symbol && TypeSymbol::Kind::ENUM == symbol->second.kind) ? symbol->second.enumDecl : nullptr;
+}
+
+std::string SchemaDiff::TypeName(const Field* field)
+{
+    const TypeSpec* typeSpec = field->GetType();
+    if (typeSpec->IsPrimitive())
+    {
+        return PrimitiveTypeSpec::TypeToString(static_cast<const PrimitiveTypeSpec*>(typeSpec)->GetType());
+    }
+    return static_cast<const UserDefinedTypeSpec*>(typeSpec)->GetTypeName();
+}
+
+std::vector<const Field*> SchemaDiff::DeclaredFields(const ClassLayout& layout)
+{
+    std::vector<const Field*> fields;
+    for (const ClassDeclaration* classDecl : layout.classChain)
+    {
+        for (const auto& field : classDecl->GetFields())
+        {
+            fields.push_back(field.get());
+        }
+    }
+    return fields;
+}
+
+void SchemaDiff::Dump() const
+{
+    std::cout << "========================================\n";
+    std::cout << "Schema Diff\n";
+    std::cout << "========================================\n\n";
+
+    if (changes_.empty())
+    {
+        std::cout << "  No changes\n\n";
+    }
+    else
+    {
+        std::cout << "  Changes:\n";
+        for (const auto& change : changes_)
+        {
+            std::cout << "    " << (change.breaking ? "! " : "  ") << SchemaChange::KindToString(change.kind) << ": " << change.typeName;
+            if (false == change.fieldName.empty())
+            {
+                std::cout << "." << change.fieldName;
+            }
+            if (false == change.detail.empty())
+            {
+                std::cout << " (" << change.detail << ")";
+            }
+            std::cout << "\n";
+        }
+        std::cout << "\n";
+    }
+
+    for (const auto& migration : migrations_)
+    {
+        std::cout << "  class " << migration.newClassName;
+        if (migration.oldClassName != migration.newClassName)
+        {
+            std::cout << " (was " << migration.oldClassName << ")";
+        }
+        if (migration.identical)
+        {
+            std::cout << ": unchanged, records copied as they are\n\n";
+            continue;
+        }
+
+        std::cout << ": " << migration.oldSize << "-byte -> " << migration.newSize << "-byte records\n";
+        for (const auto& op : migration.ops)
+        {
+            switch (op.kind)
+            {
+                case MigrationOpKind::COPY:
+                    std::cout << "    copy     @" << op.oldOffset << " -> @" << op.newOffset << ", " << op.size << " bytes (" << op.fields << ")\n";
+                    break;
+                case MigrationOpKind::CONVERT:
+                    std::cout << "    convert  @" << op.oldOffset << " -> @" << op.newOffset << " " << op.fields << ": " << op.detail << "\n";
+                    break;
+                case MigrationOpKind::REMAP_ENUM:
+                    std::cout << "    remap    @" << op.oldOffset << " -> @" << op.newOffset << " " << op.fields << ": " << op.detail << "\n";
+                    break;
+                case MigrationOpKind::PRESENCE:
+                    if ("set bit" == op.detail)
+                    {
+                        std::cout << "    presence set bit " << op.newOffset << " (" << op.fields << ")\n";
+                    }
+                    else
+                    {
+                        std::cout << "    presence bit " << op.oldOffset << " -> " << op.newOffset << " (" << op.fields << ")\n";
+                    }
+                    break;
+                case MigrationOpKind::ZERO:
+                default:
+                    std::cout << "    zero     @" << op.newOffset << ", " << op.size << " bytes (" << op.fields << ")\n";
+                    break;
+            }
+        }
+
+        std::cout << "    Columns:\n";
+        for (const auto& column : migration.columns)
+        {
+            std::cout << "      " << column << "\n";
+        }
+        std::cout << "\n";
+    }
+
+    std::cout << "  " << (IsCompatible() ? "Compatible: old data converts without loss" : "Breaking: some old data cannot be converted without loss or validation")
+              << "\n";
+    std::cout << "========================================\n";
+}
+} // namespace bbfm
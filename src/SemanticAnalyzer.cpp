@@ -1,24 +1,198 @@
 #include "SemanticAnalyzer.h"
+#include "AllocTracker.h"
 #include "Common.h"
 #include "Console.h"
-#include <iostream>
+#include "Diagnostics.h"
+#include "Json.h"
+#include "Layout.h"
+#include "Profiler.h"
+#include <algorithm>
+
+namespace {
+// Query input values of looked-up types without a declaration
+const uint64_t PRIMITIVE_TYPE_HASH = 0x7072696d69746976ULL;
+const uint64_t UNDEFINED_TYPE_HASH = 0x756e646566696e65ULL;
+
+/// \brief Fold a value into a hash (the order of the values matters)
+uint64_t CombineHash(const uint64_t hash, const uint64_t value)
+{
+    return hash ^ (value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2));
+}
+} // namespace
 
 namespace bbfm {
-SemanticAnalyzer::SemanticAnalyzer(const AST* ast) : ast_(ast), hasErrors_(false) {}
+void AnalysisCache::BeginAnalysis()
+{
+    ++generation_;
+    reusedCount_   = 0;
+    computedCount_ = 0;
+}
+
+const ClassQueryResult* AnalysisCache::Find(const std::string& className) const
+{
+    auto it = results_.find(className);
+    return results_.end() == it ? nullptr : &it->second;
+}
+
+void AnalysisCache::Reuse(const std::string& className)
+{
+    results_.at(className).generation = generation_;
+    ++reusedCount_;
+}
+
+void AnalysisCache::Store(const std::string& className, ClassQueryResult result)
+{
+    auto previous = results_.find(className);
+    if (results_.end() != previous)
+    {
+        UpdateDependents(className, previous->second, false);
+    }
+    UpdateDependents(className, result, true);
+    if (result.valid && result.errors.empty())
+    {
+        failedClasses_.erase(className);
+    }
+    else
+    {
+        failedClasses_.insert(className);
+    }
+
+    result.generation   = generation_;
+    results_[className] = std::move(result);
+    ++computedCount_;
+}
+
+void AnalysisCache::Drop(const std::string& className)
+{
+    auto it = results_.find(className);
+    if (results_.end() != it)
+    {
+        UpdateDependents(className, it->second, false);
+        failedClasses_.erase(className);
+        results_.erase(it);
+    }
+}
+
+void AnalysisCache::EndAnalysis()
+{
+    for (auto it = results_.begin(); results_.end() != it;)
+    {
+        if (generation_ == it->second.generation)
+        {
+            ++it;
+            continue;
+        }
+        UpdateDependents(it->first, it->second, false);
+        failedClasses_.erase(it->first);
+        it = results_.erase(it);
+    }
+}
+
+size_t AnalysisCache::GetReusedCount() const
+{
+    return reusedCount_;
+}
+
+size_t AnalysisCache::GetComputedCount() const
+{
+    return computedCount_;
+}
+
+void AnalysisCache::ClearTables()
+{
+    types_.clear();
+    symbolTable_.clear();
+    aggregates_.clear();
+    patterns_.clear();
+    compiledPatterns_.clear();
+    incremental_ = false;
+}
+
+void AnalysisCache::UpdateDependents(const std::string& className, const ClassQueryResult& result, const bool add)
+{
+    for (const std::string& typeName : result.dependencies)
+    {
+        if (add)
+        {
+            dependents_[typeName].insert(className);
+            continue;
+        }
+        auto dependents = dependents_.find(typeName);
+        if (dependents_.end() != dependents && 0 != dependents->second.erase(className) && dependents->second.empty())
+        {
+            dependents_.erase(dependents);
+        }
+    }
+}
+
+SemanticAnalyzer::SemanticAnalyzer(const AST* ast, AnalysisCache* cache, const ModuleAsts* imports) :
+    cache_(cache),
+    symbolTable_((nullptr != cache) ? cache->symbolTable_ : ownTables_.symbolTable_),
+    aggregates_((nullptr != cache) ? cache->aggregates_ : ownTables_.aggregates_),
+    patterns_((nullptr != cache) ? cache->patterns_ : ownTables_.patterns_),
+    compiledPatterns_((nullptr != cache) ? cache->compiledPatterns_ : ownTables_.compiledPatterns_),
+    hasErrors_(false),
+    currentQuery_(nullptr),
+    errorDeclaration_(nullptr),
+    errorNode_(nullptr)
+{
+    // Imported declarations first, in module order
+    std::vector<const AST*> modules;
+    if (nullptr != imports)
+    {
+        for (const auto& module : *imports)
+        {
+            modules.push_back(module.get());
+        }
+    }
+    modules.push_back(ast);
+    for (const AST* module : modules)
+    {
+        if (nullptr != module)
+        {
+            for (const auto& decl : module->GetDeclarations())
+            {
+                declarations_.push_back(decl.get());
+            }
+        }
+    }
+}
 
 bool SemanticAnalyzer::Analyze()
 {
+    if (nullptr != cache_)
+    {
+        cache_->BeginAnalysis();
+
+        // Update the tables of the previous analysis if it analyzed a complete model
+        bool valid = true;
+        if (cache_->incremental_ && AnalyzeChanges(valid))
+        {
+            return valid && !hasErrors_;
+        }
+        cache_->ClearTables();
+    }
+
     // Register built-in primitive types
     RegisterPrimitiveTypes();
 
     // Build symbol table from declarations
-    if (!BuildSymbolTable())
     {
-        return false;
+        ProfileScope profile("pass", "Symbol table");
+        if (!BuildSymbolTable())
+        {
+            return false;
+        }
     }
 
     // Validate type references
-    if (!ValidateTypeReferences())
+    const bool valid = ValidateTypeReferences();
+    if (nullptr != cache_)
+    {
+        cache_->EndAnalysis();
+        cache_->incremental_ = brokenTypes_.empty();
+    }
+    if (!valid)
     {
         return false;
     }
@@ -40,41 +214,69 @@ void SemanticAnalyzer::RegisterPrimitiveTypes()
 
 bool SemanticAnalyzer::BuildSymbolTable()
 {
+    BBFM_ALLOC_SITE("SemanticAnalyzer::BuildSymbolTable");
+
     bool success = true;
 
-    for (const auto& decl : ast_->GetDeclarations())
+    for (const Declaration* decl : declarations_)
     {
         if (Declaration::Kind::ENUM == decl->GetKind())
         {
             const EnumDeclaration* enumDecl = decl->AsEnum();
             const std::string&     name     = enumDecl->GetName();
+            errorDeclaration_               = decl;
+            errorNode_                      = enumDecl;
 
-            // Check for duplicate type names
+            // Check for duplicate type names, a declaration damaged by a syntax error may be a misspelled other one
+            if (decl->HadSyntaxError())
+            {
+                brokenTypes_.insert(name);
+            }
             if (TypeExists(name))
             {
-                ReportError("Type '" + name + "' is already declared");
-                success = false;
+                if (false == decl->HadSyntaxError() && 0 == brokenTypes_.count(name))
+                {
+                    ReportError("Type '" + name + "' is already declared");
+                    success = false;
+                }
                 continue;
             }
 
             // Add to symbol table
             symbolTable_.insert({name, TypeSymbol(enumDecl)});
+            if (nullptr != cache_)
+            {
+                cache_->types_[name] = AnalysisCache::TypeEntry{decl->GetId(), decl->GetSourceHash(), cache_->generation_};
+            }
         }
         else if (Declaration::Kind::CLASS == decl->GetKind())
         {
             const ClassDeclaration* classDecl = decl->AsClass();
             const std::string&      name      = classDecl->GetName();
+            errorDeclaration_                 = decl;
+            errorNode_                        = classDecl;
 
-            // Check for duplicate type names
+            // Check for duplicate type names, a declaration damaged by a syntax error may be a misspelled other one
+            if (decl->HadSyntaxError())
+            {
+                brokenTypes_.insert(name);
+            }
             if (TypeExists(name))
             {
-                ReportError("Type '" + name + "' is already declared");
-                success = false;
+                if (false == decl->HadSyntaxError() && 0 == brokenTypes_.count(name))
+                {
+                    ReportError("Type '" + name + "' is already declared");
+                    success = false;
+                }
                 continue;
             }
 
             // Add to symbol table
             symbolTable_.insert({name, TypeSymbol(classDecl)});
+            if (nullptr != cache_)
+            {
+                cache_->types_[name] = AnalysisCache::TypeEntry{decl->GetId(), decl->GetSourceHash(), cache_->generation_};
+            }
         }
     }
 
@@ -83,48 +285,382 @@ bool SemanticAnalyzer::BuildSymbolTable()
 
 bool SemanticAnalyzer::ValidateTypeReferences()
 {
+    BBFM_ALLOC_SITE("SemanticAnalyzer::ValidateTypeReferences");
+
     bool success = true;
 
-    // First pass: Validate type references
-    for (const auto& decl : ast_->GetDeclarations())
+    // Classes inheriting from a damaged type are missing its members, their errors would be follow-ups
+    for (const Declaration* decl : declarations_)
     {
-        if (Declaration::Kind::CLASS == decl->GetKind())
+        if (Declaration::Kind::CLASS == decl->GetKind() && InheritsFromBrokenType(decl->AsClass()))
         {
-            const ClassDeclaration* classDecl = decl->AsClass();
+            brokenTypes_.insert(decl->AsClass()->GetName());
+        }
+    }
 
-            if (!ValidateClassDeclaration(classDecl))
+    // Validate type references; inheritance cycles are reported after all classes,
+    // each cycle is found in every class of the cycle
+    std::vector<const Declaration*> cyclic;
+    {
+        ProfileScope profile("pass", "Class validation");
+        for (const Declaration* decl : declarations_)
+        {
+            if (Declaration::Kind::CLASS == decl->GetKind() && 0 == brokenTypes_.count(decl->AsClass()->GetName()))
             {
-                success = false;
+                bool inheritsFromItself = false;
+                if (!QueryClassValidity(decl, inheritsFromItself))
+                {
+                    success = false;
+                }
+                if (inheritsFromItself)
+                {
+                    cyclic.push_back(decl);
+                }
             }
         }
     }
+    ReportInheritanceCycles(cyclic);
+
+    return success;
+}
+
+bool SemanticAnalyzer::AnalyzeChanges(bool& valid)
+{
+    BBFM_ALLOC_SITE("SemanticAnalyzer::AnalyzeChanges");
 
-    // Second pass: Check for inheritance cycles
-    // This must be done after all types are validated to handle forward references
-    for (const auto& decl : ast_->GetDeclarations())
+    // Compare each declaration with the one the symbol table holds
+    std::vector<std::string> changed; // Types added, removed or declared by different source
+    std::vector<std::string> moved;   // Types declared by a new declaration with the same source
+    size_t                   declaredCount = 0;
     {
-        if (Declaration::Kind::CLASS == decl->GetKind())
+        ProfileScope profile("pass", "Symbol table");
+        for (const Declaration* decl : declarations_)
         {
-            const ClassDeclaration* classDecl = decl->AsClass();
+            const bool         isClass = (Declaration::Kind::CLASS == decl->GetKind());
+            const std::string& name    = isClass ? decl->AsClass()->GetName() : decl->AsEnum()->GetName();
+            if (decl->HadSyntaxError())
+            {
+                return false;
+            }
 
-            if (classDecl->HasExplicitBase())
+            auto type = cache_->types_.find(name);
+            if (cache_->types_.end() == type)
             {
-                std::set<std::string> visited;
-                visited.insert(classDecl->GetName());
-                if (HasInheritanceCycle(classDecl->GetBaseType(), visited))
+                // A new type, unless it is a primitive type
+                if (!symbolTable_.insert({name, isClass ? TypeSymbol(decl->AsClass()) : TypeSymbol(decl->AsEnum())}).second)
                 {
-                    ReportError("Circular inheritance detected in class '" + classDecl->GetName() + "'");
-                    success = false;
+                    return false;
+                }
+                cache_->types_[name] = AnalysisCache::TypeEntry{decl->GetId(), decl->GetSourceHash(), cache_->generation_};
+                changed.push_back(name);
+                ++declaredCount;
+                continue;
+            }
+
+            // Duplicate types are reported by an analysis of the whole model
+            AnalysisCache::TypeEntry& entry = type->second;
+            if (cache_->generation_ == entry.generation)
+            {
+                return false;
+            }
+            entry.generation = cache_->generation_;
+            ++declaredCount;
+            if (decl->GetId() == entry.declarationId)
+            {
+                continue;
+            }
+
+            const bool sameSource = (0 != decl->GetSourceHash() && decl->GetSourceHash() == entry.sourceHash);
+            entry.declarationId   = decl->GetId();
+            entry.sourceHash      = decl->GetSourceHash();
+            symbolTable_.at(name) = isClass ? TypeSymbol(decl->AsClass()) : TypeSymbol(decl->AsEnum());
+            (sameSource ? moved : changed).push_back(name);
+        }
+
+        // Removed types
+        if (declaredCount != cache_->types_.size())
+        {
+            for (auto type = cache_->types_.begin(); cache_->types_.end() != type;)
+            {
+                if (cache_->generation_ == type->second.generation)
+                {
+                    ++type;
+                    continue;
                 }
+                changed.push_back(type->first);
+                symbolTable_.erase(type->first);
+                type = cache_->types_.erase(type);
             }
         }
     }
 
-    return success;
+    // Queries of changed classes and of the classes that looked up a changed type are computed again.
+    // Queries of the classes that looked up a moved class only rebuild their aggregates.
+    std::set<std::string> dirty;
+    std::set<std::string> refresh;
+    for (const std::string& name : changed)
+    {
+        auto symbol = symbolTable_.find(name);
+        if (symbolTable_.end() != symbol && TypeSymbol::Kind::CLASS == symbol->second.kind)
+        {
+            dirty.insert(name);
+        }
+        else
+        {
+            // Removed, or a class redeclared as an enum
+            aggregates_.erase(name);
+            patterns_.erase(name);
+            cache_->Drop(name);
+        }
+        auto dependents = cache_->dependents_.find(name);
+        if (cache_->dependents_.end() != dependents)
+        {
+            dirty.insert(dependents->second.begin(), dependents->second.end());
+        }
+    }
+    for (const std::string& name : moved)
+    {
+        if (TypeSymbol::Kind::CLASS == symbolTable_.at(name).kind)
+        {
+            refresh.insert(name);
+        }
+        auto dependents = cache_->dependents_.find(name);
+        if (cache_->dependents_.end() != dependents)
+        {
+            refresh.insert(dependents->second.begin(), dependents->second.end());
+        }
+    }
+
+    // Visit the classes in declaration order, so errors are reported in the order of a whole analysis
+    ProfileScope                    profile("pass", "Class validation");
+    std::vector<const Declaration*> cyclic;
+    size_t                          classCount = 0;
+    valid                                      = true;
+    for (const Declaration* decl : declarations_)
+    {
+        if (Declaration::Kind::CLASS != decl->GetKind())
+        {
+            continue;
+        }
+        ++classCount;
+
+        const ClassDeclaration* classDecl = decl->AsClass();
+        const std::string&      name      = classDecl->GetName();
+        const bool              isDirty   = (0 != dirty.count(name));
+        const bool              failed    = (false == cache_->failedClasses_.empty() && 0 != cache_->failedClasses_.count(name));
+        const bool              moved     = (0 != refresh.count(name));
+        if (!isDirty && !failed && !moved)
+        {
+            continue; // Unchanged and valid
+        }
+
+        // Replay the errors and rebuild the aggregates of unchanged classes
+        const ClassQueryResult* result = isDirty ? nullptr : cache_->Find(name);
+        if (nullptr != result)
+        {
+            errorDeclaration_ = decl;
+            errorNode_        = classDecl;
+            if (moved)
+            {
+                aggregates_.erase(name);
+                patterns_.erase(name);
+                RestoreQuerySymbols(classDecl, *result);
+            }
+            if (failed)
+            {
+                ReplayQueryErrors(classDecl, *result);
+                valid = valid && result->valid;
+                if (result->cyclic)
+                {
+                    cyclic.push_back(decl);
+                }
+            }
+            continue;
+        }
+
+        bool inheritsFromItself = false;
+        valid                   = ComputeClassQuery(decl, inheritsFromItself) && valid;
+        if (inheritsFromItself)
+        {
+            cyclic.push_back(decl);
+        }
+    }
+    ReportInheritanceCycles(cyclic);
+
+    cache_->reusedCount_ = classCount - std::min(classCount, cache_->computedCount_);
+    return true;
+}
+
+bool SemanticAnalyzer::InheritsFromBrokenType(const ClassDeclaration* classDecl) const
+{
+    std::set<std::string> visited;
+    for (const ClassDeclaration* current = classDecl; nullptr != current && current->HasExplicitBase();)
+    {
+        const std::string& baseType = current->GetBaseType();
+        if (0 != brokenTypes_.count(baseType))
+        {
+            return true;
+        }
+        if (false == visited.insert(baseType).second)
+        {
+            return false; // Inheritance cycle, reported by the cycle pass
+        }
+        auto base = symbolTable_.find(baseType);
+        current   = (symbolTable_.end() != base) ? base->second.classDecl : nullptr;
+    }
+    return false;
+}
+
+bool SemanticAnalyzer::QueryClassValidity(const Declaration* decl, bool& cyclic)
+{
+    BBFM_ALLOC_SITE("SemanticAnalyzer::QueryClassValidity");
+
+    const ClassDeclaration* classDecl = decl->AsClass();
+    const std::string&      name      = classDecl->GetName();
+    errorDeclaration_                 = decl;
+    errorNode_                        = classDecl;
+
+    // Duplicate declarations share a name, only the registered one is cached
+    const TypeSymbol* registered = LookupType(name);
+    if (nullptr == cache_ || nullptr == registered || classDecl != registered->classDecl)
+    {
+        ProfileScope profile("class", name);
+        const bool   valid = ValidateClassDeclaration(classDecl);
+        errorNode_         = classDecl;
+        cyclic             = InheritsFromItself(classDecl);
+        return valid && !cyclic;
+    }
+
+    // Reuse the previous result if the class and every type it looked up are unchanged
+    const ClassQueryResult* cached = cache_->Find(name);
+    uint64_t                inputHash;
+    if (nullptr != cached && 0 != cached->inputHash && HashQueryInputs(decl->GetSourceHash(), cached->dependencies, inputHash) &&
+        inputHash == cached->inputHash)
+    {
+        ReplayQueryErrors(classDecl, *cached);
+        RestoreQuerySymbols(classDecl, *cached);
+        cache_->Reuse(name);
+        cyclic = cached->cyclic;
+        return cached->valid;
+    }
+
+    return ComputeClassQuery(decl, cyclic);
+}
+
+bool SemanticAnalyzer::ComputeClassQuery(const Declaration* decl, bool& cyclic)
+{
+    BBFM_ALLOC_SITE("SemanticAnalyzer::ComputeClassQuery");
+
+    const ClassDeclaration* classDecl = decl->AsClass();
+    const std::string&      name      = classDecl->GetName();
+    ProfileScope            profile("class", name);
+    errorDeclaration_ = decl;
+    errorNode_        = classDecl;
+    aggregates_.erase(name);
+    patterns_.erase(name);
+
+    // Compute the query, recording its lookups and effects
+    ClassQueryResult result{};
+    currentQuery_ = &result;
+    result.valid  = ValidateClassDeclaration(classDecl);
+    errorNode_    = classDecl;
+    result.cyclic = InheritsFromItself(classDecl);
+    result.valid  = result.valid && !result.cyclic;
+    currentQuery_ = nullptr;
+
+    if (!HashQueryInputs(decl->GetSourceHash(), result.dependencies, result.inputHash))
+    {
+        result.inputHash = 0;
+    }
+    const bool valid = result.valid;
+    cyclic           = result.cyclic;
+    cache_->Store(name, std::move(result));
+    return valid;
+}
+
+bool SemanticAnalyzer::HashQueryInputs(const uint64_t sourceHash, const std::set<std::string>& dependencies, uint64_t& inputHash) const
+{
+    if (0 == sourceHash)
+    {
+        return false;
+    }
+
+    // The dependencies are the same set whenever the class source is, only their values are folded in
+    inputHash = sourceHash;
+    for (const std::string& typeName : dependencies)
+    {
+        auto symbol = symbolTable_.find(typeName);
+        if (symbolTable_.end() == symbol)
+        {
+            inputHash = CombineHash(inputHash, UNDEFINED_TYPE_HASH);
+        }
+        else if (TypeSymbol::Kind::PRIMITIVE == symbol->second.kind)
+        {
+            inputHash = CombineHash(inputHash, PRIMITIVE_TYPE_HASH);
+        }
+        else
+        {
+            auto type = cache_->types_.find(typeName);
+            if (cache_->types_.end() == type || 0 == type->second.sourceHash)
+            {
+                return false;
+            }
+            inputHash = CombineHash(inputHash, type->second.sourceHash);
+        }
+    }
+    return true;
+}
+
+void SemanticAnalyzer::ReplayQueryErrors(const ClassDeclaration* classDecl, const ClassQueryResult& result)
+{
+    for (const ClassQueryResult::Error& error : result.errors)
+    {
+        ReportError(error.message, (0 == error.column) ? 0 : classDecl->GetLine() + error.lineOffset, error.column);
+    }
+}
+
+void SemanticAnalyzer::RestoreQuerySymbols(const ClassDeclaration* classDecl, const ClassQueryResult& result)
+{
+    // Aggregates refer to fields of the current AST
+    for (const ClassQueryResult::Aggregate& aggregate : result.aggregates)
+    {
+        const Field* collection = LookupField(classDecl, aggregate.collectionName);
+        aggregates_[classDecl->GetName()].push_back(AggregateSymbol{aggregate.kind, collection, aggregate.memberName, aggregate.resultType});
+    }
+
+    // Patterns compiled when the result was recorded, compile them for this analysis
+    for (const ClassQueryResult::Pattern& pattern : result.patterns)
+    {
+        auto compiled = compiledPatterns_.find(pattern.pattern);
+        if (compiledPatterns_.end() == compiled)
+        {
+            std::string                 patternError;
+            std::unique_ptr<PatternDfa> dfa = PatternCompiler::Compile(pattern.pattern, patternError);
+            if (nullptr == dfa)
+            {
+                continue;
+            }
+            compiled = compiledPatterns_.insert({pattern.pattern, std::move(dfa)}).first;
+        }
+        patterns_[classDecl->GetName()].push_back(PatternSymbol{pattern.subject, pattern.pattern, compiled->second.get()});
+    }
+}
+
+void SemanticAnalyzer::ReportInheritanceCycles(const std::vector<const Declaration*>& cyclic)
+{
+    ProfileScope profile("pass", "Inheritance cycles");
+    for (const Declaration* decl : cyclic)
+    {
+        errorDeclaration_ = decl;
+        errorNode_        = decl->AsClass();
+        ReportError("Circular inheritance detected in class '" + decl->AsClass()->GetName() + "'");
+    }
 }
 
 bool SemanticAnalyzer::ValidateClassDeclaration(const ClassDeclaration* classDecl)
 {
+    BBFM_ALLOC_SITE("SemanticAnalyzer::ValidateClassDeclaration");
+
     bool success = true;
 
     // Validate base type if specified
@@ -145,8 +681,7 @@ bool SemanticAnalyzer::ValidateClassDeclaration(const ClassDeclaration* classDec
                 ReportError("Class '" + classDecl->GetName() + "' cannot inherit from non-class type '" + baseType + "'");
                 success = false;
             }
-            // Note: Inheritance cycle detection happens in a second pass
-            // after all types are validated, to avoid issues with forward references
+            // Note: Inheritance cycles are checked after the class is validated
         }
     }
 
@@ -154,6 +689,7 @@ bool SemanticAnalyzer::ValidateClassDeclaration(const ClassDeclaration* classDec
     for (const auto& field : classDecl->GetFields())
     {
         const TypeSpec* typeSpec = field->GetType();
+        errorNode_               = field.get();
 
         if (typeSpec->IsUserDefined())
         {
@@ -166,7 +702,14 @@ bool SemanticAnalyzer::ValidateClassDeclaration(const ClassDeclaration* classDec
                 success = false;
             }
         }
+
+        // Validate storage modifiers
+        if (!ValidateFieldModifiers(field.get(), classDecl))
+        {
+            success = false;
+        }
     }
+    errorNode_ = classDecl;
 
     // Validate field uniqueness
     if (!ValidateFieldUniqueness(classDecl))
@@ -189,8 +732,21 @@ bool SemanticAnalyzer::ValidateClassDeclaration(const ClassDeclaration* classDec
     return success;
 }
 
+bool SemanticAnalyzer::InheritsFromItself(const ClassDeclaration* classDecl)
+{
+    if (!classDecl->HasExplicitBase())
+    {
+        return false;
+    }
+    std::set<std::string> visited;
+    visited.insert(classDecl->GetName());
+    return HasInheritanceCycle(classDecl->GetBaseType(), visited);
+}
+
 bool SemanticAnalyzer::HasInheritanceCycle(const std::string& className, std::set<std::string>& visited)
 {
+    BBFM_ALLOC_SITE("SemanticAnalyzer::HasInheritanceCycle");
+
     // If we've visited this class before, we have a cycle
     if (0 != visited.count(className))
     {
@@ -224,6 +780,8 @@ bool SemanticAnalyzer::HasInheritanceCycle(const std::string& className, std::se
 
 void SemanticAnalyzer::GetAllFields(const ClassDeclaration* classDecl, std::vector<const Field*>& allFields) const
 {
+    BBFM_ALLOC_SITE("SemanticAnalyzer::GetAllFields");
+
     // Use a set to track visited classes and prevent infinite recursion on cycles
     std::set<std::string> visited;
     GetAllFieldsHelper(classDecl, allFields, visited);
@@ -261,8 +819,26 @@ void SemanticAnalyzer::GetAllFieldsHelper(const ClassDeclaration* classDecl, std
     }
 }
 
+void SemanticAnalyzer::GetClassChain(const ClassDeclaration* classDecl, std::vector<const ClassDeclaration*>& chain) const
+{
+    BBFM_ALLOC_SITE("SemanticAnalyzer::GetClassChain");
+
+    // Walk up the base classes, stopping on cycles
+    std::set<std::string> visited;
+    for (const ClassDeclaration* current = classDecl; nullptr != current && 0 == visited.count(current->GetName());)
+    {
+        visited.insert(current->GetName());
+        chain.insert(chain.begin(), current);
+
+        const TypeSymbol* baseSym = current->HasExplicitBase() ? LookupType(current->GetBaseType()) : nullptr;
+        current                   = (nullptr != baseSym && TypeSymbol::Kind::CLASS == baseSym->kind) ? baseSym->classDecl : nullptr;
+    }
+}
+
 void SemanticAnalyzer::GetAllInvariants(const ClassDeclaration* classDecl, std::vector<const Invariant*>& allInvariants) const
 {
+    BBFM_ALLOC_SITE("SemanticAnalyzer::GetAllInvariants");
+
     // Use a set to track visited classes and prevent infinite recursion on cycles
     std::set<std::string> visited;
     GetAllInvariantsHelper(classDecl, allInvariants, visited);
@@ -301,8 +877,120 @@ void SemanticAnalyzer::GetAllInvariantsHelper(
     }
 }
 
+bool SemanticAnalyzer::ValidateFieldModifiers(const Field* field, const ClassDeclaration* classDecl)
+{
+    BBFM_ALLOC_SITE("SemanticAnalyzer::ValidateFieldModifiers");
+
+    bool            success  = true;
+    const TypeSpec* typeSpec = field->GetType();
+
+    // Element type category, used to check which storage modifiers apply
+    const PrimitiveType primitive  = typeSpec->IsPrimitive() ? static_cast<const PrimitiveTypeSpec*>(typeSpec)->GetType() : PrimitiveType::STRING;
+    const TypeSymbol*   typeSymbol = typeSpec->IsPrimitive() ? nullptr : LookupType(TypeSpecToName(typeSpec));
+    const bool          isEnum     = (nullptr != typeSymbol && TypeSymbol::Kind::ENUM == typeSymbol->kind);
+    const bool          isString   = (typeSpec->IsPrimitive() && PrimitiveType::STRING == primitive);
+
+    // Only stored String fields can use interned storage
+    if (field->IsInterned())
+    {
+        if (!isString)
+        {
+            ReportError(
+                "Field '" + field->GetName() + "' in class '" + classDecl->GetName() + "' is marked [interned] but has type '" + TypeSpecToName(typeSpec) +
+                "' - only String fields can be interned");
+            success = false;
+        }
+        else if (field->IsComputed())
+        {
+            ReportError("Computed feature '" + field->GetName() + "' in class '" + classDecl->GetName() + "' cannot be [interned] because it is not stored");
+            success = false;
+        }
+    }
+
+    // Unique values are enforced by a store index on a single stored value
+    if (field->HasUniqueConstraint())
+    {
+        const CardinalityModifier* cardinality = field->GetCardinalityModifier();
+        if (field->IsComputed())
+        {
+            ReportError("Computed feature '" + field->GetName() + "' in class '" + classDecl->GetName() + "' cannot be [unique] because it is not stored");
+            success = false;
+        }
+        else if (nullptr != cardinality && cardinality->IsArray())
+        {
+            ReportError("Array field '" + field->GetName() + "' in class '" + classDecl->GetName() + "' cannot be [unique]");
+            success = false;
+        }
+    }
+
+    // Columnar encodings must exist and fit the element type
+    const EncodingModifier* encodingMod = field->GetEncodingModifier();
+    if (nullptr != encodingMod)
+    {
+        const std::string& encoding = encodingMod->GetEncoding();
+        ColumnEncoding     columnEncoding;
+        if (!ColumnLayout::EncodingFromString(encoding, columnEncoding))
+        {
+            const auto& encodings = ColumnLayout::GetEncodings();
+            std::string expected;
+            for (size_t i = 0; i < encodings.size(); ++i)
+            {
+                expected += (0 == i) ? "" : (i + 1 == encodings.size()) ? " or " : ", ";
+                expected += ColumnLayout::EncodingToString(encodings[i]);
+            }
+            ReportError(
+                "Field '" + field->GetName() + "' in class '" + classDecl->GetName() + "' has unknown encoding '" + encoding + "' (expected " + expected +
+                ")");
+            return false;
+        }
+
+        const bool isNumeric =
+            typeSpec->IsPrimitive() && (PrimitiveType::INT == primitive || PrimitiveType::TIMESTAMP == primitive || PrimitiveType::TIMESPAN == primitive ||
+                                        PrimitiveType::DATE == primitive);
+        const bool isBool = typeSpec->IsPrimitive() && PrimitiveType::BOOL == primitive;
+
+        // No default, so a new encoding is a compiler warning until its element types are listed here
+        bool applicable = false;
+        switch (columnEncoding)
+        {
+            case ColumnEncoding::PLAIN:
+                applicable = true;
+                break;
+            case ColumnEncoding::BITPACKED:
+                applicable = isBool || isEnum;
+                break;
+            case ColumnEncoding::DICTIONARY:
+                applicable = isString || isEnum;
+                break;
+            case ColumnEncoding::RLE:
+                applicable = isBool || isEnum || isString || isNumeric;
+                break;
+            case ColumnEncoding::DELTA:
+                applicable = isNumeric;
+                break;
+        }
+
+        if (field->IsComputed())
+        {
+            ReportError("Computed feature '" + field->GetName() + "' in class '" + classDecl->GetName() + "' cannot have an encoding because it is not stored");
+            success = false;
+        }
+        else if (!applicable)
+        {
+            ReportError(
+                "Field '" + field->GetName() + "' in class '" + classDecl->GetName() + "' of type '" + TypeSpecToName(typeSpec) + "' cannot use encoding '" +
+                encoding + "'");
+            success = false;
+        }
+    }
+
+    return success;
+}
+
 bool SemanticAnalyzer::ValidateFieldUniqueness(const ClassDeclaration* classDecl)
 {
+    BBFM_ALLOC_SITE("SemanticAnalyzer::ValidateFieldUniqueness");
+
     std::vector<const Field*> allFields;
     GetAllFields(classDecl, allFields);
 
@@ -314,17 +1002,24 @@ bool SemanticAnalyzer::ValidateFieldUniqueness(const ClassDeclaration* classDecl
         const std::string& name = field->GetName();
         if (0 != fieldNames.count(name))
         {
+            // Inherited fields may come from another file, those are reported at the class
+            const auto& ownFields = classDecl->GetFields();
+            const bool  own       = ownFields.end() != std::find_if(ownFields.begin(), ownFields.end(), [field](const auto& f) { return field == f.get(); });
+            errorNode_            = own ? static_cast<const ASTNode*>(field) : classDecl;
             ReportError("Duplicate field '" + name + "' in class '" + classDecl->GetName() + "' (possibly inherited)");
             success = false;
         }
         fieldNames.insert(name);
     }
+    errorNode_ = classDecl;
 
     return success;
 }
 
 bool SemanticAnalyzer::ValidateInvariants(const ClassDeclaration* classDecl)
 {
+    BBFM_ALLOC_SITE("SemanticAnalyzer::ValidateInvariants");
+
     bool success = true;
 
     // Get all fields (including inherited) for validation
@@ -336,11 +1031,13 @@ bool SemanticAnalyzer::ValidateInvariants(const ClassDeclaration* classDecl)
     {
         fieldNames.insert(field->GetName());
     }
+    AddUniversalFieldNames(fieldNames);
 
     // Validate each invariant
     for (const auto& invariant : classDecl->GetInvariants())
     {
         const Expression* expr = invariant->GetExpression();
+        errorNode_             = invariant.get();
         if (nullptr == expr)
         {
             ReportError("Invariant '" + invariant->GetName() + "' in class '" + classDecl->GetName() + "' has no expression");
@@ -361,13 +1058,34 @@ bool SemanticAnalyzer::ValidateInvariants(const ClassDeclaration* classDecl)
                 success = false;
             }
         }
+
+        // Validate built-in function calls
+        if (!ValidateFunctionCallsInExpression(expr, classDecl, "invariant '" + invariant->GetName() + "'"))
+        {
+            success = false;
+        }
+
+        // Validate quantified expressions
+        if (!ValidateQuantifiersInExpression(expr, classDecl, "invariant '" + invariant->GetName() + "'"))
+        {
+            success = false;
+        }
+
+        // Validate temporal arithmetic and comparisons
+        if (!ValidateTemporalOperandsInExpression(expr, classDecl, "invariant '" + invariant->GetName() + "'"))
+        {
+            success = false;
+        }
     }
+    errorNode_ = classDecl;
 
     return success;
 }
 
 void SemanticAnalyzer::CollectFieldReferences(const Expression* expr, std::set<std::string>& fields) const
 {
+    BBFM_ALLOC_SITE("SemanticAnalyzer::CollectFieldReferences");
+
     if (nullptr == expr)
     {
         return;
@@ -426,11 +1144,26 @@ void SemanticAnalyzer::CollectFieldReferences(const Expression* expr, std::set<s
         return;
     }
 
+    // Check if this is a quantified expression - the bound variable is not a field
+    const QuantifiedExpression* quantExpr = dynamic_cast<const QuantifiedExpression*>(expr);
+    if (nullptr != quantExpr)
+    {
+        CollectFieldReferences(quantExpr->GetCollection(), fields);
+
+        std::set<std::string> bodyFields;
+        CollectFieldReferences(quantExpr->GetBody(), bodyFields);
+        bodyFields.erase(quantExpr->GetVariableName());
+        fields.insert(bodyFields.begin(), bodyFields.end());
+        return;
+    }
+
     // Literals don't contain field references
 }
 
 bool SemanticAnalyzer::ValidateComputedFeatures(const ClassDeclaration* classDecl)
 {
+    BBFM_ALLOC_SITE("SemanticAnalyzer::ValidateComputedFeatures");
+
     bool success = true;
 
     // Get all fields including inherited ones
@@ -443,24 +1176,29 @@ bool SemanticAnalyzer::ValidateComputedFeatures(const ClassDeclaration* classDec
     {
         availableFields.insert(field->GetName());
     }
+    AddUniversalFieldNames(availableFields);
 
     // Validate each computed feature
     for (const auto& field : classDecl->GetFields())
     {
         if (field->IsComputed())
         {
+            errorNode_ = field.get();
             if (!ValidateComputedFeatureExpression(field.get(), classDecl, availableFields))
             {
                 success = false;
             }
         }
     }
+    errorNode_ = classDecl;
 
     return success;
 }
 
 bool SemanticAnalyzer::ValidateComputedFeatureExpression(const Field* field, const ClassDeclaration* classDecl, const std::set<std::string>& availableFields)
 {
+    BBFM_ALLOC_SITE("SemanticAnalyzer::ValidateComputedFeatureExpression");
+
     bool              success = true;
     const Expression* expr    = field->GetInitializer();
 
@@ -502,6 +1240,24 @@ bool SemanticAnalyzer::ValidateComputedFeatureExpression(const Field* field, con
         success = false;
     }
 
+    // Validate built-in function calls
+    if (!ValidateFunctionCallsInExpression(expr, classDecl, "computed feature '" + field->GetName() + "'"))
+    {
+        success = false;
+    }
+
+    // Validate quantified expressions
+    if (!ValidateQuantifiersInExpression(expr, classDecl, "computed feature '" + field->GetName() + "'"))
+    {
+        success = false;
+    }
+
+    // Validate temporal arithmetic and comparisons
+    if (!ValidateTemporalOperandsInExpression(expr, classDecl, "computed feature '" + field->GetName() + "'"))
+    {
+        success = false;
+    }
+
     // Type checking - verify expression type matches declared field type
     Expression::Type exprType = InferExpressionType(expr, classDecl);
     if (Expression::Type::UNKNOWN != exprType)
@@ -521,39 +1277,9 @@ bool SemanticAnalyzer::ValidateComputedFeatureExpression(const Field* field, con
                 fieldTypeName                       = userType->GetTypeName();
             }
 
-            // Map Expression::Type to string for error message
-            std::string exprTypeName;
-            switch (exprType)
-            {
-                case Expression::Type::INT:
-                    exprTypeName = "Int";
-                    break;
-                case Expression::Type::REAL:
-                    exprTypeName = "Real";
-                    break;
-                case Expression::Type::STRING:
-                    exprTypeName = "String";
-                    break;
-                case Expression::Type::BOOL:
-                    exprTypeName = "Bool";
-                    break;
-                case Expression::Type::TIMESTAMP:
-                    exprTypeName = "Timestamp";
-                    break;
-                case Expression::Type::TIMESPAN:
-                    exprTypeName = "Timespan";
-                    break;
-                case Expression::Type::GUID:
-                    exprTypeName = "Guid";
-                    break;
-                default:
-                    exprTypeName = "Unknown";
-                    break;
-            }
-
             ReportError(
                 "Computed feature '" + field->GetName() + "' in class '" + classDecl->GetName() + "' has type mismatch: declared as '" + fieldTypeName +
-                "' but expression evaluates to '" + exprTypeName + "'");
+                "' but expression evaluates to '" + Expression::TypeToString(exprType) + "'");
             success = false;
         }
     }
@@ -563,6 +1289,8 @@ bool SemanticAnalyzer::ValidateComputedFeatureExpression(const Field* field, con
 
 bool SemanticAnalyzer::ValidateMemberAccessInExpression(const Expression* expr, const ClassDeclaration* classDecl, const std::string& errorContext)
 {
+    BBFM_ALLOC_SITE("SemanticAnalyzer::ValidateMemberAccessInExpression");
+
     if (nullptr == expr)
     {
         return true;
@@ -611,18 +1339,17 @@ bool SemanticAnalyzer::ValidateMemberAccessInExpression(const Expression* expr,
         return ValidateMemberAccessInExpression(parenExpr->GetExpression(), classDecl, errorContext);
     }
 
-    // Recursively check function call arguments
-    const FunctionCall* funcCall = dynamic_cast<const FunctionCall*>(expr);
-    if (nullptr != funcCall)
+    // Function call arguments are validated with the call (ValidateAggregate, ValidatePatternMatch)
+    if (nullptr != dynamic_cast<const FunctionCall*>(expr))
     {
-        for (const auto& arg : funcCall->GetArguments())
-        {
-            if (!ValidateMemberAccessInExpression(arg.get(), classDecl, errorContext))
-            {
-                success = false;
-            }
-        }
-        return success;
+        return true;
+    }
+
+    // Quantifier bodies are validated by ValidateQuantifiersInExpression, which
+    // puts the bound variable in scope first
+    if (nullptr != dynamic_cast<const QuantifiedExpression*>(expr))
+    {
+        return true;
     }
 
     // Field references and literals don't need member access validation
@@ -631,6 +1358,8 @@ bool SemanticAnalyzer::ValidateMemberAccessInExpression(const Expression* expr,
 
 bool SemanticAnalyzer::ValidateMemberAccess(const MemberAccessExpression* memberAccess, const ClassDeclaration* classDecl, const std::string& errorContext)
 {
+    BBFM_ALLOC_SITE("SemanticAnalyzer::ValidateMemberAccess");
+
     bool success = true;
 
     // Get the object expression (left side of the dot)
@@ -657,6 +1386,12 @@ bool SemanticAnalyzer::ValidateMemberAccess(const MemberAccessExpression* member
             return false;
         }
 
+        // Members of a type damaged by a syntax error are unknown, the access is not checked further
+        if (0 != brokenTypes_.count(fieldType->name))
+        {
+            return false;
+        }
+
         // Verify the member exists in the field's type
         const ClassDeclaration* fieldClass = fieldType->classDecl;
         const TypeSymbol*       memberType = GetFieldType(fieldClass, memberAccess->GetMemberName());
@@ -682,41 +1417,726 @@ bool SemanticAnalyzer::ValidateMemberAccess(const MemberAccessExpression* member
         }
     }
 
-    return success;
+    return success;
+}
+
+const TypeSymbol* SemanticAnalyzer::GetFieldType(const ClassDeclaration* classDecl, const std::string& fieldName) const
+{
+    BBFM_ALLOC_SITE("SemanticAnalyzer::GetFieldType");
+
+    // Variables bound by an enclosing quantifier take precedence
+    const TypeSymbol* boundType = LookupBoundVariable(fieldName);
+    if (nullptr != boundType)
+    {
+        return boundType;
+    }
+
+    // Find the field including inherited fields
+    const Field* field = LookupField(classDecl, fieldName);
+    if (nullptr != field)
+    {
+        return LookupType(TypeSpecToName(field->GetType()));
+    }
+
+    // Universal metadata fields exist on every class
+    const char* universalType = UniversalFieldTypeName(fieldName);
+    if (nullptr != universalType)
+    {
+        return LookupType(universalType);
+    }
+
+    return nullptr;
+}
+
+const std::map<std::string, const char*>& SemanticAnalyzer::GetUniversalFields()
+{
+    static const std::map<std::string, const char*> universalFields = {
+        {"typeId", "Guid"},
+        {"id", "Guid"},
+        {"cardinality", "Int"},
+        {"creationDate", "Timestamp"},
+        {"modificationDate", "Timestamp"},
+        {"comment", "String"},
+    };
+    return universalFields;
+}
+
+const char* SemanticAnalyzer::UniversalFieldTypeName(const std::string& fieldName)
+{
+    const auto& universalFields = GetUniversalFields();
+    auto        it              = universalFields.find(fieldName);
+    return (universalFields.end() != it) ? it->second : nullptr;
+}
+
+void SemanticAnalyzer::AddUniversalFieldNames(std::set<std::string>& fieldNames)
+{
+    for (const auto& entry : GetUniversalFields())
+    {
+        fieldNames.insert(entry.first);
+    }
+}
+
+std::string SemanticAnalyzer::TypeSpecToName(const TypeSpec* typeSpec)
+{
+    if (typeSpec->IsPrimitive())
+    {
+        const PrimitiveTypeSpec* primType = static_cast<const PrimitiveTypeSpec*>(typeSpec);
+        return PrimitiveTypeSpec::TypeToString(primType->GetType());
+    }
+
+    const UserDefinedTypeSpec* userType = static_cast<const UserDefinedTypeSpec*>(typeSpec);
+    return userType->GetTypeName();
+}
+
+const Field* SemanticAnalyzer::LookupField(const ClassDeclaration* classDecl, const std::string& fieldName) const
+{
+    BBFM_ALLOC_SITE("SemanticAnalyzer::LookupField");
+
+    std::vector<const Field*> allFields;
+    GetAllFields(classDecl, allFields);
+
+    for (const auto* field : allFields)
+    {
+        if (field->GetName() == fieldName)
+        {
+            return field;
+        }
+    }
+
+    return nullptr;
+}
+
+bool SemanticAnalyzer::ValidateFunctionCallsInExpression(const Expression* expr, const ClassDeclaration* classDecl, const std::string& errorContext)
+{
+    BBFM_ALLOC_SITE("SemanticAnalyzer::ValidateFunctionCallsInExpression");
+
+    if (nullptr == expr)
+    {
+        return true;
+    }
+
+    // Function calls are validated as a whole
+    const FunctionCall* funcCall = dynamic_cast<const FunctionCall*>(expr);
+    if (nullptr != funcCall)
+    {
+        if ("matches" == funcCall->GetFunctionName())
+        {
+            return ValidatePatternMatch(funcCall, classDecl, errorContext);
+        }
+        return ValidateAggregate(funcCall, classDecl, errorContext);
+    }
+
+    // Recursively check binary expressions
+    const BinaryExpression* binExpr = dynamic_cast<const BinaryExpression*>(expr);
+    if (nullptr != binExpr)
+    {
+        bool success = ValidateFunctionCallsInExpression(binExpr->GetLeft(), classDecl, errorContext);
+        if (!ValidateFunctionCallsInExpression(binExpr->GetRight(), classDecl, errorContext))
+        {
+            success = false;
+        }
+        return success;
+    }
+
+    // Recursively check unary expressions
+    const UnaryExpression* unaryExpr = dynamic_cast<const UnaryExpression*>(expr);
+    if (nullptr != unaryExpr)
+    {
+        return ValidateFunctionCallsInExpression(unaryExpr->GetOperand(), classDecl, errorContext);
+    }
+
+    // Recursively check parenthesized expressions
+    const ParenthesizedExpression* parenExpr = dynamic_cast<const ParenthesizedExpression*>(expr);
+    if (nullptr != parenExpr)
+    {
+        return ValidateFunctionCallsInExpression(parenExpr->GetExpression(), classDecl, errorContext);
+    }
+
+    // Recursively check quantifier bodies with the bound variable in scope
+    const QuantifiedExpression* quantExpr = dynamic_cast<const QuantifiedExpression*>(expr);
+    if (nullptr != quantExpr)
+    {
+        const Field* collection = ResolveCollectionField(quantExpr->GetCollection(), classDecl);
+        if (nullptr == collection)
+        {
+            // Reported by ValidateQuantifiersInExpression
+            return true;
+        }
+
+        boundVariables_.push_back({quantExpr->GetVariableName(), LookupType(TypeSpecToName(collection->GetType()))});
+        bool success = ValidateFunctionCallsInExpression(quantExpr->GetBody(), classDecl, errorContext);
+        boundVariables_.pop_back();
+        return success;
+    }
+
+    // Field references, member access and literals cannot contain function calls
+    return true;
+}
+
+bool SemanticAnalyzer::ValidateAggregate(const FunctionCall* funcCall, const ClassDeclaration* classDecl, const std::string& errorContext)
+{
+    BBFM_ALLOC_SITE("SemanticAnalyzer::ValidateAggregate");
+
+    const std::string& functionName = funcCall->GetFunctionName();
+
+    AggregateSymbol::Kind kind;
+    if (!AggregateKindFromName(functionName, kind))
+    {
+        ReportError("In " + errorContext + ": unknown function '" + functionName + "'");
+        return false;
+    }
+
+    const auto& arguments = funcCall->GetArguments();
+    if (1 != arguments.size())
+    {
+        ReportError("In " + errorContext + ": " + functionName + "() expects exactly one argument, got " + std::to_string(arguments.size()));
+        return false;
+    }
+
+    // The argument is either an array field (count(episodes), sum(scores))
+    // or a member of an array field's element type (sum(episodes.duration))
+    const Expression*             argument     = arguments[0].get();
+    const FieldReference*         fieldRef     = dynamic_cast<const FieldReference*>(argument);
+    const MemberAccessExpression* memberAccess = dynamic_cast<const MemberAccessExpression*>(argument);
+    if (nullptr != memberAccess)
+    {
+        fieldRef = dynamic_cast<const FieldReference*>(memberAccess->GetObject());
+        if (nullptr == fieldRef)
+        {
+            ReportError("In " + errorContext + ": " + functionName + "() only supports a single member access on an array field");
+            return false;
+        }
+    }
+
+    if (nullptr == fieldRef)
+    {
+        ReportError("In " + errorContext + ": argument of " + functionName + "() must be an array field");
+        return false;
+    }
+
+    if (nullptr != LookupBoundVariable(fieldRef->GetFieldName()))
+    {
+        ReportError(
+            "In " + errorContext + ": " + functionName + "() over quantified variable '" + fieldRef->GetFieldName() +
+            "' is not supported - aggregates must range over an array field of the class");
+        return false;
+    }
+
+    const Field* collection = LookupField(classDecl, fieldRef->GetFieldName());
+    if (nullptr == collection)
+    {
+        // Undefined field references are reported by the caller
+        return false;
+    }
+
+    const CardinalityModifier* cardinality = collection->GetCardinalityModifier();
+    if (nullptr == cardinality || !cardinality->IsArray())
+    {
+        ReportError(
+            "In " + errorContext + ": " + functionName + "() requires an array field, but '" + collection->GetName() +
+            "' is not an array field (a cardinality with a maximum above 1)");
+        return false;
+    }
+
+    if (AggregateSymbol::Kind::COUNT == kind && nullptr != memberAccess)
+    {
+        ReportError("In " + errorContext + ": count() takes the array field itself, not a member of its elements");
+        return false;
+    }
+
+    // The member must exist on the element type before its type can be checked
+    if (nullptr != memberAccess && !ValidateMemberAccess(memberAccess, classDecl, errorContext))
+    {
+        return false;
+    }
+
+    Expression::Type resultType = InferAggregateType(funcCall, classDecl);
+    if (AggregateSymbol::Kind::SUM == kind && Expression::Type::UNKNOWN == resultType)
+    {
+        ReportError(
+            "In " + errorContext + ": sum() requires numeric elements (Int, Real or Timespan), but '" + argument->ToString() +
+            "' is not numeric");
+        return false;
+    }
+
+    // Record the aggregate for incremental maintenance (deduplicated per class)
+    const std::string memberName = (nullptr != memberAccess) ? memberAccess->GetMemberName() : std::string();
+    auto&             aggregates = aggregates_[classDecl->GetName()];
+    for (const auto& existing : aggregates)
+    {
+        if (existing.kind == kind && existing.collection == collection && existing.memberName == memberName)
+        {
+            return true;
+        }
+    }
+    aggregates.push_back(AggregateSymbol{kind, collection, memberName, resultType});
+    if (nullptr != currentQuery_)
+    {
+        currentQuery_->aggregates.push_back(ClassQueryResult::Aggregate{kind, collection->GetName(), memberName, resultType});
+    }
+
+    return true;
+}
+
+bool SemanticAnalyzer::ValidatePatternMatch(const FunctionCall* funcCall, const ClassDeclaration* classDecl, const std::string& errorContext)
+{
+    BBFM_ALLOC_SITE("SemanticAnalyzer::ValidatePatternMatch");
+
+    const auto& arguments = funcCall->GetArguments();
+    if (2 != arguments.size())
+    {
+        ReportError("In " + errorContext + ": matches() expects a string field and a pattern, got " + std::to_string(arguments.size()) + " argument(s)");
+        return false;
+    }
+
+    bool success = true;
+
+    // The subject must be a string (field, member of an object or bound variable)
+    const Expression* subject = arguments[0].get();
+    if (!ValidateMemberAccessInExpression(subject, classDecl, errorContext))
+    {
+        success = false;
+    }
+    else
+    {
+        Expression::Type subjectType = InferExpressionType(subject, classDecl);
+        if (Expression::Type::STRING != subjectType && Expression::Type::UNKNOWN != subjectType)
+        {
+            ReportError("In " + errorContext + ": matches() requires a String subject, but '" + subject->ToString() + "' is not a String");
+            success = false;
+        }
+        else if (Expression::Type::UNKNOWN == subjectType && nullptr == dynamic_cast<const FieldReference*>(subject))
+        {
+            ReportError("In " + errorContext + ": matches() requires a String subject, but the type of '" + subject->ToString() + "' is unknown");
+            success = false;
+        }
+        else if (IsMultiValued(subject, classDecl))
+        {
+            // The type of an array is its element type, but a pattern matches one value; a member of an array's elements is matched per element
+            const MemberAccessExpression* memberAccess = dynamic_cast<const MemberAccessExpression*>(subject);
+            std::string                   suggestion   = "forall t in " + subject->ToString() + ": matches(t, ...)";
+            if (nullptr != memberAccess && IsMultiValued(memberAccess->GetObject(), classDecl))
+            {
+                suggestion = "forall e in " + memberAccess->GetObject()->ToString() + ": matches(e." + memberAccess->GetMemberName() + ", ...)";
+            }
+            ReportError("In " + errorContext + ": matches() requires a single String, but '" + subject->ToString() + "' may hold several values - use '" +
+                        suggestion + "'");
+            success = false;
+        }
+    }
+
+    // The pattern must be a literal so it can be compiled now
+    const LiteralExpression* patternLiteral = dynamic_cast<const LiteralExpression*>(arguments[1].get());
+    if (nullptr == patternLiteral || Expression::Type::STRING != patternLiteral->GetResultType())
+    {
+        ReportError("In " + errorContext + ": second argument of matches() must be a string literal pattern");
+        return false;
+    }
+
+    // The lexer keeps the quotes of string literals
+    std::string pattern = patternLiteral->GetStringValue();
+    if (pattern.size() >= 2 && '"' == pattern.front() && '"' == pattern.back())
+    {
+        pattern = pattern.substr(1, pattern.size() - 2);
+    }
+
+    // Compile each distinct pattern once
+    auto compiled = compiledPatterns_.find(pattern);
+    if (compiledPatterns_.end() == compiled)
+    {
+        std::string                 patternError;
+        std::unique_ptr<PatternDfa> dfa = PatternCompiler::Compile(pattern, patternError);
+        if (nullptr == dfa)
+        {
+            ReportError("In " + errorContext + ": invalid pattern \"" + pattern + "\": " + patternError);
+            return false;
+        }
+        compiled = compiledPatterns_.insert({pattern, std::move(dfa)}).first;
+    }
+
+    if (!success)
+    {
+        return false;
+    }
+
+    // Record the pattern constraint (deduplicated per class)
+    const std::string subjectText = subject->ToString();
+    auto&             patterns    = patterns_[classDecl->GetName()];
+    for (const auto& existing : patterns)
+    {
+        if (existing.subject == subjectText && existing.pattern == pattern)
+        {
+            return true;
+        }
+    }
+    patterns.push_back(PatternSymbol{subjectText, pattern, compiled->second.get()});
+    if (nullptr != currentQuery_)
+    {
+        currentQuery_->patterns.push_back(ClassQueryResult::Pattern{subjectText, pattern});
+    }
+
+    return true;
+}
+
+bool SemanticAnalyzer::ValidateQuantifiersInExpression(const Expression* expr, const ClassDeclaration* classDecl, const std::string& errorContext)
+{
+    BBFM_ALLOC_SITE("SemanticAnalyzer::ValidateQuantifiersInExpression");
+
+    if (nullptr == expr)
+    {
+        return true;
+    }
+
+    const QuantifiedExpression* quantExpr = dynamic_cast<const QuantifiedExpression*>(expr);
+    if (nullptr != quantExpr)
+    {
+        const char*        quantifier   = QuantifiedExpression::QuantifierToString(quantExpr->GetQuantifier());
+        const std::string& variableName = quantExpr->GetVariableName();
+        const Expression*  collectionEx = quantExpr->GetCollection();
+
+        // The collection is either an array field or an array member of an enclosing bound variable
+        if (!ValidateMemberAccessInExpression(collectionEx, classDecl, errorContext))
+        {
+            return false;
+        }
+
+        const Field* collection = ResolveCollectionField(collectionEx, classDecl);
+        if (nullptr == collection)
+        {
+            const FieldReference* fieldRef = dynamic_cast<const FieldReference*>(collectionEx);
+            if (nullptr != fieldRef && nullptr == LookupBoundVariable(fieldRef->GetFieldName()))
+            {
+                // Undefined field references are reported by the caller
+                return false;
+            }
+
+            ReportError("In " + errorContext + ": " + quantifier + " must range over an array field, not '" + collectionEx->ToString() + "'");
+            return false;
+        }
+
+        const CardinalityModifier* cardinality = collection->GetCardinalityModifier();
+        if (nullptr == cardinality || !cardinality->IsArray())
+        {
+            ReportError(
+                "In " + errorContext + ": " + quantifier + " requires an array field, but '" + collection->GetName() +
+                "' is not an array field (a cardinality with a maximum above 1)");
+            return false;
+        }
+
+        if (nullptr != LookupField(classDecl, variableName) || nullptr != LookupBoundVariable(variableName))
+        {
+            ReportError("In " + errorContext + ": quantified variable '" + variableName + "' shadows a field or an enclosing variable");
+            return false;
+        }
+
+        bool success = true;
+
+        // Validate the body with the bound variable ranging over the element type
+        boundVariables_.push_back({variableName, LookupType(TypeSpecToName(collection->GetType()))});
+
+        if (!ValidateMemberAccessInExpression(quantExpr->GetBody(), classDecl, errorContext))
+        {
+            success = false;
+        }
+
+        if (!ValidateQuantifiersInExpression(quantExpr->GetBody(), classDecl, errorContext))
+        {
+            success = false;
+        }
+
+        Expression::Type bodyType = InferExpressionType(quantExpr->GetBody(), classDecl);
+        if (Expression::Type::BOOL != bodyType && Expression::Type::UNKNOWN != bodyType)
+        {
+            ReportError("In " + errorContext + ": body of " + quantifier + " over '" + collection->GetName() + "' must be a boolean predicate");
+            success = false;
+        }
+
+        boundVariables_.pop_back();
+        return success;
+    }
+
+    // Recursively check binary expressions
+    const BinaryExpression* binExpr = dynamic_cast<const BinaryExpression*>(expr);
+    if (nullptr != binExpr)
+    {
+        bool success = ValidateQuantifiersInExpression(binExpr->GetLeft(), classDecl, errorContext);
+        if (!ValidateQuantifiersInExpression(binExpr->GetRight(), classDecl, errorContext))
+        {
+            success = false;
+        }
+        return success;
+    }
+
+    // Recursively check unary expressions
+    const UnaryExpression* unaryExpr = dynamic_cast<const UnaryExpression*>(expr);
+    if (nullptr != unaryExpr)
+    {
+        return ValidateQuantifiersInExpression(unaryExpr->GetOperand(), classDecl, errorContext);
+    }
+
+    // Recursively check parenthesized expressions
+    const ParenthesizedExpression* parenExpr = dynamic_cast<const ParenthesizedExpression*>(expr);
+    if (nullptr != parenExpr)
+    {
+        return ValidateQuantifiersInExpression(parenExpr->GetExpression(), classDecl, errorContext);
+    }
+
+    // Field references, member access, function calls and literals cannot contain quantifiers
+    return true;
+}
+
+bool SemanticAnalyzer::ValidateTemporalOperandsInExpression(const Expression* expr, const ClassDeclaration* classDecl, const std::string& errorContext)
+{
+    BBFM_ALLOC_SITE("SemanticAnalyzer::ValidateTemporalOperandsInExpression");
+
+    if (nullptr == expr)
+    {
+        return true;
+    }
+
+    const BinaryExpression* binExpr = dynamic_cast<const BinaryExpression*>(expr);
+    if (nullptr != binExpr)
+    {
+        bool success = ValidateTemporalOperandsInExpression(binExpr->GetLeft(), classDecl, errorContext);
+        if (!ValidateTemporalOperandsInExpression(binExpr->GetRight(), classDecl, errorContext))
+        {
+            success = false;
+        }
+        if (!success)
+        {
+            return false;
+        }
+
+        const BinaryExpression::Op op        = binExpr->GetOperator();
+        const Expression::Type     leftType  = InferExpressionType(binExpr->GetLeft(), classDecl);
+        const Expression::Type     rightType = InferExpressionType(binExpr->GetRight(), classDecl);
+
+        const bool leftTemporal  = (Expression::Type::TIMESTAMP == leftType || Expression::Type::TIMESPAN == leftType);
+        const bool rightTemporal = (Expression::Type::TIMESTAMP == rightType || Expression::Type::TIMESPAN == rightType);
+        if ((!leftTemporal && !rightTemporal) || Expression::Type::UNKNOWN == leftType || Expression::Type::UNKNOWN == rightType)
+        {
+            return true;
+        }
+
+        bool valid = true;
+        switch (op)
+        {
+            case BinaryExpression::Op::AND:
+            case BinaryExpression::Op::OR:
+                valid = false;
+                break;
+
+            case BinaryExpression::Op::LT:
+            case BinaryExpression::Op::GT:
+            case BinaryExpression::Op::LE:
+            case BinaryExpression::Op::GE:
+            case BinaryExpression::Op::EQ:
+            case BinaryExpression::Op::NE:
+                // Same temporal type, or a raw Int microsecond count
+                valid = (leftType == rightType) || (leftTemporal && Expression::Type::INT == rightType) ||
+                        (rightTemporal && Expression::Type::INT == leftType);
+                break;
+
+            default:
+                valid = (Expression::Type::UNKNOWN != BinaryExpression::InferArithmeticType(op, leftType, rightType));
+                break;
+        }
+
+        if (!valid)
+        {
+            ReportError(
+                "In " + errorContext + ": operator '" + BinaryExpression::OpToString(op) + "' cannot be applied to '" + Expression::TypeToString(leftType) +
+                "' and '" + Expression::TypeToString(rightType) + "' in '" + binExpr->ToString() + "'");
+            return false;
+        }
+        return true;
+    }
+
+    const UnaryExpression* unaryExpr = dynamic_cast<const UnaryExpression*>(expr);
+    if (nullptr != unaryExpr)
+    {
+        if (!ValidateTemporalOperandsInExpression(unaryExpr->GetOperand(), classDecl, errorContext))
+        {
+            return false;
+        }
+
+        // A point in time has no negation, a duration does
+        if (UnaryExpression::Op::NEG == unaryExpr->GetOperator() && Expression::Type::TIMESTAMP == InferExpressionType(unaryExpr->GetOperand(), classDecl))
+        {
+            ReportError("In " + errorContext + ": cannot negate Timestamp '" + unaryExpr->GetOperand()->ToString() + "'");
+            return false;
+        }
+        return true;
+    }
+
+    const ParenthesizedExpression* parenExpr = dynamic_cast<const ParenthesizedExpression*>(expr);
+    if (nullptr != parenExpr)
+    {
+        return ValidateTemporalOperandsInExpression(parenExpr->GetExpression(), classDecl, errorContext);
+    }
+
+    // Check quantifier bodies with the bound variable in scope
+    const QuantifiedExpression* quantExpr = dynamic_cast<const QuantifiedExpression*>(expr);
+    if (nullptr != quantExpr)
+    {
+        const Field* collection = ResolveCollectionField(quantExpr->GetCollection(), classDecl);
+        if (nullptr == collection)
+        {
+            // Reported by ValidateQuantifiersInExpression
+            return true;
+        }
+
+        boundVariables_.push_back({quantExpr->GetVariableName(), LookupType(TypeSpecToName(collection->GetType()))});
+        bool success = ValidateTemporalOperandsInExpression(quantExpr->GetBody(), classDecl, errorContext);
+        boundVariables_.pop_back();
+        return success;
+    }
+
+    // Function call arguments are checked by ValidateFunctionCallsInExpression
+    return true;
+}
+
+const Field* SemanticAnalyzer::ResolveCollectionField(const Expression* collection, const ClassDeclaration* classDecl) const
+{
+    // Array field of the class itself
+    const FieldReference* fieldRef = dynamic_cast<const FieldReference*>(collection);
+    if (nullptr != fieldRef)
+    {
+        if (nullptr != LookupBoundVariable(fieldRef->GetFieldName()))
+        {
+            return nullptr;
+        }
+        return LookupField(classDecl, fieldRef->GetFieldName());
+    }
+
+    // Array member of an object field or of an enclosing bound variable (e.g., e.regions)
+    const MemberAccessExpression* memberAccess = dynamic_cast<const MemberAccessExpression*>(collection);
+    if (nullptr != memberAccess)
+    {
+        const FieldReference* objectRef = dynamic_cast<const FieldReference*>(memberAccess->GetObject());
+        if (nullptr != objectRef)
+        {
+            const TypeSymbol* objectType = GetFieldType(classDecl, objectRef->GetFieldName());
+            if (nullptr != objectType && TypeSymbol::Kind::CLASS == objectType->kind)
+            {
+                return LookupField(objectType->classDecl, memberAccess->GetMemberName());
+            }
+        }
+    }
+
+    return nullptr;
+}
+
+bool SemanticAnalyzer::IsMultiValued(const Expression* expr, const ClassDeclaration* classDecl) const
+{
+    // A bound variable is one element of its collection
+    const FieldReference* fieldRef = dynamic_cast<const FieldReference*>(expr);
+    if (nullptr != fieldRef && nullptr != LookupBoundVariable(fieldRef->GetFieldName()))
+    {
+        return false;
+    }
+
+    // A member of every element of an array (e.g., episodes.title) has several values too
+    const MemberAccessExpression* memberAccess = dynamic_cast<const MemberAccessExpression*>(expr);
+    if (nullptr != memberAccess && IsMultiValued(memberAccess->GetObject(), classDecl))
+    {
+        return true;
+    }
+
+    const Field*               field       = ResolveCollectionField(expr, classDecl);
+    const CardinalityModifier* cardinality = (nullptr != field) ? field->GetCardinalityModifier() : nullptr;
+    return nullptr != cardinality && cardinality->IsArray();
+}
+
+const TypeSymbol* SemanticAnalyzer::LookupBoundVariable(const std::string& name) const
+{
+    // Innermost binding wins
+    for (auto it = boundVariables_.rbegin(); it != boundVariables_.rend(); ++it)
+    {
+        if (it->first == name)
+        {
+            return it->second;
+        }
+    }
+
+    return nullptr;
+}
+
+Expression::Type SemanticAnalyzer::InferAggregateType(const FunctionCall* funcCall, const ClassDeclaration* classDecl) const
+{
+    AggregateSymbol::Kind kind;
+    if (!AggregateKindFromName(funcCall->GetFunctionName(), kind) || 1 != funcCall->GetArguments().size())
+    {
+        return Expression::Type::UNKNOWN;
+    }
+
+    if (AggregateSymbol::Kind::COUNT == kind)
+    {
+        return Expression::Type::INT;
+    }
+
+    // sum() has the element type, which must be numeric
+    const Expression*             argument     = funcCall->GetArguments()[0].get();
+    const MemberAccessExpression* memberAccess = dynamic_cast<const MemberAccessExpression*>(argument);
+    const FieldReference*         fieldRef     = dynamic_cast<const FieldReference*>(nullptr != memberAccess ? memberAccess->GetObject() : argument);
+    if (nullptr == fieldRef)
+    {
+        return Expression::Type::UNKNOWN;
+    }
+
+    const TypeSymbol* elementType = GetFieldType(classDecl, fieldRef->GetFieldName());
+    if (nullptr != elementType && nullptr != memberAccess)
+    {
+        elementType = (TypeSymbol::Kind::CLASS == elementType->kind) ? GetFieldType(elementType->classDecl, memberAccess->GetMemberName()) : nullptr;
+    }
+
+    if (nullptr == elementType || TypeSymbol::Kind::PRIMITIVE != elementType->kind)
+    {
+        return Expression::Type::UNKNOWN;
+    }
+
+    Expression::Type type = PrimitiveNameToExpressionType(elementType->name);
+    if (Expression::Type::INT == type || Expression::Type::REAL == type || Expression::Type::TIMESPAN == type)
+    {
+        return type;
+    }
+
+    return Expression::Type::UNKNOWN;
+}
+
+bool SemanticAnalyzer::AggregateKindFromName(const std::string& functionName, AggregateSymbol::Kind& kind)
+{
+    if ("count" == functionName)
+    {
+        kind = AggregateSymbol::Kind::COUNT;
+        return true;
+    }
+    if ("sum" == functionName)
+    {
+        kind = AggregateSymbol::Kind::SUM;
+        return true;
+    }
+
+    return false;
 }
 
-const TypeSymbol* SemanticAnalyzer::GetFieldType(const ClassDeclaration* classDecl, const std::string& fieldName) const
+const char* AggregateSymbol::KindToString(const Kind kind)
 {
-    // Get all fields including inherited
-    std::vector<const Field*> allFields;
-    const_cast<SemanticAnalyzer*>(this)->GetAllFields(classDecl, allFields);
-
-    // Find the field
-    for (const auto* field : allFields)
+    switch (kind)
     {
-        if (field->GetName() == fieldName)
-        {
-            const TypeSpec* typeSpec = field->GetType();
-
-            if (typeSpec->IsPrimitive())
-            {
-                const PrimitiveTypeSpec* primType = static_cast<const PrimitiveTypeSpec*>(typeSpec);
-                const std::string        typeName = PrimitiveTypeSpec::TypeToString(primType->GetType());
-                return LookupType(typeName);
-            }
-            else if (typeSpec->IsUserDefined())
-            {
-                const UserDefinedTypeSpec* userType = static_cast<const UserDefinedTypeSpec*>(typeSpec);
-                return LookupType(userType->GetTypeName());
-            }
-        }
+        case Kind::COUNT:
+            return "count";
+        case Kind::SUM:
+            return "sum";
+        default:
+            return "?";
     }
-
-    return nullptr;
 }
 
 Expression::Type SemanticAnalyzer::InferExpressionType(const Expression* expr, const ClassDeclaration* classDecl) const
 {
+    BBFM_ALLOC_SITE("SemanticAnalyzer::InferExpressionType");
+
     if (nullptr == expr)
     {
         return Expression::Type::UNKNOWN;
@@ -791,26 +2211,7 @@ Expression::Type SemanticAnalyzer::InferExpressionType(const Expression* expr, c
             return Expression::Type::UNKNOWN;
         }
 
-        // Type widening: if either is REAL, result is REAL
-        if (Expression::Type::REAL == leftType || Expression::Type::REAL == rightType || Expression::Type::TIMESTAMP == leftType ||
-            Expression::Type::TIMESTAMP == rightType || Expression::Type::TIMESPAN == leftType || Expression::Type::TIMESPAN == rightType)
-        {
-            return Expression::Type::REAL;
-        }
-
-        // If both are INT, result is INT
-        if (Expression::Type::INT == leftType && Expression::Type::INT == rightType)
-        {
-            return Expression::Type::INT;
-        }
-
-        // If both are STRING, result is STRING (for concatenation)
-        if (Expression::Type::STRING == leftType && Expression::Type::STRING == rightType && BinaryExpression::Op::ADD == op)
-        {
-            return Expression::Type::STRING;
-        }
-
-        return Expression::Type::UNKNOWN;
+        return BinaryExpression::InferArithmeticType(op, leftType, rightType);
     }
 
     // Check for unary expressions
@@ -837,7 +2238,17 @@ Expression::Type SemanticAnalyzer::InferExpressionType(const Expression* expr, c
     const FunctionCall* funcCall = dynamic_cast<const FunctionCall*>(expr);
     if (nullptr != funcCall)
     {
-        return funcCall->GetResultType();
+        if ("matches" == funcCall->GetFunctionName())
+        {
+            return Expression::Type::BOOL;
+        }
+        return InferAggregateType(funcCall, classDecl);
+    }
+
+    // Quantified expressions are predicates
+    if (nullptr != dynamic_cast<const QuantifiedExpression*>(expr))
+    {
+        return Expression::Type::BOOL;
     }
 
     return Expression::Type::UNKNOWN;
@@ -845,6 +2256,8 @@ Expression::Type SemanticAnalyzer::InferExpressionType(const Expression* expr, c
 
 bool SemanticAnalyzer::IsTypeCompatible(Expression::Type exprType, const TypeSpec* fieldTypeSpec) const
 {
+    BBFM_ALLOC_SITE("SemanticAnalyzer::IsTypeCompatible");
+
     if (nullptr == fieldTypeSpec)
     {
         return false;
@@ -871,13 +2284,9 @@ bool SemanticAnalyzer::IsTypeCompatible(Expression::Type exprType, const TypeSpe
         return true;
     }
 
-    // Timestamp and Timespan are both represented as Real internally
-    if (Expression::Type::REAL == exprType && (Expression::Type::TIMESTAMP == fieldType || Expression::Type::TIMESPAN == fieldType))
-    {
-        return true;
-    }
-
-    if ((Expression::Type::TIMESTAMP == exprType || Expression::Type::TIMESPAN == exprType) && Expression::Type::REAL == fieldType)
+    // Timestamp and Timespan are Int microsecond counts, so an Int converts to either.
+    // Real never converts to or from a temporal type, which would lose precision.
+    if (Expression::Type::INT == exprType && (Expression::Type::TIMESTAMP == fieldType || Expression::Type::TIMESPAN == fieldType))
     {
         return true;
     }
@@ -922,11 +2331,21 @@ Expression::Type SemanticAnalyzer::PrimitiveNameToExpressionType(const std::stri
 
 bool SemanticAnalyzer::TypeExists(const std::string& typeName) const
 {
+    if (nullptr != currentQuery_)
+    {
+        currentQuery_->dependencies.insert(typeName);
+    }
     return 0 != symbolTable_.count(typeName);
 }
 
 const TypeSymbol* SemanticAnalyzer::LookupType(const std::string& typeName) const
 {
+    BBFM_ALLOC_SITE("SemanticAnalyzer::LookupType");
+
+    if (nullptr != currentQuery_)
+    {
+        currentQuery_->dependencies.insert(typeName);
+    }
     auto it = symbolTable_.find(typeName);
     if (symbolTable_.end() == it)
     {
@@ -937,8 +2356,33 @@ const TypeSymbol* SemanticAnalyzer::LookupType(const std::string& typeName) cons
 
 void SemanticAnalyzer::ReportError(const std::string& message)
 {
-    Console::ReportError("Semantic error: " + message);
+    const bool located = (nullptr != errorNode_ && 0 != errorNode_->GetLine());
+    ReportError(message, located ? errorNode_->GetLine() : 0, located ? errorNode_->GetColumn() : 0);
+}
+
+void SemanticAnalyzer::ReportError(const std::string& message, const int line, const int column)
+{
+    if (0 == line || nullptr == errorDeclaration_ || errorDeclaration_->GetSourceFile().empty())
+    {
+        Console::ReportError("Semantic error: " + message);
+    }
+    else
+    {
+        Diagnostic diagnostic;
+        diagnostic.file    = errorDeclaration_->GetSourceFile();
+        diagnostic.line    = line;
+        diagnostic.column  = column;
+        diagnostic.message = message;
+        Diagnostics::Report(std::move(diagnostic));
+    }
+
     hasErrors_ = true;
+    if (nullptr != currentQuery_)
+    {
+        // Queries are per class; the offset keeps the location right when the class moves
+        const int classLine = errorDeclaration_->AsClass()->GetLine();
+        currentQuery_->errors.push_back(ClassQueryResult::Error{message, line - classLine, (0 == line) ? 0 : column});
+    }
 }
 
 bool SemanticAnalyzer::HasErrors() const
@@ -951,75 +2395,84 @@ const std::map<std::string, TypeSymbol>& SemanticAnalyzer::GetSymbolTable() cons
     return symbolTable_;
 }
 
-void SemanticAnalyzer::DumpSymbolTable() const
+const std::vector<PatternSymbol>& SemanticAnalyzer::GetPatterns(const std::string& className) const
+{
+    static const std::vector<PatternSymbol> noPatterns;
+
+    auto it = patterns_.find(className);
+    if (patterns_.end() == it)
+    {
+        return noPatterns;
+    }
+    return it->second;
+}
+
+const std::vector<AggregateSymbol>& SemanticAnalyzer::GetAggregates(const std::string& className) const
+{
+    static const std::vector<AggregateSymbol> noAggregates;
+
+    auto it = aggregates_.find(className);
+    if (aggregates_.end() == it)
+    {
+        return noAggregates;
+    }
+    return it->second;
+}
+
+void SemanticAnalyzer::DumpSymbolTable(OutputBuffer& out) const
 {
-    std::cout << "========================================\n";
-    std::cout << "Symbol Table\n";
-    std::cout << "========================================\n\n";
+    out << "========================================\n";
+    out << "Symbol Table\n";
+    out << "========================================\n\n";
 
     // Count types by kind
     int primitiveCount = 0;
     int enumCount      = 0;
     int classCount     = 0;
+    CountSymbols(primitiveCount, enumCount, classCount);
 
-    for (const auto& entry : symbolTable_)
-    {
-        if (TypeSymbol::Kind::PRIMITIVE == entry.second.kind)
-        {
-            primitiveCount++;
-        }
-        else if (TypeSymbol::Kind::ENUM == entry.second.kind)
-        {
-            enumCount++;
-        }
-        else if (TypeSymbol::Kind::CLASS == entry.second.kind)
-        {
-            classCount++;
-        }
-    }
-
-    std::cout << "Total Symbols: " << symbolTable_.size() << "\n";
-    std::cout << "  Primitive Types: " << primitiveCount << "\n";
-    std::cout << "  Enumerations: " << enumCount << "\n";
-    std::cout << "  Classes: " << classCount << "\n";
-    std::cout << "\n";
+    out << "Total Symbols: " << symbolTable_.size() << "\n";
+    out << "  Primitive Types: " << primitiveCount << "\n";
+    out << "  Enumerations: " << enumCount << "\n";
+    out << "  Classes: " << classCount << "\n";
+    out << "\n";
 
     // Dump primitive types
     if (primitiveCount > 0)
     {
-        std::cout << "Primitive Types:\n";
-        std::cout << "----------------\n";
+        out << "Primitive Types:\n";
+        out << "----------------\n";
         for (const auto& entry : symbolTable_)
         {
             if (TypeSymbol::Kind::PRIMITIVE == entry.second.kind)
             {
-                std::cout << "  " << entry.second.name << "\n";
+                out << "  " << entry.second.name << "\n";
             }
         }
-        std::cout << "\n";
+        out << "\n";
     }
 
     // Dump enums
     if (enumCount > 0)
     {
-        std::cout << "Enumerations:\n";
-        std::cout << "-------------\n";
+        out << "Enumerations:\n";
+        out << "-------------\n";
         for (const auto& entry : symbolTable_)
         {
             if (TypeSymbol::Kind::ENUM == entry.second.kind)
             {
-                std::cout << "  enum " << entry.second.name << " {\n";
+                out << "  enum " << entry.second.name << " {\n";
                 const auto& values = entry.second.enumDecl->GetValues();
                 for (size_t i = 0; i < values.size(); ++i)
                 {
-                    std::cout << "    " << values[i];
+                    out << "    " << values[i];
                     if (i < values.size() - 1)
                     {
-                        std::cout << ",";
+                        out << ",";
                     }
-                    std::cout << "\n";
+                    out << "\n";
                 }
-                std::cout << "  }\n\n";
+                out << "  }\n\n";
             }
         }
     }
@@ -1027,203 +2480,368 @@ void SemanticAnalyzer::DumpSymbolTable() const
     // Dump classes
     if (classCount > 0)
     {
-        std::cout << "Classes:\n";
-        std::cout << "--------\n";
+        out << "Classes:\n";
+        out << "--------\n";
         for (const auto& entry : symbolTable_)
         {
             if (TypeSymbol::Kind::CLASS == entry.second.kind)
             {
-                std::cout << "  class " << entry.second.name;
+                const ClassDeclaration* classDecl = entry.second.classDecl;
+                out << "  class " << entry.second.name;
 
                 // Show inheritance
-                const std::string& baseType = entry.second.classDecl->GetBaseType();
+                const std::string& baseType = classDecl->GetBaseType();
                 if (false == baseType.empty())
                 {
-                    std::cout << " inherits " << baseType;
+                    out << " inherits " << baseType;
                 }
-                std::cout << " {\n";
+                out << " {\n";
 
                 // Show fields (including inherited)
                 std::vector<const Field*> allFields;
-                GetAllFields(entry.second.classDecl, allFields);
+                GetAllFields(classDecl, allFields);
 
                 // Also get just the local fields for comparison
-                const auto&            localFields = entry.second.classDecl->GetFields();
                 std::set<const Field*> localFieldSet;
-                for (const auto& field : localFields)
+                for (const auto& field : classDecl->GetFields())
                 {
                     localFieldSet.insert(field.get());
                 }
 
                 if (false == allFields.empty())
                 {
-                    std::cout << "    Features:\n";
+                    out << "    Features:\n";
                     for (const auto* field : allFields)
                     {
                         // Determine if this is a local or inherited field
                         bool isLocal = (0 != localFieldSet.count(field));
-                        std::cout << "      " << (isLocal ? "Self::" : "Base::") << field->GetName() << ": ";
-
-                        // Get type name based on TypeSpec type
-                        const TypeSpec* typeSpec = field->GetType();
-                        if (typeSpec->IsPrimitive())
-                        {
-                            const PrimitiveTypeSpec* primType = dynamic_cast<const PrimitiveTypeSpec*>(typeSpec);
-                            std::cout << PrimitiveTypeSpec::TypeToString(primType->GetType());
-                        }
-                        else
-                        {
-                            const UserDefinedTypeSpec* userType = dynamic_cast<const UserDefinedTypeSpec*>(typeSpec);
-                            std::cout << userType->GetTypeName();
-                        }
+                        out << "      " << (isLocal ? "Self::" : "Base::") << field->GetName() << ": " << TypeSpecToName(field->GetType());
 
                         // Show modifiers
-                        const auto& modifiers = field->GetModifiers();
-                        if (false == modifiers.empty())
+                        if (false == field->GetModifiers().empty())
                         {
-                            std::cout << " [";
+                            out << " [";
+                            const auto& modifiers = field->GetModifiers();
                             for (size_t i = 0; i < modifiers.size(); ++i)
                             {
-                                if (const CardinalityModifier* cardMod = dynamic_cast<const CardinalityModifier*>(modifiers[i].get()))
-                                {
-                                    std::cout << cardMod->GetMin() << ".." << cardMod->GetMax();
-                                }
-                                else if (dynamic_cast<const UniqueModifier*>(modifiers[i].get()))
-                                {
-                                    std::cout << "unique";
-                                }
-
+                                PrintModifier(out, modifiers[i].get());
                                 if (i < modifiers.size() - 1)
                                 {
-                                    std::cout << ", ";
+                                    out << ", ";
                                 }
                             }
-                            std::cout << "]";
+                            out << "]";
                         }
 
                         // Show computed feature expression with annotated field origins
-                        if (field->IsComputed())
+                        if (field->IsComputed() && nullptr != field->GetInitializer())
                         {
-                            const Expression* initializer = field->GetInitializer();
-                            if (nullptr != initializer)
-                            {
-                                std::string annotatedExpr = AnnotateExpressionWithOrigin(initializer, entry.second.classDecl, localFieldSet);
-                                std::cout << " = " << annotatedExpr;
-                            }
+                            out << " = ";
+                            AnnotateExpressionWithOrigin(out, field->GetInitializer(), classDecl, localFieldSet);
                         }
 
-                        std::cout << "\n";
+                        out << "\n";
                     }
                 }
 
                 // Show invariants (including inherited)
                 std::vector<const Invariant*> allInvariants;
-                GetAllInvariants(entry.second.classDecl, allInvariants);
+                GetAllInvariants(classDecl, allInvariants);
 
                 // Also get just the local invariants for comparison
-                const auto&                localInvariants = entry.second.classDecl->GetInvariants();
                 std::set<const Invariant*> localInvariantSet;
-                for (const auto& invariant : localInvariants)
+                for (const auto& invariant : classDecl->GetInvariants())
                 {
                     localInvariantSet.insert(invariant.get());
                 }
 
                 if (false == allInvariants.empty())
                 {
-                    std::cout << "    Invariants:\n";
+                    out << "    Invariants:\n";
                     for (const auto* invariant : allInvariants)
                     {
                         // Determine if this is a local or inherited invariant
                         bool isLocal = (0 != localInvariantSet.count(invariant));
-                        std::cout << "      " << (isLocal ? "Self::" : "Base::") << invariant->GetName() << ": ";
+                        out << "      " << (isLocal ? "Self::" : "Base::") << invariant->GetName() << ": ";
                         if (nullptr != invariant->GetExpression())
                         {
-                            std::cout << invariant->GetExpression()->ToString();
+                            invariant->GetExpression()->Print(out);
+                        }
+                        out << "\n";
+                    }
+                }
+
+                // Show incrementally maintained aggregates (including inherited)
+                std::vector<std::pair<bool, const AggregateSymbol*>> allAggregates;
+                GetAllAggregates(classDecl, allAggregates);
+                if (false == allAggregates.empty())
+                {
+                    out << "    Aggregates:\n";
+                    for (const auto& [isLocal, aggregate] : allAggregates)
+                    {
+                        out << "      " << (isLocal ? "Self::" : "Base::") << AggregateSymbol::KindToString(aggregate->kind) << "("
+                            << aggregate->collection->GetName();
+                        if (false == aggregate->memberName.empty())
+                        {
+                            out << "." << aggregate->memberName;
+                        }
+                        out << ")\n";
+                    }
+                }
+
+                // Show compiled pattern constraints (including inherited)
+                std::vector<const ClassDeclaration*> classChain;
+                GetClassChain(classDecl, classChain);
+
+                bool patternsHeaderShown = false;
+                for (const ClassDeclaration* current : classChain)
+                {
+                    for (const auto& pattern : GetPatterns(current->GetName()))
+                    {
+                        if (!patternsHeaderShown)
+                        {
+                            out << "    Patterns:\n";
+                            patternsHeaderShown = true;
                         }
-                        std::cout << "\n";
+                        out << "      " << (current == classDecl ? "Self::" : "Base::") << "matches(" << pattern.subject << ", \"" << pattern.pattern
+                            << "\"): DFA with " << pattern.dfa->GetStateCount() << " states, " << pattern.dfa->GetClassCount() << " byte classes\n";
                     }
                 }
 
-                std::cout << "  }\n\n";
+                out << "  }\n\n";
             }
         }
     }
 
-    std::cout << "========================================\n";
+    out << "========================================\n";
 }
 
-std::string
-    SemanticAnalyzer::AnnotateExpressionWithOrigin(const Expression* expr, const ClassDeclaration* classDecl, const std::set<const Field*>& localFields) const
+void SemanticAnalyzer::DumpSymbolTableJson(JsonWriter& json) const
 {
-    if (nullptr == expr)
+    int primitiveCount = 0;
+    int enumCount      = 0;
+    int classCount     = 0;
+    CountSymbols(primitiveCount, enumCount, classCount);
+
+    json.BeginObject().Key("counts").BeginObject();
+    json.Key("symbols").Integer(static_cast<long long>(symbolTable_.size()));
+    json.Key("primitives").Integer(primitiveCount).Key("enums").Integer(enumCount).Key("classes").Integer(classCount);
+    json.EndObject();
+
+    json.Key("primitives").BeginArray();
+    for (const auto& entry : symbolTable_)
     {
-        return "";
+        if (TypeSymbol::Kind::PRIMITIVE == entry.second.kind)
+        {
+            json.String(entry.second.name);
+        }
     }
+    json.EndArray();
 
-    // Handle different expression types
-    if (const BinaryExpression* binExpr = dynamic_cast<const BinaryExpression*>(expr))
+    json.Key("enums").BeginArray();
+    for (const auto& entry : symbolTable_)
+    {
+        if (TypeSymbol::Kind::ENUM == entry.second.kind)
+        {
+            json.BeginObject().Key("name").String(entry.second.name).Key("values").BeginArray();
+            for (const std::string& value : entry.second.enumDecl->GetValues())
+            {
+                json.String(value);
+            }
+            json.EndArray().EndObject();
+        }
+    }
+    json.EndArray();
+
+    // Expressions are written as text with Self:: and Base:: origin markers, like the text dump
+    OutputBuffer text;
+    json.Key("classes").BeginArray();
+    for (const auto& entry : symbolTable_)
     {
-        std::string left  = AnnotateExpressionWithOrigin(binExpr->GetLeft(), classDecl, localFields);
-        std::string right = AnnotateExpressionWithOrigin(binExpr->GetRight(), classDecl, localFields);
-        std::string op;
+        if (TypeSymbol::Kind::CLASS != entry.second.kind)
+        {
+            continue;
+        }
+        const ClassDeclaration* classDecl = entry.second.classDecl;
+        json.BeginObject().Key("name").String(entry.second.name);
+        if (false == classDecl->GetBaseType().empty())
+        {
+            json.Key("inherits").String(classDecl->GetBaseType());
+        }
 
-        switch (binExpr->GetOperator())
+        std::vector<const Field*> allFields;
+        GetAllFields(classDecl, allFields);
+        std::set<const Field*> localFieldSet;
+        for (const auto& field : classDecl->GetFields())
         {
-            case BinaryExpression::Op::ADD:
-                op = " + ";
-                break;
-            case BinaryExpression::Op::SUB:
-                op = " - ";
-                break;
-            case BinaryExpression::Op::MUL:
-                op = " * ";
-                break;
-            case BinaryExpression::Op::DIV:
-                op = " / ";
-                break;
-            case BinaryExpression::Op::MOD:
-                op = " % ";
-                break;
-            case BinaryExpression::Op::LT:
-                op = " < ";
-                break;
-            case BinaryExpression::Op::GT:
-                op = " > ";
-                break;
-            case BinaryExpression::Op::LE:
-                op = " <= ";
-                break;
-            case BinaryExpression::Op::GE:
-                op = " >= ";
-                break;
-            case BinaryExpression::Op::EQ:
-                op = " == ";
-                break;
-            case BinaryExpression::Op::NE:
-                op = " != ";
-                break;
-            case BinaryExpression::Op::AND:
-                op = " && ";
-                break;
-            case BinaryExpression::Op::OR:
-                op = " || ";
-                break;
+            localFieldSet.insert(field.get());
+        }
+
+        json.Key("features").BeginArray();
+        for (const Field* field : allFields)
+        {
+            json.BeginObject().Key("name").String(field->GetName());
+            json.Key("origin").String(0 != localFieldSet.count(field) ? "self" : "base");
+            json.Key("type").String(TypeSpecToName(field->GetType()));
+            json.Key("modifiers").BeginArray();
+            for (const auto& modifier : field->GetModifiers())
+            {
+                PrintModifier(text, modifier.get());
+                json.String(text.TakeText());
+            }
+            json.EndArray();
+            if (field->IsComputed() && nullptr != field->GetInitializer())
+            {
+                AnnotateExpressionWithOrigin(text, field->GetInitializer(), classDecl, localFieldSet);
+                json.Key("expression").String(text.TakeText());
+            }
+            json.EndObject();
+        }
+        json.EndArray();
+
+        std::vector<const Invariant*> allInvariants;
+        GetAllInvariants(classDecl, allInvariants);
+        std::set<const Invariant*> localInvariantSet;
+        for (const auto& invariant : classDecl->GetInvariants())
+        {
+            localInvariantSet.insert(invariant.get());
+        }
+
+        json.Key("invariants").BeginArray();
+        for (const Invariant* invariant : allInvariants)
+        {
+            json.BeginObject().Key("name").String(invariant->GetName());
+            json.Key("origin").String(0 != localInvariantSet.count(invariant) ? "self" : "base");
+            if (nullptr != invariant->GetExpression())
+            {
+                invariant->GetExpression()->Print(text);
+                json.Key("expression").String(text.TakeText());
+            }
+            json.EndObject();
+        }
+        json.EndArray();
+
+        std::vector<std::pair<bool, const AggregateSymbol*>> allAggregates;
+        GetAllAggregates(classDecl, allAggregates);
+        json.Key("aggregates").BeginArray();
+        for (const auto& [isLocal, aggregate] : allAggregates)
+        {
+            json.BeginObject().Key("origin").String(isLocal ? "self" : "base");
+            json.Key("function").String(AggregateSymbol::KindToString(aggregate->kind)).Key("collection").String(aggregate->collection->GetName());
+            if (false == aggregate->memberName.empty())
+            {
+                json.Key("member").String(aggregate->memberName);
+            }
+            json.EndObject();
         }
+        json.EndArray();
 
-        return left + op + right;
+        std::vector<const ClassDeclaration*> classChain;
+        GetClassChain(classDecl, classChain);
+        json.Key("patterns").BeginArray();
+        for (const ClassDeclaration* current : classChain)
+        {
+            for (const auto& pattern : GetPatterns(current->GetName()))
+            {
+                json.BeginObject().Key("origin").String(current == classDecl ? "self" : "base");
+                json.Key("subject").String(pattern.subject).Key("pattern").String(pattern.pattern);
+                json.Key("states").Integer(static_cast<long long>(pattern.dfa->GetStateCount()));
+                json.Key("byteClasses").Integer(static_cast<long long>(pattern.dfa->GetClassCount()));
+                json.EndObject();
+            }
+        }
+        json.EndArray().EndObject();
     }
-    else if (const UnaryExpression* unaryExpr = dynamic_cast<const UnaryExpression*>(expr))
+    json.EndArray().EndObject();
+}
+
+void SemanticAnalyzer::CountSymbols(int& primitiveCount, int& enumCount, int& classCount) const
+{
+    for (const auto& entry : symbolTable_)
     {
-        std::string operand = AnnotateExpressionWithOrigin(unaryExpr->GetOperand(), classDecl, localFields);
-        if (UnaryExpression::Op::NEG == unaryExpr->GetOperator())
+        if (TypeSymbol::Kind::PRIMITIVE == entry.second.kind)
+        {
+            primitiveCount++;
+        }
+        else if (TypeSymbol::Kind::ENUM == entry.second.kind)
+        {
+            enumCount++;
+        }
+        else if (TypeSymbol::Kind::CLASS == entry.second.kind)
         {
-            return "-" + operand;
+            classCount++;
         }
-        else if (UnaryExpression::Op::NOT == unaryExpr->GetOperator())
+    }
+}
+
+void SemanticAnalyzer::GetAllAggregates(const ClassDeclaration* classDecl, std::vector<std::pair<bool, const AggregateSymbol*>>& allAggregates) const
+{
+    // An aggregate already maintained by a base class is not listed again
+    std::vector<const ClassDeclaration*> classChain;
+    GetClassChain(classDecl, classChain);
+    for (const ClassDeclaration* current : classChain)
+    {
+        for (const auto& aggregate : GetAggregates(current->GetName()))
         {
-            return "!" + operand;
+            bool alreadyListed = false;
+            for (const auto& listed : allAggregates)
+            {
+                if (listed.second->kind == aggregate.kind && listed.second->collection == aggregate.collection &&
+                    listed.second->memberName == aggregate.memberName)
+                {
+                    alreadyListed = true;
+                    break;
+                }
+            }
+
+            if (!alreadyListed)
+            {
+                allAggregates.push_back({current == classDecl, &aggregate});
+            }
         }
     }
+}
+
+void SemanticAnalyzer::PrintModifier(OutputBuffer& out, const Modifier* modifier)
+{
+    if (const CardinalityModifier* cardMod = dynamic_cast<const CardinalityModifier*>(modifier))
+    {
+        out << cardMod->GetMin() << ".." << cardMod->GetMax();
+    }
+    else if (dynamic_cast<const UniqueModifier*>(modifier))
+    {
+        out << "unique";
+    }
+    else if (dynamic_cast<const InternedModifier*>(modifier))
+    {
+        out << "interned";
+    }
+    else if (const EncodingModifier* encodingMod = dynamic_cast<const EncodingModifier*>(modifier))
+    {
+        out << "encoding(" << encodingMod->GetEncoding() << ")";
+    }
+}
+
+void SemanticAnalyzer::AnnotateExpressionWithOrigin(
+    OutputBuffer& out, const Expression* expr, const ClassDeclaration* classDecl, const std::set<const Field*>& localFields) const
+{
+    if (nullptr == expr)
+    {
+        return;
+    }
+
+    // Handle different expression types
+    if (const BinaryExpression* binExpr = dynamic_cast<const BinaryExpression*>(expr))
+    {
+        AnnotateExpressionWithOrigin(out, binExpr->GetLeft(), classDecl, localFields);
+        out << ' ' << BinaryExpression::OpToString(binExpr->GetOperator()) << ' ';
+        AnnotateExpressionWithOrigin(out, binExpr->GetRight(), classDecl, localFields);
+    }
+    else if (const UnaryExpression* unaryExpr = dynamic_cast<const UnaryExpression*>(expr))
+    {
+        out << UnaryExpression::OpToString(unaryExpr->GetOperator());
+        AnnotateExpressionWithOrigin(out, unaryExpr->GetOperand(), classDecl, localFields);
+    }
     else if (const FieldReference* fieldRef = dynamic_cast<const FieldReference*>(expr))
     {
         // Look up the field to determine if it's local or inherited
@@ -1245,36 +2863,49 @@ std::string
             }
         }
 
-        // Annotate with origin marker
+        // Annotate with origin marker (no marker if not found)
         if (nullptr != foundField)
         {
-            return (isLocal ? "Self::" : "Base::") + fieldName;
-        }
-        else
-        {
-            return fieldName; // Fallback if not found
+            out << (isLocal ? "Self::" : "Base::");
         }
+        out << fieldName;
     }
     else if (const MemberAccessExpression* memberExpr = dynamic_cast<const MemberAccessExpression*>(expr))
     {
-        std::string object = AnnotateExpressionWithOrigin(memberExpr->GetObject(), classDecl, localFields);
-        std::string member = memberExpr->GetMemberName();
-        return object + "." + member;
-    }
-    else if (const LiteralExpression* litExpr = dynamic_cast<const LiteralExpression*>(expr))
-    {
-        return litExpr->ToString();
+        AnnotateExpressionWithOrigin(out, memberExpr->GetObject(), classDecl, localFields);
+        out << '.' << memberExpr->GetMemberName();
     }
     else if (const ParenthesizedExpression* parenExpr = dynamic_cast<const ParenthesizedExpression*>(expr))
     {
-        std::string inner = AnnotateExpressionWithOrigin(parenExpr->GetExpression(), classDecl, localFields);
-        return "(" + inner + ")";
+        out << '(';
+        AnnotateExpressionWithOrigin(out, parenExpr->GetExpression(), classDecl, localFields);
+        out << ')';
     }
     else if (const FunctionCall* funcCall = dynamic_cast<const FunctionCall*>(expr))
     {
-        return funcCall->ToString(); // Function calls not yet implemented, use default
+        out << funcCall->GetFunctionName() << '(';
+        const auto& args = funcCall->GetArguments();
+        for (size_t i = 0; i < args.size(); ++i)
+        {
+            if (i > 0)
+            {
+                out << ", ";
+            }
+            AnnotateExpressionWithOrigin(out, args[i].get(), classDecl, localFields);
+        }
+        out << ')';
+    }
+    else if (const QuantifiedExpression* quantExpr = dynamic_cast<const QuantifiedExpression*>(expr))
+    {
+        out << QuantifiedExpression::QuantifierToString(quantExpr->GetQuantifier()) << ' ' << quantExpr->GetVariableName() << " in ";
+        AnnotateExpressionWithOrigin(out, quantExpr->GetCollection(), classDecl, localFields);
+        out << ": ";
+        AnnotateExpressionWithOrigin(out, quantExpr->GetBody(), classDecl, localFields);
+    }
+    else
+    {
+        // Literals and any other expression print as written
+        expr->Print(out);
     }
-
-    return expr->ToString(); // Fallback
 }
 } // namespace bbfm
@@ -0,0 +1,424 @@
+#include "SqlSchema.h"
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include <vector>
+
+namespace bbfm {
+SqlSchemaWriter::SqlSchemaWriter(const SemanticAnalyzer* analyzer, const LayoutBuilder* layouts, const std::string& tablePrefix) :
+    analyzer_(analyzer), layouts_(layouts), tablePrefix_(tablePrefix)
+{
+}
+
+void SqlSchemaWriter::Write(std::ostream& out) const
+{
+    out << "-- SQLite schema generated by the BBFM model compiler\n";
+    out << "PRAGMA foreign_keys = ON;\n";
+
+    // Every class another class inherits from, collected once for all reference columns
+    std::set<std::string> baseClasses;
+    for (const auto& entry : layouts_->GetLayouts())
+    {
+        const auto& classChain = entry.second.classChain;
+        for (size_t i = 0; i + 1 < classChain.size(); ++i)
+        {
+            baseClasses.insert(classChain[i]->GetName());
+        }
+    }
+
+    for (const auto& entry : layouts_->GetLayouts())
+    {
+        out << "\n";
+        WriteClass(out, entry.second, baseClasses);
+    }
+}
+
+void SqlSchemaWriter::WriteClass(std::ostream& out, const ClassLayout& layout, const std::set<std::string>& baseClasses) const
+{
+    const std::string table = tablePrefix_ + layout.className;
+
+    // Columns stored in the class table (arrays go to junction tables)
+    std::vector<const ColumnLayout*> tableColumns;
+    std::vector<const ColumnLayout*> listColumns;
+    for (const auto& column : layout.columns)
+    {
+        (column.list ? listColumns : tableColumns).push_back(&column);
+    }
+
+    out << "-- " << layout.className << " fingerprint " << SchemaFingerprinter::ToString(layout.fingerprint) << "\n";
+    out << "CREATE TABLE " << QuoteIdentifier(table) << " (\n";
+    for (const ColumnLayout* column : tableColumns)
+    {
+        out << "    " << QuoteIdentifier(column->name) << " " << ColumnDefinition(*column, baseClasses);
+        if ("id" == column->name && column->declaringClass.empty())
+        {
+            out << " PRIMARY KEY";
+        }
+        out << ",\n";
+    }
+
+    // Invariants of the whole class chain become CHECK constraints where possible
+    std::vector<std::string> checks;
+    std::vector<std::string> skipped;
+    for (const ClassDeclaration* classDecl : layout.classChain)
+    {
+        for (const auto& invariant : classDecl->GetInvariants())
+        {
+            std::string sql;
+            if (nullptr != invariant->GetExpression() && ExpressionToSql(invariant->GetExpression(), layout, 0, sql))
+            {
+                checks.push_back("    CONSTRAINT " + QuoteIdentifier(invariant->GetName()) + " CHECK (" + sql + ")");
+            }
+            else
+            {
+                skipped.push_back(invariant->GetName());
+            }
+        }
+    }
+
+    for (size_t i = 0; i < checks.size(); ++i)
+    {
+        out << checks[i] << ",\n";
+    }
+    out << "    CHECK (length(\"id\") = 16)\n";
+    out << ") WITHOUT ROWID;\n";
+
+    for (const std::string& name : skipped)
+    {
+        out << "-- invariant '" << name << "' is not expressible in SQL and is checked by the loader\n";
+    }
+
+    // A subclass row lives in the subclass table, so references to a class with subclasses have no foreign key
+    for (const auto& column : layout.columns)
+    {
+        if (StorageKind::OBJECT_REF == column.storage && 0 != baseClasses.count(column.typeName))
+        {
+            out << "-- field '" << column.name << "' may reference a subclass of " << column.typeName << " and is checked by the loader\n";
+        }
+    }
+
+    // Junction tables for array fields, keyed by owner and position
+    for (const ColumnLayout* column : listColumns)
+    {
+        const std::string junction = table + "_" + column->name;
+        out << "CREATE TABLE " << QuoteIdentifier(junction) << " (\n";
+        out << "    \"owner\" BLOB NOT NULL REFERENCES " << QuoteIdentifier(table) << "(\"id\") ON DELETE CASCADE,\n";
+        out << "    \"position\" INTEGER NOT NULL,\n";
+        out << "    \"value\" " << SqlType(column->storage) << " NOT NULL";
+        if (StorageKind::OBJECT_REF == column->storage && 0 == baseClasses.count(column->typeName))
+        {
+            out << " REFERENCES " << QuoteIdentifier(tablePrefix_ + column->typeName) << "(\"id\")";
+        }
+        out << ",\n";
+        out << "    PRIMARY KEY (\"owner\", \"position\")\n";
+        out << ") WITHOUT ROWID;\n";
+        if (StorageKind::OBJECT_REF == column->storage)
+        {
+            out << "CREATE INDEX " << QuoteIdentifier(junction + "_value") << " ON " << QuoteIdentifier(junction) << "(\"value\");\n";
+        }
+    }
+
+    // Unique indexes from [unique] (the primary key already covers id)
+    for (const auto& index : layout.indexes)
+    {
+        if (!index.primary)
+        {
+            out << "CREATE UNIQUE INDEX " << QuoteIdentifier(table + "_" + index.fieldName + "_unique") << " ON " << QuoteIdentifier(table) << "("
+                << QuoteIdentifier(index.fieldName) << ");\n";
+        }
+    }
+
+    // Loader statements with positional parameters in column order
+    out << "-- loader: INSERT INTO " << QuoteIdentifier(table) << " (";
+    for (size_t i = 0; i < tableColumns.size(); ++i)
+    {
+        out << (0 == i ? "" : ", ") << QuoteIdentifier(tableColumns[i]->name);
+    }
+    out << ") VALUES (";
+    for (size_t i = 0; i < tableColumns.size(); ++i)
+    {
+        out << (0 == i ? "" : ", ") << "?" << (i + 1);
+    }
+    out << ");\n";
+    for (const ColumnLayout* column : listColumns)
+    {
+        out << "-- loader: INSERT INTO " << QuoteIdentifier(table + "_" + column->name) << " (\"owner\", \"position\", \"value\") VALUES (?1, ?2, ?3);\n";
+    }
+}
+
+std::string SqlSchemaWriter::ColumnDefinition(const ColumnLayout& column, const std::set<std::string>& baseClasses) const
+{
+    std::string definition = SqlType(column.storage);
+
+    if (!column.nullable)
+    {
+        definition += " NOT NULL";
+    }
+
+    // The comment metadata field is optional text
+    if (column.declaringClass.empty() && "comment" == column.name)
+    {
+        definition += " DEFAULT ''";
+    }
+
+    if (StorageKind::ENUM == column.storage)
+    {
+        const auto& symbolTable = analyzer_->GetSymbolTable();
+        auto        symbol      = symbolTable.find(column.typeName);
+        if (symbolTable.end() != symbol && nullptr != symbol->second.enumDecl)
+        {
+            definition += " CHECK (" + QuoteIdentifier(column.name) + " IN (";
+            const auto& values = symbol->second.enumDecl->GetValues();
+            for (size_t i = 0; i < values.size(); ++i)
+            {
+                definition += (0 == i ? "'" : ", '") + values[i] + "'";
+            }
+            definition += "))";
+        }
+    }
+    else if (StorageKind::BOOL == column.storage)
+    {
+        definition += " CHECK (" + QuoteIdentifier(column.name) + " IN (0, 1))";
+    }
+    else if (StorageKind::OBJECT_REF == column.storage && 0 == baseClasses.count(column.typeName))
+    {
+        definition += " REFERENCES " + QuoteIdentifier(tablePrefix_ + column.typeName) + "(\"id\")";
+    }
+
+    return definition;
+}
+
+const char* SqlSchemaWriter::SqlType(const StorageKind storage)
+{
+    switch (storage)
+    {
+        case StorageKind::BOOL:
+        case StorageKind::INT64:
+        case StorageKind::TIMESTAMP64:
+        case StorageKind::TIMESPAN64:
+        case StorageKind::DATE32:
+            return "INTEGER";
+        case StorageKind::FLOAT64:
+            return "REAL";
+        case StorageKind::GUID128:
+        case StorageKind::OBJECT_REF:
+            return "BLOB";
+        case StorageKind::STRING_REF:
+        case StorageKind::INTERNED_STRING:
+        case StorageKind::ENUM:
+        default:
+            return "TEXT";
+    }
+}
+
+bool SqlSchemaWriter::ExpressionToSql(const Expression* expr, const ClassLayout& layout, const int depth, std::string& sql) const
+{
+    if (nullptr == expr || depth > MAX_INLINE_DEPTH)
+    {
+        return false;
+    }
+
+    const BinaryExpression* binExpr = dynamic_cast<const BinaryExpression*>(expr);
+    if (nullptr != binExpr)
+    {
+        std::string left;
+        std::string right;
+        if (!ExpressionToSql(binExpr->GetLeft(), layout, depth, left) || !ExpressionToSql(binExpr->GetRight(), layout, depth, right))
+        {
+            return false;
+        }
+
+        std::string op;
+        switch (binExpr->GetOperator())
+        {
+            case BinaryExpression::Op::EQ:
+                op = "=";
+                break;
+            case BinaryExpression::Op::NE:
+                op = "<>";
+                break;
+            case BinaryExpression::Op::AND:
+                op = "AND";
+                break;
+            case BinaryExpression::Op::OR:
+                op = "OR";
+                break;
+            case BinaryExpression::Op::ADD:
+                // String concatenation
+                op = (IsStringExpression(binExpr->GetLeft(), layout) || IsStringExpression(binExpr->GetRight(), layout)) ? "||" : "+";
+                break;
+            default:
+                op = BinaryExpression::OpToString(binExpr->GetOperator());
+                break;
+        }
+
+        sql = "(" + left + " " + op + " " + right + ")";
+        return true;
+    }
+
+    const UnaryExpression* unaryExpr = dynamic_cast<const UnaryExpression*>(expr);
+    if (nullptr != unaryExpr)
+    {
+        std::string operand;
+        if (!ExpressionToSql(unaryExpr->GetOperand(), layout, depth, operand))
+        {
+            return false;
+        }
+        sql = (UnaryExpression::Op::NOT == unaryExpr->GetOperator() ? "(NOT " : "(-") + operand + ")";
+        return true;
+    }
+
+    const ParenthesizedExpression* parenExpr = dynamic_cast<const ParenthesizedExpression*>(expr);
+    if (nullptr != parenExpr)
+    {
+        return ExpressionToSql(parenExpr->GetExpression(), layout, depth, sql);
+    }
+
+    const LiteralExpression* literal = dynamic_cast<const LiteralExpression*>(expr);
+    if (nullptr != literal)
+    {
+        switch (literal->GetResultType())
+        {
+            case Expression::Type::INT:
+                sql = std::to_string(literal->GetIntValue());
+                return true;
+            case Expression::Type::REAL:
+            {
+                std::ostringstream real;
+                real << std::setprecision(17) << literal->GetRealValue();
+                sql = real.str();
+                if (std::string::npos == sql.find_first_of(".eEn"))
+                {
+                    sql += ".0";
+                }
+                return true;
+            }
+            case Expression::Type::BOOL:
+                sql = literal->GetBoolValue() ? "1" : "0";
+                return true;
+            case Expression::Type::STRING:
+                sql = StringLiteralToSql(literal->GetStringValue());
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    const FieldReference* fieldRef = dynamic_cast<const FieldReference*>(expr);
+    if (nullptr != fieldRef)
+    {
+        const FieldLayout* stored = layout.FindField(fieldRef->GetFieldName());
+        if (nullptr != stored)
+        {
+            // Arrays and object references have no scalar SQL value to compare
+            if (StorageKind::ARRAY_REF == stored->storage || StorageKind::OBJECT_REF == stored->storage)
+            {
+                return false;
+            }
+            sql = QuoteIdentifier(stored->name);
+            return true;
+        }
+
+        // Computed features are inlined
+        const Field* field = FindDeclaredField(layout, fieldRef->GetFieldName());
+        if (nullptr != field && field->IsComputed())
+        {
+            std::string inlined;
+            if (!ExpressionToSql(field->GetInitializer(), layout, depth + 1, inlined))
+            {
+                return false;
+            }
+            sql = "(" + inlined + ")";
+            return true;
+        }
+        return false;
+    }
+
+    // Member access, aggregates, quantifiers and pattern matches need other rows
+    return false;
+}
+
+bool SqlSchemaWriter::IsStringExpression(const Expression* expr, const ClassLayout& layout) const
+{
+    const LiteralExpression* literal = dynamic_cast<const LiteralExpression*>(expr);
+    if (nullptr != literal)
+    {
+        return Expression::Type::STRING == literal->GetResultType();
+    }
+
+    const FieldReference* fieldRef = dynamic_cast<const FieldReference*>(expr);
+    if (nullptr != fieldRef)
+    {
+        const FieldLayout* stored = layout.FindField(fieldRef->GetFieldName());
+        return nullptr != stored && (StorageKind::STRING_REF == stored->storage || StorageKind::INTERNED_STRING == stored->storage);
+    }
+
+    const BinaryExpression* binExpr = dynamic_cast<const BinaryExpression*>(expr);
+    if (nullptr != binExpr && BinaryExpression::Op::ADD == binExpr->GetOperator())
+    {
+        return IsStringExpression(binExpr->GetLeft(), layout) || IsStringExpression(binExpr->GetRight(), layout);
+    }
+
+    const ParenthesizedExpression* parenExpr = dynamic_cast<const ParenthesizedExpression*>(expr);
+    if (nullptr != parenExpr)
+    {
+        return IsStringExpression(parenExpr->GetExpression(), layout);
+    }
+
+    return false;
+}
+
+const Field* SqlSchemaWriter::FindDeclaredField(const ClassLayout& layout, const std::string& fieldName)
+{
+    for (const ClassDeclaration* classDecl : layout.classChain)
+    {
+        for (const auto& field : classDecl->GetFields())
+        {
+            if (field->GetName() == fieldName)
+            {
+                return field.get();
+            }
+        }
+    }
+    return nullptr;
+}
+
+std::string SqlSchemaWriter::QuoteIdentifier(const std::string& name)
+{
+    return "\"" + name + "\"";
+}
+
+std::string SqlSchemaWriter::StringLiteralToSql(const std::string& literal)
+{
+    // The lexer keeps the surrounding double quotes and escapes
+    std::string value = literal;
+    if (value.size() >= 2 && '"' == value.front() && '"' == value.back())
+    {
+        value = value.substr(1, value.size() - 2);
+    }
+
+    std::string sql = "'";
+    for (size_t i = 0; i < value.size(); ++i)
+    {
+        char c = value[i];
+        if ('\\' == c && i + 1 < value.size())
+        {
+            c = value[++i];
+            if ('n' == c)
+            {
+                c = '\n';
+            }
+            else if ('t' == c)
+            {
+                c = '\t';
+            }
+        }
+        if ('\'' == c)
+        {
+            sql += '\'';
+        }
+        sql += c;
+    }
+    return sql + "'";
+}
+} // namespace bbfm
@@ -0,0 +1,445 @@
+#include "ArrowSchema.h"
+#include "Common.h"
+#include "Console.h"
+#include "Driver.h"
+#include "Json.h"
+#include "Layout.h"
+#include "ModelGenerator.h"
+#include "SemanticAnalyzer.h"
+#include "SqlSchema.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+// Stages timed for every model size, in pipeline order
+const char* const STAGES[] = {"lex", "parse", "semantic", "layout", "arrow", "sql"};
+
+// Differences below this are noise, whatever the ratio
+const double MIN_REGRESSION_MS = 0.5;
+
+/// \brief Benchmark settings from the command line
+struct BenchOptions
+{
+    std::vector<size_t>    classCounts = {100, 1000, 10000};
+    bbfm::GeneratorOptions model;       // Shape of the models (the class count is set per size)
+    size_t                 repeat      = 3;
+    double                 threshold   = 10.0; // Percent slower than the baseline that counts as a regression
+    std::string            outPath;
+    std::string            comparePath;
+    std::string            emitModelPath;
+};
+
+/// \brief Timings of one model size
+struct BenchResult
+{
+    bbfm::GeneratorOptions        model;
+    size_t                        sourceBytes = 0;
+    size_t                        tokenCount  = 0;
+    std::map<std::string, double> stageMs; // Best of the repetitions, by stage
+};
+
+/// \brief Run a stage several times and keep the fastest run
+double BestOf(const size_t repeat, const std::function<void()>& stage)
+{
+    double best = -1.0;
+    for (size_t i = 0; i < repeat; ++i)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        stage();
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        best            = (best < 0.0) ? ms : std::min(best, ms);
+    }
+    return best;
+}
+
+/// \brief Key identifying a model shape across result files
+std::string ShapeKey(const bbfm::GeneratorOptions& model)
+{
+    return std::to_string(model.classCount) + "/" + std::to_string(model.fieldsPerClass) + "/" + std::to_string(model.inheritanceDepth) + "/" +
+           std::to_string(model.invariantsPerClass) + "/" + std::to_string(model.expressionSize);
+}
+
+/// \brief Parse a comma-separated list of sizes
+bool ParseSizes(const std::string& text, std::vector<size_t>& sizes)
+{
+    sizes.clear();
+    std::istringstream stream(text);
+    std::string        item;
+    while (std::getline(stream, item, ','))
+    {
+        char*                    end   = nullptr;
+        const unsigned long long value = strtoull(item.c_str(), &end, 10);
+        if (item.empty() || '\0' != *end || 0 == value)
+        {
+            return false;
+        }
+        sizes.push_back(static_cast<size_t>(value));
+    }
+    return false == sizes.empty();
+}
+
+/// \brief Parse a non-negative number option
+bool ParseCount(const std::string& text, size_t& value)
+{
+    char*                    end    = nullptr;
+    const unsigned long long number = strtoull(text.c_str(), &end, 10);
+    if (text.empty() || '\0' != *end)
+    {
+        return false;
+    }
+    value = static_cast<size_t>(number);
+    return true;
+}
+
+/// \brief Print the usage text
+void PrintUsage()
+{
+    std::cout << "Usage: model-compiler-bench [options]\n"
+                 "  --classes N,N,...      Class counts to benchmark (default 100,1000,10000)\n"
+                 "  --fields N             Fields per class (default 8)\n"
+                 "  --depth N              Inheritance depth (default 3)\n"
+                 "  --invariants N         Invariants per class (default 2)\n"
+                 "  --expression-size N    Operands per invariant (default 4)\n"
+                 "  --repeat N             Runs per stage, the fastest counts (default 3)\n"
+                 "  --out FILE             Write the results as JSON\n"
+                 "  --compare FILE         Compare against earlier results, exit 1 on regressions\n"
+                 "  --threshold PERCENT    Slowdown that counts as a regression (default 10)\n"
+                 "  --emit-model FILE      Write the model of the first size and exit\n";
+}
+
+/// \brief Parse the command line
+/// \return False on invalid arguments (already reported)
+bool ParseArguments(const int argc, char* argv[], BenchOptions& options, bool& showHelp)
+{
+    showHelp = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string option = argv[i];
+        if ("-h" == option || "--help" == option)
+        {
+            showHelp = true;
+            return true;
+        }
+        if (i + 1 >= argc)
+        {
+            bbfm::Console::ReportError("Error: Missing value for " + option);
+            return false;
+        }
+        const std::string value = argv[++i];
+
+        bool valid = true;
+        if ("--classes" == option)
+        {
+            valid = ParseSizes(value, options.classCounts);
+        }
+        else if ("--fields" == option)
+        {
+            valid = ParseCount(value, options.model.fieldsPerClass);
+        }
+        else if ("--depth" == option)
+        {
+            valid = ParseCount(value, options.model.inheritanceDepth);
+        }
+        else if ("--invariants" == option)
+        {
+            valid = ParseCount(value, options.model.invariantsPerClass);
+        }
+        else if ("--expression-size" == option)
+        {
+            valid = ParseCount(value, options.model.expressionSize);
+        }
+        else if ("--repeat" == option)
+        {
+            valid = ParseCount(value, options.repeat) && options.repeat > 0;
+        }
+        else if ("--threshold" == option)
+        {
+            char* end         = nullptr;
+            options.threshold = strtod(value.c_str(), &end);
+            valid             = '\0' == *end && options.threshold >= 0.0;
+        }
+        else if ("--out" == option)
+        {
+            options.outPath = value;
+        }
+        else if ("--compare" == option)
+        {
+            options.comparePath = value;
+        }
+        else if ("--emit-model" == option)
+        {
+            options.emitModelPath = value;
+        }
+        else
+        {
+            bbfm::Console::ReportError("Error: Unknown option " + option);
+            return false;
+        }
+        if (!valid)
+        {
+            bbfm::Console::ReportError("Error: Invalid value '" + value + "' for " + option);
+            return false;
+        }
+    }
+    return true;
+}
+
+/// \brief Generate a model and time every stage on it
+/// \return False if the generated model does not compile (already reported)
+bool RunSize(const BenchOptions& options, const bbfm::GeneratorOptions& model, BenchResult& result)
+{
+    const std::string text = bbfm::ModelGenerator(model).Generate();
+    result.model           = model;
+    result.sourceBytes     = text.size();
+
+    bbfm::Driver driver({"synthetic.fm"});
+    result.stageMs["lex"] = BestOf(options.repeat, [&]() { result.tokenCount = driver.LexText(text); });
+
+    // The parser pulls tokens from the lexer, lexing is subtracted
+    std::unique_ptr<bbfm::AST> ast;
+    const double               parseMs = BestOf(options.repeat, [&]() { ast = driver.ParseText("synthetic.fm", text); });
+    if (nullptr == ast)
+    {
+        return false;
+    }
+    result.stageMs["parse"] = std::max(parseMs - result.stageMs["lex"], 0.0);
+
+    std::unique_ptr<bbfm::SemanticAnalyzer> analyzer;
+    bool                                    valid = false;
+    result.stageMs["semantic"] = BestOf(options.repeat,
+        [&]()
+        {
+            analyzer = std::make_unique<bbfm::SemanticAnalyzer>(ast.get());
+            valid    = analyzer->Analyze();
+        });
+    if (!valid)
+    {
+        bbfm::Console::ReportError("Error: The generated model has semantic errors");
+        return false;
+    }
+
+    std::unique_ptr<bbfm::LayoutBuilder> layouts;
+    result.stageMs["layout"] = BestOf(options.repeat,
+        [&]()
+        {
+            layouts = std::make_unique<bbfm::LayoutBuilder>(analyzer.get());
+            layouts->Build();
+        });
+    result.stageMs["arrow"] = BestOf(options.repeat,
+        [&]()
+        {
+            std::ostringstream      out;
+            bbfm::ArrowSchemaWriter writer(analyzer.get(), layouts.get());
+            writer.Write(out);
+        });
+    result.stageMs["sql"] = BestOf(options.repeat,
+        [&]()
+        {
+            std::ostringstream    out;
+            bbfm::SqlSchemaWriter writer(analyzer.get(), layouts.get(), "");
+            writer.Write(out);
+        });
+    return true;
+}
+
+/// \brief Print the timings, with the growth exponent against the previous size
+void PrintResults(const std::vector<BenchResult>& results)
+{
+    char row[256];
+    snprintf(row, sizeof(row), "%8s %10s %9s", "classes", "bytes", "tokens");
+    std::string heading = row;
+    for (const char* stage : STAGES)
+    {
+        snprintf(row, sizeof(row), " %11s %5s", (std::string(stage) + " ms").c_str(), "^k");
+        heading += row;
+    }
+    bbfm::Console::ReportStatus(heading);
+
+    // k in time ~ n^k: about 1 for linear stages, 2 for quadratic ones
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const BenchResult& result = results[i];
+        snprintf(row, sizeof(row), "%8zu %10zu %9zu", result.model.classCount, result.sourceBytes, result.tokenCount);
+        std::string line = row;
+        for (const char* stage : STAGES)
+        {
+            const double ms = result.stageMs.at(stage);
+            if (i > 0 && results[i - 1].stageMs.at(stage) > 0.05 && ms > 0.05 && result.model.classCount != results[i - 1].model.classCount)
+            {
+                const double growth =
+                    std::log(ms / results[i - 1].stageMs.at(stage)) / std::log(static_cast<double>(result.model.classCount) / results[i - 1].model.classCount);
+                snprintf(row, sizeof(row), " %11.2f %5.2f", ms, growth);
+            }
+            else
+            {
+                snprintf(row, sizeof(row), " %11.2f %5s", ms, "-");
+            }
+            line += row;
+        }
+        bbfm::Console::ReportStatus(line);
+    }
+}
+
+/// \brief Convert results to JSON
+bbfm::JsonValue ResultsToJson(const BenchOptions& options, const std::vector<BenchResult>& results)
+{
+    bbfm::JsonValue items = bbfm::JsonValue::MakeArray();
+    for (const BenchResult& result : results)
+    {
+        bbfm::JsonValue stages = bbfm::JsonValue::MakeObject();
+        for (const auto& stage : result.stageMs)
+        {
+            stages.Set(stage.first, stage.second);
+        }
+        bbfm::JsonValue item = bbfm::JsonValue::MakeObject();
+        item.Set("classes", static_cast<double>(result.model.classCount)).Set("fields", static_cast<double>(result.model.fieldsPerClass));
+        item.Set("depth", static_cast<double>(result.model.inheritanceDepth)).Set("invariants", static_cast<double>(result.model.invariantsPerClass));
+        item.Set("expressionSize", static_cast<double>(result.model.expressionSize)).Set("sourceBytes", static_cast<double>(result.sourceBytes));
+        item.Set("tokens", static_cast<double>(result.tokenCount)).Set("stagesMs", std::move(stages));
+        items.Append(std::move(item));
+    }
+
+    bbfm::JsonValue document = bbfm::JsonValue::MakeObject();
+    document.Set("benchmark", "model-compiler-bench").Set("compilerVersion", BBFM_COMPILER_VERSION).Set("repeat", static_cast<double>(options.repeat));
+    document.Set("results", std::move(items));
+    return document;
+}
+
+/// \brief Compare results against a baseline file
+/// \return Number of regressions, or -1 if the baseline cannot be read
+int CompareResults(const BenchOptions& options, const std::vector<BenchResult>& results)
+{
+    std::ifstream infile(options.comparePath, std::ios::binary);
+    if (!infile.is_open())
+    {
+        bbfm::Console::ReportError("Error: Could not read baseline '" + options.comparePath + "'");
+        return -1;
+    }
+    std::ostringstream content;
+    content << infile.rdbuf();
+    bbfm::JsonValue baseline;
+    if (!bbfm::JsonValue::Parse(content.str(), baseline) || bbfm::JsonValue::Kind::ARRAY != baseline["results"].GetKind())
+    {
+        bbfm::Console::ReportError("Error: '" + options.comparePath + "' is not a benchmark result file");
+        return -1;
+    }
+
+    std::map<std::string, const bbfm::JsonValue*> baselineByShape;
+    for (const bbfm::JsonValue& item : baseline["results"].GetItems())
+    {
+        bbfm::GeneratorOptions model;
+        model.classCount         = static_cast<size_t>(item["classes"].AsNumber());
+        model.fieldsPerClass     = static_cast<size_t>(item["fields"].AsNumber());
+        model.inheritanceDepth   = static_cast<size_t>(item["depth"].AsNumber());
+        model.invariantsPerClass = static_cast<size_t>(item["invariants"].AsNumber());
+        model.expressionSize     = static_cast<size_t>(item["expressionSize"].AsNumber());
+        baselineByShape[ShapeKey(model)] = &item;
+    }
+
+    char heading[256];
+    snprintf(heading, sizeof(heading), "\nComparison with %s (regression: more than %.1f%% and %.1f ms slower):", options.comparePath.c_str(), options.threshold,
+        MIN_REGRESSION_MS);
+    bbfm::Console::ReportStatus(heading);
+    int regressions = 0;
+    for (const BenchResult& result : results)
+    {
+        auto it = baselineByShape.find(ShapeKey(result.model));
+        if (baselineByShape.end() == it)
+        {
+            bbfm::Console::ReportStatus("  " + std::to_string(result.model.classCount) + " classes: not in the baseline");
+            continue;
+        }
+        for (const char* stage : STAGES)
+        {
+            const bbfm::JsonValue& previous = (*it->second)["stagesMs"][stage];
+            if (previous.IsNull())
+            {
+                continue;
+            }
+            const double before     = previous.AsNumber();
+            const double after      = result.stageMs.at(stage);
+            const bool   regression = after > before * (1.0 + options.threshold / 100.0) && after - before >= MIN_REGRESSION_MS;
+            char         line[160];
+            snprintf(line, sizeof(line), "  %7zu classes %-9s %10.2f -> %10.2f ms (%+6.1f%%)%s", result.model.classCount, stage, before, after,
+                before > 0.0 ? (after - before) * 100.0 / before : 0.0, regression ? "  REGRESSION" : "");
+            bbfm::Console::ReportStatus(line);
+            regressions += regression ? 1 : 0;
+        }
+    }
+    return regressions;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    BenchOptions options;
+    bool         showHelp = false;
+    if (!ParseArguments(argc, argv, options, showHelp))
+    {
+        PrintUsage();
+        return 1;
+    }
+    if (showHelp)
+    {
+        PrintUsage();
+        return 0;
+    }
+
+    // Only write a model, e.g., to profile the compiler on it
+    if (false == options.emitModelPath.empty())
+    {
+        bbfm::GeneratorOptions model = options.model;
+        model.classCount             = options.classCounts[0];
+        std::ofstream out(options.emitModelPath, std::ios::binary);
+        if (!out.is_open() || !(out << bbfm::ModelGenerator(model).Generate()))
+        {
+            bbfm::Console::ReportError("Error: Could not write '" + options.emitModelPath + "'");
+            return 1;
+        }
+        return 0;
+    }
+
+    std::vector<BenchResult> results;
+    for (const size_t classCount : options.classCounts)
+    {
+        bbfm::GeneratorOptions model = options.model;
+        model.classCount             = classCount;
+        BenchResult result;
+        if (!RunSize(options, model, result))
+        {
+            return 1;
+        }
+        results.push_back(std::move(result));
+    }
+    PrintResults(results);
+
+    if (false == options.outPath.empty())
+    {
+        std::ofstream out(options.outPath, std::ios::binary);
+        if (!out.is_open() || !(out << ResultsToJson(options, results).Serialize() << "\n"))
+        {
+            bbfm::Console::ReportError("Error: Could not write '" + options.outPath + "'");
+            return 1;
+        }
+        bbfm::Console::ReportStatus("\nResults written to " + options.outPath);
+    }
+
+    if (false == options.comparePath.empty())
+    {
+        const int regressions = CompareResults(options, results);
+        if (0 != regressions)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
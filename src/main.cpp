@@ -1,19 +1,286 @@
 #include "Console.h"
 #include "Driver.h"
+#include "AllocTracker.h"
+#include "ArrowSchema.h"
+#include "Common.h"
+#include "CompileCache.h"
+#include "CompileServer.h"
+#include "Diagnostics.h"
+#include "Json.h"
+#include "LanguageServer.h"
+#include "Layout.h"
+#include "ModelCache.h"
+#include "ModelWatcher.h"
+#include "OutputBuffer.h"
+#include "Profiler.h"
+#include "SchemaDiff.h"
+#include "SqlSchema.h"
 #include <cxxopts.hpp>
+#include <fstream>
 #include <iostream>
 #include <memory>
+#include <sstream>
+#include <string>
 #include <vector>
 
-int main(int argc, char* argv[])
+namespace {
+/// \brief Dump the AST of a model as text or as one line of JSON
+/// \param model The model (its module ASTs are dumped as one AST if they are shared)
+/// \param out Output buffer
+/// \param json True for JSON
+void DumpSyntaxTree(const bbfm::CompiledModel& model, bbfm::OutputBuffer& out, const bool json)
+{
+    const bool shared = (false == model.moduleAsts.empty());
+    if (json)
+    {
+        bbfm::JsonWriter writer(out);
+        writer.BeginObject().Key("syntaxTree");
+        shared ? bbfm::AST::DumpModulesJson(model.moduleAsts, writer) : model.ast->DumpJson(writer);
+        writer.EndObject();
+        out << '\n';
+    }
+    else
+    {
+        out << '\n';
+        shared ? bbfm::AST::DumpModules(model.moduleAsts, out) : model.ast->Dump(out);
+    }
+    out.Flush();
+}
+
+/// \brief Run Phase 0 and Phase 1, or reuse the model from the cache if its files are unchanged
+/// \param sourceFiles Source files
+/// \param classPrefix Class prefix
+/// \param syntaxTreeOut Output buffer for the AST dump after Phase 0 (nullptr for no dump)
+/// \param dumpJson Dump the AST as JSON instead of text
+/// \param cache The model cache
+/// \param imports Files parsed by earlier compiles (nullptr to parse every file)
+/// \return The compiled model (kept alive even if a later load replaces the cache entry) or nullptr on errors (already reported)
+std::shared_ptr<const bbfm::CompiledModel> LoadModel(const std::vector<std::string>& sourceFiles,
+                                                     const std::string&              classPrefix,
+                                                     bbfm::OutputBuffer*             syntaxTreeOut,
+                                                     const bool                      dumpJson,
+                                                     bbfm::ModelCache&               cache,
+                                                     bbfm::ImportCache*              imports)
+{
+    uint64_t contentHash = 0;
+    if (bbfm::ModelCache::HashFiles(sourceFiles, contentHash))
+    {
+        std::shared_ptr<const bbfm::CompiledModel> cached = cache.Find(sourceFiles, classPrefix, contentHash);
+        if (nullptr != cached)
+        {
+            std::string fileList;
+            for (const std::string& sourceFile : sourceFiles)
+            {
+                fileList += (fileList.empty() ? "" : ", ") + sourceFile;
+            }
+            bbfm::Console::ReportStatus("Phase 0 and Phase 1 reused for " + fileList + " (unchanged)");
+            if (nullptr != syntaxTreeOut)
+            {
+                DumpSyntaxTree(*cached, *syntaxTreeOut, dumpJson);
+            }
+            return cached;
+        }
+    }
+
+    bbfm::Driver driver(sourceFiles, classPrefix);
+    auto         model = std::make_unique<bbfm::CompiledModel>();
+
+    // Phase 0: Lexical analysis and parsing; with an import cache only changed files are parsed, and the files stay separate
+    model->ast = (nullptr != imports) ? driver.Phase0(*imports, model->moduleAsts) : driver.Phase0();
+    if (nullptr == model->ast)
+    {
+        return nullptr;
+    }
+
+    // Dump the AST if requested
+    if (nullptr != syntaxTreeOut)
+    {
+        DumpSyntaxTree(*model, *syntaxTreeOut, dumpJson);
+    }
+
+    // Phase 1: Semantic analysis, also of the declarations that survived syntax errors
+    model->analyzer = driver.Phase1(model->ast.get(), nullptr, (nullptr != imports) ? &model->moduleAsts : nullptr);
+    if (nullptr == model->analyzer || driver.HasErrors())
+    {
+        return nullptr;
+    }
+
+    // Storage layouts
+    {
+        bbfm::ProfileScope profile("phase", "Storage layout");
+        model->layouts = std::make_unique<bbfm::LayoutBuilder>(model->analyzer.get());
+        model->layouts->Build();
+    }
+
+    model->classPrefix = classPrefix;
+    model->contentHash = contentHash;
+    model->modules     = driver.GetModules();
+    if (!bbfm::ModelCache::CanonicalPaths(sourceFiles, model->sourceFiles))
+    {
+        // A source file went away after parsing: use the model once without caching it
+        return std::shared_ptr<const bbfm::CompiledModel>(std::move(model));
+    }
+    return cache.Insert(std::move(model));
+}
+
+int RunCompiler(const std::vector<std::string>& args, bbfm::ModelCache& cache, bbfm::ImportCache* imports, const bool allowServer);
+
+/// \brief Remove an option and its value from a command line
+/// \param args Arguments
+/// \param option Option name including the dashes (e.g., --cache-dir)
+/// \return Arguments without the option
+std::vector<std::string> RemoveOption(const std::vector<std::string>& args, const std::string& option)
+{
+    std::vector<std::string> remaining;
+    for (size_t i = 0; i < args.size(); ++i)
+    {
+        if (option == args[i] && i + 1 < args.size())
+        {
+            ++i;
+            continue;
+        }
+        if (0 == args[i].rfind(option + "=", 0))
+        {
+            continue;
+        }
+        remaining.push_back(args[i]);
+    }
+    return remaining;
+}
+
+/// \brief Run a command line through the compile cache
+///
+/// On a hit the stored output is printed and the stored files are written
+/// without compiling. On a miss the command line runs with captured output,
+/// and a successful compile is stored with the files it wrote.
+/// \param args Arguments including the program name and the cache options
+/// \param result Parsed arguments
+/// \param cache Cache of compiled models
+/// \param imports Cache of parsed files (nullptr for none)
+/// \param allowServer True if --server may be used
+/// \return Exit code
+int RunCached(const std::vector<std::string>& args, const cxxopts::ParseResult& result, bbfm::ModelCache& cache, bbfm::ImportCache* imports,
+              const bool allowServer)
+{
+    const std::vector<std::string> compileArgs = RemoveOption(RemoveOption(args, "--cache-dir"), "--cache-size");
+    bbfm::CompileCache             compileCache(result["cache-dir"].as<std::string>(), result["cache-size"].as<uint64_t>() * 1024 * 1024);
+
+    // Key: the command line (without the program name) and the content of every input and imported file
+    std::vector<std::string> sourceFiles = result["input"].as<std::vector<std::string>>();
+    if (result.count("diff"))
+    {
+        sourceFiles.push_back(result["diff"].as<std::string>());
+    }
+    std::vector<std::string> inputFiles;
+    std::string              key;
+    if (!bbfm::Driver::FindModuleFiles(sourceFiles, inputFiles) ||
+        !bbfm::CompileCache::MakeKey(std::vector<std::string>(compileArgs.begin() + 1, compileArgs.end()), inputFiles, key))
+    {
+        return RunCompiler(compileArgs, cache, imports, allowServer);
+    }
+
+    bbfm::CachedCompile entry;
+    if (compileCache.Lookup(key, entry))
+    {
+        for (const auto& file : entry.files)
+        {
+            std::ofstream out(file.first, std::ios::binary);
+            if (!out.is_open() || !(out << file.second))
+            {
+                bbfm::Console::ReportError("Error: Could not write '" + file.first + "'");
+                return 1;
+            }
+        }
+        std::cout << entry.out << std::flush;
+        std::cerr << entry.err << std::flush;
+        return entry.exitCode;
+    }
+
+    // Miss: compile with captured output
+    std::ostringstream out;
+    std::ostringstream err;
+    std::streambuf*    savedOut = std::cout.rdbuf(out.rdbuf());
+    std::streambuf*    savedErr = std::cerr.rdbuf(err.rdbuf());
+    entry.exitCode              = RunCompiler(compileArgs, cache, imports, allowServer);
+    std::cout.rdbuf(savedOut);
+    std::cerr.rdbuf(savedErr);
+    entry.out = out.str();
+    entry.err = err.str();
+    std::cout << entry.out << std::flush;
+    std::cerr << entry.err << std::flush;
+
+    // Only successful compiles are stored, errors are always reported by a fresh compile
+    if (0 != entry.exitCode)
+    {
+        return entry.exitCode;
+    }
+    for (const char* option : {"emit-arrow-schema", "emit-sql", "dump-out"})
+    {
+        if (result.count(option))
+        {
+            const std::string  path = result[option].as<std::string>();
+            std::ifstream      infile(path, std::ios::binary);
+            std::ostringstream content;
+            if (!infile.is_open() || !(content << infile.rdbuf()))
+            {
+                return entry.exitCode;
+            }
+            entry.files.emplace_back(path, content.str());
+        }
+    }
+    compileCache.Store(key, entry);
+    return entry.exitCode;
+}
+
+/// \brief Run one compiler command line
+/// \param args Arguments including the program name
+/// \param cache Cache of compiled models (shared across requests in server mode)
+/// \param imports Cache of parsed files (shared across requests in server mode, nullptr otherwise)
+/// \param allowServer True if --server may be used (false inside a server request)
+/// \return Exit code
+int RunCompiler(const std::vector<std::string>& args, bbfm::ModelCache& cache, bbfm::ImportCache* imports, const bool allowServer)
 {
     try
     {
+        std::vector<const char*> argv;
+        for (const auto& arg : args)
+        {
+            argv.push_back(arg.c_str());
+        }
+
         // Setup command line options
         cxxopts::Options options("model-compiler", "BBFM Model Compiler - Compiles .fm source files to Swift");
 
         options.add_options()("h,help", "Print usage information")("v,version", "Print version information")(
             "dump-syntax-tree", "Dump the Abstract Syntax Tree after lexical analysis")("dump-symbol-table", "Dump the Symbol Table after semantic analysis")(
+            "dump-format", "Format of the syntax tree and symbol table dumps: text or json (one JSON object per line)",
+            cxxopts::value<std::string>()->default_value("text"))(
+            "dump-out", "Write the syntax tree and symbol table dumps to the given file instead of stdout", cxxopts::value<std::string>())(
+            "dump-layout", "Dump the storage layout of every class after semantic analysis")(
+            "emit-arrow-schema", "Write the Arrow columnar schema of every class as JSON to the given file",
+            cxxopts::value<std::string>())(
+            "emit-sql", "Write the SQLite schema and loader statements of every class to the given file", cxxopts::value<std::string>())(
+            "diff", "Compare the model against an older version (the given file) and print the changes and migration plan",
+            cxxopts::value<std::string>())(
+            "server", "Serve compile requests on the given Unix socket, keeping parsed models in memory", cxxopts::value<std::string>())(
+            "connect", "Forward this command line to the compile server on the given Unix socket", cxxopts::value<std::string>())(
+            "lsp", "Run as a language server on stdin/stdout")(
+            "watch", "Rebuild the .fm files of the given directory whenever they change (output options name directories)",
+            cxxopts::value<std::string>())(
+            "cache-dir", "Reuse complete compiles from the given cache directory, and store new ones there", cxxopts::value<std::string>())(
+            "cache-size", "Size limit of the cache directory in MB (least recently used compiles are removed)",
+            cxxopts::value<uint64_t>()->default_value("256"))(
+            "time-report", "Print wall time, CPU time and peak memory of every phase, and the slowest classes to validate")(
+            "trace-out", "Write a Chrome trace (about://tracing, Perfetto) of the phases, files and classes to the given file",
+            cxxopts::value<std::string>())(
+            "perf-counters", "Add cycles, instructions, cache and branch misses of every phase to the time report ('passes' also measures the passes of Phase 1)",
+            cxxopts::value<std::string>()->implicit_value("phases"))(
+            "alloc-report", "Print heap allocations per phase and the hottest allocation sites (needs -DBBFM_ALLOC_TRACKING=ON)")(
+            "alloc-report-json", "Write the heap allocations per phase and site as JSON to the given file (needs -DBBFM_ALLOC_TRACKING=ON)",
+            cxxopts::value<std::string>())(
+            "diagnostics-format", "Format of errors on stderr: text, json or sarif", cxxopts::value<std::string>()->default_value("text"))(
+            "error-limit", "Number of errors shown, the rest are counted (0 for all)",
+            cxxopts::value<size_t>()->default_value(std::to_string(bbfm::DiagnosticSession::DEFAULT_ERROR_LIMIT)))(
             "class-prefix", "Prefix to add to generated class and enum names",
             cxxopts::value<std::string>()->default_value(""))("input", "Input source file(s)", cxxopts::value<std::vector<std::string>>());
 
@@ -21,7 +288,7 @@ int main(int argc, char* argv[])
         options.positional_help("<source_file>");
 
         // Parse command line arguments
-        auto result = options.parse(argc, argv);
+        auto result = options.parse(static_cast<int>(argv.size()), argv.data());
 
         // Handle --help
         if (result.count("help"))
@@ -33,10 +300,58 @@ int main(int argc, char* argv[])
         // Handle --version
         if (result.count("version"))
         {
-            std::cout << "BBFM Model Compiler v0.1.0" << std::endl;
+            std::cout << "BBFM Model Compiler v" BBFM_COMPILER_VERSION << std::endl;
             return 0;
         }
 
+        // Handle --server
+        if (result.count("server") || result.count("connect"))
+        {
+            if (!allowServer)
+            {
+                bbfm::Console::ReportError("Error: --server and --connect cannot be used in a compile server request");
+                return 1;
+            }
+            if (result.count("connect"))
+            {
+                bbfm::Console::ReportError("Error: --server and --connect cannot be combined");
+                return 1;
+            }
+
+            bbfm::CompileServer server(result["server"].as<std::string>(),
+                [](const std::vector<std::string>& requestArgs, bbfm::ModelCache& serverCache, bbfm::ImportCache& serverImports)
+                { return RunCompiler(requestArgs, serverCache, &serverImports, false); });
+            return server.Run();
+        }
+
+        // Handle --lsp
+        if (result.count("lsp"))
+        {
+            if (!allowServer)
+            {
+                bbfm::Console::ReportError("Error: --lsp cannot be used in a compile server request");
+                return 1;
+            }
+
+            bbfm::LanguageServer languageServer(std::cin, std::cout, result["class-prefix"].as<std::string>());
+            return languageServer.Run();
+        }
+
+        // Handle --watch
+        if (result.count("watch"))
+        {
+            if (!allowServer)
+            {
+                bbfm::Console::ReportError("Error: --watch cannot be used in a compile server request");
+                return 1;
+            }
+
+            const std::string arrowDirectory = result.count("emit-arrow-schema") ? result["emit-arrow-schema"].as<std::string>() : std::string();
+            const std::string sqlDirectory   = result.count("emit-sql") ? result["emit-sql"].as<std::string>() : std::string();
+            bbfm::ModelWatcher watcher(result["watch"].as<std::string>(), result["class-prefix"].as<std::string>(), arrowDirectory, sqlDirectory);
+            return watcher.Run();
+        }
+
         // Check for input files
         if (0 == result.count("input"))
         {
@@ -45,47 +360,178 @@ int main(int argc, char* argv[])
             return 1;
         }
 
+        // Allocation reports need the interposed allocator
+        const bool        allocReport   = result.count("alloc-report") > 0;
+        const std::string allocJsonPath = result.count("alloc-report-json") ? result["alloc-report-json"].as<std::string>() : std::string();
+        if ((allocReport || false == allocJsonPath.empty()) && !bbfm::AllocTracker::IsAvailable())
+        {
+            bbfm::Console::ReportError("Error: --alloc-report needs a build configured with -DBBFM_ALLOC_TRACKING=ON");
+            return 1;
+        }
+
+        // Hardware counters of the phases, or also of the passes of Phase 1
+        bbfm::PerfCounterMode perfCounters = bbfm::PerfCounterMode::OFF;
+        if (result.count("perf-counters"))
+        {
+            const std::string mode = result["perf-counters"].as<std::string>();
+            if ("phases" != mode && "passes" != mode)
+            {
+                bbfm::Console::ReportError("Error: --perf-counters must be 'phases' or 'passes', not '" + mode + "'");
+                return 1;
+            }
+            perfCounters = ("passes" == mode) ? bbfm::PerfCounterMode::PASSES : bbfm::PerfCounterMode::PHASES;
+        }
+
+        // Reuse a complete compile from the cache directory (a profiled compile always runs)
+        const bool        timeReport = result.count("time-report") > 0;
+        const std::string tracePath  = result.count("trace-out") ? result["trace-out"].as<std::string>() : std::string();
+        const bool        profiled   = timeReport || false == tracePath.empty() || bbfm::PerfCounterMode::OFF != perfCounters;
+        if (result.count("cache-dir") && !profiled && !allocReport && allocJsonPath.empty())
+        {
+            return RunCached(args, result, cache, imports, allowServer);
+        }
+
+        // Errors are buffered and written in one batch when the compile ends
+        bbfm::DiagnosticFormat diagnosticFormat = bbfm::DiagnosticFormat::TEXT;
+        if (!bbfm::Diagnostics::ParseFormat(result["diagnostics-format"].as<std::string>(), diagnosticFormat))
+        {
+            bbfm::Console::ReportError("Error: --diagnostics-format must be text, json or sarif");
+            return 1;
+        }
+        bbfm::DiagnosticSession diagnostics(diagnosticFormat, result["error-limit"].as<size_t>());
+
+        // Report and trace are written when the compile ends, also after errors
+        bbfm::ProfileSession profileSession(timeReport, tracePath, perfCounters);
+
+        // Declared after the profile session, so tracking stops before the time report is written
+        bbfm::AllocSession allocSession(allocReport, allocJsonPath);
+
         // Collect source files from command line
         std::vector<std::string> sourceFiles = result["input"].as<std::vector<std::string>>();
 
         // Get class prefix option
         std::string classPrefix = result["class-prefix"].as<std::string>();
 
-        // Create driver with source files
-        bbfm::Driver driver(sourceFiles, classPrefix);
-
         // Report class prefix if set
         if (false == classPrefix.empty())
         {
             bbfm::Console::ReportStatus("Class prefix: " + classPrefix);
         }
 
-        // Phase 0: Lexical analysis and parsing
-        std::unique_ptr<bbfm::AST> ast = driver.Phase0();
-        if (nullptr == ast)
+        // The syntax tree and symbol table dumps stream through one buffer
+        const std::string dumpFormat = result["dump-format"].as<std::string>();
+        if ("text" != dumpFormat && "json" != dumpFormat)
         {
+            bbfm::Console::ReportError("Error: --dump-format must be text or json");
             return 1;
         }
-
-        // Dump the AST if requested
-        if (result.count("dump-syntax-tree"))
+        const bool                          dumpJson = ("json" == dumpFormat);
+        std::ofstream                       dumpFile;
+        std::unique_ptr<bbfm::OutputBuffer> dumpOut;
+        if (result.count("dump-syntax-tree") || result.count("dump-symbol-table"))
         {
-            std::cout << "\n";
-            ast->Dump();
+            if (result.count("dump-out"))
+            {
+                const std::string dumpPath = result["dump-out"].as<std::string>();
+                dumpFile.open(dumpPath, std::ios::binary);
+                if (!dumpFile.is_open())
+                {
+                    bbfm::Console::ReportError("Error: Could not write dump to '" + dumpPath + "'");
+                    return 1;
+                }
+            }
+            dumpOut = std::make_unique<bbfm::OutputBuffer>(dumpFile.is_open() ? static_cast<std::ostream&>(dumpFile) : std::cout);
         }
 
-        // Phase 1: Semantic analysis
-        std::unique_ptr<bbfm::SemanticAnalyzer> analyzer = driver.Phase1(ast.get());
-        if (nullptr == analyzer)
+        // Phase 0 and Phase 1
+        const std::shared_ptr<const bbfm::CompiledModel> model =
+            LoadModel(sourceFiles, classPrefix, result.count("dump-syntax-tree") ? dumpOut.get() : nullptr, dumpJson, cache, imports);
+        if (nullptr == model)
         {
             return 1;
         }
+        const bbfm::SemanticAnalyzer* analyzer      = model->analyzer.get();
+        const bbfm::LayoutBuilder&    layoutBuilder = *model->layouts;
 
         // Dump the symbol table if requested
         if (result.count("dump-symbol-table"))
+        {
+            if (dumpJson)
+            {
+                bbfm::JsonWriter writer(*dumpOut);
+                writer.BeginObject().Key("symbolTable");
+                analyzer->DumpSymbolTableJson(writer);
+                writer.EndObject();
+                *dumpOut << '\n';
+            }
+            else
+            {
+                *dumpOut << '\n';
+                analyzer->DumpSymbolTable(*dumpOut);
+            }
+            dumpOut->Flush();
+        }
+        if (nullptr != dumpOut && dumpOut->HasFailed())
+        {
+            bbfm::Console::ReportError("Error: Could not write the dump");
+            return 1;
+        }
+
+        // Dump the storage layouts if requested
+        if (result.count("dump-layout"))
         {
             std::cout << "\n";
-            analyzer->DumpSymbolTable();
+            layoutBuilder.DumpLayouts();
+        }
+
+        // Write the Arrow schemas if requested
+        if (result.count("emit-arrow-schema"))
+        {
+            const std::string schemaFile = result["emit-arrow-schema"].as<std::string>();
+            std::ofstream     schemaOut(schemaFile);
+            if (!schemaOut.is_open())
+            {
+                bbfm::Console::ReportError("Error: Could not write Arrow schema to '" + schemaFile + "'");
+                return 1;
+            }
+
+            bbfm::ProfileScope      profile("output", "Arrow schema");
+            bbfm::ArrowSchemaWriter schemaWriter(analyzer, &layoutBuilder);
+            schemaWriter.Write(schemaOut);
+            bbfm::Console::ReportStatus("Arrow schema written to " + schemaFile);
+        }
+
+        // Write the SQLite schema if requested
+        if (result.count("emit-sql"))
+        {
+            const std::string sqlFile = result["emit-sql"].as<std::string>();
+            std::ofstream     sqlOut(sqlFile);
+            if (!sqlOut.is_open())
+            {
+                bbfm::Console::ReportError("Error: Could not write SQL schema to '" + sqlFile + "'");
+                return 1;
+            }
+
+            bbfm::ProfileScope    profile("output", "SQL schema");
+            bbfm::SqlSchemaWriter sqlWriter(analyzer, &layoutBuilder, classPrefix);
+            sqlWriter.Write(sqlOut);
+            bbfm::Console::ReportStatus("SQL schema written to " + sqlFile);
+        }
+
+        // Compare against an older version of the model if requested
+        if (result.count("diff"))
+        {
+            const std::shared_ptr<const bbfm::CompiledModel> oldModel = LoadModel({result["diff"].as<std::string>()}, classPrefix, nullptr, false, cache, imports);
+            if (nullptr == oldModel)
+            {
+                return 1;
+            }
+
+            bbfm::ProfileScope profile("output", "Schema diff");
+            bbfm::SchemaDiff   schemaDiff(oldModel->analyzer.get(), oldModel->layouts.get(), analyzer, &layoutBuilder);
+            schemaDiff.Compute();
+            std::cout << "\n";
+            schemaDiff.Dump();
         }
 
         bbfm::Console::ReportStatus("\nCompilation completed successfully!");
@@ -102,3 +548,29 @@ int main(int argc, char* argv[])
         return 1;
     }
 }
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> args(argv, argv + argc);
+
+    // Thin client: forward the command line to a compile server, and compile here if it does not answer
+    for (size_t i = 1; i < args.size(); ++i)
+    {
+        const bool separate = ("--connect" == args[i] && i + 1 < args.size());
+        if (separate || 0 == args[i].rfind("--connect=", 0))
+        {
+            const std::string socketPath = separate ? args[i + 1] : args[i].substr(10);
+            args.erase(args.begin() + static_cast<std::ptrdiff_t>(i), args.begin() + static_cast<std::ptrdiff_t>(i + (separate ? 2 : 1)));
+            int exitCode = 1;
+            if (bbfm::CompileServer::Forward(socketPath, args, exitCode))
+            {
+                return exitCode;
+            }
+            break;
+        }
+    }
+
+    bbfm::ModelCache cache;
+    return RunCompiler(args, cache, nullptr, true);
+}
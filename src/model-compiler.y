@@ -1,4 +1,5 @@
 %{
+#include <climits>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -7,36 +8,50 @@
 #include <vector>
 #include <fstream>
 #include <sstream>
+#include <string_view>
 #include "AST.h"
 #include "Console.h"
+#include "Diagnostics.h"
+#include "ParseContext.h"
+%}
+
+/* Reentrant: every parse has its own scanner and context, so files can be parsed in parallel */
+%define api.pure full
+%locations
+%param {yyscan_t scanner}
+%parse-param {bbfm::ParseContext& context}
 
-#ifdef __cplusplus
-extern "C" {
-#endif
-extern int yylex(void);
-extern int yylineno;
-extern FILE *yyin;
-void yyerror(const char *s);
-#ifdef __cplusplus
+%code requires {
+    // Scanner state of the reentrant flex scanner
+    #ifndef YY_TYPEDEF_YY_SCANNER_T
+    #define YY_TYPEDEF_YY_SCANNER_T
+    typedef void* yyscan_t;
+    #endif
+
+    namespace bbfm {
+    struct ParseContext;
+    }
 }
-#endif
 
-// Global AST root
-std::unique_ptr<bbfm::AST> g_ast;
+%code provides {
+    // The flex scanner (bison-bridge and bison-locations)
+    int yylex(YYSTYPE* yylval_param, YYLTYPE* yylloc_param, yyscan_t yyscanner);
 
-// Global filename for error reporting
-std::string g_current_filename;
+    // Report a character the scanner does not know, counted as a syntax error
+    void ReportUnknownCharacter(bbfm::ParseContext& context, const int line, const int column, const char character);
+}
 
-// Cache of source file lines for error reporting
-std::vector<std::string> g_source_lines;
-%}
+%code {
+    static void yyerror(YYLTYPE* location, yyscan_t scanner, bbfm::ParseContext& context, const char* s);
 
-%locations
+    // Report a syntax error at a location with the source line
+    static void ReportSyntaxError(bbfm::ParseContext& context, const int line, const int column, const char* s);
 
-%code requires {
-    #ifdef __cplusplus
-    #define YYPARSE_DECL extern "C" int yyparse (void)
-    #endif
+    // Cardinality bounds are int; a larger literal is reported instead of being truncated
+    static bool CardinalityBoundFits(bbfm::ParseContext& context, const long long bound, const int line, const int column);
+
+    // Name-only stand-in for a declaration dropped by 'error RBRACE', null if no name can be recovered
+    static bbfm::Declaration* DroppedDeclaration(const bbfm::ParseContext& context, const int line, const int column);
 }
 
 // NOTE: This union uses void* (raw pointers) instead of smart pointers
@@ -46,10 +61,12 @@ std::vector<std::string> g_source_lines;
 // std::unique_ptr in the grammar actions, ensuring safe ownership transfer.
 // This is the standard pattern for Bison parsers in C++.
 %union {
-    int integer;
+    long long integer;
     char *string;
     void *ast;
     void *declaration;
+    void *importDecl;
+    void *importList;
     void *enumDecl;
     void *classDecl;
     void *field;
@@ -62,10 +79,12 @@ std::vector<std::string> g_source_lines;
     void *fieldList;
     void *invariantList;
     void *modifierList;
+    void *expressionList;
 }
 
 /* Token declarations */
-%token CLASS INHERITS ENUM FEATURE INVARIANT OPTIONAL UNIQUE
+%token CLASS INHERITS ENUM IMPORT FEATURE INVARIANT OPTIONAL UNIQUE INTERNED ENCODING
+%token FORALL EXISTS IN
 %token STRING_TYPE INT_TYPE REAL_TYPE BOOL_TYPE TIMESTAMP_TYPE TIMESPAN_TYPE DATE_TYPE GUID_TYPE
 %token LBRACE RBRACE LBRACKET RBRACKET LPAREN RPAREN
 %token SEMICOLON COLON COMMA EQUALS DOT DOTDOT ASTERISK
@@ -81,6 +100,8 @@ std::vector<std::string> g_source_lines;
 %type <ast> program
 %type <declarationList> declaration_list
 %type <declaration> declaration
+%type <importList> import_list
+%type <importDecl> import_declaration
 %type <enumDecl> enum_declaration
 %type <classDecl> class_declaration
 %type <stringList> enum_value_list
@@ -93,10 +114,35 @@ std::vector<std::string> g_source_lines;
 %type <modifier> modifier
 %type <string> field_name
 %type <string> attribute_name
+%type <string> contextual_keyword
 %type <string> literal_value
 %type <expression> expression primary_expression
+%type <expressionList> argument_list
+
+/* Values dropped by error recovery (the AST itself is owned by the context) */
+%destructor { free($$); } <string>
+%destructor { delete static_cast<bbfm::ImportDeclaration*>($$); } <importDecl>
+%destructor { delete static_cast<std::vector<std::unique_ptr<bbfm::ImportDeclaration>>*>($$); } <importList>
+%destructor { delete static_cast<bbfm::Declaration*>($$); } <declaration>
+%destructor { delete static_cast<std::vector<std::unique_ptr<bbfm::Declaration>>*>($$); } <declarationList>
+%destructor { delete static_cast<bbfm::EnumDeclaration*>($$); } <enumDecl>
+%destructor { delete static_cast<std::vector<std::string>*>($$); } <stringList>
+%destructor { delete static_cast<bbfm::ClassDeclaration*>($$); } <classDecl>
+%destructor { delete static_cast<std::vector<std::unique_ptr<bbfm::Field>>*>($$); } <fieldList>
+%destructor { delete static_cast<bbfm::Field*>($$); } <field>
+%destructor { delete static_cast<std::vector<std::unique_ptr<bbfm::Invariant>>*>($$); } <invariantList>
+%destructor { delete static_cast<bbfm::Invariant*>($$); } <invariant>
+%destructor { delete static_cast<bbfm::TypeSpec*>($$); } <typeSpec>
+%destructor { delete static_cast<std::vector<std::unique_ptr<bbfm::Modifier>>*>($$); } <modifierList>
+%destructor { delete static_cast<bbfm::Modifier*>($$); } <modifier>
+%destructor { delete static_cast<bbfm::Expression*>($$); } <expression>
+%destructor { delete static_cast<std::vector<std::unique_ptr<bbfm::Expression>>*>($$); } <expressionList>
+
+/* An error in the field list of a class is recovered there, not as an error after the (empty) invariant list */
+%expect 2
 
 /* Operator precedence (lowest to highest) */
+%nonassoc QUANTIFIER
 %left OR
 %left AND
 %left EQ NE
@@ -110,42 +156,105 @@ std::vector<std::string> g_source_lines;
 %%
 
 program:
-    /* empty */
+    import_list
     {
+        auto* imports = static_cast<std::vector<std::unique_ptr<bbfm::ImportDeclaration>>*>($1);
         auto* ast = new bbfm::AST(std::vector<std::unique_ptr<bbfm::Declaration>>());
+        ast->SetImports(std::move(*imports));
+        delete imports;
         $$ = ast;
-        g_ast = std::unique_ptr<bbfm::AST>(ast);
+        context.ast = std::unique_ptr<bbfm::AST>(ast);
     }
-    | declaration_list
+    | import_list declaration_list
     {
-        auto* list = static_cast<std::vector<std::unique_ptr<bbfm::Declaration>>*>($1);
+        auto* imports = static_cast<std::vector<std::unique_ptr<bbfm::ImportDeclaration>>*>($1);
+        auto* list = static_cast<std::vector<std::unique_ptr<bbfm::Declaration>>*>($2);
         auto* ast = new bbfm::AST(std::move(*list));
+        ast->SetImports(std::move(*imports));
+        delete imports;
         delete list;
         $$ = ast;
-        g_ast = std::unique_ptr<bbfm::AST>(ast);
+        context.ast = std::unique_ptr<bbfm::AST>(ast);
+    }
+    ;
+
+/* Imports come before the declarations of a file */
+import_list:
+    /* empty */
+    { $$ = new std::vector<std::unique_ptr<bbfm::ImportDeclaration>>(); }
+    | import_list import_declaration
+    {
+        auto* list = static_cast<std::vector<std::unique_ptr<bbfm::ImportDeclaration>>*>($1);
+        if (nullptr != $2)
+        {
+            list->push_back(std::unique_ptr<bbfm::ImportDeclaration>(static_cast<bbfm::ImportDeclaration*>($2)));
+        }
+        $$ = list;
     }
     ;
 
+import_declaration:
+    IMPORT STRING_LITERAL SEMICOLON
+    {
+        // The lexer keeps the quotes of string literals
+        std::string path = $2;
+        if (path.size() >= 2 && '"' == path.front() && '"' == path.back())
+        {
+            path = path.substr(1, path.size() - 2);
+        }
+        $$ = new bbfm::ImportDeclaration(path);
+        static_cast<bbfm::ImportDeclaration*>($$)->SetLocation(@2.first_line, @2.first_column);
+        free($2);
+    }
+    | IMPORT error SEMICOLON
+    { $$ = nullptr; yyerrok; }  // Reported by yyerror(), the import is skipped
+    ;
+
+/* Declarations dropped by error recovery are null */
 declaration_list:
     declaration
     {
         auto* list = new std::vector<std::unique_ptr<bbfm::Declaration>>();
-        list->push_back(std::unique_ptr<bbfm::Declaration>(static_cast<bbfm::Declaration*>($1)));
+        if (nullptr != $1)
+        {
+            list->push_back(std::unique_ptr<bbfm::Declaration>(static_cast<bbfm::Declaration*>($1)));
+        }
         $$ = list;
     }
     | declaration_list declaration
     {
         auto* list = static_cast<std::vector<std::unique_ptr<bbfm::Declaration>>*>($1);
-        list->push_back(std::unique_ptr<bbfm::Declaration>(static_cast<bbfm::Declaration*>($2)));
+        if (nullptr != $2)
+        {
+            list->push_back(std::unique_ptr<bbfm::Declaration>(static_cast<bbfm::Declaration*>($2)));
+        }
         $$ = list;
     }
     ;
 
 declaration:
     enum_declaration
-    { $$ = new bbfm::Declaration(std::unique_ptr<bbfm::EnumDeclaration>(static_cast<bbfm::EnumDeclaration*>($1))); }
+    {
+        $$ = new bbfm::Declaration(std::unique_ptr<bbfm::EnumDeclaration>(static_cast<bbfm::EnumDeclaration*>($1)));
+        static_cast<bbfm::Declaration*>($$)->SetSourceFile(context.fileName);
+        static_cast<bbfm::Declaration*>($$)->SetHadSyntaxError(context.declarationRecovered);
+        context.declarationRecovered = false;
+    }
     | class_declaration
-    { $$ = new bbfm::Declaration(std::unique_ptr<bbfm::ClassDeclaration>(static_cast<bbfm::ClassDeclaration*>($1))); }
+    {
+        $$ = new bbfm::Declaration(std::unique_ptr<bbfm::ClassDeclaration>(static_cast<bbfm::ClassDeclaration*>($1)));
+        static_cast<bbfm::Declaration*>($$)->SetSourceFile(context.fileName);
+        static_cast<bbfm::Declaration*>($$)->SetHadSyntaxError(context.declarationRecovered);
+        context.declarationRecovered = false;
+    }
+    | error RBRACE
+    {
+        // An error before the body of a declaration skips to its closing brace; the name is kept,
+        // so references to the declaration are not reported as undefined types
+        $$ = DroppedDeclaration(context, @1.first_line, @1.first_column);
+        context.declarationRecovered = false;
+        yyerrok;
+    }
     ;
 
 enum_declaration:
@@ -153,6 +262,7 @@ enum_declaration:
     {
         auto* values = static_cast<std::vector<std::string>*>($4);
         $$ = new bbfm::EnumDeclaration($2, std::move(*values));
+        static_cast<bbfm::EnumDeclaration*>($$)->SetLocation(@2.first_line, @2.first_column);
         free($2);
         delete values;
     }
@@ -173,6 +283,16 @@ enum_value_list:
         free($3);
         $$ = list;
     }
+    | enum_value_list error
+    {
+        // Tokens are skipped up to the next ',' or '}', which resume reporting errors
+        $$ = $1;
+        context.declarationRecovered = true;
+        if (COMMA == yychar || RBRACE == yychar)
+        {
+            yyerrok;
+        }
+    }
     ;
 
 class_declaration:
@@ -181,6 +301,7 @@ class_declaration:
         auto* fields = static_cast<std::vector<std::unique_ptr<bbfm::Field>>*>($4);
         auto* invariants = static_cast<std::vector<std::unique_ptr<bbfm::Invariant>>*>($5);
         $$ = new bbfm::ClassDeclaration($2, "", std::move(*fields), std::move(*invariants));
+        static_cast<bbfm::ClassDeclaration*>($$)->SetLocation(@2.first_line, @2.first_column);
         free($2);
         delete fields;
         delete invariants;
@@ -190,6 +311,7 @@ class_declaration:
         auto* fields = static_cast<std::vector<std::unique_ptr<bbfm::Field>>*>($6);
         auto* invariants = static_cast<std::vector<std::unique_ptr<bbfm::Invariant>>*>($7);
         $$ = new bbfm::ClassDeclaration($2, $4, std::move(*fields), std::move(*invariants));
+        static_cast<bbfm::ClassDeclaration*>($$)->SetLocation(@2.first_line, @2.first_column);
         free($2);
         free($4);
         delete fields;
@@ -206,6 +328,18 @@ field_list:
         list->push_back(std::unique_ptr<bbfm::Field>(static_cast<bbfm::Field*>($2)));
         $$ = list;
     }
+    | field_list error SEMICOLON
+    { $$ = $1; context.declarationRecovered = true; yyerrok; }  // The broken field is dropped up to its ';'
+    | field_list error
+    {
+        // The broken field is dropped, tokens are skipped up to the next member or '}'
+        $$ = $1;
+        context.declarationRecovered = true;
+        if (FEATURE == yychar || INVARIANT == yychar || RBRACE == yychar)
+        {
+            yyerrok;
+        }
+    }
     ;
 
 invariant_list:
@@ -217,6 +351,18 @@ invariant_list:
         list->push_back(std::unique_ptr<bbfm::Invariant>(static_cast<bbfm::Invariant*>($2)));
         $$ = list;
     }
+    | invariant_list error SEMICOLON
+    { $$ = $1; context.declarationRecovered = true; yyerrok; }  // The broken invariant is dropped up to its ';'
+    | invariant_list error
+    {
+        // The broken invariant is dropped, tokens are skipped up to the next invariant or '}'
+        $$ = $1;
+        context.declarationRecovered = true;
+        if (INVARIANT == yychar || RBRACE == yychar)
+        {
+            yyerrok;
+        }
+    }
     ;
 
 literal_value:
@@ -236,6 +382,20 @@ attribute_name:
     | TIMESPAN_TYPE { $$ = strdup("timespan"); }
     | DATE_TYPE     { $$ = strdup("date"); }
     | GUID_TYPE     { $$ = strdup("guid"); }
+    | INTERNED      { $$ = strdup("interned"); }
+    | ENCODING      { $$ = strdup("encoding"); }
+    | IMPORT        { $$ = strdup("import"); }
+    ;
+
+/* Keywords added after field names were in use; forall, exists and in start or
+   continue a quantifier, so in an expression they only follow a '.' */
+contextual_keyword:
+    INTERNED        { $$ = strdup("interned"); }
+    | ENCODING      { $$ = strdup("encoding"); }
+    | IMPORT        { $$ = strdup("import"); }
+    | FORALL        { $$ = strdup("forall"); }
+    | EXISTS        { $$ = strdup("exists"); }
+    | IN            { $$ = strdup("in"); }
     ;
 
 invariant:
@@ -243,6 +403,7 @@ invariant:
     {
         $$ = new bbfm::Invariant($2,
             std::unique_ptr<bbfm::Expression>(static_cast<bbfm::Expression*>($4)));
+        static_cast<bbfm::Invariant*>($$)->SetLocation(@2.first_line, @2.first_column);
         free($2);
     }
     ;
@@ -257,6 +418,7 @@ field_name:
     | TIMESPAN_TYPE { $$ = strdup("timespan"); }
     | DATE_TYPE     { $$ = strdup("date"); }
     | GUID_TYPE     { $$ = strdup("guid"); }
+    | contextual_keyword
     ;
 
 field:
@@ -270,6 +432,7 @@ field:
             std::move(*modifiers),
             false
         );
+        static_cast<bbfm::Field*>($$)->SetLocation(@2.first_line, @2.first_column);
         free($2);
         delete modifiers;
     }
@@ -286,6 +449,7 @@ field:
             std::move(modifiers),
             false
         );
+        static_cast<bbfm::Field*>($$)->SetLocation(@2.first_line, @2.first_column);
         free($2);
     }
     | FEATURE field_name COLON type_spec modifier_spec EQUALS expression SEMICOLON
@@ -301,6 +465,7 @@ field:
             false,
             std::unique_ptr<bbfm::Expression>(expr)
         );
+        static_cast<bbfm::Field*>($$)->SetLocation(@2.first_line, @2.first_column);
         free($2);
         delete modifiers;
     }
@@ -319,6 +484,7 @@ field:
             false,
             std::unique_ptr<bbfm::Expression>(expr)
         );
+        static_cast<bbfm::Field*>($$)->SetLocation(@2.first_line, @2.first_column);
         free($2);
     }
     ;
@@ -357,15 +523,37 @@ modifier_list:
 
 modifier:
     INTEGER_LITERAL
-    { $$ = new bbfm::CardinalityModifier($1, $1); }
+    {
+        if (!CardinalityBoundFits(context, $1, @1.first_line, @1.first_column))
+        {
+            YYERROR;
+        }
+        $$ = new bbfm::CardinalityModifier(static_cast<int>($1), static_cast<int>($1));
+    }
     | INTEGER_LITERAL DOTDOT INTEGER_LITERAL
-    { $$ = new bbfm::CardinalityModifier($1, $3); }
+    {
+        if (!CardinalityBoundFits(context, $1, @1.first_line, @1.first_column) || !CardinalityBoundFits(context, $3, @3.first_line, @3.first_column))
+        {
+            YYERROR;
+        }
+        $$ = new bbfm::CardinalityModifier(static_cast<int>($1), static_cast<int>($3));
+    }
     | INTEGER_LITERAL DOTDOT ASTERISK
-    { $$ = new bbfm::CardinalityModifier($1, -1); }
+    {
+        if (!CardinalityBoundFits(context, $1, @1.first_line, @1.first_column))
+        {
+            YYERROR;
+        }
+        $$ = new bbfm::CardinalityModifier(static_cast<int>($1), -1);
+    }
     | OPTIONAL
     { $$ = new bbfm::CardinalityModifier(0, 1); }  // optional is equivalent to [0..1]
     | UNIQUE
     { $$ = new bbfm::UniqueModifier(); }
+    | INTERNED
+    { $$ = new bbfm::InternedModifier(); }
+    | ENCODING LPAREN IDENTIFIER RPAREN
+    { $$ = new bbfm::EncodingModifier($3); free($3); }
     ;
 
 /* Expression grammar with operator precedence */
@@ -462,6 +650,24 @@ expression:
     { $$ = new bbfm::ParenthesizedExpression(
         std::unique_ptr<bbfm::Expression>(static_cast<bbfm::Expression*>($2))
     ); }
+    | FORALL IDENTIFIER IN expression COLON expression %prec QUANTIFIER
+    { $$ = new bbfm::QuantifiedExpression(
+        bbfm::QuantifiedExpression::Quantifier::FORALL,
+        $2,
+        std::unique_ptr<bbfm::Expression>(static_cast<bbfm::Expression*>($4)),
+        std::unique_ptr<bbfm::Expression>(static_cast<bbfm::Expression*>($6))
+    );
+      free($2);
+    }
+    | EXISTS IDENTIFIER IN expression COLON expression %prec QUANTIFIER
+    { $$ = new bbfm::QuantifiedExpression(
+        bbfm::QuantifiedExpression::Quantifier::EXISTS,
+        $2,
+        std::unique_ptr<bbfm::Expression>(static_cast<bbfm::Expression*>($4)),
+        std::unique_ptr<bbfm::Expression>(static_cast<bbfm::Expression*>($6))
+    );
+      free($2);
+    }
     | expression DOT IDENTIFIER
     { $$ = new bbfm::MemberAccessExpression(
         std::unique_ptr<bbfm::Expression>(static_cast<bbfm::Expression*>($1)),
@@ -469,6 +675,13 @@ expression:
     );
       free($3);
     }
+    | expression DOT contextual_keyword
+    { $$ = new bbfm::MemberAccessExpression(
+        std::unique_ptr<bbfm::Expression>(static_cast<bbfm::Expression*>($1)),
+        $3
+    );
+      free($3);
+    }
     | primary_expression
     { $$ = $1; }
     ;
@@ -498,38 +711,147 @@ primary_expression:
         $$ = new bbfm::FieldReference($1);
         free($1);
     }
+    | IDENTIFIER LPAREN argument_list RPAREN
+    {
+        auto* args = static_cast<std::vector<std::unique_ptr<bbfm::Expression>>*>($3);
+        $$ = new bbfm::FunctionCall($1, std::move(*args));
+        free($1);
+        delete args;
+    }
+    ;
+
+argument_list:
+    expression
+    {
+        auto* list = new std::vector<std::unique_ptr<bbfm::Expression>>();
+        list->push_back(std::unique_ptr<bbfm::Expression>(static_cast<bbfm::Expression*>($1)));
+        $$ = list;
+    }
+    | argument_list COMMA expression
+    {
+        auto* list = static_cast<std::vector<std::unique_ptr<bbfm::Expression>>*>($1);
+        list->push_back(std::unique_ptr<bbfm::Expression>(static_cast<bbfm::Expression*>($3)));
+        $$ = list;
+    }
     ;
 
 %%
 
-/* Ensure C linkage when compiled as C++ */
-#ifdef __cplusplus
-extern "C" {
-#endif
+static void yyerror(YYLTYPE* location, yyscan_t /*scanner*/, bbfm::ParseContext& context, const char* s) {
+    ReportSyntaxError(context, location->first_line, location->first_column, s);
+}
+
+/* Find a line of the source text, lines are counted from context.firstLine */
+static bool SourceLine(const bbfm::ParseContext& context, const int line, std::string_view& source) {
+    if (line < context.firstLine) {
+        return false;
+    }
+    size_t begin = 0;
+    for (int current = context.firstLine; current < line; ++current) {
+        begin = context.text.find('\n', begin);
+        if (std::string_view::npos == begin) {
+            return false;
+        }
+        ++begin;
+    }
+    const size_t end = context.text.find('\n', begin);
+    source           = context.text.substr(begin, (std::string_view::npos == end) ? std::string_view::npos : end - begin);
+    return true;
+}
 
-void yyerror(const char *s) {
-    std::ostringstream errorMsg;
-    errorMsg << g_current_filename << ":" << yylloc.first_line
-             << ":" << yylloc.first_column
-             << ": error: " << s;
+static void ReportSyntaxError(bbfm::ParseContext& context, const int line, const int column, const char* s) {
+    ++context.syntaxErrorCount;
 
-    bbfm::Console::ReportError(errorMsg.str());
+    bbfm::Diagnostic diagnostic;
+    diagnostic.file    = context.fileName;
+    diagnostic.line    = line;
+    diagnostic.column  = column;
+    diagnostic.message = s;
 
-    // Show the source line if available
-    if (yylloc.first_line > 0 && yylloc.first_line <= static_cast<int>(g_source_lines.size())) {
-        const std::string& line = g_source_lines[yylloc.first_line - 1];
-        bbfm::Console::ReportError(line);
+    // Show the source line with a caret at the error column if available
+    std::string_view source;
+    if (SourceLine(context, line, source)) {
+        diagnostic.sourceLine = std::string(source);
+    }
 
-        // Show a caret pointing to the error column
-        std::ostringstream caretLine;
-        for (int i = 1; i < yylloc.first_column; ++i) {
-            caretLine << " ";
-        }
-        caretLine << "^";
-        bbfm::Console::ReportError(caretLine.str());
+    bbfm::Diagnostics::Report(std::move(diagnostic));
+}
+
+void ReportUnknownCharacter(bbfm::ParseContext& context, const int line, const int column, const char character) {
+    // Bytes that are not printable ASCII are shown as hex, so JSON and SARIF output stays valid UTF-8
+    const unsigned char byte = static_cast<unsigned char>(character);
+    char                shown[8];
+    if (byte >= 0x20 && byte < 0x7f) {
+        snprintf(shown, sizeof(shown), "%c", character);
+    } else {
+        snprintf(shown, sizeof(shown), "\\x%02x", byte);
+    }
+    const std::string message = std::string("unknown character '") + shown + "'";
+    ReportSyntaxError(context, line, column, message.c_str());
+}
+
+static bool CardinalityBoundFits(bbfm::ParseContext& context, const long long bound, const int line, const int column) {
+    if (bound <= INT_MAX) {
+        return true;
     }
+    const std::string message = "cardinality bound is larger than " + std::to_string(INT_MAX);
+    ReportSyntaxError(context, line, column, message.c_str());
+    return false;
 }
 
-#ifdef __cplusplus
+static bbfm::Declaration* DroppedDeclaration(const bbfm::ParseContext& context, const int line, const int column) {
+    // Collect the words of the declaration header, from the error up to the '{' of the body
+    struct Word {
+        std::string text;
+        int         line;
+        int         column;
+    };
+    std::vector<Word> words;
+    bool              body = false;
+    std::string_view  source;
+    for (int current = line; !body && SourceLine(context, current, source); ++current) {
+        size_t pos = (line == current) ? static_cast<size_t>(column - 1) : 0;
+        while (pos < source.size() && '{' != source[pos]) {
+            if (0 != isalpha(static_cast<unsigned char>(source[pos])) || '_' == source[pos]) {
+                const size_t start = pos;
+                while (pos < source.size() && (0 != isalnum(static_cast<unsigned char>(source[pos])) || '_' == source[pos])) {
+                    ++pos;
+                }
+                words.push_back(Word{std::string(source.substr(start, pos - start)), current, static_cast<int>(start) + 1});
+            } else {
+                ++pos;
+            }
+        }
+        body = pos < source.size();
+    }
+
+    // 'class Name ...' and 'enum Name ...', else 'Name inherits ...', else the word before the body
+    const bool keyword = false == words.empty() &&
+                         (0 == strcasecmp(words[0].text.c_str(), "class") || 0 == strcasecmp(words[0].text.c_str(), "enum"));
+    const bool isEnum  = keyword && 0 == strcasecmp(words[0].text.c_str(), "enum");
+    size_t     name    = keyword ? 1 : words.size() - 1;
+    for (size_t i = 1; !keyword && i < words.size(); ++i) {
+        if (0 == strcasecmp(words[i].text.c_str(), "inherits")) {
+            name = i - 1;
+            break;
+        }
+    }
+    if (name >= words.size()) {
+        return nullptr;
+    }
+
+    bbfm::Declaration* declaration = nullptr;
+    if (isEnum) {
+        auto enumDecl = std::make_unique<bbfm::EnumDeclaration>(words[name].text, std::vector<std::string>());
+        enumDecl->SetLocation(words[name].line, words[name].column);
+        declaration = new bbfm::Declaration(std::move(enumDecl));
+    } else {
+        auto classDecl = std::make_unique<bbfm::ClassDeclaration>(words[name].text, "", std::vector<std::unique_ptr<bbfm::Field>>(),
+                                                                  std::vector<std::unique_ptr<bbfm::Invariant>>());
+        classDecl->SetLocation(words[name].line, words[name].column);
+        declaration = new bbfm::Declaration(std::move(classDecl));
+    }
+    declaration->SetSourceFile(context.fileName);
+    declaration->SetHadSyntaxError(true);
+    return declaration;
 }
-#endif